@@ -0,0 +1,192 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief A minimal stand-in for the max-api "c74_max.h" header.
+//! @details Only declares the subset of the Max C API used by the objects of this package,
+//! so that they can be compiled and driven outside of Max by the pa.bench host (see maxhost.cpp).
+//! Declarations follow the signatures of the real max-api.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <math.h>
+
+#if defined(_WIN32)
+#define C74_EXPORT __declspec(dllexport)
+#else
+#define C74_EXPORT __attribute__((visibility("default")))
+#endif
+
+namespace c74
+{
+    namespace max
+    {
+        // ================================================================================ //
+        //                                      TYPES                                       //
+        // ================================================================================ //
+
+        typedef intptr_t    t_ptr_int;
+        typedef int64_t     t_int64;
+        typedef t_int64     t_atom_long;
+        typedef double      t_atom_float;
+        typedef t_atom_long t_max_err;
+
+        typedef void* (*method)(void*, ...);
+
+        struct t_class;
+        struct t_outlet;
+        struct t_inlet;
+
+        //! @brief The header of every Max object.
+        struct t_object
+        {
+            void*       o_messlist;
+            t_ptr_int   o_magic;
+            void*       o_inlet;
+            void*       o_outlet;
+        };
+
+        //! @brief Clocks are plain objects (they are freed with freeobject()).
+        typedef t_object t_clock;
+
+        struct t_symbol
+        {
+            const char* s_name;
+            t_object*   s_thing;
+        };
+
+        union word
+        {
+            t_atom_long     w_long;
+            t_atom_float    w_float;
+            t_symbol*       w_sym;
+            t_object*       w_obj;
+        };
+
+        struct t_atom
+        {
+            short   a_type;
+            word    a_w;
+        };
+
+        enum e_max_atomtypes
+        {
+            A_NOTHING = 0,
+            A_LONG,
+            A_FLOAT,
+            A_SYM,
+            A_OBJ,
+            A_DEFLONG,
+            A_DEFFLOAT,
+            A_DEFSYM,
+            A_GIMME,
+            A_CANT,
+            A_SEMI,
+            A_COMMA,
+            A_DOLLAR,
+            A_DOLLSYM,
+            A_GIMMEBACK,
+            A_DEFER = 0x41,
+            A_USURP = 0x42,
+            A_DEFER_LOW = 0x43,
+            A_USURP_LOW = 0x44
+        };
+
+        enum e_max_errorcodes
+        {
+            MAX_ERR_NONE = 0,
+            MAX_ERR_GENERIC = -1,
+            MAX_ERR_INVALID_PTR = -2,
+            MAX_ERR_DUPLICATE = -3,
+            MAX_ERR_OUT_OF_MEM = -4
+        };
+
+        enum t_assist_function
+        {
+            ASSIST_INLET = 1,
+            ASSIST_OUTLET
+        };
+
+        static const int ASSIST_STRING_MAXSIZE = 256;
+
+        typedef uint32_t t_fourcc;
+
+        //! @brief The size of a path.
+        static const int MAX_PATH_CHARS = 2048;
+
+        // ================================================================================ //
+        //                                       API                                        //
+        // ================================================================================ //
+
+        extern "C"
+        {
+            C74_EXPORT t_symbol* gensym(const char* s);
+
+            C74_EXPORT t_class* class_new(const char* name, const method mnew, const method mfree,
+                                          long size, const method mmenu, short type, ...);
+            C74_EXPORT t_max_err class_addmethod(t_class* c, const method m, const char* name, ...);
+            C74_EXPORT t_max_err class_register(t_symbol* name_space, t_class* c);
+
+            C74_EXPORT void* object_alloc(t_class* c);
+            C74_EXPORT t_max_err object_free(void* x);
+            C74_EXPORT void freeobject(t_object* op);
+            C74_EXPORT method object_method_direct_getmethod(t_object* x, t_symbol* sym);
+            C74_EXPORT void* object_method_direct_getobject(t_object* x, t_symbol* sym);
+
+            C74_EXPORT void object_post(t_object* x, const char* s, ...);
+            C74_EXPORT void object_warn(t_object* x, const char* s, ...);
+            C74_EXPORT void object_error(t_object* x, const char* s, ...);
+            C74_EXPORT void post(const char* fmt, ...);
+
+            C74_EXPORT long atom_gettype(const t_atom* a);
+            C74_EXPORT t_atom_long atom_getlong(const t_atom* a);
+            C74_EXPORT t_atom_float atom_getfloat(const t_atom* a);
+            C74_EXPORT t_symbol* atom_getsym(const t_atom* a);
+            C74_EXPORT t_max_err atom_setlong(t_atom* a, t_atom_long b);
+            C74_EXPORT t_max_err atom_setfloat(t_atom* a, double b);
+            C74_EXPORT t_max_err atom_setsym(t_atom* a, const t_symbol* b);
+
+            C74_EXPORT void* outlet_new(void* x, const char* s);
+            C74_EXPORT void* outlet_bang(void* o);
+            C74_EXPORT void* outlet_int(void* o, t_atom_long n);
+            C74_EXPORT void* outlet_float(void* o, double f);
+            C74_EXPORT void* outlet_list(void* o, t_symbol* s, short ac, t_atom* av);
+            C74_EXPORT void* outlet_anything(void* o, const t_symbol* s, short ac, const t_atom* av);
+
+            C74_EXPORT void* proxy_new(void* x, long id, long* stuffloc);
+            C74_EXPORT long proxy_getinlet(t_object* master);
+
+            C74_EXPORT t_clock* clock_new(void* obj, method fn);
+            C74_EXPORT void clock_delay(t_clock* x, long n);
+            C74_EXPORT void clock_fdelay(t_clock* c, double time);
+            C74_EXPORT void clock_unset(t_clock* x);
+
+            C74_EXPORT float sys_getsr(void);
+            C74_EXPORT int sys_getmaxblksize(void);
+            C74_EXPORT int sys_getdspstate(void);
+
+            C74_EXPORT short locatefile_extended(char* name, short* outvol, t_fourcc* outtype, const t_fourcc* filetypelist, short numtypes);
+            C74_EXPORT t_max_err path_toabsolutesystempath(const short in_path, const char* in_filename, char* out_filepath);
+        }
+
+        //! @brief The default namespace for box classes.
+        #define CLASS_BOX gensym("box")
+
+        //! @brief Call a method of an object directly, skipping typechecking.
+        #define object_method_direct(rt, sig, x, s, ...) \
+        ((rt (*)sig)object_method_direct_getmethod((t_object*)x, s))((t_object*)object_method_direct_getobject((t_object*)x, s), __VA_ARGS__)
+    }
+}
+
+//! @brief The entry point of every external, called once when the class is loaded.
+extern "C" C74_EXPORT void ext_main(void* r);
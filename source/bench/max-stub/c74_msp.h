@@ -0,0 +1,59 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief A minimal stand-in for the max-api "c74_msp.h" header.
+//! @details Adds the MSP part of the API (signal objects and buffer~ access) to c74_max.h.
+
+#pragma once
+
+#include "c74_max.h"
+
+namespace c74
+{
+    namespace max
+    {
+        //! @brief The header of every signal object.
+        struct t_pxobject
+        {
+            t_object    z_ob;
+            long        z_in;
+            void*       z_proxy;
+            long        z_disabled;
+            short       z_count;
+            short       z_misc;
+        };
+
+        typedef void (*t_perfroutine64)(t_object* dsp64, double** ins, long numins,
+                                        double** outs, long numouts, long sampleframes,
+                                        long flags, void* userparam);
+
+        struct t_buffer_ref;
+        struct t_buffer_obj;
+
+        extern "C"
+        {
+            C74_EXPORT void class_dspinit(t_class* c);
+            C74_EXPORT void dsp_setup(t_pxobject* x, long nsignals);
+            C74_EXPORT void dsp_free(t_pxobject* x);
+            C74_EXPORT void dsp_add64(t_object* chain, t_object* x, t_perfroutine64 f,
+                                      long flags, void* userparam);
+
+            C74_EXPORT t_buffer_ref* buffer_ref_new(t_object* self, t_symbol* name);
+            C74_EXPORT void buffer_ref_set(t_buffer_ref* x, t_symbol* name);
+            C74_EXPORT t_atom_long buffer_ref_exists(t_buffer_ref* x);
+            C74_EXPORT t_buffer_obj* buffer_ref_getobject(t_buffer_ref* x);
+            C74_EXPORT t_max_err buffer_ref_notify(t_buffer_ref* x, t_symbol* s, t_symbol* msg,
+                                                   void* sender, void* data);
+
+            C74_EXPORT float* buffer_locksamples(t_buffer_obj* buffer_object);
+            C74_EXPORT void buffer_unlocksamples(t_buffer_obj* buffer_object);
+            C74_EXPORT t_atom_long buffer_getchannelcount(t_buffer_obj* buffer_object);
+            C74_EXPORT t_atom_long buffer_getframecount(t_buffer_obj* buffer_object);
+            C74_EXPORT t_atom_float buffer_getsamplerate(t_buffer_obj* buffer_object);
+            C74_EXPORT t_symbol* buffer_getfilename(t_buffer_obj* buffer_object);
+        }
+    }
+}
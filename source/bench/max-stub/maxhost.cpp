@@ -0,0 +1,903 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief Implementation of the Max API stand-in.
+//! @details Everything runs on the calling thread, there is no scheduler nor patcher.
+
+#include "maxhost.h"
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+
+namespace maxhost
+{
+    // ================================================================================ //
+    //                                  HOST STRUCTURES                                 //
+    // ================================================================================ //
+
+    struct t_method_entry
+    {
+        method              m_method;
+        std::vector<short>  m_types;
+    };
+
+    struct t_outlet_entry
+    {
+        t_object*   m_owner;
+        t_symbol*   m_type;
+        long        m_messages;
+    };
+
+    //! @brief Bookkeeping of an instance (kept outside the object's memory).
+    struct t_object_entry
+    {
+        long                    m_signal_inlets = 0;
+        long                    m_current_inlet = 0;
+        std::vector<std::unique_ptr<t_outlet_entry>> m_outlets;
+    };
+
+    struct t_dspchain
+    {
+        t_object                        m_obj;
+        std::vector<t_perform_call>*    m_calls;
+    };
+
+    static double                       s_samplerate = 44100.;
+    static long                         s_vectorsize = 64;
+    static bool                         s_dspstate = false;
+    static bool                         s_verbose = false;
+    static long                         s_error_count = 0;
+    static double                       s_time_ms = 0.;
+    static t_class*                     s_last_registered = nullptr;
+    static std::map<t_object*, t_object_entry> s_objects;
+}
+
+using namespace maxhost;
+
+namespace c74
+{
+    namespace max
+    {
+        struct t_class
+        {
+            std::string                             m_name;
+            method                                  m_new;
+            method                                  m_free;
+            long                                    m_size;
+            std::vector<short>                      m_new_types;
+            std::map<t_symbol*, t_method_entry>     m_methods;
+            bool                                    m_dsp = false;
+        };
+
+        struct t_clock_entry
+        {
+            t_object    m_obj;
+            void*       m_owner;
+            method      m_fn;
+            double      m_when;
+            bool        m_set;
+        };
+
+        struct t_buffer_obj
+        {
+            t_symbol*           m_name;
+            t_atom_long         m_frames;
+            t_atom_long         m_channels;
+            double              m_samplerate;
+            std::vector<float>  m_samples;
+        };
+
+        struct t_buffer_ref
+        {
+            t_object    m_obj;
+            t_object*   m_owner;
+            t_symbol*   m_name;
+        };
+    }
+}
+
+namespace maxhost
+{
+    static std::vector<t_clock_entry*>                  s_clocks;
+    static std::vector<t_buffer_ref*>               s_buffer_refs;
+    static std::map<t_symbol*, std::unique_ptr<t_buffer_obj>> s_buffers;
+
+    //! @brief Classes of the objects allocated by the host itself.
+    static t_class* host_class(const char* name, method mfree = nullptr)
+    {
+        static std::map<std::string, std::unique_ptr<t_class>> classes;
+
+        std::unique_ptr<t_class>& c = classes[name];
+        if(!c)
+        {
+            c.reset(new t_class());
+            c->m_name = name;
+            c->m_new = nullptr;
+            c->m_free = mfree;
+            c->m_size = 0;
+        }
+
+        return c.get();
+    }
+
+    static void* clock_free(t_clock_entry* clock)
+    {
+        s_clocks.erase(std::remove(s_clocks.begin(), s_clocks.end(), clock), s_clocks.end());
+        return nullptr;
+    }
+
+    static void* buffer_ref_free(t_buffer_ref* ref)
+    {
+        s_buffer_refs.erase(std::remove(s_buffer_refs.begin(), s_buffer_refs.end(), ref), s_buffer_refs.end());
+        return nullptr;
+    }
+
+    static t_class* object_class(t_object* x)
+    {
+        return x ? static_cast<t_class*>(x->o_messlist) : nullptr;
+    }
+
+    static void dspchain_add64(t_dspchain* chain, t_object* x, t_perfroutine64 f, long flags, void* userparam)
+    {
+        chain->m_calls->push_back({x, (t_perfroutine64_x)f, flags, userparam});
+    }
+
+    static void vprint(const char* prefix, t_object* x, const char* fmt, va_list args)
+    {
+        if(!s_verbose) return;
+
+        t_class* c = object_class(x);
+        fprintf(stderr, "%s%s%s", c ? c->m_name.c_str() : "", c ? ": " : "", prefix);
+        vfprintf(stderr, fmt, args);
+        fprintf(stderr, "\n");
+    }
+
+    static t_method_entry const* find_method(t_object* x, t_symbol* s)
+    {
+        t_class* c = object_class(x);
+        if(!c) return nullptr;
+
+        auto it = c->m_methods.find(s);
+        return (it != c->m_methods.end()) ? &it->second : nullptr;
+    }
+
+    //! @brief Arguments of a typed method call, split by register bank.
+    //! @details Integer and pointer arguments are passed in the general purpose registers
+    //! and floating-point arguments in the vector registers, independently of their order.
+    //! This is also how Max dispatches typed messages, it holds for x86-64 and arm64.
+    struct t_typed_args
+    {
+        t_ptr_int   ints[4] = {0, 0, 0, 0};
+        double      floats[4] = {0., 0., 0., 0.};
+    };
+
+    static t_typed_args collect_typed_args(std::vector<short> const& types, std::vector<t_atom> const& args)
+    {
+        t_typed_args typed;
+        int nints = 0, nfloats = 0;
+        size_t argi = 0;
+
+        for(short type : types)
+        {
+            const t_atom* a = (argi < args.size()) ? &args[argi] : nullptr;
+            argi++;
+
+            switch(type)
+            {
+                case A_LONG:
+                case A_DEFLONG:
+                    if(nints < 4) typed.ints[nints++] = a ? (t_ptr_int)atom_getlong(a) : 0;
+                    break;
+                case A_FLOAT:
+                case A_DEFFLOAT:
+                    if(nfloats < 4) typed.floats[nfloats++] = a ? atom_getfloat(a) : 0.;
+                    break;
+                case A_SYM:
+                case A_DEFSYM:
+                    if(nints < 4) typed.ints[nints++] = (t_ptr_int)(a ? atom_getsym(a) : gensym(""));
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        return typed;
+    }
+
+    static void call_typed(method m, t_object* x, std::vector<short> const& types,
+                           std::vector<t_atom> const& args)
+    {
+        typedef void* (*t_typed_method)(void*, t_ptr_int, t_ptr_int, t_ptr_int, t_ptr_int,
+                                        double, double, double, double);
+
+        const t_typed_args t = collect_typed_args(types, args);
+        ((t_typed_method)m)(x, t.ints[0], t.ints[1], t.ints[2], t.ints[3],
+                            t.floats[0], t.floats[1], t.floats[2], t.floats[3]);
+    }
+
+    // ================================================================================ //
+    //                                     SETTINGS                                     //
+    // ================================================================================ //
+
+    void set_samplerate(double samplerate)  { s_samplerate = samplerate; }
+    void set_vectorsize(long vectorsize)    { s_vectorsize = vectorsize; }
+    void set_dspstate(bool state)           { s_dspstate = state; }
+    void set_verbose(bool verbose)          { s_verbose = verbose; }
+    long error_count()                      { return s_error_count; }
+
+    // ================================================================================ //
+    //                                 CLASSES / OBJECTS                                //
+    // ================================================================================ //
+
+    t_class* load_external(std::string const& path, std::string& error)
+    {
+        void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if(!handle)
+        {
+            error = dlerror();
+            return nullptr;
+        }
+
+        typedef void (*t_ext_main)(void*);
+        t_ext_main entry = (t_ext_main)dlsym(handle, "ext_main");
+        if(!entry)
+        {
+            error = "no ext_main in " + path;
+            return nullptr;
+        }
+
+        s_last_registered = nullptr;
+        entry(nullptr);
+
+        if(!s_last_registered)
+        {
+            error = "ext_main did not register a class";
+        }
+
+        return s_last_registered;
+    }
+
+    std::string class_name(t_class* c)
+    {
+        return c ? c->m_name : std::string();
+    }
+
+    bool class_is_dsp(t_class* c)
+    {
+        return c && c->m_dsp;
+    }
+
+    std::vector<t_atom> parse_atoms(std::string const& text)
+    {
+        std::vector<t_atom> atoms;
+        std::istringstream stream(text);
+        std::string token;
+
+        while(stream >> token)
+        {
+            t_atom a;
+            char* end = nullptr;
+
+            const long long l = strtoll(token.c_str(), &end, 10);
+            if(*end == '\0')
+            {
+                atom_setlong(&a, l);
+            }
+            else
+            {
+                const double d = strtod(token.c_str(), &end);
+                if(*end == '\0')
+                {
+                    atom_setfloat(&a, d);
+                }
+                else
+                {
+                    atom_setsym(&a, gensym(token.c_str()));
+                }
+            }
+
+            atoms.push_back(a);
+        }
+
+        return atoms;
+    }
+
+    t_object* object_create(t_class* c, std::vector<t_atom> const& args)
+    {
+        if(!c || !c->m_new) return nullptr;
+
+        t_symbol* name = gensym(c->m_name.c_str());
+        void* x = nullptr;
+
+        if(!c->m_new_types.empty() && c->m_new_types[0] == A_GIMME)
+        {
+            typedef void* (*t_gimme_new)(t_symbol*, long, t_atom*);
+            x = ((t_gimme_new)c->m_new)(name, (long)args.size(), const_cast<t_atom*>(args.data()));
+        }
+        else
+        {
+            typedef void* (*t_typed_new)(t_ptr_int, t_ptr_int, t_ptr_int, t_ptr_int,
+                                         double, double, double, double);
+
+            const t_typed_args t = collect_typed_args(c->m_new_types, args);
+            x = ((t_typed_new)c->m_new)(t.ints[0], t.ints[1], t.ints[2], t.ints[3],
+                                        t.floats[0], t.floats[1], t.floats[2], t.floats[3]);
+        }
+
+        return static_cast<t_object*>(x);
+    }
+
+    void object_destroy(t_object* x)
+    {
+        object_free(x);
+    }
+
+    bool object_send(t_object* x, std::string const& message, long inlet)
+    {
+        std::vector<t_atom> atoms = parse_atoms(message);
+        if(atoms.empty()) return false;
+
+        t_symbol* selector = nullptr;
+
+        // leading numbers are "int", "float" or "list" messages, as in Max.
+        if(atom_gettype(&atoms[0]) != A_SYM)
+        {
+            if(atoms.size() > 1) selector = gensym("list");
+            else selector = gensym(atom_gettype(&atoms[0]) == A_LONG ? "int" : "float");
+        }
+        else
+        {
+            selector = atom_getsym(&atoms[0]);
+            atoms.erase(atoms.begin());
+        }
+
+        t_method_entry const* entry = find_method(x, selector);
+
+        // an int can be received by a float method and vice versa.
+        if(!entry && selector == gensym("int")) entry = find_method(x, (selector = gensym("float")));
+        else if(!entry && selector == gensym("float")) entry = find_method(x, (selector = gensym("int")));
+
+        if(!entry || (!entry->m_types.empty() && entry->m_types[0] == A_CANT))
+        {
+            return false;
+        }
+
+        s_objects[x].m_current_inlet = inlet;
+
+        if(entry->m_types.empty())
+        {
+            // methods declared without arguments (bang, clear...)
+            ((void* (*)(void*))entry->m_method)(x);
+        }
+        else if(entry->m_types[0] == A_GIMME)
+        {
+            typedef void* (*t_gimme_method)(void*, t_symbol*, long, t_atom*);
+            ((t_gimme_method)entry->m_method)(x, selector, (long)atoms.size(), atoms.data());
+        }
+        else
+        {
+            call_typed(entry->m_method, x, entry->m_types, atoms);
+        }
+
+        s_objects[x].m_current_inlet = 0;
+        return true;
+    }
+
+    long object_signal_inlets(t_object* x)
+    {
+        auto it = s_objects.find(x);
+        return (it != s_objects.end()) ? it->second.m_signal_inlets : 0;
+    }
+
+    long object_signal_outlets(t_object* x)
+    {
+        long count = 0;
+        auto it = s_objects.find(x);
+        if(it != s_objects.end())
+        {
+            for(auto const& outlet : it->second.m_outlets)
+            {
+                if(outlet->m_type == gensym("signal")) count++;
+            }
+        }
+
+        return count;
+    }
+
+    long object_outlet_messages(t_object* x)
+    {
+        long count = 0;
+        auto it = s_objects.find(x);
+        if(it != s_objects.end())
+        {
+            for(auto const& outlet : it->second.m_outlets)
+            {
+                count += outlet->m_messages;
+            }
+        }
+
+        return count;
+    }
+
+    // ================================================================================ //
+    //                                       DSP                                        //
+    // ================================================================================ //
+
+    std::vector<t_perform_call> object_dsp(t_object* x, std::vector<short> connected,
+                                           double samplerate, long maxvectorsize)
+    {
+        std::vector<t_perform_call> calls;
+
+        t_method_entry const* entry = find_method(x, gensym("dsp64"));
+        if(!entry) return calls;
+
+        static t_class* chain_class = nullptr;
+        if(!chain_class)
+        {
+            chain_class = host_class("dspchain");
+            chain_class->m_methods[gensym("dsp_add64")] = {(method)dspchain_add64, {A_CANT}};
+        }
+
+        t_dspchain chain;
+        chain.m_obj.o_messlist = chain_class;
+        chain.m_calls = &calls;
+
+        const size_t count_size = object_signal_inlets(x) + object_signal_outlets(x);
+        if(connected.size() < count_size) connected.resize(count_size, 0);
+
+        typedef void (*t_dsp64_method)(t_object*, t_object*, short*, double, long, long);
+        ((t_dsp64_method)entry->m_method)(x, (t_object*)&chain, connected.data(),
+                                          samplerate, maxvectorsize, 0);
+
+        return calls;
+    }
+
+    // ================================================================================ //
+    //                                  CLOCKS / BUFFERS                                //
+    // ================================================================================ //
+
+    void advance_time(double ms)
+    {
+        s_time_ms += ms;
+
+        for(size_t i = 0; i < s_clocks.size(); ++i)
+        {
+            t_clock_entry* clock = s_clocks[i];
+            if(clock->m_set && clock->m_when <= s_time_ms)
+            {
+                clock->m_set = false;
+                ((void* (*)(void*))clock->m_fn)(clock->m_owner);
+            }
+        }
+    }
+
+    float* buffer_create(std::string const& name, t_atom_long frames,
+                         t_atom_long channels, double samplerate)
+    {
+        t_symbol* s = gensym(name.c_str());
+        std::unique_ptr<t_buffer_obj>& buffer = s_buffers[s];
+        if(!buffer) buffer.reset(new t_buffer_obj());
+
+        buffer->m_name = s;
+        buffer->m_frames = frames;
+        buffer->m_channels = channels;
+        buffer->m_samplerate = samplerate;
+        buffer->m_samples.assign(frames * channels, 0.f);
+
+        return buffer->m_samples.data();
+    }
+
+    void buffer_modified(std::string const& name)
+    {
+        t_symbol* s = gensym(name.c_str());
+        auto it = s_buffers.find(s);
+        if(it == s_buffers.end()) return;
+
+        // copy the list, an object may change its reference when notified.
+        std::vector<t_buffer_ref*> refs = s_buffer_refs;
+
+        for(t_buffer_ref* ref : refs)
+        {
+            if(ref->m_name != s) continue;
+
+            t_method_entry const* entry = find_method(ref->m_owner, gensym("notify"));
+            if(entry)
+            {
+                typedef t_max_err (*t_notify_method)(t_object*, t_symbol*, t_symbol*, void*, void*);
+                ((t_notify_method)entry->m_method)(ref->m_owner, s, gensym("buffer_modified"),
+                                                   it->second.get(), nullptr);
+            }
+        }
+    }
+}
+
+// ================================================================================ //
+//                                     MAX API                                      //
+// ================================================================================ //
+
+namespace c74
+{
+    namespace max
+    {
+        t_symbol* gensym(const char* s)
+        {
+            static std::unordered_map<std::string, std::unique_ptr<t_symbol>> table;
+
+            std::unique_ptr<t_symbol>& sym = table[s ? s : ""];
+            if(!sym)
+            {
+                sym.reset(new t_symbol());
+                sym->s_name = strdup(s ? s : "");
+                sym->s_thing = nullptr;
+            }
+
+            return sym.get();
+        }
+
+        t_class* class_new(const char* name, const method mnew, const method mfree,
+                           long size, const method mmenu, short type, ...)
+        {
+            t_class* c = new t_class();
+            c->m_name = name;
+            c->m_new = mnew;
+            c->m_free = mfree;
+            c->m_size = size;
+
+            va_list args;
+            va_start(args, type);
+            for(int t = type; t != A_NOTHING; t = va_arg(args, int))
+            {
+                c->m_new_types.push_back((short)t);
+            }
+            va_end(args);
+
+            return c;
+        }
+
+        t_max_err class_addmethod(t_class* c, const method m, const char* name, ...)
+        {
+            if(!c) return MAX_ERR_INVALID_PTR;
+
+            t_method_entry entry;
+            entry.m_method = m;
+
+            va_list args;
+            va_start(args, name);
+            for(int t = va_arg(args, int); t != A_NOTHING; t = va_arg(args, int))
+            {
+                entry.m_types.push_back((short)t);
+            }
+            va_end(args);
+
+            c->m_methods[gensym(name)] = entry;
+            return MAX_ERR_NONE;
+        }
+
+        t_max_err class_register(t_symbol* name_space, t_class* c)
+        {
+            s_last_registered = c;
+            return MAX_ERR_NONE;
+        }
+
+        void class_dspinit(t_class* c)
+        {
+            c->m_dsp = true;
+        }
+
+        void* object_alloc(t_class* c)
+        {
+            // like Max: zeroed memory, no constructor is called.
+            t_object* x = (t_object*)calloc(1, c->m_size);
+            if(x)
+            {
+                x->o_messlist = c;
+                s_objects[x];
+            }
+
+            return x;
+        }
+
+        t_max_err object_free(void* x)
+        {
+            t_object* ob = (t_object*)x;
+            if(!ob) return MAX_ERR_INVALID_PTR;
+
+            t_class* c = object_class(ob);
+            if(c && c->m_free)
+            {
+                ((void* (*)(void*))c->m_free)(ob);
+            }
+
+            s_objects.erase(ob);
+            free(ob);
+            return MAX_ERR_NONE;
+        }
+
+        void freeobject(t_object* op)
+        {
+            object_free(op);
+        }
+
+        method object_method_direct_getmethod(t_object* x, t_symbol* sym)
+        {
+            t_method_entry const* entry = find_method(x, sym);
+            return entry ? entry->m_method : nullptr;
+        }
+
+        void* object_method_direct_getobject(t_object* x, t_symbol* sym)
+        {
+            return x;
+        }
+
+        void object_post(t_object* x, const char* s, ...)
+        {
+            va_list args;
+            va_start(args, s);
+            vprint("", x, s, args);
+            va_end(args);
+        }
+
+        void object_warn(t_object* x, const char* s, ...)
+        {
+            va_list args;
+            va_start(args, s);
+            vprint("warning: ", x, s, args);
+            va_end(args);
+        }
+
+        void object_error(t_object* x, const char* s, ...)
+        {
+            s_error_count++;
+
+            va_list args;
+            va_start(args, s);
+            vprint("error: ", x, s, args);
+            va_end(args);
+        }
+
+        void post(const char* fmt, ...)
+        {
+            va_list args;
+            va_start(args, fmt);
+            vprint("", nullptr, fmt, args);
+            va_end(args);
+        }
+
+        long atom_gettype(const t_atom* a)
+        {
+            return a ? a->a_type : A_NOTHING;
+        }
+
+        t_atom_long atom_getlong(const t_atom* a)
+        {
+            if(!a) return 0;
+            if(a->a_type == A_LONG) return a->a_w.w_long;
+            if(a->a_type == A_FLOAT) return (t_atom_long)a->a_w.w_float;
+            return 0;
+        }
+
+        t_atom_float atom_getfloat(const t_atom* a)
+        {
+            if(!a) return 0.;
+            if(a->a_type == A_FLOAT) return a->a_w.w_float;
+            if(a->a_type == A_LONG) return (t_atom_float)a->a_w.w_long;
+            return 0.;
+        }
+
+        t_symbol* atom_getsym(const t_atom* a)
+        {
+            return (a && a->a_type == A_SYM) ? a->a_w.w_sym : gensym("");
+        }
+
+        t_max_err atom_setlong(t_atom* a, t_atom_long b)
+        {
+            a->a_type = A_LONG;
+            a->a_w.w_long = b;
+            return MAX_ERR_NONE;
+        }
+
+        t_max_err atom_setfloat(t_atom* a, double b)
+        {
+            a->a_type = A_FLOAT;
+            a->a_w.w_float = b;
+            return MAX_ERR_NONE;
+        }
+
+        t_max_err atom_setsym(t_atom* a, const t_symbol* b)
+        {
+            a->a_type = A_SYM;
+            a->a_w.w_sym = const_cast<t_symbol*>(b);
+            return MAX_ERR_NONE;
+        }
+
+        void* outlet_new(void* x, const char* s)
+        {
+            std::unique_ptr<t_outlet_entry> outlet(new t_outlet_entry());
+            outlet->m_owner = (t_object*)x;
+            outlet->m_type = gensym(s ? s : "");
+            outlet->m_messages = 0;
+
+            t_outlet_entry* ptr = outlet.get();
+            s_objects[(t_object*)x].m_outlets.push_back(std::move(outlet));
+            return ptr;
+        }
+
+        static void* outlet_count(void* o)
+        {
+            if(o) static_cast<t_outlet_entry*>(o)->m_messages++;
+            return nullptr;
+        }
+
+        void* outlet_bang(void* o)                                              { return outlet_count(o); }
+        void* outlet_int(void* o, t_atom_long n)                                { return outlet_count(o); }
+        void* outlet_float(void* o, double f)                                   { return outlet_count(o); }
+        void* outlet_list(void* o, t_symbol* s, short ac, t_atom* av)           { return outlet_count(o); }
+        void* outlet_anything(void* o, const t_symbol* s, short ac, const t_atom* av) { return outlet_count(o); }
+
+        void* proxy_new(void* x, long id, long* stuffloc)
+        {
+            return nullptr;
+        }
+
+        long proxy_getinlet(t_object* master)
+        {
+            auto it = s_objects.find(master);
+            return (it != s_objects.end()) ? it->second.m_current_inlet : 0;
+        }
+
+        t_clock* clock_new(void* obj, method fn)
+        {
+            t_clock_entry* clock = (t_clock_entry*)calloc(1, sizeof(t_clock_entry));
+            clock->m_obj.o_messlist = host_class("clock", (method)clock_free);
+            clock->m_owner = obj;
+            clock->m_fn = fn;
+            clock->m_set = false;
+
+            s_clocks.push_back(clock);
+            return (t_clock*)clock;
+        }
+
+        void clock_fdelay(t_clock* c, double time)
+        {
+            t_clock_entry* clock = (t_clock_entry*)c;
+            clock->m_when = s_time_ms + time;
+            clock->m_set = true;
+        }
+
+        void clock_delay(t_clock* x, long n)
+        {
+            clock_fdelay(x, (double)n);
+        }
+
+        void clock_unset(t_clock* x)
+        {
+            ((t_clock_entry*)x)->m_set = false;
+        }
+
+        float sys_getsr(void)
+        {
+            return (float)s_samplerate;
+        }
+
+        int sys_getmaxblksize(void)
+        {
+            return (int)s_vectorsize;
+        }
+
+        int sys_getdspstate(void)
+        {
+            return s_dspstate ? 1 : 0;
+        }
+
+        // there is no search path: a file is found if it can be opened (relative to the working directory)
+        short locatefile_extended(char* name, short* outvol, t_fourcc* outtype, const t_fourcc* filetypelist, short numtypes)
+        {
+            FILE* file = std::fopen(name, "rb");
+
+            if(!file)
+            {
+                return 1;
+            }
+
+            std::fclose(file);
+            *outvol = 0;
+            *outtype = 0;
+            return 0;
+        }
+
+        t_max_err path_toabsolutesystempath(const short in_path, const char* in_filename, char* out_filepath)
+        {
+            std::snprintf(out_filepath, MAX_PATH_CHARS, "%s", in_filename);
+            return MAX_ERR_NONE;
+        }
+
+        void dsp_setup(t_pxobject* x, long nsignals)
+        {
+            x->z_in = nsignals;
+            s_objects[(t_object*)x].m_signal_inlets = nsignals;
+        }
+
+        void dsp_free(t_pxobject* x)
+        {
+            ;
+        }
+
+        void dsp_add64(t_object* chain, t_object* x, t_perfroutine64 f, long flags, void* userparam)
+        {
+            dspchain_add64((t_dspchain*)chain, x, f, flags, userparam);
+        }
+
+        t_buffer_ref* buffer_ref_new(t_object* self, t_symbol* name)
+        {
+            t_buffer_ref* ref = (t_buffer_ref*)calloc(1, sizeof(t_buffer_ref));
+            ref->m_obj.o_messlist = host_class("buffer_ref", (method)buffer_ref_free);
+            ref->m_owner = self;
+            ref->m_name = name;
+
+            s_buffer_refs.push_back(ref);
+            return ref;
+        }
+
+        void buffer_ref_set(t_buffer_ref* x, t_symbol* name)
+        {
+            if(x) x->m_name = name;
+        }
+
+        t_buffer_obj* buffer_ref_getobject(t_buffer_ref* x)
+        {
+            if(!x) return nullptr;
+
+            auto it = s_buffers.find(x->m_name);
+            return (it != s_buffers.end()) ? it->second.get() : nullptr;
+        }
+
+        t_atom_long buffer_ref_exists(t_buffer_ref* x)
+        {
+            return buffer_ref_getobject(x) ? 1 : 0;
+        }
+
+        t_max_err buffer_ref_notify(t_buffer_ref* x, t_symbol* s, t_symbol* msg, void* sender, void* data)
+        {
+            return MAX_ERR_NONE;
+        }
+
+        float* buffer_locksamples(t_buffer_obj* buffer_object)
+        {
+            return (buffer_object && !buffer_object->m_samples.empty()) ? buffer_object->m_samples.data() : nullptr;
+        }
+
+        void buffer_unlocksamples(t_buffer_obj* buffer_object)
+        {
+            ;
+        }
+
+        t_atom_long buffer_getchannelcount(t_buffer_obj* buffer_object)
+        {
+            return buffer_object ? buffer_object->m_channels : 0;
+        }
+
+        t_atom_long buffer_getframecount(t_buffer_obj* buffer_object)
+        {
+            return buffer_object ? buffer_object->m_frames : 0;
+        }
+
+        t_atom_float buffer_getsamplerate(t_buffer_obj* buffer_object)
+        {
+            return buffer_object ? buffer_object->m_samplerate : 0.;
+        }
+
+        t_symbol* buffer_getfilename(t_buffer_obj* buffer_object)
+        {
+            return gensym("");
+        }
+    }
+}
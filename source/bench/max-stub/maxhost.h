@@ -0,0 +1,123 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief Host side of the Max API stand-in.
+//! @details Lets a program load the externals of this package as plain shared libraries,
+//! instantiate them, send them messages and run their perform routines without Max.
+
+#pragma once
+
+#include "c74_msp.h"
+
+#include <string>
+#include <vector>
+
+namespace maxhost
+{
+    using namespace c74::max;
+
+    //! @brief The perform routine signature as it is really called by MSP (with the object first).
+    typedef void (*t_perfroutine64_x)(t_object* x, t_object* dsp64, double** ins, long numins,
+                                      double** outs, long numouts, long sampleframes,
+                                      long flags, void* userparam);
+
+    //! @brief A perform routine added to the chain by an object in its dsp64 method.
+    struct t_perform_call
+    {
+        t_object*           m_object;
+        t_perfroutine64_x   m_perform;
+        long                m_flags;
+        void*               m_userparam;
+    };
+
+    // ================================================================================ //
+    //                                     SETTINGS                                     //
+    // ================================================================================ //
+
+    //! @brief Set the value returned by sys_getsr().
+    void set_samplerate(double samplerate);
+
+    //! @brief Set the value returned by sys_getmaxblksize().
+    void set_vectorsize(long vectorsize);
+
+    //! @brief Set the value returned by sys_getdspstate().
+    void set_dspstate(bool state);
+
+    //! @brief Counts the errors reported by objects with object_error().
+    long error_count();
+
+    //! @brief Enable or disable the printing of object_post() and object_error() messages.
+    void set_verbose(bool verbose);
+
+    // ================================================================================ //
+    //                                 CLASSES / OBJECTS                                //
+    // ================================================================================ //
+
+    //! @brief Load an external from a shared library file and run its ext_main().
+    //! @return The class registered by the external or nullptr on failure.
+    t_class* load_external(std::string const& path, std::string& error);
+
+    //! @brief Returns the name of a class.
+    std::string class_name(t_class* c);
+
+    //! @brief Returns true if the class called class_dspinit().
+    bool class_is_dsp(t_class* c);
+
+    //! @brief Parse a space separated string into atoms (as in a Max box).
+    std::vector<t_atom> parse_atoms(std::string const& text);
+
+    //! @brief Instantiate an object of a given class with creation arguments.
+    t_object* object_create(t_class* c, std::vector<t_atom> const& args);
+
+    //! @brief Call the free method of an object then release its memory.
+    void object_destroy(t_object* x);
+
+    //! @brief Send a message to an object as if it was received in a given inlet.
+    //! @details "int", "float" and "list" messages are resolved as in Max.
+    //! @return false if the object does not understand the message.
+    bool object_send(t_object* x, std::string const& message, long inlet = 0);
+
+    //! @brief Returns the number of signal inlets created with dsp_setup().
+    long object_signal_inlets(t_object* x);
+
+    //! @brief Returns the number of outlets created with the "signal" type.
+    long object_signal_outlets(t_object* x);
+
+    //! @brief Returns the number of messages sent through the outlets of an object.
+    long object_outlet_messages(t_object* x);
+
+    // ================================================================================ //
+    //                                       DSP                                        //
+    // ================================================================================ //
+
+    //! @brief Call the dsp64 method of an object and collect the perform routines it adds.
+    //! @param connected One flag per signal inlet then per signal outlet (the count array of dsp64).
+    std::vector<t_perform_call> object_dsp(t_object* x, std::vector<short> connected,
+                                           double samplerate, long maxvectorsize);
+
+    //! @brief Run a perform routine on one vector.
+    inline void perform(t_perform_call const& call,
+                        double** ins, long numins, double** outs, long numouts, long vecsize)
+    {
+        call.m_perform(call.m_object, nullptr, ins, numins, outs, numouts,
+                       vecsize, call.m_flags, call.m_userparam);
+    }
+
+    // ================================================================================ //
+    //                                  CLOCKS / BUFFERS                                //
+    // ================================================================================ //
+
+    //! @brief Advance the scheduler time and fire the clocks that are due.
+    void advance_time(double ms);
+
+    //! @brief Create (or replace) a named buffer~ that objects can reference.
+    //! @return A pointer to the interleaved samples of the buffer.
+    float* buffer_create(std::string const& name, t_atom_long frames,
+                         t_atom_long channels, double samplerate);
+
+    //! @brief Send a "buffer_modified" notification to every object referencing a buffer.
+    void buffer_modified(std::string const& name);
+}
@@ -0,0 +1,1216 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief Throughput benchmark of the pa.* signal objects, without Max.
+//! @details Loads every external as a shared library through the Max API stand-in,
+//! runs its perform routine(s) at the requested vector sizes and sampling rates
+//! and reports throughput, per-vector latency percentiles and CPU budget usage.
+
+#include "maxhost.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace c74::max;
+
+// ================================================================================ //
+//                                      SIGNALS                                     //
+// ================================================================================ //
+
+//! @brief Describes the signal connected to an inlet.
+struct t_signal
+{
+    enum e_kind
+    {
+        None = 0,   // not connected
+        Const,      // m_value1
+        Noise,      // white noise with m_value1 amplitude
+        Sine,       // sine at m_value1 Hz
+        Ramp        // sawtooth from m_value1 to m_value2 every m_period seconds
+    };
+
+    e_kind  m_kind = None;
+    double  m_value1 = 0.;
+    double  m_value2 = 0.;
+    double  m_period = 1.;
+
+    // generator state
+    double  m_phase = 0.;
+
+    static t_signal constant(double value)          { t_signal s; s.m_kind = Const; s.m_value1 = value; return s; }
+    static t_signal noise(double amp = 1.)          { t_signal s; s.m_kind = Noise; s.m_value1 = amp; return s; }
+    static t_signal sine(double freq)               { t_signal s; s.m_kind = Sine; s.m_value1 = freq; return s; }
+    static t_signal ramp(double from, double to, double period)
+    {
+        t_signal s; s.m_kind = Ramp; s.m_value1 = from; s.m_value2 = to; s.m_period = period; return s;
+    }
+
+    //! @brief Fill a vector with the next samples of the signal.
+    void generate(double* out, long vecsize, double samplerate, std::minstd_rand& rng)
+    {
+        switch(m_kind)
+        {
+            case None:
+            {
+                std::fill(out, out + vecsize, 0.);
+                break;
+            }
+            case Const:
+            {
+                std::fill(out, out + vecsize, m_value1);
+                break;
+            }
+            case Noise:
+            {
+                std::uniform_real_distribution<double> dist(-m_value1, m_value1);
+                for(long i = 0; i < vecsize; ++i) out[i] = dist(rng);
+                break;
+            }
+            case Sine:
+            {
+                const double inc = m_value1 / samplerate;
+                for(long i = 0; i < vecsize; ++i)
+                {
+                    out[i] = sin(2. * M_PI * m_phase);
+                    m_phase += inc;
+                    if(m_phase >= 1.) m_phase -= 1.;
+                }
+                break;
+            }
+            case Ramp:
+            {
+                const double inc = 1. / (m_period * samplerate);
+                for(long i = 0; i < vecsize; ++i)
+                {
+                    out[i] = m_value1 + m_phase * (m_value2 - m_value1);
+                    m_phase += inc;
+                    if(m_phase >= 1.) m_phase -= 1.;
+                }
+                break;
+            }
+        }
+    }
+};
+
+// ================================================================================ //
+//                                      CHECKS                                      //
+// ================================================================================ //
+
+//! @brief Returns the largest error of a vector of outputs against the expected ones (called for every vector).
+using t_check = std::function<double(double const* const* ins, double const* const* outs,
+                                     long vecsize, double samplerate)>;
+
+//! @brief Compares an oscillator with an ideal one, its phase accumulated in long double.
+//! @param freq The frequency, or 0 to read it from the first inlet.
+//! @param cosine true for cos(2pi.phase), false for the phase (compared modulo 1).
+static t_check check_oscillator(double freq, bool cosine)
+{
+    long double phase = 0.;
+
+    return [phase, freq, cosine](double const* const* ins, double const* const* outs,
+                                 long vecsize, double samplerate) mutable
+    {
+        double error = 0.;
+
+        for(long i = 0; i < vecsize; ++i)
+        {
+            double diff = 0.;
+
+            if(cosine)
+            {
+                diff = std::abs(outs[0][i] - (double)cosl(2.L * (long double)M_PI * phase));
+            }
+            else
+            {
+                diff = std::abs(outs[0][i] - (double)phase);
+                diff -= std::floor(diff);
+                diff = std::min(diff, 1. - diff);
+            }
+
+            error = std::max(error, diff);
+
+            phase += (long double)(freq != 0. ? freq : ins[0][i]) / samplerate;
+            phase -= floorl(phase);
+        }
+
+        return error;
+    };
+}
+
+//! @brief Compares a 32-bit fixed-point oscillator with the exact sum of its quantized increments.
+//! @details The float frequency is rounded to 2^-32 period per sample and the signal one is truncated,
+//! so the phasor must match exactly and the cosine only differs by the table error.
+static t_check check_fixed_oscillator(double freq, bool cosine)
+{
+    uint32_t phase = 0;
+
+    return [phase, freq, cosine](double const* const* ins, double const* const* outs,
+                                 long vecsize, double samplerate) mutable
+    {
+        const double period = 4294967296.;
+        const uint32_t phase_inc = (uint32_t)std::llround(std::fmod(freq / samplerate, 1.) * period);
+        const double scale = period / samplerate;
+        double error = 0.;
+
+        for(long i = 0; i < vecsize; ++i)
+        {
+            const long double value = phase / (long double)period;
+            const double expected = cosine ? (double)cosl(2.L * (long double)M_PI * value) : (double)value;
+
+            error = std::max(error, std::abs(outs[0][i] - expected));
+
+            phase += (freq != 0.) ? phase_inc : (uint32_t)(int64_t)(ins[0][i] * scale);
+        }
+
+        return error;
+    };
+}
+
+//! @brief Compares pa.oscbank~ with the mean of its partials (55 + 10i Hz, amplitude 1), every 8 samples.
+//! @param lag The number of samples the output is behind the partials (the hop of the inverse FFT),
+//! the samples before the first complete frame are not compared.
+static t_check check_oscbank(long partials, long lag)
+{
+    long long sample = 0;
+
+    return [sample, partials, lag](double const* const* ins, double const* const* outs,
+                                   long vecsize, double samplerate) mutable
+    {
+        double error = 0.;
+
+        for(long i = 0; i < vecsize; ++i, ++sample)
+        {
+            if(sample < 2 * lag || sample % 8 != 0) continue;
+
+            const long double t = (long double)(sample - lag) / samplerate;
+            long double sum = 0.;
+
+            for(long p = 0; p < partials; ++p)
+            {
+                sum += cosl(2.L * (long double)M_PI * (55.L + 10.L * p) * t);
+            }
+
+            error = std::max(error, std::abs(outs[0][i] - (double)(sum / partials)));
+        }
+
+        return error;
+    };
+}
+
+//! @brief Compares a fixed delay with the input delayed by a number of samples.
+static t_check check_fixed_delay(long delay)
+{
+    std::vector<double> history(delay, 0.);
+    size_t writer = 0;
+
+    return [history, writer](double const* const* ins, double const* const* outs,
+                             long vecsize, double samplerate) mutable
+    {
+        double error = 0.;
+
+        for(long i = 0; i < vecsize; ++i)
+        {
+            error = std::max(error, std::abs(outs[0][i] - history[writer]));
+
+            history[writer] = ins[0][i];
+            writer = (writer + 1) % history.size();
+        }
+
+        return error;
+    };
+}
+
+//! @brief Compares the linear interpolating readers of a delay line with a delay line that keeps all its history.
+//! @param buffersize The size of the delay line, the delay sizes are clipped to [1, buffersize - 1].
+//! @param readers The number of delay size inlets (after the input) and outputs.
+//! @param vector_latency true if the delays can't be shorter than a vector (the reader comes before the writer).
+static t_check check_delay(long buffersize, long readers, bool vector_latency = false)
+{
+    std::vector<double> history(buffersize + 1, 0.);
+    size_t writer = 0;
+
+    return [history, writer, buffersize, readers, vector_latency](double const* const* ins, double const* const* outs,
+                                                                  long vecsize, double samplerate) mutable
+    {
+        const size_t length = history.size();
+        const double min_delay = vector_latency ? (double)vecsize : 1.;
+        double error = 0.;
+
+        for(long i = 0; i < vecsize; ++i)
+        {
+            for(long j = 0; j < readers; ++j)
+            {
+                const double delay = std::min(std::max(ins[j + 1][i], min_delay), buffersize - 1.);
+                const long integer = (long)delay;
+                const double y1 = history[(writer + length - integer) % length];
+                const double y2 = history[(writer + length - integer - 1) % length];
+
+                error = std::max(error, std::abs(outs[j][i] - (y1 + (delay - integer) * (y2 - y1))));
+            }
+
+            history[writer] = ins[0][i];
+            writer = (writer + 1) % length;
+        }
+
+        return error;
+    };
+}
+
+//! @brief Compares the readers of a delay line fed with a sine with the ideal delayed sine.
+//! @details The first samples are skipped: the line is filled with zeros before the sine starts.
+//! @param freq The frequency of the sine of the first inlet.
+//! @param delays The constant delay size of each reader (in samples).
+static t_check check_fractional_delay(double freq, std::vector<double> delays)
+{
+    long sample = 0;
+
+    return [freq, delays, sample](double const* const* ins, double const* const* outs,
+                                  long vecsize, double samplerate) mutable
+    {
+        double error = 0.;
+
+        for(long i = 0; i < vecsize; ++i, ++sample)
+        {
+            for(size_t j = 0; j < delays.size(); ++j)
+            {
+                if(sample < delays[j] + 64.) continue;
+
+                const long double phase = (sample - delays[j]) * (long double)freq / samplerate;
+                const double expected = (double)sinl(2.L * M_PI * (phase - floorl(phase)));
+                error = std::max(error, std::abs(outs[j][i] - expected));
+            }
+        }
+
+        return error;
+    };
+}
+
+//! @brief The sound file streamed by pa.readbuffer3~ and mapped by pa.readbuffer1~ and pa.readbuffer2~, it holds the samples of the pa.bench buffer~ (see make_sound_file).
+static const char* const sound_file_path = "/tmp/pa.bench.wav";
+
+//! @brief Compares a reader of the pa.bench buffer~ (see make_buffer) with the ideal sines of its channels.
+//! @details The phase in [0, 1) of the buffer is accumulated from the speeds of the first input (in buffer lengths per buffer length),
+//! the error includes the error of the interpolation (1.2e-4 for a linear interpolation of the 220 Hz sine at 44.1 kHz).
+//! @param channels The number of outlets, outlet c reads channel c (a sine of 220 * (c + 1) Hz).
+static t_check check_readbuffer(long channels = 1)
+{
+    long double phase = 0.;
+
+    return [phase, channels](double const* const* ins, double const* const* outs,
+                             long vecsize, double samplerate) mutable
+    {
+        const long double frames = (long double)(t_atom_long)(samplerate * 4.);
+        double error = 0.;
+
+        for(long i = 0; i < vecsize; ++i)
+        {
+            for(long c = 0; c < channels; ++c)
+            {
+                const double expected = (double)sinl(2.L * (long double)M_PI * 220.L * (c + 1) * phase * frames / samplerate);
+                error = std::max(error, std::abs(outs[c][i] - expected));
+            }
+
+            phase += ins[0][i] / frames;
+            phase -= floorl(phase);
+        }
+
+        return error;
+    };
+}
+
+// ================================================================================ //
+//                                     SCENARIOS                                    //
+// ================================================================================ //
+
+//! @brief An object to benchmark, with its arguments, setup messages and input signals.
+struct t_scenario
+{
+    std::string                 m_label;
+    std::string                 m_object;
+    std::string                 m_args;
+    std::vector<std::string>    m_messages;
+    std::vector<t_signal>       m_inputs;
+    t_check                     m_check;
+
+    // an object that the benchmarked one reads from (eg. pa.tapin~ for pa.tapout~),
+    // performed before it (or after it with m_writer_last), its inlets take the first inputs.
+    std::string                 m_writer;
+    bool                        m_writer_last = false;
+
+    // the vectors are paced in real time, for the objects that rely on a background thread (eg. the disk I/O of pa.delay6~)
+    bool                        m_realtime = false;
+
+    // a pause before the dsp is turned on, for the objects that build their tables in the background (eg. the mip-map of pa.readbuffer2~)
+    double                      m_settle_ms = 0.;
+
+    // messages sent once the dsp runs, before the second vector (eg. to rebuild a delay line while it is read)
+    std::vector<std::string>    m_running_messages;
+
+    // the outputs share the memory of the inputs even without --inplace (eg. to check that an input is read before its output is written)
+    bool                        m_inplace = false;
+
+    // the vector size used instead of the ones of --vs (0 for these), eg. 7 to run the scalar tail of the SIMD kernels
+    long                        m_vectorsize = 0;
+};
+
+struct t_options
+{
+    std::vector<long>           vectorsizes = {64};
+    std::vector<double>         samplerates = {44100.};
+    std::vector<std::string>    filters;
+    std::string                 modules_path;
+    double                      seconds = 2.;
+    std::vector<long>           partials = {256};
+    std::vector<long>           crossovers = {-1};
+    std::vector<long>           threads = {0};
+    long                        taps = 8;
+    long                        channels = 2;
+    bool                        inplace = false;
+    bool                        csv = false;
+    bool                        list = false;
+    bool                        verbose = false;
+};
+
+static std::vector<t_scenario> make_scenarios(t_options const& options)
+{
+    std::vector<t_scenario> scenarios;
+
+    auto add = [&scenarios](std::string label, std::string object, std::string args,
+                            std::vector<std::string> messages, std::vector<t_signal> inputs,
+                            t_check check = t_check())
+    {
+        scenarios.push_back({label, object, args, messages, inputs, check});
+    };
+
+    // oscillators, with a float frequency then a signal frequency
+    for(std::string name : {"pa.phasor~", "pa.phasorpp~", "pa.osc1~", "pa.osc2~", "pa.osc3~", "pa.oscpp~"})
+    {
+        const bool cosine = (name.find("osc") != std::string::npos);
+
+        add(name + " float", name, "440", {}, {t_signal()}, check_oscillator(440., cosine));
+        add(name + " signal", name, "", {}, {t_signal::ramp(100., 1000., 1.)}, check_oscillator(0., cosine));
+    }
+
+    // the SIMD kernels in place, with a vector size that isn't a multiple of their width
+    for(std::string name : {"pa.phasorpp~", "pa.oscpp~"})
+    {
+        const bool cosine = (name.find("osc") != std::string::npos);
+
+        add(name + " signal inplace vs 7", name, "", {}, {t_signal::ramp(100., 1000., 1.)}, check_oscillator(0., cosine));
+        scenarios.back().m_inplace = true;
+        scenarios.back().m_vectorsize = 7;
+    }
+
+    // 32-bit fixed-point phase accumulators
+    for(std::string name : {"pa.phasorpp~", "pa.osc3~"})
+    {
+        const bool cosine = (name.find("osc") != std::string::npos);
+
+        add(name + " fixed float", name, "440", {"fixed 1"}, {t_signal()}, check_fixed_oscillator(440., cosine));
+        add(name + " fixed signal", name, "", {"fixed 1"}, {t_signal::ramp(100., 1000., 1.)},
+            check_fixed_oscillator(0., cosine));
+        add(name + " fixed signal inplace", name, "", {"fixed 1"}, {t_signal::ramp(100., 1000., 1.)},
+            check_fixed_oscillator(0., cosine));
+        scenarios.back().m_inplace = true;
+    }
+
+    // recursive (complex rotation) oscillators
+    for(std::string name : {"pa.osc1~", "pa.osc3~", "pa.oscpp~"})
+    {
+        add(name + " recursive float", name, "440", {"recursive 1"}, {t_signal()}, check_oscillator(440., true));
+    }
+
+    // polynomial cosines, from the least to the most accurate
+    for(long accuracy = 1; accuracy <= 3; ++accuracy)
+    {
+        const std::string tier = std::to_string(accuracy);
+
+        add("pa.osc1~ accuracy " + tier + " float", "pa.osc1~", "440 " + tier, {}, {t_signal()},
+            check_oscillator(440., true));
+        add("pa.osc1~ accuracy " + tier + " signal", "pa.osc1~", "0 " + tier, {}, {t_signal::ramp(100., 1000., 1.)},
+            check_oscillator(0., true));
+    }
+
+    // oscillator bank
+    auto oscbank_list = [](long partials)
+    {
+        std::ostringstream list;
+        list << "list";
+        for(long i = 0; i < partials; ++i)
+        {
+            list << " " << (55. + 10. * i);
+        }
+        return list.str();
+    };
+
+    for(long partials : options.partials)
+    {
+        const std::string list = oscbank_list(partials);
+
+        for(long crossover : options.crossovers)
+        {
+            for(long threads : options.threads)
+            {
+                std::string label = "pa.oscbank~ " + std::to_string(partials) + " partials";
+                std::vector<std::string> messages;
+
+                if(crossover >= 0)
+                {
+                    label += (crossover > 0 && partials >= crossover) ? " fft" : " direct";
+                    messages.push_back("crossover " + std::to_string(crossover));
+                }
+
+                if(threads > 0) label += " " + std::to_string(threads) + " threads";
+
+                messages.push_back(list);
+                add(label, "pa.oscbank~", std::to_string(threads), messages, {});
+            }
+        }
+    }
+
+    // a bank large enough for the worker threads, summed directly and by inverse FFT (its output lags by a hop of 128 samples)
+    for(long threads : {0L, 2L})
+    {
+        const std::string suffix = (threads > 0) ? " " + std::to_string(threads) + " threads" : "";
+
+        add("pa.oscbank~ 2048 partials direct" + suffix, "pa.oscbank~", std::to_string(threads),
+            {"crossover 0", oscbank_list(2048)}, {}, check_oscbank(2048, 0));
+        add("pa.oscbank~ 2048 partials fft" + suffix, "pa.oscbank~", std::to_string(threads),
+            {"crossover 1", oscbank_list(2048)}, {}, check_oscbank(2048, 128));
+    }
+
+    // utilities
+    add("pa.count~", "pa.count~", "0 44100", {}, {});
+    add("pa.clip~", "pa.clip~", "-0.5 0.5", {}, {t_signal::noise()});
+    add("pa.sah~", "pa.sah~", "0.5", {}, {t_signal::noise(), t_signal::sine(100.)});
+    add("pa.gain~", "pa.gain~", "", {"gain 0.5 100"}, {t_signal::noise()});
+    add("pa.snapshot~", "pa.snapshot~", "10", {}, {t_signal::noise()});
+    add("pa.starter~", "pa.starter~", "", {}, {t_signal::noise(), t_signal::noise()});
+
+    // delays
+    add("pa.delay1~", "pa.delay1~", "", {}, {t_signal::noise()});
+    add("pa.delay2~", "pa.delay2~", "4410", {}, {t_signal::noise()}, check_fixed_delay(4410));
+    add("pa.delay2~ 17 samples", "pa.delay2~", "17", {}, {t_signal::noise()}, check_fixed_delay(17));
+    add("pa.delay3~", "pa.delay3~", "44100", {"size 4410"}, {t_signal::noise()}, check_fixed_delay(4410));
+    add("pa.delay3~ 17 samples", "pa.delay3~", "44100", {"size 17"}, {t_signal::noise()}, check_fixed_delay(17));
+    add("pa.delay3~ full", "pa.delay3~", "4410", {"size 4410"}, {t_signal::noise()}, check_fixed_delay(4410));
+    add("pa.delay4~", "pa.delay4~", "44100", {},
+        {t_signal::noise(), t_signal::ramp(1., 44000., 2.)});
+
+    // the buffers resized by the maxsize message are adopted by the first vector
+    add("pa.delay2~ maxsize", "pa.delay2~", "4410", {"maxsize 17"}, {t_signal::noise()}, check_fixed_delay(17));
+    add("pa.delay4~ maxsize", "pa.delay4~", "4410", {"maxsize 65536"},
+        {t_signal::noise(), t_signal::ramp(1., 65535., 2.)}, check_delay(65536, 1));
+
+    {
+        std::vector<t_signal> inputs = {t_signal::noise()};
+        for(long i = 0; i < options.taps; ++i)
+        {
+            inputs.push_back(t_signal::ramp(1. + 100. * i, 44000. - 100. * i, 1. + 0.1 * i));
+        }
+
+        add("pa.delay5~ " + std::to_string(options.taps) + " taps", "pa.delay5~",
+            "44100 " + std::to_string(options.taps), {}, inputs);
+    }
+
+    // delay lines from 64 samples to 10 seconds, the delay sizes sweep the whole line
+    for(long length : {64l, 4096l, 65536l, 441000l})
+    {
+        const std::string samples = std::to_string(length) + " samples";
+
+        add("pa.delay4~ " + samples, "pa.delay4~", std::to_string(length), {},
+            {t_signal::noise(), t_signal::ramp(1., length - 1., 2.)}, check_delay(length, 1));
+
+        std::vector<t_signal> inputs = {t_signal::noise()};
+        for(long i = 0; i < options.taps; ++i)
+        {
+            inputs.push_back(t_signal::ramp(1. + i, length - 1. - i, 1. + 0.1 * i));
+        }
+
+        add("pa.delay5~ " + std::to_string(options.taps) + " taps " + samples, "pa.delay5~",
+            std::to_string(length) + " " + std::to_string(options.taps), {}, inputs,
+            check_delay(length, options.taps));
+    }
+
+    // compact storages of the delay lines: float and 24 bits samples (rounding errors of -150 and -138 dB)
+    for(std::string storage : {"float", "int24"})
+    {
+        add("pa.delay3~ " + storage, "pa.delay3~", "44100", {"storage " + storage, "size 4410"},
+            {t_signal::noise()}, check_fixed_delay(4410));
+
+        add("pa.delay4~ 441000 " + storage, "pa.delay4~", "441000", {"storage " + storage},
+            {t_signal::noise(), t_signal::ramp(1., 440999., 2.)}, check_delay(441000, 1));
+
+        std::vector<t_signal> inputs = {t_signal::noise()};
+        for(long i = 0; i < options.taps; ++i)
+        {
+            inputs.push_back(t_signal::ramp(1. + i, 440999. - i, 1. + 0.1 * i));
+        }
+
+        add("pa.delay5~ " + std::to_string(options.taps) + " taps 441000 " + storage, "pa.delay5~",
+            "441000 " + std::to_string(options.taps), {"storage " + storage}, inputs,
+            check_delay(441000, options.taps));
+    }
+
+    // the first pass of the write head on a line of 1.5 s at 44.1 kHz (the pages it maps are counted by the faults column),
+    // with the default pages, 2 MB pages and locked pages
+    for(std::string pages : {"", "hugepages", "mlock"})
+    {
+        const std::string suffix = pages.empty() ? "" : " " + pages;
+        const std::vector<std::string> messages = pages.empty() ? std::vector<std::string>() : std::vector<std::string>{pages + " 1"};
+
+        add("pa.delay2~ 66150" + suffix, "pa.delay2~", "66150", messages, {t_signal::noise()}, check_fixed_delay(66150));
+
+        std::vector<std::string> delay3_messages = messages;
+        delay3_messages.push_back("size 66150");
+        add("pa.delay3~ 66150" + suffix, "pa.delay3~", "66150", delay3_messages, {t_signal::noise()}, check_fixed_delay(66150));
+
+        add("pa.delay4~ 66150" + suffix, "pa.delay4~", "66150", messages,
+            {t_signal::noise(), t_signal::ramp(1., 66149., 2.)}, check_delay(66150, 1));
+
+        std::vector<t_signal> inputs = {t_signal::noise()};
+        for(long i = 0; i < options.taps; ++i)
+        {
+            inputs.push_back(t_signal::ramp(1. + i, 66149. - i, 1. + 0.1 * i));
+        }
+
+        add("pa.delay5~ 66150" + suffix, "pa.delay5~", "66150 " + std::to_string(options.taps), messages, inputs,
+            check_delay(66150, options.taps));
+    }
+
+    // interpolations: a 5 kHz sine read at constant fractional delays, compared with the ideal delayed sine
+    for(std::string interpolation : {"linear", "hermite", "lagrange", "thiran", "sinc"})
+    {
+        add("pa.delay4~ " + interpolation, "pa.delay4~", "44100", {"interp " + interpolation},
+            {t_signal::sine(5000.), t_signal::constant(100.5)}, check_fractional_delay(5000., {100.5}));
+
+        std::vector<t_signal> inputs = {t_signal::sine(5000.)};
+        std::vector<double> delays;
+        for(long i = 0; i < options.taps; ++i)
+        {
+            delays.push_back(100.5 + 1000.37 * i);
+            inputs.push_back(t_signal::constant(delays.back()));
+        }
+
+        add("pa.delay5~ " + std::to_string(options.taps) + " taps " + interpolation, "pa.delay5~",
+            "44100 " + std::to_string(options.taps), {"interp " + interpolation}, inputs,
+            check_fractional_delay(5000., delays));
+    }
+
+    // a storage message then a maxsize message while the dsp runs: the line is rebuilt for the storage of the perform routine,
+    // the new storage is only taken into account by the next dsp64 method.
+    {
+        const std::vector<std::string> running = {"storage float", "maxsize 10000"};
+
+        add("pa.delay3~ storage maxsize", "pa.delay3~", "44100", {"size 4410"}, {t_signal::noise()}, check_fixed_delay(4410));
+        scenarios.back().m_running_messages = running;
+
+        add("pa.delay4~ storage maxsize", "pa.delay4~", "4410", {},
+            {t_signal::noise(), t_signal::ramp(1., 4409., 2.)}, check_delay(4410, 1));
+        scenarios.back().m_running_messages = running;
+
+        std::vector<t_signal> inputs = {t_signal::noise()};
+        for(long i = 0; i < options.taps; ++i)
+        {
+            inputs.push_back(t_signal::ramp(1. + i, 4409. - i, 1. + 0.1 * i));
+        }
+
+        add("pa.delay5~ " + std::to_string(options.taps) + " taps storage maxsize", "pa.delay5~",
+            "4410 " + std::to_string(options.taps), {}, inputs, check_delay(4410, options.taps));
+        scenarios.back().m_running_messages = running;
+    }
+
+    // a maxsize message while the dsp runs: the history of a line of 65536 samples is copied to the new one over several vectors
+    {
+        const std::vector<std::string> running = {"maxsize 131072"};
+
+        add("pa.delay3~ 65536 resized", "pa.delay3~", "65536", {"size 65536"}, {t_signal::noise()}, check_fixed_delay(65536));
+        scenarios.back().m_running_messages = running;
+
+        add("pa.delay4~ 65536 resized", "pa.delay4~", "65536", {},
+            {t_signal::noise(), t_signal::ramp(1., 65535., 2.)}, check_delay(65536, 1));
+        scenarios.back().m_running_messages = running;
+
+        std::vector<t_signal> inputs = {t_signal::noise()};
+        for(long i = 0; i < options.taps; ++i)
+        {
+            inputs.push_back(t_signal::ramp(1. + i, 65535. - i, 1. + 0.1 * i));
+        }
+
+        add("pa.delay5~ " + std::to_string(options.taps) + " taps 65536 resized", "pa.delay5~",
+            "65536 " + std::to_string(options.taps), {}, inputs, check_delay(65536, options.taps));
+        scenarios.back().m_running_messages = running;
+    }
+
+    // named delay lines: a 10 seconds pa.tapin~ read by a pa.tapout~ after it (or before it)
+    for(bool writer_last : {false, true})
+    {
+        std::vector<t_signal> inputs = {t_signal::noise()};
+        for(long i = 0; i < options.taps; ++i)
+        {
+            inputs.push_back(t_signal::ramp(1. + i, 440999. - i, 1. + 0.1 * i));
+        }
+
+        add("pa.tapout~ " + std::to_string(options.taps) + " taps" + (writer_last ? " first" : ""),
+            "pa.tapout~", "pa.bench " + std::to_string(options.taps), {}, inputs,
+            check_delay(441000, options.taps, writer_last));
+
+        scenarios.back().m_writer = "pa.tapin~ pa.bench 441000";
+        scenarios.back().m_writer_last = writer_last;
+    }
+
+    // a disk delay line: 10 seconds of history read by constant delays from 1 second (paced in real time)
+    {
+        std::vector<t_signal> inputs = {t_signal::noise()};
+        for(long i = 0; i < options.taps; ++i)
+        {
+            inputs.push_back(t_signal::constant(44100. + 4410. * i));
+        }
+
+        add("pa.delay6~ " + std::to_string(options.taps) + " taps", "pa.delay6~",
+            "441000 " + std::to_string(options.taps), {}, inputs, check_delay(441000, options.taps));
+
+        scenarios.back().m_realtime = true;
+    }
+
+    // buffer~ readers
+    add("pa.readbuffer1~", "pa.readbuffer1~", "pa.bench", {}, {t_signal::ramp(0., 1., 1.)});
+    add("pa.readbuffer2~", "pa.readbuffer2~", "pa.bench", {}, {t_signal::constant(1.5)}, check_readbuffer());
+    add("pa.readbuffer2~ signal speed", "pa.readbuffer2~", "pa.bench", {}, {t_signal::ramp(-2., 2., 1.)}, check_readbuffer());
+    add("pa.readbuffer1~ 2 channels", "pa.readbuffer1~", "pa.bench 2", {}, {t_signal::ramp(0., 1., 1.)});
+    add("pa.readbuffer2~ 2 channels", "pa.readbuffer2~", "pa.bench 2", {}, {t_signal::constant(1.5)}, check_readbuffer(2));
+    add("pa.readbuffer2~ no mipmap", "pa.readbuffer2~", "pa.bench", {"mipmap 0"}, {t_signal::constant(1.5)}, check_readbuffer());
+    add("pa.readbuffer2~ hermite", "pa.readbuffer2~", "pa.bench", {"interp hermite"}, {t_signal::constant(1.5)}, check_readbuffer());
+    add("pa.readbuffer2~ sinc", "pa.readbuffer2~", "pa.bench", {"interp sinc"}, {t_signal::constant(1.5)}, check_readbuffer());
+    add("pa.readbuffer2~ sinc signal speed", "pa.readbuffer2~", "pa.bench", {"interp sinc"}, {t_signal::ramp(-2., 2., 1.)}, check_readbuffer());
+
+    // the same sines read in place in the sound file (see MappedFile)
+    const std::string map = std::string("map ") + sound_file_path;
+    add("pa.readbuffer1~ mapped", "pa.readbuffer1~", "pa.bench", {map}, {t_signal::ramp(0., 1., 1.)});
+    add("pa.readbuffer2~ mapped", "pa.readbuffer2~", "pa.bench", {map}, {t_signal::constant(1.5)}, check_readbuffer());
+    add("pa.readbuffer2~ mapped sinc", "pa.readbuffer2~", "pa.bench", {map, "interp sinc"}, {t_signal::ramp(-2., 2., 1.)}, check_readbuffer());
+    add("pa.readbuffer2~ mapped prefetch", "pa.readbuffer2~", "pa.bench", {map, "prefetch 500"}, {t_signal::constant(1.5)}, check_readbuffer());
+
+    // a sound file streamed from disk: the same sines as the buffer~ (paced in real time)
+    add("pa.readbuffer3~", "pa.readbuffer3~", sound_file_path, {}, {t_signal::constant(1.5)}, check_readbuffer());
+    add("pa.readbuffer3~ sinc signal speed", "pa.readbuffer3~", sound_file_path, {"interp sinc"}, {t_signal::ramp(-2., 2., 1.)}, check_readbuffer());
+
+    for(t_scenario& scenario : scenarios)
+    {
+        if(scenario.m_object == "pa.readbuffer2~") scenario.m_settle_ms = 200.;
+
+        if(scenario.m_object == "pa.readbuffer3~")
+        {
+            scenario.m_realtime = true;
+            scenario.m_settle_ms = 200.;
+        }
+    }
+
+    // keep only the requested objects
+    if(!options.filters.empty())
+    {
+        auto rejected = [&options](t_scenario const& scenario)
+        {
+            for(std::string const& filter : options.filters)
+            {
+                if(scenario.m_label.find(filter) != std::string::npos) return false;
+            }
+
+            return true;
+        };
+
+        scenarios.erase(std::remove_if(scenarios.begin(), scenarios.end(), rejected), scenarios.end());
+    }
+
+    return scenarios;
+}
+
+// ================================================================================ //
+//                                      RESULTS                                     //
+// ================================================================================ //
+
+struct t_result
+{
+    double  m_ns_per_sample = 0.;
+    double  m_msamples_per_sec = 0.;
+    double  m_p50_us = 0.;
+    double  m_p90_us = 0.;
+    double  m_p99_us = 0.;
+    double  m_max_us = 0.;
+    double  m_cpu_percent = 0.;
+    double  m_max_error = -1.;   // negative if the scenario has no check
+    long    m_minor_faults = 0;
+};
+
+static double percentile(std::vector<double> const& sorted, double p)
+{
+    if(sorted.empty()) return 0.;
+
+    const size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+static t_result make_result(std::vector<double> vector_ns, long vecsize, double samplerate)
+{
+    t_result result;
+    if(vector_ns.empty()) return result;
+
+    double total_ns = 0.;
+    for(double ns : vector_ns) total_ns += ns;
+
+    std::sort(vector_ns.begin(), vector_ns.end());
+
+    const double mean_ns = total_ns / vector_ns.size();
+    const double budget_ns = 1e9 * vecsize / samplerate;
+
+    result.m_ns_per_sample = mean_ns / vecsize;
+    result.m_msamples_per_sec = (result.m_ns_per_sample > 0.) ? (1e3 / result.m_ns_per_sample) : 0.;
+    result.m_p50_us = percentile(vector_ns, 0.50) * 1e-3;
+    result.m_p90_us = percentile(vector_ns, 0.90) * 1e-3;
+    result.m_p99_us = percentile(vector_ns, 0.99) * 1e-3;
+    result.m_max_us = vector_ns.back() * 1e-3;
+    result.m_cpu_percent = 100. * mean_ns / budget_ns;
+
+    return result;
+}
+
+// ================================================================================ //
+//                                       BENCH                                      //
+// ================================================================================ //
+
+//! @brief Returns the class of an object, loading its external the first time.
+static t_class* get_class(std::string const& name, t_options const& options)
+{
+    static std::vector<std::pair<std::string, t_class*>> loaded;
+
+    for(auto const& entry : loaded)
+    {
+        if(entry.first == name) return entry.second;
+    }
+
+    std::string error;
+    t_class* c = maxhost::load_external(options.modules_path + "/" + name + ".so", error);
+    if(!c)
+    {
+        std::cerr << "pa.bench: can't load " << name << ": " << error << std::endl;
+    }
+
+    loaded.push_back({name, c});
+    return c;
+}
+
+//! @brief Returns the number of minor page faults (a page mapped by its first access) of the calling thread.
+static long minor_faults()
+{
+    struct rusage usage;
+
+    #if defined(RUSAGE_THREAD)
+    getrusage(RUSAGE_THREAD, &usage);
+    #else
+    getrusage(RUSAGE_SELF, &usage);
+    #endif
+
+    return usage.ru_minflt;
+}
+
+//! @brief Run a scenario and measure the time spent in the perform routines for every vector.
+static bool run_scenario(t_scenario scenario, t_options const& options,
+                         long vecsize, double samplerate, t_result& result)
+{
+    t_class* c = get_class(scenario.m_object, options);
+    if(!c || !maxhost::class_is_dsp(c)) return false;
+
+    if(scenario.m_vectorsize > 0) vecsize = scenario.m_vectorsize;
+
+    // the writer must exist before the reader looks for it
+    t_object* writer = nullptr;
+    if(!scenario.m_writer.empty())
+    {
+        const size_t space = scenario.m_writer.find(' ');
+        t_class* writer_class = get_class(scenario.m_writer.substr(0, space), options);
+        if(!writer_class) return false;
+
+        const std::string writer_args = (space != std::string::npos) ? scenario.m_writer.substr(space + 1) : "";
+        writer = maxhost::object_create(writer_class, maxhost::parse_atoms(writer_args));
+        if(!writer) return false;
+    }
+
+    t_object* x = maxhost::object_create(c, maxhost::parse_atoms(scenario.m_args));
+    if(!x)
+    {
+        std::cerr << "pa.bench: can't create " << scenario.m_label << std::endl;
+        return false;
+    }
+
+    for(std::string const& message : scenario.m_messages)
+    {
+        if(!maxhost::object_send(x, message))
+        {
+            std::cerr << "pa.bench: " << scenario.m_object << " doesn't understand "
+                      << message.substr(0, message.find(' ')) << std::endl;
+        }
+    }
+
+    if(scenario.m_settle_ms > 0.)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(scenario.m_settle_ms));
+    }
+
+    // the inputs of the writer come first
+    const long writer_ins = writer ? maxhost::object_signal_inlets(writer) : 0;
+    const long object_ins = maxhost::object_signal_inlets(x);
+    const long numins = writer_ins + object_ins;
+    const long numouts = maxhost::object_signal_outlets(x);
+    scenario.m_inputs.resize(numins);
+
+    const bool inplace = (options.inplace || scenario.m_inplace);
+
+    std::vector<short> connected;
+    for(t_signal const& input : scenario.m_inputs) connected.push_back(input.m_kind != t_signal::None);
+    for(long i = 0; i < numouts; ++i) connected.push_back(1);
+
+    // dsp64 methods are called in the order of the dsp chain
+    maxhost::set_dspstate(true);
+    std::vector<maxhost::t_perform_call> calls, writer_calls;
+    const std::vector<short> writer_connected(connected.begin(), connected.begin() + writer_ins);
+    const std::vector<short> object_connected(connected.begin() + writer_ins, connected.end());
+
+    if(writer && !scenario.m_writer_last) writer_calls = maxhost::object_dsp(writer, writer_connected, samplerate, vecsize);
+    calls = maxhost::object_dsp(x, object_connected, samplerate, vecsize);
+    if(writer && scenario.m_writer_last) writer_calls = maxhost::object_dsp(writer, writer_connected, samplerate, vecsize);
+
+    // signal vectors (outputs may share the inputs memory like in MSP)
+    std::vector<std::vector<double>> in_vectors(numins, std::vector<double>(vecsize, 0.));
+    std::vector<std::vector<double>> out_vectors(numouts, std::vector<double>(vecsize, 0.));
+    std::vector<double*> ins, outs;
+    for(auto& vec : in_vectors) ins.push_back(vec.data());
+    for(long i = 0; i < numouts; ++i)
+    {
+        outs.push_back((inplace && i < object_ins) ? ins[writer_ins + i] : out_vectors[i].data());
+    }
+
+    // the inputs given to the check (a copy made before the perform routines in-place)
+    std::vector<std::vector<double>> saved_ins(inplace ? numins : 0, std::vector<double>(vecsize, 0.));
+    std::vector<double*> checked_ins(ins);
+    for(long i = 0; i < (long)saved_ins.size(); ++i) checked_ins[i] = saved_ins[i].data();
+
+    std::minstd_rand rng(1);
+    const double vector_ms = 1000. * vecsize / samplerate;
+    const long vectors = std::max(16l, (long)(options.seconds * samplerate / vecsize));
+    const long warmup = std::max(16l, vectors / 20);
+
+    std::vector<double> vector_ns;
+    vector_ns.reserve(vectors);
+    double max_error = scenario.m_check ? 0. : -1.;
+    long faults = 0;
+    const auto first_vector = std::chrono::steady_clock::now();
+
+    for(long v = 0; v < warmup + vectors; ++v)
+    {
+        if(v == 1)
+        {
+            for(std::string const& message : scenario.m_running_messages) maxhost::object_send(x, message);
+        }
+
+        for(long i = 0; i < numins; ++i)
+        {
+            scenario.m_inputs[i].generate(ins[i], vecsize, samplerate, rng);
+        }
+
+        if(inplace && scenario.m_check)
+        {
+            // the outputs will overwrite the inputs
+            for(long i = 0; i < numins; ++i) std::copy(ins[i], ins[i] + vecsize, saved_ins[i].begin());
+        }
+
+        const long faults_before = minor_faults();
+        const auto start = std::chrono::steady_clock::now();
+
+        if(!scenario.m_writer_last)
+        {
+            for(auto const& call : writer_calls) maxhost::perform(call, ins.data(), writer_ins, nullptr, 0, vecsize);
+        }
+
+        for(auto const& call : calls)
+        {
+            maxhost::perform(call, ins.data() + writer_ins, object_ins, outs.data(), numouts, vecsize);
+        }
+
+        if(scenario.m_writer_last)
+        {
+            for(auto const& call : writer_calls) maxhost::perform(call, ins.data(), writer_ins, nullptr, 0, vecsize);
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        faults += minor_faults() - faults_before;
+
+        if(v >= warmup)
+        {
+            vector_ns.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+
+        if(scenario.m_check)
+        {
+            max_error = std::max(max_error, scenario.m_check(checked_ins.data(), outs.data(), vecsize, samplerate));
+        }
+
+        // clocks run between vectors, like the scheduler in overdrive mode.
+        maxhost::advance_time(vector_ms);
+
+        if(scenario.m_realtime)
+        {
+            std::this_thread::sleep_until(first_vector + std::chrono::duration<double, std::milli>((v + 1) * vector_ms));
+        }
+    }
+
+    maxhost::set_dspstate(false);
+    maxhost::object_destroy(x);
+    if(writer) maxhost::object_destroy(writer);
+
+    result = make_result(vector_ns, vecsize, samplerate);
+    result.m_max_error = max_error;
+    result.m_minor_faults = faults;
+    return !calls.empty();
+}
+
+//! @brief Fill the "pa.bench" buffer~ used by the buffer readers.
+static void make_buffer(double samplerate, long channels)
+{
+    const t_atom_long frames = (t_atom_long)(samplerate * 4.);
+    float* samples = maxhost::buffer_create("pa.bench", frames, channels, samplerate);
+
+    for(t_atom_long i = 0; i < frames; ++i)
+    {
+        for(long c = 0; c < channels; ++c)
+        {
+            samples[i * channels + c] = (float)sin(2. * M_PI * 220. * (c + 1) * i / samplerate);
+        }
+    }
+}
+
+//! @brief Write the samples of the "pa.bench" buffer~ in a 32 bits float WAV file, read by pa.readbuffer3~.
+static void make_sound_file(double samplerate, long channels)
+{
+    const uint32_t frames = (uint32_t)(samplerate * 4.);
+    const uint32_t bytes = frames * (uint32_t)channels * 4;
+    std::FILE* file = std::fopen(sound_file_path, "wb");
+
+    if(!file)
+    {
+        std::cerr << "pa.bench: can't write " << sound_file_path << std::endl;
+        return;
+    }
+
+    // little endian fields
+    auto put = [file](uint32_t value, int size)
+    {
+        for(int b = 0; b < size; ++b) std::fputc((value >> (8 * b)) & 0xFF, file);
+    };
+
+    std::fputs("RIFF", file); put(36 + bytes, 4); std::fputs("WAVE", file);
+    std::fputs("fmt ", file); put(16, 4); put(3, 2); put((uint32_t)channels, 2);
+    put((uint32_t)samplerate, 4); put((uint32_t)(samplerate * channels * 4), 4); put((uint32_t)channels * 4, 2); put(32, 2);
+    std::fputs("data", file); put(bytes, 4);
+
+    // the floats are written in the byte order of the host (little endian)
+    std::vector<float> frame(channels);
+
+    for(uint32_t i = 0; i < frames; ++i)
+    {
+        for(long c = 0; c < channels; ++c)
+        {
+            frame[c] = (float)sin(2. * M_PI * 220. * (c + 1) * i / samplerate);
+        }
+
+        std::fwrite(frame.data(), sizeof(float), channels, file);
+    }
+
+    std::fclose(file);
+}
+
+// ================================================================================ //
+//                                        MAIN                                      //
+// ================================================================================ //
+
+template<class T>
+static std::vector<T> parse_list(std::string const& text)
+{
+    std::vector<T> values;
+    std::istringstream stream(text);
+    std::string item;
+
+    while(std::getline(stream, item, ','))
+    {
+        std::istringstream value(item);
+        T v;
+        if(value >> v) values.push_back(v);
+    }
+
+    return values;
+}
+
+static void print_usage()
+{
+    std::cout <<
+    "usage: pa.bench [options] [object filters...]\n"
+    "  --vs <n,n,...>      vector sizes (default 64)\n"
+    "  --sr <sr,sr,...>    sampling rates (default 44100)\n"
+    "  --seconds <s>       seconds of audio per measure (default 2)\n"
+    "  --partials <n,...>  number of oscillators of pa.oscbank~ (default 256)\n"
+    "  --crossover <n,...> inverse FFT crossover of pa.oscbank~ (default: the object's one)\n"
+    "  --threads <n,n,...> worker threads of pa.oscbank~ (default 0)\n"
+    "  --taps <n>          number of readers of pa.delay5~ (default 8)\n"
+    "  --channels <n>      number of channels of the buffer~ (default 2)\n"
+    "  --modules <dir>     directory of the externals (default: next to pa.bench)\n"
+    "  --inplace           outputs share the memory of the inputs, like in MSP\n"
+    "  --csv               print results as comma separated values\n"
+    "  --list              list the scenarios and exit\n"
+    "  --verbose           print the posts and errors of the objects\n";
+}
+
+static bool parse_options(int argc, char* argv[], t_options& options)
+{
+    std::string exe = argv[0];
+    const size_t slash = exe.find_last_of('/');
+    options.modules_path = (slash != std::string::npos) ? exe.substr(0, slash) : ".";
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = (i + 1 < argc);
+
+        if(arg == "--vs" && has_value)              options.vectorsizes = parse_list<long>(argv[++i]);
+        else if(arg == "--sr" && has_value)         options.samplerates = parse_list<double>(argv[++i]);
+        else if(arg == "--seconds" && has_value)    options.seconds = atof(argv[++i]);
+        else if(arg == "--partials" && has_value)   options.partials = parse_list<long>(argv[++i]);
+        else if(arg == "--crossover" && has_value)  options.crossovers = parse_list<long>(argv[++i]);
+        else if(arg == "--threads" && has_value)    options.threads = parse_list<long>(argv[++i]);
+        else if(arg == "--taps" && has_value)       options.taps = std::max(1l, atol(argv[++i]));
+        else if(arg == "--channels" && has_value)   options.channels = std::max(1l, atol(argv[++i]));
+        else if(arg == "--modules" && has_value)    options.modules_path = argv[++i];
+        else if(arg == "--inplace")                 options.inplace = true;
+        else if(arg == "--csv")                     options.csv = true;
+        else if(arg == "--list")                    options.list = true;
+        else if(arg == "--verbose")                 options.verbose = true;
+        else if(arg == "--help" || arg == "-h")     return false;
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            std::cerr << "pa.bench: unknown option " << arg << std::endl;
+            return false;
+        }
+        else options.filters.push_back(arg);
+    }
+
+    return !options.vectorsizes.empty() && !options.samplerates.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    t_options options;
+    if(!parse_options(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+
+    maxhost::set_verbose(options.verbose);
+
+    const std::vector<t_scenario> scenarios = make_scenarios(options);
+
+    if(options.list)
+    {
+        for(t_scenario const& scenario : scenarios)
+        {
+            std::cout << scenario.m_label << "\t[" << scenario.m_object << " " << scenario.m_args << "]\n";
+        }
+
+        return 0;
+    }
+
+    char line[256];
+    int failures = 0;
+
+    if(options.csv)
+    {
+        std::cout << "object,samplerate,vectorsize,ns_per_sample,msamples_per_sec,"
+                     "p50_us,p90_us,p99_us,max_us,cpu_percent,max_error,minor_faults\n";
+    }
+
+    for(double samplerate : options.samplerates)
+    {
+        for(long vecsize : options.vectorsizes)
+        {
+            maxhost::set_samplerate(samplerate);
+            maxhost::set_vectorsize(vecsize);
+            make_buffer(samplerate, options.channels);
+            make_sound_file(samplerate, options.channels);
+
+            if(!options.csv)
+            {
+                std::cout << "\n" << samplerate << " Hz, vector size " << vecsize
+                          << " (" << options.seconds << " s per object)\n";
+
+                snprintf(line, sizeof(line), "%-32s %9s %9s %9s %9s %9s %9s %8s %9s %7s\n",
+                         "object", "ns/samp", "Msamp/s", "p50 us", "p90 us", "p99 us", "max us", "cpu %", "max err", "faults");
+                std::cout << line;
+            }
+
+            for(t_scenario const& scenario : scenarios)
+            {
+                t_result r;
+                if(!run_scenario(scenario, options, vecsize, samplerate, r))
+                {
+                    failures++;
+                    continue;
+                }
+
+                char error[32] = "";
+                if(r.m_max_error >= 0.)
+                {
+                    snprintf(error, sizeof(error), options.csv ? "%.3e" : "%9.2e", r.m_max_error);
+                }
+                else if(!options.csv)
+                {
+                    snprintf(error, sizeof(error), "%9s", "-");
+                }
+
+                const long scenario_vecsize = (scenario.m_vectorsize > 0) ? scenario.m_vectorsize : vecsize;
+
+                if(options.csv)
+                {
+                    snprintf(line, sizeof(line), "%s,%g,%ld,%.4f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f,%s,%ld\n",
+                             scenario.m_label.c_str(), samplerate, scenario_vecsize, r.m_ns_per_sample,
+                             r.m_msamples_per_sec, r.m_p50_us, r.m_p90_us, r.m_p99_us,
+                             r.m_max_us, r.m_cpu_percent, error, r.m_minor_faults);
+                }
+                else
+                {
+                    snprintf(line, sizeof(line), "%-32s %9.3f %9.2f %9.3f %9.3f %9.3f %9.3f %8.4f %s %7ld\n",
+                             scenario.m_label.c_str(), r.m_ns_per_sample, r.m_msamples_per_sec,
+                             r.m_p50_us, r.m_p90_us, r.m_p99_us, r.m_max_us, r.m_cpu_percent, error, r.m_minor_faults);
+                }
+
+                std::cout << line << std::flush;
+            }
+        }
+    }
+
+    std::remove(sound_file_path);
+
+    return (failures == 0) ? 0 : 2;
+}
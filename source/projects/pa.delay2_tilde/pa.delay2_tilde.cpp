@@ -11,6 +11,17 @@
 using namespace c74::max;
 
 #include <stdlib.h> // malloc, calloc, free...
+#include <string.h> // memcpy
+
+#include <algorithm> // std::swap_ranges
+
+#include "DeferredHistory.hpp"
+#include "Handoff.hpp"
+#include "PageAllocator.hpp"
+using paccpp::DeferredHistory;
+using paccpp::Handoff;
+using paccpp::PageAllocator;
+using paccpp::PageVector;
 
 static t_class* this_class = nullptr;
 
@@ -18,47 +29,157 @@ struct t_pa_delay2_tilde
 {
     t_pxobject  m_obj;
     
+    // the buffer used by the perform method
     double*     m_buffer;
     t_atom_long m_buffersize;
     t_atom_long m_count;
+    
+    // the buffers built by the message thread, adopted by the perform method
+    Handoff<PageVector<double>>* m_buffers;
+    t_atom_long m_maxsize;
+    bool        m_default_size;
+    
+    // the history of the buffer being replaced, copied by the perform method
+    DeferredHistory* m_history;
+    
+    // the pages of the buffers
+    bool        m_hugepages;
+    bool        m_mlock;
+    
+    // deletes the buffers replaced by the audio thread
+    t_clock*    m_clock;
 };
 
-void pa_delay2_tilde_delete_buffer(t_pa_delay2_tilde* x)
+void pa_delay2_tilde_reclaim(t_pa_delay2_tilde* x)
 {
-    if(x->m_buffer)
+    x->m_buffers->reclaim();
+}
+
+//! @brief Build a new buffer and hand it over to the perform method (message thread).
+//! @details The memory is allocated and its pages are mapped here (see PageAllocator), and locked on demand:
+//! the perform method never allocates nor frees nor faults, it only adopts the new buffer at the beginning of a vector.
+void pa_delay2_tilde_create_buffer(t_pa_delay2_tilde* x, t_atom_long buffersize)
+{
+    const PageAllocator<double> allocator(x->m_hugepages ? PageAllocator<double>::HugePages : 0);
+    PageVector<double>* buffer = new PageVector<double>(buffersize, 0., allocator);
+    
+    if(x->m_mlock && !paccpp::lockPages(buffer->data(), buffer->size() * sizeof(double)))
     {
-        // free allocated buffer
-        free(x->m_buffer);
-        x->m_buffer = NULL;
+        object_error((t_object*)x, "can't lock the buffer in memory (see ulimit -l)");
     }
+    
+    x->m_maxsize = buffersize;
+    x->m_buffers->publish(buffer);
 }
 
-void pa_delay2_tilde_clear_buffer(t_pa_delay2_tilde* x)
+void pa_delay2_tilde_set_maxsize(t_pa_delay2_tilde* x, long buffersize)
 {
-    int i = 0;
-    if(x->m_buffer)
+    if(buffersize < 1)
     {
-        for(; i < x->m_buffersize; ++i)
-        {
-            x->m_buffer[i] = 0.f;
-        }
+        object_error((t_object*)x, "buffer size must be > 0");
+        return;
+    }
+    
+    // the size doesn't follow the sampling rate anymore
+    x->m_default_size = false;
+    pa_delay2_tilde_create_buffer(x, buffersize);
+}
+
+//! @brief Use huge pages for the buffer or not, it is rebuilt.
+void pa_delay2_tilde_set_hugepages(t_pa_delay2_tilde* x, long state)
+{
+    x->m_hugepages = (state != 0);
+    pa_delay2_tilde_create_buffer(x, x->m_maxsize);
+}
+
+//! @brief Lock the buffer in memory or not, it is rebuilt.
+void pa_delay2_tilde_set_mlock(t_pa_delay2_tilde* x, long state)
+{
+    x->m_mlock = (state != 0);
+    pa_delay2_tilde_create_buffer(x, x->m_maxsize);
+}
+
+//! @brief Copy count samples from a position of the previous buffer to a position of a new one, both wrapped.
+void pa_delay2_tilde_copy_history(PageVector<double> const& previous, size_t from, PageVector<double>& buffer, size_t to, size_t count)
+{
+    while(count > 0)
+    {
+        const size_t size = std::min({count, previous.size() - from, buffer.size() - to});
+        
+        memcpy(buffer.data() + to, previous.data() + from, size * sizeof(double));
+        
+        from = (from + size < previous.size()) ? (from + size) : 0;
+        to = (to + size < buffer.size()) ? (to + size) : 0;
+        count -= size;
     }
 }
 
-void pa_delay2_tilde_create_buffer(t_pa_delay2_tilde* x)
+//! @brief Adopt the last buffer built by the message thread once it holds the history of the current one, if any (audio thread).
+//! @details The history is copied a chunk per vector (see DeferredHistory) so the delay goes on without a glitch,
+//! the previous buffer can't be deleted in the audio thread so we defer it to the clock.
+void pa_delay2_tilde_update(t_pa_delay2_tilde* x)
 {
-    pa_delay2_tilde_delete_buffer(x);
+    DeferredHistory& history = *x->m_history;
+    
+    auto prepare = [x, &history](PageVector<double>& buffer, PageVector<double> const& previous)
+    {
+        const size_t size = previous.size();
+        
+        return history.step(std::min(size, buffer.size()), [x, &history, &buffer, &previous, size](size_t delay, size_t count)
+        {
+            // the playhead is the position of the next sample written
+            pa_delay2_tilde_copy_history(previous, ((size_t)x->m_count + size - delay) % size,
+                                         buffer, history.copied() % buffer.size(), count);
+        });
+    };
     
-    // allocate buffer
-    x->m_buffer = (double*)malloc(sizeof(double) * x->m_buffersize);
+    auto adopt = [x, &history](PageVector<double>& buffer, PageVector<double> const*)
+    {
+        // the playhead follows the copied samples, the oldest one is the next one
+        x->m_buffer = buffer.data();
+        x->m_buffersize = (t_atom_long)buffer.size();
+        x->m_count = (t_atom_long)(history.copied() % buffer.size());
+        
+        history.finish();
+    };
     
-    if(x->m_buffer)
+    if(x->m_buffers->update(prepare, adopt))
+    {
+        clock_delay(x->m_clock, 0);
+    }
+}
+
+//! @brief Output size samples of the buffer and replace them by the input.
+void pa_delay2_tilde_exchange(double* buffer_playhead, double* in, double* out, long size)
+{
+    if(in == out)
     {
-        pa_delay2_tilde_clear_buffer(x);
+        // in-place: swapping the input and buffer samples reads then writes each of them
+        std::swap_ranges(buffer_playhead, buffer_playhead + size, out);
     }
+    else
+    {
+        memcpy(out, buffer_playhead, size * sizeof(double));
+        memcpy(buffer_playhead, in, size * sizeof(double));
+    }
+}
+
+//! @brief Block version of the perform method, for a buffer at least as large as the vector.
+//! @details Every sample is read just before being overwritten by the input, so the vector
+//! is processed as (at most) two contiguous segments: before and after the end of the buffer.
+void pa_delay2_tilde_perform64_block(t_pa_delay2_tilde* x, double* in, double* out, long vecsize)
+{
+    double* buffer = x->m_buffer;
+    const t_atom_long count = x->m_count;
+    const t_atom_long buffersize = x->m_buffersize;
+    
+    const long first = (vecsize < buffersize - count) ? vecsize : (long)(buffersize - count);
     
-    // or alloc and init to 0 directly with calloc
-    //x->m_buffer = (double*)calloc(x->m_buffersize, sizeof(double));
+    pa_delay2_tilde_exchange(buffer + count, in, out, first);
+    pa_delay2_tilde_exchange(buffer, in + first, out + first, vecsize - first);
+    
+    x->m_count = (first < vecsize) ? (vecsize - first) : (count + vecsize);
+    if(x->m_count >= buffersize) x->m_count = 0;
 }
 
 void pa_delay2_tilde_perform64(t_pa_delay2_tilde* x, t_object* dsp64,
@@ -68,6 +189,19 @@ void pa_delay2_tilde_perform64(t_pa_delay2_tilde* x, t_object* dsp64,
     double* in = ins[0];
     double* out = outs[0];
     
+    pa_delay2_tilde_update(x);
+    
+    // the vector is written in the buffer, the next update copies it if a new buffer is waiting
+    x->m_history->written((size_t)vecsize);
+    
+    if(vecsize <= x->m_buffersize)
+    {
+        pa_delay2_tilde_perform64_block(x, in, out, vecsize);
+        return;
+    }
+    
+    // the buffer is smaller than the vector: sample by sample
+    
     double* buffer = x->m_buffer;
     t_atom_long count = x->m_count;
     double* buffer_playhead = NULL;
@@ -100,9 +234,11 @@ void pa_delay2_tilde_perform64(t_pa_delay2_tilde* x, t_object* dsp64,
 void pa_delay2_tilde_dsp64(t_pa_delay2_tilde* x, t_object* dsp64, short* count,
                             double samplerate, long maxvectorsize, long flags)
 {
-    // as you want :
-    //pa_delay2_tilde_clear_buffer(x);
-    //x->m_count = 0;
+    // the default size is 100ms at the current sampling rate
+    if(x->m_default_size && x->m_maxsize != (t_atom_long)(samplerate * 0.1))
+    {
+        pa_delay2_tilde_create_buffer(x, (t_atom_long)(samplerate * 0.1));
+    }
     
     object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
                          dsp64, gensym("dsp_add64"), (t_object*)x,
@@ -114,7 +250,7 @@ void pa_delay2_tilde_assist(t_pa_delay2_tilde* x, void* unused,
 {
     if(io == ASSIST_INLET)
     {
-        strncpy(string_dest, "(signal) input to be delayed", ASSIST_STRING_MAXSIZE);
+        strncpy(string_dest, "(signal) input to be delayed, (maxsize) delay size in samps, (hugepages, mlock) 0 or 1", ASSIST_STRING_MAXSIZE);
     }
     else if(io == ASSIST_OUTLET)
     {
@@ -129,7 +265,20 @@ void* pa_delay2_tilde_new(t_symbol *name, long argc, t_atom *argv)
     if(x)
     {
         x->m_buffer = nullptr;
+        x->m_buffersize = 0;
         x->m_count = 0;
+        x->m_default_size = true;
+        x->m_hugepages = false;
+        x->m_mlock = false;
+        
+        // instantiate a new Handoff object
+        // Note: dont forget to delete it in the free method !
+        x->m_buffers = new Handoff<PageVector<double>>();
+        
+        // instantiate a new DeferredHistory object
+        // Note: dont forget to delete it in the free method !
+        x->m_history = new DeferredHistory();
+        x->m_clock = clock_new(x, (method)pa_delay2_tilde_reclaim);
         
         t_atom_long buffersize = (t_atom_long)(sys_getsr() * 0.1); // default to 100ms
         
@@ -138,6 +287,7 @@ void* pa_delay2_tilde_new(t_symbol *name, long argc, t_atom *argv)
             if(atom_getlong(argv) > 0)
             {
                 buffersize = atom_getlong(argv);
+                x->m_default_size = false;
             }
             else
             {
@@ -145,10 +295,8 @@ void* pa_delay2_tilde_new(t_symbol *name, long argc, t_atom *argv)
             }
         }
         
-        x->m_buffersize = buffersize;
-        
-        // reset our buffer.
-        pa_delay2_tilde_create_buffer(x);
+        // the first buffer is adopted by the first vector
+        pa_delay2_tilde_create_buffer(x, buffersize);
         
         dsp_setup((t_pxobject*)x, 1);
         outlet_new(x, "signal");
@@ -160,6 +308,15 @@ void* pa_delay2_tilde_new(t_symbol *name, long argc, t_atom *argv)
 void pa_delay2_tilde_free(t_pa_delay2_tilde* x)
 {
     dsp_free((t_pxobject*)x);
+    
+    // get rid of the clock
+    freeobject(x->m_clock);
+    
+    // free the memory for the Handoff object (and the buffers)
+    delete x->m_buffers;
+    
+    // free the memory for the DeferredHistory object
+    delete x->m_history;
 }
 
 void ext_main(void* r)
@@ -167,8 +324,11 @@ void ext_main(void* r)
     this_class = class_new("pa.delay2~", (method)pa_delay2_tilde_new, (method)pa_delay2_tilde_free,
                            sizeof(t_pa_delay2_tilde), 0, A_GIMME, 0);
     
-    class_addmethod(this_class, (method)pa_delay2_tilde_assist,    "assist",   A_CANT,		0);
-    class_addmethod(this_class, (method)pa_delay2_tilde_dsp64,     "dsp64",    A_CANT,		0);
+    class_addmethod(this_class, (method)pa_delay2_tilde_assist,        "assist",   A_CANT,		0);
+    class_addmethod(this_class, (method)pa_delay2_tilde_dsp64,         "dsp64",    A_CANT,		0);
+    class_addmethod(this_class, (method)pa_delay2_tilde_set_maxsize,   "maxsize",  A_LONG,     0);
+    class_addmethod(this_class, (method)pa_delay2_tilde_set_hugepages, "hugepages", A_LONG,    0);
+    class_addmethod(this_class, (method)pa_delay2_tilde_set_mlock,     "mlock",    A_LONG,     0);
     
     class_dspinit(this_class);
     class_register(CLASS_BOX, this_class);
@@ -0,0 +1,112 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                  DEFERRED CLEAR                                  //
+    // ================================================================================ //
+
+    //! @brief Clears a delay buffer from the audio thread, a bounded chunk per vector.
+    //! @details request() only counts the requests (message thread), the audio thread starts the clear
+    //! at the beginning of the next vector and zeroes at most Chunk samples per vector, just ahead of the write head:
+    //! the samples written since the clear started and the zeroed ones make a contiguous region that grows
+    //! on both sides until it covers the whole buffer. The reads are muted until then, the buffer then holds
+    //! what an instant clear would have left in it, whatever its size the cost of a vector stays bounded.
+    class DeferredClear
+    {
+    public: // methods
+
+        //! @brief The largest number of samples zeroed per vector.
+        static const size_t Chunk = 16384;
+
+        //! @brief Default constructor
+        DeferredClear() = default;
+
+        DeferredClear(DeferredClear const&) = delete;
+        DeferredClear& operator=(DeferredClear const&) = delete;
+
+        //! @brief Ask for a clear (message thread).
+        void request()
+        {
+            m_requests.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        //! @brief Start a clear if one has been asked since the last one (audio thread).
+        //! @param size The number of samples of the buffer.
+        //! @return true if a clear starts, the caller resets the states of its reads.
+        bool start(size_t size)
+        {
+            const size_t requests = m_requests.load(std::memory_order_relaxed);
+
+            if(requests == m_handled)
+            {
+                return false;
+            }
+
+            m_handled = requests;
+            m_ahead = 0;
+            m_left = size;
+            return true;
+        }
+
+        //! @brief The buffer has been replaced (audio thread): a clear in progress starts again on the new one.
+        void restart(size_t size)
+        {
+            if(active())
+            {
+                m_ahead = 0;
+                m_left = size;
+            }
+        }
+
+        //! @brief Zero the next chunk ahead of the write head, before the vector is written (audio thread).
+        //! @param zero Called with the offset of the first sample from the write head and the number of samples.
+        template<class Function>
+        void step(Function&& zero)
+        {
+            const size_t count = std::min(Chunk, m_left);
+
+            if(count > 0)
+            {
+                zero(m_ahead, count);
+                m_ahead += count;
+                m_left -= count;
+            }
+        }
+
+        //! @brief The write head has moved by size samples (audio thread).
+        void written(size_t size)
+        {
+            // the zeroed samples are overwritten first, then the ones that were not cleared yet
+            const size_t zeroed = std::min(size, m_ahead);
+
+            m_ahead -= zeroed;
+            m_left -= std::min(m_left, size - zeroed);
+        }
+
+        //! @brief Returns true while the buffer is being cleared, the reads are muted (audio thread).
+        bool active() const
+        {
+            return m_left > 0;
+        }
+
+    private: // variables
+
+        std::atomic<size_t> m_requests {0};
+        size_t              m_handled = 0;
+
+        // the number of samples zeroed ahead of the write head and of samples still to clear
+        size_t              m_ahead = 0;
+        size_t              m_left = 0;
+    };
+}
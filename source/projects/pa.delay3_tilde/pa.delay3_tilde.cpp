@@ -10,79 +10,338 @@
 using namespace c74::max;
 
 #include <stdlib.h> // malloc, calloc, free...
+#include <string.h> // strcmp
+
+#include <algorithm> // std::swap_ranges
+#include <atomic>
+
+#include "DeferredClear.hpp"
+#include "DeferredHistory.hpp"
+#include "Handoff.hpp"
+#include "PageAllocator.hpp"
+#include "Sample.hpp"
+using paccpp::DeferredClear;
+using paccpp::DeferredHistory;
+using paccpp::Handoff;
+using paccpp::Int24;
+using paccpp::PageAllocator;
+using paccpp::PageVector;
 
 static t_class* this_class = nullptr;
 
+//! @brief The names of the sample storages, in the order of m_storage.
+static const char* const storage_names[] = {"double", "float", "int24"};
+
+//! @brief A buffer built by the message thread, adopted by the perform method.
+//! @details Only the samples of the storage type are allocated.
+struct t_pa_delay3_tilde_buffer
+{
+    PageVector<double>  m_samples;
+    PageVector<float>   m_samples32;
+    PageVector<Int24>   m_samples24;
+};
+
+//! @brief Returns the samples of a storage type.
+PageVector<double>& pa_delay3_tilde_samples(t_pa_delay3_tilde_buffer& buffer, double) { return buffer.m_samples; }
+PageVector<float>& pa_delay3_tilde_samples(t_pa_delay3_tilde_buffer& buffer, float) { return buffer.m_samples32; }
+PageVector<Int24>& pa_delay3_tilde_samples(t_pa_delay3_tilde_buffer& buffer, Int24) { return buffer.m_samples24; }
+PageVector<double> const& pa_delay3_tilde_samples(t_pa_delay3_tilde_buffer const& buffer, double) { return buffer.m_samples; }
+PageVector<float> const& pa_delay3_tilde_samples(t_pa_delay3_tilde_buffer const& buffer, float) { return buffer.m_samples32; }
+PageVector<Int24> const& pa_delay3_tilde_samples(t_pa_delay3_tilde_buffer const& buffer, Int24) { return buffer.m_samples24; }
+
 struct t_pa_delay3_tilde
 {
     t_pxobject  m_obj;
     
-    double*     m_buffer;
+    // the buffer used by the perform method
+    t_pa_delay3_tilde_buffer* m_buffer;
     t_atom_long m_buffersize;
     
     t_atom_long m_writer_playhead;
-    t_atom_long m_reader_playhead;
+    
+    // the delay set by the size message, the perform method places the reader playhead (clipped to the buffer it uses)
+    std::atomic<t_atom_long> m_delay;
+    
+    // the buffers built by the message thread, adopted by the perform method
+    Handoff<t_pa_delay3_tilde_buffer>* m_buffers;
+    t_atom_long m_maxsize;
+    long        m_buffer_storage;
+    bool        m_default_size;
+    
+    // deletes the buffers replaced by the audio thread
+    t_clock*    m_clock;
+    
+    // the clear message, carried out by the perform method
+    DeferredClear* m_clear;
+    
+    // the history of the buffer being replaced, copied by the perform method
+    DeferredHistory* m_history;
+    
+    long        m_storage;
+    
+    // the pages of the buffers
+    bool        m_hugepages;
+    bool        m_mlock;
 };
 
-void pa_delay3_tilde_delete_buffer(t_pa_delay3_tilde* x)
+void pa_delay3_tilde_reclaim(t_pa_delay3_tilde* x)
 {
-    if(x->m_buffer)
-    {
-        // free allocated buffer
-        free(x->m_buffer);
-        x->m_buffer = nullptr;
-    }
+    x->m_buffers->reclaim();
 }
 
+//! @brief Ask the perform method to clear the buffer (see DeferredClear), the output is muted until it is done.
 void pa_delay3_tilde_clear_buffer(t_pa_delay3_tilde* x)
 {
-    int i = 0;
-    if(x->m_buffer)
+    x->m_clear->request();
+}
+
+//! @brief Allocate the samples of a storage type, with the pages asked by the hugepages and mlock messages.
+template<class Sample>
+void pa_delay3_tilde_allocate(t_pa_delay3_tilde* x, PageVector<Sample>& samples, t_atom_long buffersize)
+{
+    const PageAllocator<Sample> allocator(x->m_hugepages ? PageAllocator<Sample>::HugePages : 0);
+    samples = PageVector<Sample>(buffersize, Sample(0.), allocator);
+    
+    if(x->m_mlock && !paccpp::lockPages(samples.data(), samples.size() * sizeof(Sample)))
     {
-        for(; i < x->m_buffersize; ++i)
-        {
-            x->m_buffer[i] = 0.f;
-        }
+        object_error((t_object*)x, "can't lock the buffer in memory (see ulimit -l)");
     }
 }
 
-void pa_delay3_tilde_create_buffer(t_pa_delay3_tilde* x)
+//! @brief Build a new buffer and hand it over to the perform method (message thread).
+//! @details The memory is allocated and its pages are mapped here (see PageAllocator), and locked on demand:
+//! the perform method never allocates nor frees nor faults, it only adopts the new buffer at the beginning of a vector.
+//! @param storage The storage type of the perform routine: a new one is only taken into account by the dsp64 method.
+void pa_delay3_tilde_create_buffer(t_pa_delay3_tilde* x, t_atom_long buffersize, long storage)
 {
-    pa_delay3_tilde_delete_buffer(x);
+    t_pa_delay3_tilde_buffer* buffer = new t_pa_delay3_tilde_buffer();
     
-    // allocate and clear buffer
-    x->m_buffer = (double*)calloc(x->m_buffersize, sizeof(double));
+    switch(storage)
+    {
+        case 1: pa_delay3_tilde_allocate(x, buffer->m_samples32, buffersize); break;
+        case 2: pa_delay3_tilde_allocate(x, buffer->m_samples24, buffersize); break;
+        default: pa_delay3_tilde_allocate(x, buffer->m_samples, buffersize); break;
+    }
+    
+    x->m_maxsize = buffersize;
+    x->m_buffer_storage = storage;
+    x->m_buffers->publish(buffer);
 }
 
-void pa_delay3_set_size_in_samps(t_pa_delay3_tilde *x, t_atom_long l)
+void pa_delay3_tilde_set_maxsize(t_pa_delay3_tilde* x, long buffersize)
 {
-    t_atom_long delay_size = l;
+    if(buffersize < 1)
+    {
+        object_error((t_object*)x, "buffer size must be > 0");
+        return;
+    }
     
-    // clip to buffersize max
-    if(delay_size > x->m_buffersize)
+    // the size doesn't follow the sampling rate anymore
+    x->m_default_size = false;
+    pa_delay3_tilde_create_buffer(x, buffersize, x->m_buffer_storage);
+}
+
+//! @brief Use huge pages for the buffer or not, it is rebuilt.
+void pa_delay3_tilde_set_hugepages(t_pa_delay3_tilde* x, long state)
+{
+    x->m_hugepages = (state != 0);
+    pa_delay3_tilde_create_buffer(x, x->m_maxsize, x->m_buffer_storage);
+}
+
+//! @brief Lock the buffer in memory or not, it is rebuilt.
+void pa_delay3_tilde_set_mlock(t_pa_delay3_tilde* x, long state)
+{
+    x->m_mlock = (state != 0);
+    pa_delay3_tilde_create_buffer(x, x->m_maxsize, x->m_buffer_storage);
+}
+
+//! @brief Copy count samples from a position of the previous buffer to a position of a new one, both wrapped.
+template<class Sample>
+void pa_delay3_tilde_copy_history(PageVector<Sample> const& previous, size_t from, PageVector<Sample>& buffer, size_t to, size_t count)
+{
+    while(count > 0)
     {
-        delay_size = x->m_buffersize;
+        const size_t size = std::min({count, previous.size() - from, buffer.size() - to});
+        
+        std::copy(previous.begin() + from, previous.begin() + (from + size), buffer.begin() + to);
+        
+        from = (from + size < previous.size()) ? (from + size) : 0;
+        to = (to + size < buffer.size()) ? (to + size) : 0;
+        count -= size;
     }
-    else if(delay_size < 1)
+}
+
+//! @brief Adopt the last buffer built by the message thread once it holds the history of the current one, if any (audio thread).
+//! @details The history of the storage type of the perform routine is copied a chunk per vector (see DeferredHistory)
+//! so the delay goes on without a glitch (a new storage type starts empty),
+//! the previous buffer can't be deleted in the audio thread so we defer it to the clock.
+template<class Sample>
+void pa_delay3_tilde_update(t_pa_delay3_tilde* x)
+{
+    DeferredHistory& history = *x->m_history;
+    
+    auto prepare = [x, &history](t_pa_delay3_tilde_buffer& buffer, t_pa_delay3_tilde_buffer const& previous)
+    {
+        PageVector<Sample>& samples = pa_delay3_tilde_samples(buffer, Sample());
+        PageVector<Sample> const& source = pa_delay3_tilde_samples(previous, Sample());
+        const size_t size = source.size();
+        
+        // one of the buffers has another storage type
+        if(samples.empty() || source.empty()) return true;
+        
+        return history.step(std::min(size, samples.size()), [x, &history, &samples, &source, size](size_t delay, size_t count)
+        {
+            pa_delay3_tilde_copy_history(source, ((size_t)x->m_writer_playhead + size - delay) % size,
+                                         samples, history.copied() % samples.size(), count);
+        });
+    };
+    
+    auto adopt = [x, &history](t_pa_delay3_tilde_buffer& buffer, t_pa_delay3_tilde_buffer const*)
     {
-        delay_size = 1;
+        const t_atom_long buffersize = (t_atom_long)std::max({buffer.m_samples.size(), buffer.m_samples32.size(), buffer.m_samples24.size()});
+        
+        // a clear in progress starts again on the new buffer
+        x->m_clear->restart((size_t)buffersize);
+        
+        // the writer playhead follows the copied samples
+        x->m_buffer = &buffer;
+        x->m_buffersize = buffersize;
+        x->m_writer_playhead = (t_atom_long)(history.copied() % (size_t)buffersize);
+        
+        history.finish();
+    };
+    
+    if(x->m_buffers->update(prepare, adopt))
+    {
+        clock_delay(x->m_clock, 0);
     }
+}
+
+//! @brief Set the delay (message thread).
+//! @details Only the delay is stored: the buffer and the writer playhead belong to the perform method,
+//! which clips the delay to the size of the buffer it uses at the beginning of each vector.
+void pa_delay3_set_size_in_samps(t_pa_delay3_tilde *x, t_atom_long l)
+{
+    x->m_delay.store((l < 1) ? 1 : l, std::memory_order_relaxed);
+}
+
+//! @brief Copy size samples of the buffer from a playhead position, in (at most) two contiguous segments.
+//! @details The samples are converted from the storage type (a memcpy for double).
+template<class Sample>
+void pa_delay3_tilde_read_segments(t_pa_delay3_tilde* x, Sample const* buffer, t_atom_long playhead, double* out, long size)
+{
+    const long first = (size < x->m_buffersize - playhead) ? size : (long)(x->m_buffersize - playhead);
     
-    t_atom_long reader_playhead = x->m_writer_playhead - delay_size;
+    paccpp::simd::convert(buffer + playhead, out, first);
+    paccpp::simd::convert(buffer, out + first, size - first);
+}
+
+//! @brief Copy size samples to the buffer from a playhead position, in (at most) two contiguous segments.
+template<class Sample>
+void pa_delay3_tilde_write_segments(t_pa_delay3_tilde* x, Sample* buffer, t_atom_long playhead, double const* in, long size)
+{
+    const long first = (size < x->m_buffersize - playhead) ? size : (long)(x->m_buffersize - playhead);
     
-    if(reader_playhead < 0) reader_playhead += x->m_buffersize;
+    paccpp::simd::convert(in, buffer + playhead, first);
+    paccpp::simd::convert(in + first, buffer, size - first);
+}
+
+//! @brief Set size samples of the buffer to zero from offset samples after the writer playhead, in (at most) two contiguous segments.
+template<class Sample>
+void pa_delay3_tilde_clear_segments(t_pa_delay3_tilde* x, Sample* buffer, size_t offset, size_t size)
+{
+    const t_atom_long playhead = (x->m_writer_playhead + (t_atom_long)offset) % x->m_buffersize;
+    const size_t first = std::min(size, (size_t)(x->m_buffersize - playhead));
     
-    x->m_reader_playhead = reader_playhead;
+    std::fill(buffer + playhead, buffer + playhead + first, Sample(0.));
+    std::fill(buffer, buffer + (size - first), Sample(0.));
 }
 
-void pa_delay3_tilde_perform64(t_pa_delay3_tilde* x, t_object* dsp64,
-                               double** ins, long numins, double** outs, long numouts,
-                               long vecsize, long flags, void* userparam)
+//! @brief Output size contiguous samples and replace them by the input.
+template<class Sample>
+void pa_delay3_tilde_exchange(Sample* samples, double* inout, long size)
+{
+    for(long i = 0; i < size; ++i)
+    {
+        const double sample = samples[i];
+        samples[i] = Sample(inout[i]);
+        inout[i] = sample;
+    }
+}
+
+void pa_delay3_tilde_exchange(double* samples, double* inout, long size)
+{
+    std::swap_ranges(inout, inout + size, samples);
+}
+
+//! @brief Output size samples of the buffer from a playhead position and replace them by the input (in-place).
+template<class Sample>
+void pa_delay3_tilde_exchange_segments(t_pa_delay3_tilde* x, Sample* buffer, t_atom_long playhead, double* inout, long size)
 {
-    double* in = ins[0];
-    double* out = outs[0];
+    const long first = (size < x->m_buffersize - playhead) ? size : (long)(x->m_buffersize - playhead);
+    
+    pa_delay3_tilde_exchange(buffer + playhead, inout, first);
+    pa_delay3_tilde_exchange(buffer, inout + first, size - first);
+}
+
+//! @brief Returns a playhead position moved by size samples (size <= buffersize).
+t_atom_long pa_delay3_tilde_advance(t_pa_delay3_tilde* x, t_atom_long playhead, long size)
+{
+    playhead += size;
+    return (playhead >= x->m_buffersize) ? (playhead - x->m_buffersize) : playhead;
+}
+
+void pa_delay3_tilde_set_storage(t_pa_delay3_tilde* x, t_symbol* name)
+{
+    for(long i = 0; i < 3; ++i)
+    {
+        if(strcmp(name->s_name, storage_names[i]) == 0)
+        {
+            // taken into account when the dsp chain is compiled (the buffer is cleared)
+            x->m_storage = i;
+            return;
+        }
+    }
+    
+    object_error((t_object*)x, "unknown storage %s (double, float or int24)", name->s_name);
+}
+
+//! @brief Delay a vector.
+template<class Sample>
+void pa_delay3_tilde_process(t_pa_delay3_tilde* x, Sample* buffer, double* in, double* out, long vecsize)
+{
+    // the delay is constant during the vector (1 to buffersize samples)
+    t_atom_long delay = x->m_delay.load(std::memory_order_relaxed);
+    if(delay > x->m_buffersize) delay = x->m_buffersize;
+    
+    t_atom_long reader_playhead = x->m_writer_playhead - delay;
+    if(reader_playhead < 0) reader_playhead += x->m_buffersize;
+    
+    // when the delay is at least a vector, no sample is written before being read in the same vector:
+    // the whole vector can be read then written by blocks.
+    // if the output replaces the input, the input has to be written first, which is only possible
+    // if the samples written don't overlap the ones read, or if they are exactly the same ones.
+    if(delay >= vecsize && (in != out || delay <= x->m_buffersize - vecsize || delay == x->m_buffersize))
+    {
+        if(in != out)
+        {
+            pa_delay3_tilde_read_segments(x, buffer, reader_playhead, out, vecsize);
+            pa_delay3_tilde_write_segments(x, buffer, x->m_writer_playhead, in, vecsize);
+        }
+        else if(delay == x->m_buffersize)
+        {
+            pa_delay3_tilde_exchange_segments(x, buffer, x->m_writer_playhead, out, vecsize);
+        }
+        else
+        {
+            pa_delay3_tilde_write_segments(x, buffer, x->m_writer_playhead, in, vecsize);
+            pa_delay3_tilde_read_segments(x, buffer, reader_playhead, out, vecsize);
+        }
+        
+        x->m_writer_playhead = pa_delay3_tilde_advance(x, x->m_writer_playhead, vecsize);
+        return;
+    }
     
-    double* buffer = x->m_buffer;
     double sample_to_write = 0.f;
     
     while(vecsize--)
@@ -91,14 +350,52 @@ void pa_delay3_tilde_perform64(t_pa_delay3_tilde* x, t_object* dsp64,
         sample_to_write = *in++;
         
         // we read our buffer.
-        *out++ = buffer[x->m_reader_playhead];
+        *out++ = buffer[reader_playhead];
         
         // then store incoming sample to the buffer.
         buffer[x->m_writer_playhead] = sample_to_write;
         
         // increment then wrap counters between buffer boundaries
         if(++x->m_writer_playhead >= x->m_buffersize) x->m_writer_playhead = 0;
-        if(++x->m_reader_playhead >= x->m_buffersize) x->m_reader_playhead = 0;
+        if(++reader_playhead >= x->m_buffersize) reader_playhead = 0;
+    }
+}
+
+//! @brief The perform routine of a storage type, picked by the dsp64 method.
+//! @details A clear zeroes a chunk of the buffer ahead of the writer playhead before the vector is delayed,
+//! the output is muted until the whole buffer is clear.
+template<class Sample>
+void pa_delay3_tilde_perform64(t_pa_delay3_tilde* x, t_object* dsp64,
+                               double** ins, long numins, double** outs, long numouts,
+                               long vecsize, long flags, void* userparam)
+{
+    DeferredClear& clear = *x->m_clear;
+    
+    pa_delay3_tilde_update<Sample>(x);
+    
+    PageVector<Sample>& samples = pa_delay3_tilde_samples(*x->m_buffer, Sample());
+    
+    // a buffer built by the dsp64 method for another storage type, adopted before this perform routine is replaced
+    if(samples.empty())
+    {
+        std::fill(outs[0], outs[0] + vecsize, 0.);
+        return;
+    }
+    
+    Sample* buffer = samples.data();
+    
+    clear.start((size_t)x->m_buffersize);
+    clear.step([x, buffer](size_t offset, size_t size) { pa_delay3_tilde_clear_segments(x, buffer, offset, size); });
+    
+    const bool muted = clear.active();
+    
+    pa_delay3_tilde_process(x, buffer, ins[0], outs[0], vecsize);
+    clear.written((size_t)vecsize);
+    x->m_history->written((size_t)vecsize);
+    
+    if(muted)
+    {
+        std::fill(outs[0], outs[0] + vecsize, 0.);
     }
 }
 
@@ -109,9 +406,27 @@ void pa_delay3_tilde_dsp64(t_pa_delay3_tilde* x, t_object* dsp64, short* count,
     // as you want :
     //pa_delay3_tilde_clear_buffer(x);
     
+    // the default size is 100ms at the current sampling rate,
+    // the buffer has to be rebuilt for another storage type.
+    const t_atom_long buffersize = x->m_default_size ? (t_atom_long)(samplerate * 0.1) : x->m_maxsize;
+    
+    if(buffersize != x->m_maxsize || x->m_storage != x->m_buffer_storage)
+    {
+        pa_delay3_tilde_create_buffer(x, buffersize, x->m_storage);
+    }
+    
+    t_perfroutine64 perform;
+    
+    switch(x->m_storage)
+    {
+        case 1: perform = (t_perfroutine64)pa_delay3_tilde_perform64<float>; break;
+        case 2: perform = (t_perfroutine64)pa_delay3_tilde_perform64<Int24>; break;
+        default: perform = (t_perfroutine64)pa_delay3_tilde_perform64<double>; break;
+    }
+    
     object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
                          dsp64, gensym("dsp_add64"), (t_object*)x,
-                         (t_perfroutine64)pa_delay3_tilde_perform64, 0, NULL);
+                         perform, 0, NULL);
 }
 
 void pa_delay3_tilde_assist(t_pa_delay3_tilde* x, void* unused,
@@ -119,7 +434,7 @@ void pa_delay3_tilde_assist(t_pa_delay3_tilde* x, void* unused,
 {
     if(io == ASSIST_INLET)
     {
-        strncpy(string_dest, "(signal) input to be delayed", ASSIST_STRING_MAXSIZE);
+        strncpy(string_dest, "(signal) input to be delayed, (size) delay size in samps, (maxsize) buffer size in samps, (storage) double, float or int24, (hugepages, mlock) 0 or 1", ASSIST_STRING_MAXSIZE);
     }
     else if(io == ASSIST_OUTLET)
     {
@@ -134,8 +449,25 @@ void* pa_delay3_tilde_new(t_symbol *name, long argc, t_atom *argv)
     if(x)
     {
         x->m_buffer = nullptr;
+        x->m_buffersize = 0;
         x->m_writer_playhead = 0;
-        x->m_reader_playhead = 0;
+        x->m_default_size = true;
+        x->m_storage = 0;
+        x->m_hugepages = false;
+        x->m_mlock = false;
+        
+        // instantiate a new Handoff object
+        // Note: dont forget to delete it in the free method !
+        x->m_buffers = new Handoff<t_pa_delay3_tilde_buffer>();
+        
+        // instantiate a new DeferredClear object
+        // Note: dont forget to delete it in the free method !
+        x->m_clear = new DeferredClear();
+        
+        // instantiate a new DeferredHistory object
+        // Note: dont forget to delete it in the free method !
+        x->m_history = new DeferredHistory();
+        x->m_clock = clock_new(x, (method)pa_delay3_tilde_reclaim);
         
         t_atom_long buffersize = (t_atom_long)(sys_getsr() * 0.1); // default to 100ms
         
@@ -144,6 +476,7 @@ void* pa_delay3_tilde_new(t_symbol *name, long argc, t_atom *argv)
             if(atom_getlong(argv) > 0)
             {
                 buffersize = atom_getlong(argv);
+                x->m_default_size = false;
             }
             else
             {
@@ -151,10 +484,11 @@ void* pa_delay3_tilde_new(t_symbol *name, long argc, t_atom *argv)
             }
         }
         
-        x->m_buffersize = buffersize;
+        // the delay is the whole buffer until the size message
+        x->m_delay.store(buffersize);
         
-        // reset our buffer.
-        pa_delay3_tilde_create_buffer(x);
+        // the first buffer is adopted by the first vector
+        pa_delay3_tilde_create_buffer(x, buffersize, x->m_storage);
         
         dsp_setup((t_pxobject*)x, 1);
         outlet_new(x, "signal");
@@ -166,6 +500,18 @@ void* pa_delay3_tilde_new(t_symbol *name, long argc, t_atom *argv)
 void pa_delay3_tilde_free(t_pa_delay3_tilde* x)
 {
     dsp_free((t_pxobject*)x);
+    
+    // get rid of the clock
+    freeobject(x->m_clock);
+    
+    // free the memory for the Handoff object (and the buffers)
+    delete x->m_buffers;
+    
+    // free the memory for the DeferredClear object
+    delete x->m_clear;
+    
+    // free the memory for the DeferredHistory object
+    delete x->m_history;
 }
 
 void ext_main(void* r)
@@ -177,6 +523,10 @@ void ext_main(void* r)
     class_addmethod(this_class, (method)pa_delay3_tilde_dsp64,          "dsp64",    A_CANT,		0);
     class_addmethod(this_class, (method)pa_delay3_set_size_in_samps,    "size",     A_DEFLONG,  0);
     class_addmethod(this_class, (method)pa_delay3_tilde_clear_buffer,   "clear",                0);
+    class_addmethod(this_class, (method)pa_delay3_tilde_set_maxsize,    "maxsize",  A_LONG,     0);
+    class_addmethod(this_class, (method)pa_delay3_tilde_set_storage,    "storage",  A_SYM,      0);
+    class_addmethod(this_class, (method)pa_delay3_tilde_set_hugepages,  "hugepages", A_LONG,    0);
+    class_addmethod(this_class, (method)pa_delay3_tilde_set_mlock,      "mlock",    A_LONG,     0);
     
     class_dspinit(this_class);
     class_register(CLASS_BOX, this_class);
@@ -0,0 +1,573 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include "RingBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                   INTERPOLATIONS                                 //
+    // ================================================================================ //
+
+    //! @brief The interpolations of a delay line read.
+    //! @details A delay is read between two samples y1 (the older) and y2 (the newer), delta in [0, 1] goes from y1 to y2.
+    //! MinDelay is the shortest delay that reads only samples already written,
+    //! Before is the number of samples read before y1 and Points the number of samples read.
+
+    //! @brief 2 points, see simd::readLinear().
+    struct InterpolationLinear
+    {
+        static const size_t MinDelay = 1;
+        static const size_t Before = 0;
+        static const size_t Points = 2;
+    };
+
+    //! @brief 4 points, 3rd order Hermite interpolation (Catmull-Rom spline).
+    struct InterpolationHermite
+    {
+        static const size_t MinDelay = 1;
+        static const size_t Before = 1;
+        static const size_t Points = 4;
+
+        template<class T>
+        static inline T interpolate(T y0, T y1, T y2, T y3, T delta)
+        {
+            const T c1 = T(0.5) * (y2 - y0);
+            const T c2 = y0 - T(2.5) * y1 + T(2.) * y2 - T(0.5) * y3;
+            const T c3 = T(0.5) * (y3 - y0) + T(1.5) * (y1 - y2);
+
+            return ((c3 * delta + c2) * delta + c1) * delta + y1;
+        }
+
+        #if defined(__AVX2__)
+
+        static inline __m256d interpolate(__m256d y0, __m256d y1, __m256d y2, __m256d y3, __m256d delta)
+        {
+            const __m256d half = _mm256_set1_pd(0.5);
+            const __m256d c1 = _mm256_mul_pd(half, _mm256_sub_pd(y2, y0));
+            const __m256d c2 = _mm256_sub_pd(_mm256_add_pd(_mm256_sub_pd(y0, _mm256_mul_pd(_mm256_set1_pd(2.5), y1)),
+                                                           _mm256_add_pd(y2, y2)),
+                                             _mm256_mul_pd(half, y3));
+            const __m256d c3 = _mm256_add_pd(_mm256_mul_pd(half, _mm256_sub_pd(y3, y0)),
+                                             _mm256_mul_pd(_mm256_set1_pd(1.5), _mm256_sub_pd(y1, y2)));
+
+            __m256d sum = _mm256_add_pd(_mm256_mul_pd(c3, delta), c2);
+            sum = _mm256_add_pd(_mm256_mul_pd(sum, delta), c1);
+            return _mm256_add_pd(_mm256_mul_pd(sum, delta), y1);
+        }
+
+        #elif defined(__SSE2__) || defined(_M_X64)
+
+        static inline __m128d interpolate(__m128d y0, __m128d y1, __m128d y2, __m128d y3, __m128d delta)
+        {
+            const __m128d half = _mm_set1_pd(0.5);
+            const __m128d c1 = _mm_mul_pd(half, _mm_sub_pd(y2, y0));
+            const __m128d c2 = _mm_sub_pd(_mm_add_pd(_mm_sub_pd(y0, _mm_mul_pd(_mm_set1_pd(2.5), y1)),
+                                                     _mm_add_pd(y2, y2)),
+                                          _mm_mul_pd(half, y3));
+            const __m128d c3 = _mm_add_pd(_mm_mul_pd(half, _mm_sub_pd(y3, y0)),
+                                          _mm_mul_pd(_mm_set1_pd(1.5), _mm_sub_pd(y1, y2)));
+
+            __m128d sum = _mm_add_pd(_mm_mul_pd(c3, delta), c2);
+            sum = _mm_add_pd(_mm_mul_pd(sum, delta), c1);
+            return _mm_add_pd(_mm_mul_pd(sum, delta), y1);
+        }
+
+        #endif
+    };
+
+    //! @brief 4 points, 3rd order Lagrange interpolation (the polynomial through the 4 points).
+    //! @details With the points at -1, 0, 1 and 2, the weights share the factors (delta - 1)(delta - 2)
+    //! and (delta + 1)delta, which leaves 10 multiplications.
+    struct InterpolationLagrange
+    {
+        static const size_t MinDelay = 1;
+        static const size_t Before = 1;
+        static const size_t Points = 4;
+
+        template<class T>
+        static inline T interpolate(T y0, T y1, T y2, T y3, T delta)
+        {
+            const T d1 = delta - T(1.);
+            const T d2 = delta - T(2.);
+            const T a = d1 * d2;
+            const T b = (delta + T(1.)) * delta;
+
+            return a * ((delta + T(1.)) * T(0.5) * y1 - delta * T(1. / 6.) * y0)
+                 + b * (d1 * T(1. / 6.) * y3 - d2 * T(0.5) * y2);
+        }
+
+        #if defined(__AVX2__)
+
+        static inline __m256d interpolate(__m256d y0, __m256d y1, __m256d y2, __m256d y3, __m256d delta)
+        {
+            const __m256d one = _mm256_set1_pd(1.);
+            const __m256d half = _mm256_set1_pd(0.5);
+            const __m256d sixth = _mm256_set1_pd(1. / 6.);
+            const __m256d d1 = _mm256_sub_pd(delta, one);
+            const __m256d d2 = _mm256_sub_pd(delta, _mm256_set1_pd(2.));
+            const __m256d dp = _mm256_add_pd(delta, one);
+            const __m256d a = _mm256_mul_pd(d1, d2);
+            const __m256d b = _mm256_mul_pd(dp, delta);
+
+            const __m256d left = _mm256_sub_pd(_mm256_mul_pd(_mm256_mul_pd(dp, half), y1),
+                                               _mm256_mul_pd(_mm256_mul_pd(delta, sixth), y0));
+            const __m256d right = _mm256_sub_pd(_mm256_mul_pd(_mm256_mul_pd(d1, sixth), y3),
+                                                _mm256_mul_pd(_mm256_mul_pd(d2, half), y2));
+
+            return _mm256_add_pd(_mm256_mul_pd(a, left), _mm256_mul_pd(b, right));
+        }
+
+        #elif defined(__SSE2__) || defined(_M_X64)
+
+        static inline __m128d interpolate(__m128d y0, __m128d y1, __m128d y2, __m128d y3, __m128d delta)
+        {
+            const __m128d one = _mm_set1_pd(1.);
+            const __m128d half = _mm_set1_pd(0.5);
+            const __m128d sixth = _mm_set1_pd(1. / 6.);
+            const __m128d d1 = _mm_sub_pd(delta, one);
+            const __m128d d2 = _mm_sub_pd(delta, _mm_set1_pd(2.));
+            const __m128d dp = _mm_add_pd(delta, one);
+            const __m128d a = _mm_mul_pd(d1, d2);
+            const __m128d b = _mm_mul_pd(dp, delta);
+
+            const __m128d left = _mm_sub_pd(_mm_mul_pd(_mm_mul_pd(dp, half), y1),
+                                            _mm_mul_pd(_mm_mul_pd(delta, sixth), y0));
+            const __m128d right = _mm_sub_pd(_mm_mul_pd(_mm_mul_pd(d1, sixth), y3),
+                                             _mm_mul_pd(_mm_mul_pd(d2, half), y2));
+
+            return _mm_add_pd(_mm_mul_pd(a, left), _mm_mul_pd(b, right));
+        }
+
+        #endif
+    };
+
+    //! @brief 1st order allpass (Thiran) interpolation.
+    //! @details A delay N + D is read as out = a.(x[N] - previous out) + x[N + 1] with a = (1 - D) / (1 + D),
+    //! x[k] being the sample delayed by k. The integer part N is chosen so that D stays in [0.5, 1.5):
+    //! a stays in (-0.2, 0.34] and the pole far from the unit circle.
+    //! It has no high frequency loss (the gain is 1 at all frequencies) but it is recursive:
+    //! each reader keeps its previous output and the delay should not jump.
+    struct InterpolationThiran
+    {
+        static const size_t MinDelay = 1;
+        static const size_t Before = 0;
+        static const size_t Points = 2;
+    };
+
+    //! @brief 16 points windowed sinc interpolation, with a polyphase table.
+    //! @details The filters of Phases positions between two samples are precomputed (a Kaiser window with beta = 8.6,
+    //! normalized to a gain of 1 at DC), the output between two phases interpolates the outputs of their filters.
+    //! The stopband is attenuated by about 90 dB, the passband is flat within 0.1 dB up to 0.4 times the sampling rate.
+    struct InterpolationSinc
+    {
+        static const size_t MinDelay = 7;
+        static const size_t Before = 7;
+        static const size_t Points = 16;
+        static const size_t Phases = 256;
+
+        //! @brief Returns the (Phases + 1) filters of Points coefficients, the last one is the first one shifted by a sample.
+        //! @details They are computed by the first call: make it before using them in the audio thread.
+        static double const* filters()
+        {
+            static const std::vector<double> table = build();
+            return table.data();
+        }
+
+        template<class S, class T>
+        static inline T interpolate(double const* filters, S const* points, T delta)
+        {
+            const T phase = delta * T(Phases);
+            const size_t index = std::min(size_t(phase), Phases - 1);
+            const T fraction = phase - T(index);
+
+            double const* h1 = filters + index * Points;
+            double const* h2 = h1 + Points;
+            T out1 = T(0.);
+            T out2 = T(0.);
+
+            for(size_t k = 0; k < Points; ++k)
+            {
+                const T y = T(points[k]);
+                out1 += T(h1[k]) * y;
+                out2 += T(h2[k]) * y;
+            }
+
+            return out1 + fraction * (out2 - out1);
+        }
+
+        #if defined(__AVX2__)
+
+        template<class S>
+        static inline double interpolate(double const* filters, S const* points, double delta)
+        {
+            const double phase = delta * double(Phases);
+            const size_t index = std::min(size_t(phase), Phases - 1);
+            const double fraction = phase - double(index);
+
+            double const* h1 = filters + index * Points;
+            double const* h2 = h1 + Points;
+            __m256d out1 = _mm256_setzero_pd();
+            __m256d out2 = _mm256_setzero_pd();
+
+            for(size_t k = 0; k < Points; k += 4)
+            {
+                const __m256d y = simd::load(points + k);
+                out1 = _mm256_add_pd(out1, _mm256_mul_pd(_mm256_loadu_pd(h1 + k), y));
+                out2 = _mm256_add_pd(out2, _mm256_mul_pd(_mm256_loadu_pd(h2 + k), y));
+            }
+
+            // out1 + fraction * (out2 - out1), then the horizontal sum
+            const __m256d out = _mm256_add_pd(out1, _mm256_mul_pd(_mm256_set1_pd(fraction), _mm256_sub_pd(out2, out1)));
+            const __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(out), _mm256_extractf128_pd(out, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+        }
+
+        #elif defined(__SSE2__) || defined(_M_X64)
+
+        template<class S>
+        static inline double interpolate(double const* filters, S const* points, double delta)
+        {
+            const double phase = delta * double(Phases);
+            const size_t index = std::min(size_t(phase), Phases - 1);
+            const double fraction = phase - double(index);
+
+            double const* h1 = filters + index * Points;
+            double const* h2 = h1 + Points;
+            __m128d out1 = _mm_setzero_pd();
+            __m128d out2 = _mm_setzero_pd();
+
+            for(size_t k = 0; k < Points; k += 2)
+            {
+                const __m128d y = simd::load(points + k);
+                out1 = _mm_add_pd(out1, _mm_mul_pd(_mm_loadu_pd(h1 + k), y));
+                out2 = _mm_add_pd(out2, _mm_mul_pd(_mm_loadu_pd(h2 + k), y));
+            }
+
+            const __m128d out = _mm_add_pd(out1, _mm_mul_pd(_mm_set1_pd(fraction), _mm_sub_pd(out2, out1)));
+            return _mm_cvtsd_f64(_mm_add_sd(out, _mm_unpackhi_pd(out, out)));
+        }
+
+        #endif
+
+    private: // methods
+
+        //! @brief The modified Bessel function of the first kind I0 (its power series).
+        static double bessel(double x)
+        {
+            const double u = 0.25 * x * x;
+            double term = 1.;
+            double sum = 1.;
+
+            for(int k = 1; term > 1e-17 * sum; ++k)
+            {
+                term *= u / double(k * k);
+                sum += term;
+            }
+
+            return sum;
+        }
+
+        static std::vector<double> build()
+        {
+            const double beta = 8.6;
+            const double half = 0.5 * double(Points);
+            const double pi = 3.14159265358979323846;
+            std::vector<double> table((Phases + 1) * Points);
+
+            for(size_t p = 0; p <= Phases; ++p)
+            {
+                const double delta = double(p) / double(Phases);
+                double* filter = table.data() + p * Points;
+                double sum = 0.;
+
+                for(size_t k = 0; k < Points; ++k)
+                {
+                    // distance between the point and the position read
+                    const double x = double(k) - double(Before) - delta;
+                    const double window = bessel(beta * std::sqrt(std::max(0., 1. - (x * x) / (half * half)))) / bessel(beta);
+                    const double sinc = (x == 0.) ? 1. : std::sin(pi * x) / (pi * x);
+
+                    filter[k] = sinc * window;
+                    sum += filter[k];
+                }
+
+                for(size_t k = 0; k < Points; ++k)
+                {
+                    filter[k] /= sum;
+                }
+            }
+
+            return table;
+        }
+    };
+
+    // ================================================================================ //
+    //                                INTERPOLATED READERS                              //
+    // ================================================================================ //
+
+    namespace simd
+    {
+        //! @brief 4 points interpolating reads of a ring buffer (see readLinear()), its guard must be >= 3.
+        template<class Interpolation, class S, class T>
+        inline void readFourPoints(Interpolation, S const* data, size_t mask, size_t position,
+                                   T const* delays, T max_delay, T* outs, long vecsize)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const T delay = std::max(std::min(delays[i], max_delay), T(1.));
+                const size_t integer = size_t(delay);
+                const T delta = T(1.) - (delay - T(integer));
+
+                // reader[1] is the sample delayed by the integer part + 1
+                S const* reader = data + ((position + i - integer - 2) & mask);
+                outs[i] = Interpolation::interpolate(T(reader[0]), T(reader[1]), T(reader[2]), T(reader[3]), delta);
+            }
+        }
+
+        #if defined(__AVX2__)
+
+        //! @brief 4 samples at a time with gathers (the capacity must fit in 31 bits).
+        template<class Interpolation, class S>
+        inline void readFourPoints(Interpolation, S const* data, size_t mask, size_t position,
+                                   double const* delays, double max_delay, double* outs, long vecsize)
+        {
+            const __m256d one = _mm256_set1_pd(1.);
+            const __m256d maximum = _mm256_set1_pd(max_delay);
+            const __m128i mask_4 = _mm_set1_epi32(int32_t(mask));
+            const __m128i step = _mm_set1_epi32(4);
+            __m128i positions = _mm_add_epi32(_mm_set1_epi32(int32_t(position - 2)), _mm_setr_epi32(0, 1, 2, 3));
+            long i = 0;
+
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                const __m256d delay = _mm256_max_pd(_mm256_min_pd(_mm256_loadu_pd(delays + i), maximum), one);
+                const __m128i integer = _mm256_cvttpd_epi32(delay);
+                const __m256d delta = _mm256_sub_pd(one, _mm256_sub_pd(delay, _mm256_cvtepi32_pd(integer)));
+                const __m128i index = _mm_and_si128(_mm_sub_epi32(positions, integer), mask_4);
+
+                const __m256d y0 = gather(data, index);
+                const __m256d y1 = gather(data + 1, index);
+                const __m256d y2 = gather(data + 2, index);
+                const __m256d y3 = gather(data + 3, index);
+
+                _mm256_storeu_pd(outs + i, Interpolation::interpolate(y0, y1, y2, y3, delta));
+                positions = _mm_add_epi32(positions, step);
+            }
+
+            readFourPoints<Interpolation, S, double>(Interpolation(), data, mask, position + i,
+                                                     delays + i, max_delay, outs + i, vecsize - i);
+        }
+
+        #elif defined(__SSE2__) || defined(_M_X64)
+
+        //! @brief 2 samples at a time, each one loads its 4 points with 2 unaligned loads then they are transposed.
+        template<class Interpolation, class S>
+        inline void readFourPoints(Interpolation, S const* data, size_t mask, size_t position,
+                                   double const* delays, double max_delay, double* outs, long vecsize)
+        {
+            const __m128d one = _mm_set1_pd(1.);
+            const __m128d maximum = _mm_set1_pd(max_delay);
+            const __m128i mask_2 = _mm_set1_epi32(int32_t(mask));
+            const __m128i step = _mm_set1_epi32(2);
+            __m128i positions = _mm_add_epi32(_mm_set1_epi32(int32_t(position - 2)), _mm_setr_epi32(0, 1, 0, 0));
+            long i = 0;
+
+            for(; i + 2 <= vecsize; i += 2)
+            {
+                const __m128d delay = _mm_max_pd(_mm_min_pd(_mm_loadu_pd(delays + i), maximum), one);
+                const __m128i integer = _mm_cvttpd_epi32(delay);
+                const __m128d delta = _mm_sub_pd(one, _mm_sub_pd(delay, _mm_cvtepi32_pd(integer)));
+                const __m128i index = _mm_and_si128(_mm_sub_epi32(positions, integer), mask_2);
+
+                S const* reader_0 = data + _mm_cvtsi128_si32(index);
+                S const* reader_1 = data + _mm_cvtsi128_si32(_mm_shuffle_epi32(index, 1));
+
+                const __m128d a01 = load(reader_0);
+                const __m128d a23 = load(reader_0 + 2);
+                const __m128d b01 = load(reader_1);
+                const __m128d b23 = load(reader_1 + 2);
+
+                _mm_storeu_pd(outs + i, Interpolation::interpolate(_mm_unpacklo_pd(a01, b01), _mm_unpackhi_pd(a01, b01),
+                                                                   _mm_unpacklo_pd(a23, b23), _mm_unpackhi_pd(a23, b23),
+                                                                   delta));
+                positions = _mm_add_epi32(positions, step);
+            }
+
+            readFourPoints<Interpolation, S, double>(Interpolation(), data, mask, position + i,
+                                                     delays + i, max_delay, outs + i, vecsize - i);
+        }
+
+        #endif
+
+        //! @brief Windowed sinc reads of a ring buffer (see readLinear()), its guard must be >= 15.
+        //! @details The delays are clipped to [7, max_delay]: the 8 points after the position must have been written.
+        //! Each sample is a dot product of 16 contiguous points, computed with SIMD across the points.
+        template<class S, class T>
+        inline void readSinc(S const* data, size_t mask, size_t position,
+                             T const* delays, T max_delay, T* outs, long vecsize)
+        {
+            double const* filters = InterpolationSinc::filters();
+            const T min_delay = T(InterpolationSinc::MinDelay);
+
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const T delay = std::max(std::min(delays[i], max_delay), min_delay);
+                const size_t integer = size_t(delay);
+                const T delta = T(1.) - (delay - T(integer));
+
+                S const* reader = data + ((position + i - integer - 1 - InterpolationSinc::Before) & mask);
+                outs[i] = InterpolationSinc::interpolate(filters, reader, delta);
+            }
+        }
+
+        //! @brief Computes the positions and coefficients of the allpass interpolation of a block (see readThiran()).
+        template<class T>
+        inline void thiranCoefficients(size_t mask, size_t position, T const* delays, T max_delay,
+                                       int32_t* indices, T* coefficients, long vecsize)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const T delay = std::max(std::min(delays[i], max_delay), T(1.));
+                const size_t integer = size_t(delay - T(0.5));
+                const T fraction = delay - T(integer);
+
+                indices[i] = int32_t((position + i - integer - 1) & mask);
+                coefficients[i] = (T(1.) - fraction) / (T(1.) + fraction);
+            }
+        }
+
+        #if defined(__AVX2__)
+
+        inline void thiranCoefficients(size_t mask, size_t position, double const* delays, double max_delay,
+                                       int32_t* indices, double* coefficients, long vecsize)
+        {
+            const __m256d one = _mm256_set1_pd(1.);
+            const __m256d half = _mm256_set1_pd(0.5);
+            const __m256d maximum = _mm256_set1_pd(max_delay);
+            const __m128i mask_4 = _mm_set1_epi32(int32_t(mask));
+            const __m128i step = _mm_set1_epi32(4);
+            __m128i positions = _mm_add_epi32(_mm_set1_epi32(int32_t(position - 1)), _mm_setr_epi32(0, 1, 2, 3));
+            long i = 0;
+
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                const __m256d delay = _mm256_max_pd(_mm256_min_pd(_mm256_loadu_pd(delays + i), maximum), one);
+                const __m128i integer = _mm256_cvttpd_epi32(_mm256_sub_pd(delay, half));
+                const __m256d fraction = _mm256_sub_pd(delay, _mm256_cvtepi32_pd(integer));
+
+                _mm_storeu_si128((__m128i*)(indices + i), _mm_and_si128(_mm_sub_epi32(positions, integer), mask_4));
+                _mm256_storeu_pd(coefficients + i, _mm256_div_pd(_mm256_sub_pd(one, fraction), _mm256_add_pd(one, fraction)));
+                positions = _mm_add_epi32(positions, step);
+            }
+
+            thiranCoefficients<double>(mask, position + i, delays + i, max_delay, indices + i, coefficients + i, vecsize - i);
+        }
+
+        #elif defined(__SSE2__) || defined(_M_X64)
+
+        inline void thiranCoefficients(size_t mask, size_t position, double const* delays, double max_delay,
+                                       int32_t* indices, double* coefficients, long vecsize)
+        {
+            const __m128d one = _mm_set1_pd(1.);
+            const __m128d half = _mm_set1_pd(0.5);
+            const __m128d maximum = _mm_set1_pd(max_delay);
+            const __m128i mask_2 = _mm_set1_epi32(int32_t(mask));
+            const __m128i step = _mm_set1_epi32(2);
+            __m128i positions = _mm_add_epi32(_mm_set1_epi32(int32_t(position - 1)), _mm_setr_epi32(0, 1, 0, 0));
+            long i = 0;
+
+            for(; i + 2 <= vecsize; i += 2)
+            {
+                const __m128d delay = _mm_max_pd(_mm_min_pd(_mm_loadu_pd(delays + i), maximum), one);
+                const __m128i integer = _mm_cvttpd_epi32(_mm_sub_pd(delay, half));
+                const __m128d fraction = _mm_sub_pd(delay, _mm_cvtepi32_pd(integer));
+
+                _mm_storel_epi64((__m128i*)(indices + i), _mm_and_si128(_mm_sub_epi32(positions, integer), mask_2));
+                _mm_storeu_pd(coefficients + i, _mm_div_pd(_mm_sub_pd(one, fraction), _mm_add_pd(one, fraction)));
+                positions = _mm_add_epi32(positions, step);
+            }
+
+            thiranCoefficients<double>(mask, position + i, delays + i, max_delay, indices + i, coefficients + i, vecsize - i);
+        }
+
+        #endif
+
+        //! @brief Allpass interpolating reads of a ring buffer (see readLinear()).
+        //! @details The recursion can't be vectorized across the samples: the positions and the coefficients
+        //! (a division per sample) are computed with SIMD by blocks of 64 samples first, the recursion follows.
+        //! @param state The previous output of the reader.
+        template<class S, class T>
+        inline void readThiran(S const* data, size_t mask, size_t position,
+                               T const* delays, T max_delay, T* outs, long vecsize, T& state)
+        {
+            int32_t indices[64];
+            T coefficients[64];
+            T previous = state;
+
+            for(long i = 0; i < vecsize; i += 64)
+            {
+                const long size = std::min(vecsize - i, 64l);
+                thiranCoefficients(mask, position + i, delays + i, max_delay, indices, coefficients, size);
+
+                for(long k = 0; k < size; ++k)
+                {
+                    S const* reader = data + indices[k];
+                    previous = coefficients[k] * (T(reader[1]) - previous) + T(reader[0]);
+                    outs[i + k] = previous;
+                }
+            }
+
+            state = previous;
+        }
+
+        //! @brief Reads a ring buffer with an interpolation, the overloads are resolved at compile time.
+        //! @details The samples (double, float or Int24) are converted when they are read.
+        //! @param state The state of the reader, only used by the recursive interpolations.
+        template<class S, class T>
+        inline void read(InterpolationLinear, S const* data, size_t mask, size_t position,
+                         T const* delays, T max_delay, T* outs, long vecsize, T&)
+        {
+            readLinear(data, mask, position, delays, max_delay, outs, vecsize);
+        }
+
+        template<class S, class T>
+        inline void read(InterpolationHermite, S const* data, size_t mask, size_t position,
+                         T const* delays, T max_delay, T* outs, long vecsize, T&)
+        {
+            readFourPoints(InterpolationHermite(), data, mask, position, delays, max_delay, outs, vecsize);
+        }
+
+        template<class S, class T>
+        inline void read(InterpolationLagrange, S const* data, size_t mask, size_t position,
+                         T const* delays, T max_delay, T* outs, long vecsize, T&)
+        {
+            readFourPoints(InterpolationLagrange(), data, mask, position, delays, max_delay, outs, vecsize);
+        }
+
+        template<class S, class T>
+        inline void read(InterpolationThiran, S const* data, size_t mask, size_t position,
+                         T const* delays, T max_delay, T* outs, long vecsize, T& state)
+        {
+            readThiran(data, mask, position, delays, max_delay, outs, vecsize, state);
+        }
+
+        template<class S, class T>
+        inline void read(InterpolationSinc, S const* data, size_t mask, size_t position,
+                         T const* delays, T max_delay, T* outs, long vecsize, T&)
+        {
+            readSinc(data, mask, position, delays, max_delay, outs, vecsize);
+        }
+    }
+}
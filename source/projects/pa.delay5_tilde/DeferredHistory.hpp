@@ -0,0 +1,100 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                 DEFERRED HISTORY                                 //
+    // ================================================================================ //
+
+    //! @brief Copies the history of a delay buffer to the one that replaces it, a bounded chunk per vector (audio thread).
+    //! @details The new buffer is only adopted once the copy is done (see Handoff::update()), until then the previous one
+    //! is still read and written. The samples are copied from the oldest one at most Chunk samples per vector,
+    //! the samples written meanwhile are copied after them: Chunk is larger than a vector, so the copy catches up
+    //! with the write head and the oldest samples are copied before being overwritten.
+    //! The new buffer then holds the last samples of the previous one in the order they were written,
+    //! whatever its size the cost of a vector stays bounded.
+    class DeferredHistory
+    {
+    public: // methods
+
+        //! @brief The largest number of samples copied per vector.
+        static const size_t Chunk = 16384;
+
+        //! @brief Default constructor
+        DeferredHistory() = default;
+
+        DeferredHistory(DeferredHistory const&) = delete;
+        DeferredHistory& operator=(DeferredHistory const&) = delete;
+
+        //! @brief Copy the next chunk, before the vector is written in the previous buffer.
+        //! @param size The number of samples to copy when the copy starts, then the most that can still be copied.
+        //! @param copy Called with the delay of the oldest sample to copy in the previous buffer (1 is the last one written)
+        //! and the number of samples, they are written in the new buffer after the copied() ones.
+        //! @return true once the whole history is copied, the new buffer can be adopted.
+        template<class Function>
+        bool step(size_t size, Function&& copy)
+        {
+            if(!m_active)
+            {
+                m_active = true;
+                m_left = size;
+                m_copied = 0;
+            }
+            else if(m_left > size)
+            {
+                // the oldest samples have been overwritten (a buffer smaller than a vector), their place is kept
+                m_copied += m_left - size;
+                m_left = size;
+            }
+
+            const size_t count = std::min(Chunk, m_left);
+
+            if(count > 0)
+            {
+                copy(m_left, count);
+                m_left -= count;
+                m_copied += count;
+            }
+
+            return m_left == 0;
+        }
+
+        //! @brief The previous buffer has been written by size samples, they are copied by the next step().
+        void written(size_t size)
+        {
+            if(m_active)
+            {
+                m_left += size;
+            }
+        }
+
+        //! @brief The new buffer has been adopted.
+        void finish()
+        {
+            m_active = false;
+            m_copied = 0;
+        }
+
+        //! @brief Returns the number of samples written in the new buffer (0 if the copy didn't start).
+        size_t copied() const
+        {
+            return m_copied;
+        }
+
+    private: // variables
+
+        // the number of samples of the previous buffer still to copy and of samples already copied
+        size_t              m_left = 0;
+        size_t              m_copied = 0;
+        bool                m_active = false;
+    };
+}
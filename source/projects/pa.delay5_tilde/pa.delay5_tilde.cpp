@@ -10,129 +10,309 @@
 using namespace c74::max;
 
 #include <stdlib.h> // malloc, calloc, free...
+#include <string.h> // memcpy, strcmp
+
+#include <algorithm> // std::fill, std::max
+#include <vector>
+
+#include "DeferredClear.hpp"
+#include "DeferredHistory.hpp"
+#include "DelayInterpolation.hpp"
+#include "Handoff.hpp"
+using paccpp::DeferredClear;
+using paccpp::DeferredHistory;
+using paccpp::Handoff;
+using paccpp::PageAllocator;
+using paccpp::RingBuffer;
+using paccpp::Int24;
+using paccpp::InterpolationLinear;
+using paccpp::InterpolationHermite;
+using paccpp::InterpolationLagrange;
+using paccpp::InterpolationThiran;
+using paccpp::InterpolationSinc;
 
 static t_class* this_class = nullptr;
 
+//! @brief The names of the interpolations, in the order of m_interpolation.
+static const char* const interpolation_names[] = {"linear", "hermite", "lagrange", "thiran", "sinc"};
+
+//! @brief The names of the sample storages, in the order of m_storage.
+static const char* const storage_names[] = {"double", "float", "int24"};
+
+//! @brief A delay line built by the message thread, adopted by the perform method.
+//! @details Only the ring buffer of the storage type is allocated, the others are empty.
+struct t_pa_delay5_tilde_line
+{
+    RingBuffer<double>  m_buffer;
+    RingBuffer<float>   m_buffer32;
+    RingBuffer<Int24>   m_buffer24;
+    t_atom_long         m_buffersize;
+};
+
+//! @brief Returns the ring buffer of a storage type.
+RingBuffer<double>& pa_delay5_tilde_buffer(t_pa_delay5_tilde_line& line, double) { return line.m_buffer; }
+RingBuffer<float>& pa_delay5_tilde_buffer(t_pa_delay5_tilde_line& line, float) { return line.m_buffer32; }
+RingBuffer<Int24>& pa_delay5_tilde_buffer(t_pa_delay5_tilde_line& line, Int24) { return line.m_buffer24; }
+RingBuffer<double> const& pa_delay5_tilde_buffer(t_pa_delay5_tilde_line const& line, double) { return line.m_buffer; }
+RingBuffer<float> const& pa_delay5_tilde_buffer(t_pa_delay5_tilde_line const& line, float) { return line.m_buffer32; }
+RingBuffer<Int24> const& pa_delay5_tilde_buffer(t_pa_delay5_tilde_line const& line, Int24) { return line.m_buffer24; }
+
 struct t_pa_delay5_tilde
 {
-    t_pxobject  m_obj;
+    t_pxobject          m_obj;
+    
+    // the delay line used by the perform method
+    t_pa_delay5_tilde_line* m_line;
+    
+    // the delay lines built by the message thread
+    Handoff<t_pa_delay5_tilde_line>* m_lines;
+    t_atom_long         m_maxsize;
+    long                m_maxvectorsize;
+    long                m_line_storage;
+    bool                m_default_size;
+    
+    // deletes the delay lines replaced by the audio thread
+    t_clock*            m_clock;
+    
+    // the clear message, carried out by the perform method
+    DeferredClear*      m_clear;
+    
+    // the history of the line being replaced, copied by the perform method
+    DeferredHistory*    m_history;
+    
+    t_atom_long         m_number_of_readers;
+    double*             m_delay_sizes;
     
-    double*     m_buffer;
-    t_atom_long m_buffersize;
-    t_atom_long m_writer_playhead;
-    t_atom_long m_number_of_readers;
+    long                m_interpolation;
+    long                m_storage;
+    double*             m_states;
     
-    double*     m_delay_sizes;
+    // the pages of the ring buffers
+    bool                m_hugepages;
+    bool                m_mlock;
 };
 
-void pa_delay5_tilde_delete_buffer(t_pa_delay5_tilde* x)
+void pa_delay5_tilde_reclaim(t_pa_delay5_tilde* x)
 {
-    if(x->m_buffer)
+    x->m_lines->reclaim();
+}
+
+//! @brief Ask the perform method to clear the delay line (see DeferredClear), the outputs are muted until it is done.
+void pa_delay5_tilde_clear_buffer(t_pa_delay5_tilde* x)
+{
+    x->m_clear->request();
+}
+
+//! @brief Resize the ring buffer of a storage type, with the pages asked by the hugepages and mlock messages.
+template<class Sample>
+void pa_delay5_tilde_resize(t_pa_delay5_tilde* x, RingBuffer<Sample>& buffer, size_t size)
+{
+    buffer.resize(size, InterpolationSinc::Points, x->m_hugepages ? PageAllocator<Sample>::HugePages : 0);
+    
+    if(x->m_mlock && !buffer.lock())
     {
-        // free allocated buffer
-        free(x->m_buffer);
-        x->m_buffer = nullptr;
+        object_error((t_object*)x, "can't lock the delay line in memory (see ulimit -l)");
     }
 }
 
-void pa_delay5_tilde_clear_buffer(t_pa_delay5_tilde* x)
+//! @brief Build a new delay line and hand it over to the perform method (message thread).
+//! @details The ring buffer has room for the vector written before being read and for the points of the interpolation,
+//! its memory is allocated and its pages are mapped here (see PageAllocator), and locked on demand:
+//! the perform method never allocates nor frees nor faults, it only adopts the new line at the beginning of a vector.
+//! @param storage The storage type of the perform routine: a new one is only taken into account by the dsp64 method.
+void pa_delay5_tilde_create_line(t_pa_delay5_tilde* x, t_atom_long buffersize, long maxvectorsize, long storage)
 {
-    int i = 0;
-    if(x->m_buffer)
+    const size_t size = (size_t)(buffersize + maxvectorsize) + InterpolationSinc::Points;
+    
+    t_pa_delay5_tilde_line* line = new t_pa_delay5_tilde_line();
+    line->m_buffersize = buffersize;
+    
+    switch(storage)
     {
-        for(; i < x->m_buffersize; ++i)
-        {
-            x->m_buffer[i] = 0.f;
-        }
+        case 1: pa_delay5_tilde_resize(x, line->m_buffer32, size); break;
+        case 2: pa_delay5_tilde_resize(x, line->m_buffer24, size); break;
+        default: pa_delay5_tilde_resize(x, line->m_buffer, size); break;
     }
+    
+    x->m_maxsize = buffersize;
+    x->m_maxvectorsize = maxvectorsize;
+    x->m_line_storage = storage;
+    x->m_lines->publish(line);
 }
 
-void pa_delay5_tilde_create_buffer(t_pa_delay5_tilde* x)
+void pa_delay5_tilde_set_maxsize(t_pa_delay5_tilde* x, long buffersize)
 {
-    pa_delay5_tilde_delete_buffer(x);
+    if(buffersize < 1)
+    {
+        object_error((t_object*)x, "buffer size must be > 0");
+        return;
+    }
     
-    // allocate and clear buffer
-    x->m_buffer = (double*)calloc(x->m_buffersize, sizeof(double));
+    // the size doesn't follow the sampling rate anymore
+    x->m_default_size = false;
+    pa_delay5_tilde_create_line(x, buffersize, x->m_maxvectorsize, x->m_line_storage);
+}
+
+//! @brief Use huge pages for the ring buffer or not, the delay line is rebuilt.
+void pa_delay5_tilde_set_hugepages(t_pa_delay5_tilde* x, long state)
+{
+    x->m_hugepages = (state != 0);
+    pa_delay5_tilde_create_line(x, x->m_maxsize, x->m_maxvectorsize, x->m_line_storage);
+}
+
+//! @brief Lock the ring buffer in memory or not, the delay line is rebuilt.
+void pa_delay5_tilde_set_mlock(t_pa_delay5_tilde* x, long state)
+{
+    x->m_mlock = (state != 0);
+    pa_delay5_tilde_create_line(x, x->m_maxsize, x->m_maxvectorsize, x->m_line_storage);
 }
 
-//! @brief returns a buffer value at a given index position.
-//! @details idx will be wrapped between low and high buffer boundaries in a circular way.
-double get_buffer_value(t_pa_delay5_tilde* x, t_atom_long idx)
+//! @brief Adopt the last delay line built by the message thread once it holds the history of the current one, if any (audio thread).
+//! @details The history of the storage type of the perform routine is copied a chunk per vector (see DeferredHistory)
+//! so the delay goes on without a glitch (a new storage type starts empty),
+//! the previous line can't be deleted in the audio thread so we defer it to the clock.
+template<class Sample>
+void pa_delay5_tilde_update(t_pa_delay5_tilde* x)
 {
-    const t_atom_long buffersize = x->m_buffersize;
+    DeferredHistory& history = *x->m_history;
     
-    // wrap idx between low and high buffer boundaries.
-    while(idx < 0) idx += buffersize;
-    while(idx >= buffersize) idx -= buffersize;
+    auto prepare = [&history](t_pa_delay5_tilde_line& line, t_pa_delay5_tilde_line const& previous)
+    {
+        RingBuffer<Sample>& buffer = pa_delay5_tilde_buffer(line, Sample());
+        RingBuffer<Sample> const& source = pa_delay5_tilde_buffer(previous, Sample());
+        
+        // one of the lines has another storage type
+        if(buffer.capacity() == 0 || source.capacity() == 0) return true;
+        
+        return history.step(std::min(source.capacity(), buffer.capacity()), [&buffer, &source](size_t delay, size_t size)
+        {
+            buffer.write(source, delay, size);
+        });
+    };
     
-    return x->m_buffer[idx];
+    auto adopt = [x, &history](t_pa_delay5_tilde_line& line, t_pa_delay5_tilde_line const*)
+    {
+        history.finish();
+        
+        // a clear in progress starts again on the new line
+        x->m_clear->restart(std::max({line.m_buffer.capacity(), line.m_buffer32.capacity(), line.m_buffer24.capacity()}));
+        
+        x->m_line = &line;
+    };
+    
+    if(x->m_lines->update(prepare, adopt))
+    {
+        clock_delay(x->m_clock, 0);
+    }
 }
 
-double linear_interp(double y1, double y2, double delta)
+void pa_delay5_tilde_set_interpolation(t_pa_delay5_tilde* x, t_symbol* name)
 {
-    return y1 + delta * (y2 - y1);
+    for(long i = 0; i < 5; ++i)
+    {
+        if(strcmp(name->s_name, interpolation_names[i]) == 0)
+        {
+            // taken into account when the dsp chain is compiled
+            x->m_interpolation = i;
+            return;
+        }
+    }
+    
+    object_error((t_object*)x, "unknown interpolation %s (linear, hermite, lagrange, thiran or sinc)", name->s_name);
 }
 
+void pa_delay5_tilde_set_storage(t_pa_delay5_tilde* x, t_symbol* name)
+{
+    for(long i = 0; i < 3; ++i)
+    {
+        if(strcmp(name->s_name, storage_names[i]) == 0)
+        {
+            // taken into account when the dsp chain is compiled (the delay line is cleared)
+            x->m_storage = i;
+            return;
+        }
+    }
+    
+    object_error((t_object*)x, "unknown storage %s (double, float or int24)", name->s_name);
+}
+
+//! @brief The perform routine of a storage type and an interpolation, picked by the dsp64 method.
+template<class Sample, class Interpolation>
 void pa_delay5_tilde_perform64(t_pa_delay5_tilde* x, t_object* dsp64,
                                double** ins, long numins, double** outs, long numouts,
                                long vecsize, long flags, void* userparam)
 {
-    double y1, y2, delta;
-    double delay_size_samps = 0.f;
-    double* buffer = x->m_buffer;
-    const t_atom_long buffersize = x->m_buffersize;
-    double sample_to_write = 0.f;
-    t_atom_long reader;
+    DeferredClear& clear = *x->m_clear;
+    
+    pa_delay5_tilde_update<Sample>(x);
+    
+    RingBuffer<Sample>& buffer = pa_delay5_tilde_buffer(*x->m_line, Sample());
+    const double max_delay = (double)(x->m_line->m_buffersize - 1);
+    const t_atom_long readers = x->m_number_of_readers;
+    double* delay_sizes = x->m_delay_sizes;
     
-    for(int i = 0; i < vecsize; ++i)
+    // a line built by the dsp64 method for another storage type, adopted before this perform routine is replaced
+    if(buffer.capacity() == 0)
     {
-        // store current input sample to write it later in the buffer.
-        sample_to_write = ins[0][i];
-        
-        // we first need to store delay sizes samples because they may be overriden by outputs
-        for(int j = 0; j < x->m_number_of_readers; ++j)
+        for(int j = 0; j < readers; ++j)
         {
-            // get new delay size value.
-            x->m_delay_sizes[j] = ins[j+1][i];
+            std::fill(outs[j], outs[j] + vecsize, 0.);
         }
         
-        for(int j = 0; j < x->m_number_of_readers; ++j)
+        return;
+    }
+    
+    // we first need to store the delay sizes because they may be overriden by outputs
+    for(int j = 0; j < readers; ++j)
+    {
+        memcpy(delay_sizes + j * vecsize, ins[j+1], vecsize * sizeof(double));
+    }
+    
+    // a clear zeroes a chunk of the ring buffer ahead of the write head, the outputs are muted until the whole buffer is clear
+    if(clear.start(buffer.capacity()))
+    {
+        for(int j = 0; j < readers; ++j)
         {
-            // get new delay size value.
-            delay_size_samps = x->m_delay_sizes[j];
-            
-            // clip delay size to buffersize - 1
-            if(delay_size_samps >= buffersize)
-            {
-                delay_size_samps = (double)(buffersize - 1);
-            }
-            else if(delay_size_samps < 1.) // read first implementation : 0 samps delay = max delay
-            {
-                delay_size_samps = 1.;
-            }
-            
-            // extract the fractional part
-            delta = delay_size_samps - (int)delay_size_samps;
-            
-            reader = x->m_writer_playhead - (t_atom_long)delay_size_samps;
-         
-            // Reading our buffer.
-            y1 = get_buffer_value(x, reader);
-            y2 = get_buffer_value(x, reader - 1);
-            
-            // with linear interpolation
-            outs[j][i] = linear_interp(y1, y2, delta);
+            x->m_states[j] = 0.;
         }
-        
-        // then store incoming sample to the buffer.
-        buffer[x->m_writer_playhead] = sample_to_write;
-        
-        // increment then wrap counter between buffer boundaries
-        if(++x->m_writer_playhead >= buffersize) x->m_writer_playhead -= buffersize;
     }
     
+    clear.step([&buffer](size_t offset, size_t size) { buffer.clear(offset, size); });
+    const bool muted = clear.active();
+    
+    // write the whole vector first (converted to the storage type): the ring buffer is a vector larger than the delay line,
+    // a sample written later in the vector can't overwrite one that an earlier sample reads.
+    const size_t position = buffer.position();
+    buffer.write(ins[0], vecsize);
+    clear.written((size_t)vecsize);
+    x->m_history->written((size_t)vecsize);
+    
+    // then each reader interpolates the whole vector (several samples at once)
+    for(int j = 0; j < readers; ++j)
+    {
+        paccpp::simd::read(Interpolation(), buffer.data(), buffer.mask(), position,
+                           delay_sizes + j * vecsize, max_delay, outs[j], vecsize, x->m_states[j]);
+        
+        if(muted)
+        {
+            std::fill(outs[j], outs[j] + vecsize, 0.);
+        }
+    }
 }
 
+//! @brief Returns the perform routine of an interpolation for a storage type.
+template<class Sample>
+t_perfroutine64 pa_delay5_tilde_perform_routine(long interpolation)
+{
+    switch(interpolation)
+    {
+        case 1: return (t_perfroutine64)pa_delay5_tilde_perform64<Sample, InterpolationHermite>;
+        case 2: return (t_perfroutine64)pa_delay5_tilde_perform64<Sample, InterpolationLagrange>;
+        case 3: return (t_perfroutine64)pa_delay5_tilde_perform64<Sample, InterpolationThiran>;
+        case 4: return (t_perfroutine64)pa_delay5_tilde_perform64<Sample, InterpolationSinc>;
+        default: return (t_perfroutine64)pa_delay5_tilde_perform64<Sample, InterpolationLinear>;
+    }
+}
 
 void pa_delay5_tilde_dsp64(t_pa_delay5_tilde* x, t_object* dsp64, short* count,
                             double samplerate, long maxvectorsize, long flags)
@@ -140,9 +320,37 @@ void pa_delay5_tilde_dsp64(t_pa_delay5_tilde* x, t_object* dsp64, short* count,
     // as you want :
     //pa_delay5_tilde_clear_buffer(x);
     
+    // the default size is 100ms at the current sampling rate,
+    // the ring buffer has to be rebuilt for a larger vector size or another storage type.
+    const t_atom_long buffersize = x->m_default_size ? (t_atom_long)(samplerate * 0.1) : x->m_maxsize;
+    
+    if(buffersize != x->m_maxsize || maxvectorsize > x->m_maxvectorsize || x->m_storage != x->m_line_storage)
+    {
+        pa_delay5_tilde_create_line(x, buffersize, maxvectorsize, x->m_storage);
+    }
+    
+    // a vector of delay sizes per reader
+    free(x->m_delay_sizes);
+    x->m_delay_sizes = (double*)malloc(sizeof(double) * x->m_number_of_readers * maxvectorsize);
+    
+    if(x->m_interpolation == 4)
+    {
+        // the filters are computed here rather than in the audio thread
+        InterpolationSinc::filters();
+    }
+    
+    t_perfroutine64 perform;
+    
+    switch(x->m_storage)
+    {
+        case 1: perform = pa_delay5_tilde_perform_routine<float>(x->m_interpolation); break;
+        case 2: perform = pa_delay5_tilde_perform_routine<Int24>(x->m_interpolation); break;
+        default: perform = pa_delay5_tilde_perform_routine<double>(x->m_interpolation); break;
+    }
+    
     object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
                          dsp64, gensym("dsp_add64"), (t_object*)x,
-                         (t_perfroutine64)pa_delay5_tilde_perform64, 0, NULL);
+                         perform, 0, NULL);
 }
 
 void pa_delay5_tilde_assist(t_pa_delay5_tilde* x, void* unused,
@@ -152,7 +360,7 @@ void pa_delay5_tilde_assist(t_pa_delay5_tilde* x, void* unused,
     {
         if(index == 0)
         {
-            strncpy(string_dest, "(signal) input to be delayed", ASSIST_STRING_MAXSIZE);
+            strncpy(string_dest, "(signal) input to be delayed, (interp) linear, hermite, lagrange, thiran or sinc, (storage) double, float or int24, (hugepages, mlock) 0 or 1", ASSIST_STRING_MAXSIZE);
         }
         else
         {
@@ -171,10 +379,10 @@ void* pa_delay5_tilde_new(t_symbol *name, long argc, t_atom *argv)
     
     if(x)
     {
-        x->m_buffer = nullptr;
-        x->m_writer_playhead = 0;
         t_atom_long ndelay = 1;
         
+        x->m_default_size = true;
+        
         t_atom_long buffersize = (t_atom_long)(sys_getsr() * 0.1); // default to 100ms
         
         if(argc >= 1 && (atom_gettype(argv) == A_FLOAT || atom_gettype(argv) == A_LONG))
@@ -182,6 +390,7 @@ void* pa_delay5_tilde_new(t_symbol *name, long argc, t_atom *argv)
             if(atom_getlong(argv) > 0)
             {
                 buffersize = atom_getlong(argv);
+                x->m_default_size = false;
             }
             else
             {
@@ -199,10 +408,18 @@ void* pa_delay5_tilde_new(t_symbol *name, long argc, t_atom *argv)
             }
         }
         
-        x->m_buffersize = buffersize;
+        x->m_line = nullptr;
+        x->m_storage = 0;
+        x->m_hugepages = false;
+        x->m_mlock = false;
         x->m_number_of_readers = ndelay;
         
-        x->m_delay_sizes = (double*)malloc(sizeof(double) * x->m_number_of_readers);
+        // allocated for the vector size by the dsp64 method
+        x->m_delay_sizes = nullptr;
+        
+        // the previous output of each reader (for the allpass interpolation)
+        x->m_interpolation = 0;
+        x->m_states = (double*)calloc(x->m_number_of_readers, sizeof(double));
         
         dsp_setup((t_pxobject*)x, (long)(x->m_number_of_readers + 1));
         for(int i = 0; i < x->m_number_of_readers; ++i)
@@ -210,8 +427,21 @@ void* pa_delay5_tilde_new(t_symbol *name, long argc, t_atom *argv)
             outlet_new(x, "signal");
         }
         
-        // reset our buffer.
-        pa_delay5_tilde_create_buffer(x);
+        // instantiate a new Handoff object
+        // Note: dont forget to delete it in the free method !
+        x->m_lines = new Handoff<t_pa_delay5_tilde_line>();
+        
+        // instantiate a new DeferredClear object
+        // Note: dont forget to delete it in the free method !
+        x->m_clear = new DeferredClear();
+        
+        // instantiate a new DeferredHistory object
+        // Note: dont forget to delete it in the free method !
+        x->m_history = new DeferredHistory();
+        x->m_clock = clock_new(x, (method)pa_delay5_tilde_reclaim);
+        
+        // the first delay line is adopted by the first vector
+        pa_delay5_tilde_create_line(x, buffersize, sys_getmaxblksize(), x->m_storage);
     }
     
     return x;
@@ -222,6 +452,19 @@ void pa_delay5_tilde_free(t_pa_delay5_tilde* x)
     dsp_free((t_pxobject*)x);
     
     free(x->m_delay_sizes);
+    free(x->m_states);
+    
+    // get rid of the clock
+    freeobject(x->m_clock);
+    
+    // free the memory for the Handoff object (and the delay lines)
+    delete x->m_lines;
+    
+    // free the memory for the DeferredClear object
+    delete x->m_clear;
+    
+    // free the memory for the DeferredHistory object
+    delete x->m_history;
 }
 
 void ext_main(void* r)
@@ -229,9 +472,14 @@ void ext_main(void* r)
     this_class = class_new("pa.delay5~", (method)pa_delay5_tilde_new, (method)pa_delay5_tilde_free,
                            sizeof(t_pa_delay5_tilde), 0, A_GIMME, 0);
     
-    class_addmethod(this_class, (method)pa_delay5_tilde_assist,         "assist",   A_CANT,		0);
-    class_addmethod(this_class, (method)pa_delay5_tilde_dsp64,          "dsp64",    A_CANT,		0);
-    class_addmethod(this_class, (method)pa_delay5_tilde_clear_buffer,   "clear",                0);
+    class_addmethod(this_class, (method)pa_delay5_tilde_assist,             "assist",   A_CANT,		0);
+    class_addmethod(this_class, (method)pa_delay5_tilde_dsp64,              "dsp64",    A_CANT,		0);
+    class_addmethod(this_class, (method)pa_delay5_tilde_clear_buffer,       "clear",                0);
+    class_addmethod(this_class, (method)pa_delay5_tilde_set_maxsize,        "maxsize",  A_LONG,     0);
+    class_addmethod(this_class, (method)pa_delay5_tilde_set_interpolation,  "interp",   A_SYM,      0);
+    class_addmethod(this_class, (method)pa_delay5_tilde_set_storage,        "storage",  A_SYM,      0);
+    class_addmethod(this_class, (method)pa_delay5_tilde_set_hugepages,      "hugepages", A_LONG,    0);
+    class_addmethod(this_class, (method)pa_delay5_tilde_set_mlock,          "mlock",    A_LONG,     0);
     
     class_dspinit(this_class);
     class_register(CLASS_BOX, this_class);
@@ -0,0 +1,306 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include "LockFreeQueue.hpp"
+#include "Sample.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                  DISK DELAY LINE                                 //
+    // ================================================================================ //
+
+    //! @brief A delay line stored in a file, for delays of minutes or hours.
+    //! @details The file is a ring of blocks of float samples. Only a few blocks are kept in memory:
+    //! a window of WriteBlocks blocks around the write head and a window of ReadBlocks blocks around each read head.
+    //! The audio thread only touches these windows, an I/O thread moves the blocks between them and the file:
+    //! - when the writer completes a block, it asks the I/O thread to write it to the file.
+    //! - each reader asks the I/O thread to read the blocks that follow its read head (they must have been written),
+    //!   a block of its window is used only once the I/O thread has tagged it with its number.
+    //!
+    //! The requests go through a LockFreeQueue and are handled in order: a block is written to the file before it is read.
+    //! A reader that reaches a block that is not in memory yet (after a jump of its delay, or if the disk is too slow)
+    //! outputs zeros and counts a miss, a writer that comes back to a block not written to the file yet counts an overrun.
+    class DiskDelayLine
+    {
+    public: // methods
+
+        using sample_t = float;
+
+        //! @brief The number of samples of a block (a read or a write of the file).
+        static const size_t BlockSize = 8192;
+
+        //! @brief The number of blocks in memory for the writer.
+        static const size_t WriteBlocks = 4;
+
+        //! @brief The number of blocks in memory for each reader (the one read and the ones prefetched).
+        static const size_t ReadBlocks = 4;
+
+        //! @brief Constructor, opens the file and starts the I/O thread (message thread).
+        //! @param size The largest delay in samples.
+        //! @param readers The number of readers.
+        //! @param path The file, created or overwritten (a temporary file deleted when closed if empty).
+        DiskDelayLine(size_t size, size_t readers, std::string const& path = "")
+        : m_size(std::max(size, minDelay()))
+        , m_readers(readers)
+        , m_file_blocks((m_size + BlockSize - 1) / BlockSize + ReadBlocks + 2)
+        , m_write_window(WriteBlocks * BlockSize, sample_t(0.))
+        , m_read_windows(readers * ReadBlocks * BlockSize, sample_t(0.))
+        , m_tags(new std::atomic<int64_t>[readers * ReadBlocks])
+        , m_requested(readers * ReadBlocks, -1)
+        {
+            for(size_t i = 0; i < readers * ReadBlocks; ++i)
+            {
+                m_tags[i].store(-1, std::memory_order_relaxed);
+            }
+
+            m_file = path.empty() ? std::tmpfile() : std::fopen(path.c_str(), "w+b");
+
+            if(m_file)
+            {
+                m_thread = std::thread(&DiskDelayLine::run, this);
+            }
+        }
+
+        //! @brief Destructor, stops the I/O thread and closes the file (message thread).
+        //! @details The audio thread must not use the line anymore.
+        ~DiskDelayLine()
+        {
+            m_quit.store(true, std::memory_order_relaxed);
+
+            if(m_thread.joinable())
+            {
+                m_thread.join();
+            }
+
+            if(m_file)
+            {
+                std::fclose(m_file);
+            }
+        }
+
+        DiskDelayLine(DiskDelayLine const&) = delete;
+        DiskDelayLine& operator=(DiskDelayLine const&) = delete;
+
+        //! @brief Returns false if the file couldn't be opened.
+        bool isOpen() const { return m_file != nullptr; }
+
+        //! @brief Returns the number of readers.
+        size_t readers() const { return m_readers; }
+
+        //! @brief Returns the shortest delay: the blocks prefetched by a reader must have been written.
+        static constexpr size_t minDelay() { return (ReadBlocks + 1) * BlockSize; }
+
+        //! @brief Returns the longest delay.
+        size_t maxDelay() const { return m_size; }
+
+        //! @brief Returns the number of blocks (or parts of blocks) that were not in memory when a reader needed them.
+        size_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+
+        //! @brief Returns the number of blocks that couldn't be written to the file in time.
+        size_t overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+
+        //! @brief Write a vector of samples (audio thread).
+        void write(double const* in, size_t size)
+        {
+            size_t i = 0;
+
+            while(i < size)
+            {
+                const int64_t block = m_position / int64_t(BlockSize);
+                const size_t offset = size_t(m_position % int64_t(BlockSize));
+                const size_t count = std::min(size - i, BlockSize - offset);
+
+                // the block that used this part of the window must be in the file
+                if(offset == 0 && block - m_flushed.load(std::memory_order_acquire) >= int64_t(WriteBlocks))
+                {
+                    m_overruns.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                simd::convert(in + i, m_write_window.data() + size_t(block % int64_t(WriteBlocks)) * BlockSize + offset, count);
+
+                m_position += int64_t(count);
+                i += count;
+
+                if(offset + count == BlockSize && !m_requests.push({block, -1}))
+                {
+                    m_overruns.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        //! @brief Read the vector that has just been written, delayed by delay samples (audio thread).
+        //! @param reader The index of the reader.
+        //! @param delay The delay in samples, clipped to [minDelay(), maxDelay()].
+        void read(size_t reader, size_t delay, double* out, size_t size)
+        {
+            delay = std::min(std::max(delay, minDelay()), m_size);
+
+            const int64_t start = m_position - int64_t(size) - int64_t(delay);
+            sample_t const* window = m_read_windows.data() + reader * ReadBlocks * BlockSize;
+            std::atomic<int64_t>* tags = m_tags.get() + reader * ReadBlocks;
+            size_t i = 0;
+
+            // before the first sample written
+            for(; i < size && start + int64_t(i) < 0; ++i)
+            {
+                out[i] = 0.;
+            }
+
+            while(i < size)
+            {
+                const int64_t position = start + int64_t(i);
+                const int64_t block = position / int64_t(BlockSize);
+                const size_t offset = size_t(position % int64_t(BlockSize));
+                const size_t count = std::min(size - i, BlockSize - offset);
+                const size_t slot = size_t(block % int64_t(ReadBlocks));
+
+                bool resident = (tags[slot].load(std::memory_order_acquire) == block);
+
+                if(resident)
+                {
+                    simd::convert(window + slot * BlockSize + offset, out + i, count);
+
+                    // the I/O thread may have replaced the block while it was copied
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    resident = (tags[slot].load(std::memory_order_relaxed) == block);
+                }
+
+                if(!resident)
+                {
+                    std::fill(out + i, out + i + count, 0.);
+                    m_misses.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                i += count;
+            }
+
+            prefetch(reader, start + int64_t(size));
+        }
+
+    private: // methods
+
+        //! @brief A block to write to the file (reader < 0) or to read in the window of a reader.
+        struct Request
+        {
+            int64_t m_block;
+            int64_t m_reader;
+        };
+
+        //! @brief Ask for the blocks of the window that starts at a position and have been written (audio thread).
+        void prefetch(size_t reader, int64_t position)
+        {
+            const int64_t first = std::max(position, int64_t(0)) / int64_t(BlockSize);
+            const int64_t written = m_position / int64_t(BlockSize);
+            int64_t* requested = m_requested.data() + reader * ReadBlocks;
+
+            for(int64_t block = first; block < first + int64_t(ReadBlocks) && block < written; ++block)
+            {
+                const size_t slot = size_t(block % int64_t(ReadBlocks));
+
+                if(requested[slot] != block)
+                {
+                    // asked again at the next vector if the queue is full
+                    if(!m_requests.push({block, int64_t(reader)})) return;
+
+                    requested[slot] = block;
+                }
+            }
+        }
+
+        //! @brief Move the file position to a block.
+        void seek(int64_t block)
+        {
+            const int64_t offset = (block % int64_t(m_file_blocks)) * int64_t(BlockSize * sizeof(sample_t));
+
+            #if defined(_WIN32)
+            _fseeki64(m_file, offset, SEEK_SET);
+            #else
+            fseeko(m_file, off_t(offset), SEEK_SET);
+            #endif
+        }
+
+        //! @brief The I/O thread: handles the requests in order, sleeps 1 ms when there is none.
+        void run()
+        {
+            Request request;
+
+            while(!m_quit.load(std::memory_order_relaxed))
+            {
+                if(!m_requests.pop(request))
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+
+                if(request.m_reader < 0)
+                {
+                    seek(request.m_block);
+                    std::fwrite(m_write_window.data() + size_t(request.m_block % int64_t(WriteBlocks)) * BlockSize,
+                                sizeof(sample_t), BlockSize, m_file);
+
+                    m_flushed.store(request.m_block + 1, std::memory_order_release);
+                }
+                else
+                {
+                    const size_t index = size_t(request.m_reader) * ReadBlocks + size_t(request.m_block % int64_t(ReadBlocks));
+                    sample_t* samples = m_read_windows.data() + index * BlockSize;
+
+                    // untagged while it is replaced
+                    m_tags[index].store(-1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_release);
+
+                    // the end of the file that has not been written yet reads as zeros
+                    seek(request.m_block);
+                    const size_t count = std::fread(samples, sizeof(sample_t), BlockSize, m_file);
+                    std::fill(samples + count, samples + BlockSize, sample_t(0.));
+
+                    m_tags[index].store(request.m_block, std::memory_order_release);
+                }
+            }
+        }
+
+    private: // variables
+
+        const size_t                m_size;
+        const size_t                m_readers;
+        const size_t                m_file_blocks;
+
+        std::vector<sample_t>       m_write_window;
+        std::vector<sample_t>       m_read_windows;
+
+        // the block in each slot of the read windows (-1 while it is replaced)
+        std::unique_ptr<std::atomic<int64_t>[]> m_tags;
+
+        // the block last asked for each slot of the read windows (audio thread)
+        std::vector<int64_t>        m_requested;
+
+        // the number of samples written (audio thread) and of blocks written to the file (I/O thread)
+        int64_t                     m_position = 0;
+        std::atomic<int64_t>        m_flushed {0};
+
+        LockFreeQueue<Request, 256> m_requests;
+        std::atomic<size_t>         m_misses {0};
+        std::atomic<size_t>         m_overruns {0};
+
+        std::FILE*                  m_file = nullptr;
+        std::thread                 m_thread;
+        std::atomic<bool>           m_quit {false};
+    };
+}
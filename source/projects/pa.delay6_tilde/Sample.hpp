@@ -0,0 +1,191 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                   SAMPLE STORAGE                                 //
+    // ================================================================================ //
+
+    //! @brief A sample stored on 3 bytes (signed 24 bits fixed point), in [-1, 1].
+    //! @details The values are clipped to [-1, 1 - 2^-23] and rounded to the nearest step (2^-23, -138 dB).
+    struct Int24
+    {
+        static constexpr double Scale = 8388608.;
+
+        Int24() = default;
+
+        Int24(double value)
+        {
+            const double scaled = std::min(std::max(value * Scale, -Scale), Scale - 1.);
+            const int32_t integer = int32_t(std::lrint(scaled));
+
+            m_bytes[0] = uint8_t(integer);
+            m_bytes[1] = uint8_t(integer >> 8);
+            m_bytes[2] = uint8_t(integer >> 16);
+        }
+
+        operator double() const
+        {
+            // the 3 bytes in the high part of an int32, shifted back with the sign
+            const int32_t integer = int32_t(uint32_t(m_bytes[0]) << 8 | uint32_t(m_bytes[1]) << 16 | uint32_t(m_bytes[2]) << 24) >> 8;
+            return double(integer) * (1. / Scale);
+        }
+
+        uint8_t m_bytes[3] = {0, 0, 0};
+    };
+
+    namespace simd
+    {
+        //! @brief Convert a block of samples from one storage type to another.
+        template<class From, class To>
+        inline void convert(From const* in, To* out, size_t size)
+        {
+            for(size_t i = 0; i < size; ++i)
+            {
+                out[i] = To(double(in[i]));
+            }
+        }
+
+        template<class T>
+        inline void convert(T const* in, T* out, size_t size)
+        {
+            std::copy(in, in + size, out);
+        }
+
+        #if defined(__AVX2__)
+
+        //! @brief Returns 4 contiguous samples.
+        inline __m256d load(double const* in) { return _mm256_loadu_pd(in); }
+        inline __m256d load(float const* in) { return _mm256_cvtps_pd(_mm_loadu_ps(in)); }
+        inline __m256d load(Int24 const* in)
+        {
+            // the 12 bytes, then each sample in the high 3 bytes of an int32
+            int32_t last;
+            std::memcpy(&last, (uint8_t const*)in + 8, 4);
+            const __m128i bytes = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i const*)in), _mm_cvtsi32_si128(last));
+            const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            const __m128i integers = _mm_srai_epi32(_mm_shuffle_epi8(bytes, shuffle), 8);
+            return _mm256_mul_pd(_mm256_cvtepi32_pd(integers), _mm256_set1_pd(1. / Int24::Scale));
+        }
+
+        //! @brief Returns the samples at 4 indices.
+        //! @details An Int24 is gathered with a 4 bytes load: the byte after the sample must be readable.
+        inline __m256d gather(double const* data, __m128i index) { return _mm256_i32gather_pd(data, index, 8); }
+        inline __m256d gather(float const* data, __m128i index) { return _mm256_cvtps_pd(_mm_i32gather_ps(data, index, 4)); }
+        inline __m256d gather(Int24 const* data, __m128i index)
+        {
+            const __m128i offsets = _mm_add_epi32(index, _mm_add_epi32(index, index));
+            const __m128i words = _mm_i32gather_epi32((int const*)data, offsets, 1);
+            const __m128i integers = _mm_srai_epi32(_mm_slli_epi32(words, 8), 8);
+            return _mm256_mul_pd(_mm256_cvtepi32_pd(integers), _mm256_set1_pd(1. / Int24::Scale));
+        }
+
+        inline void convert(float const* in, double* out, size_t size)
+        {
+            size_t i = 0;
+            for(; i + 4 <= size; i += 4) _mm256_storeu_pd(out + i, load(in + i));
+            for(; i < size; ++i) out[i] = in[i];
+        }
+
+        inline void convert(double const* in, float* out, size_t size)
+        {
+            size_t i = 0;
+            for(; i + 4 <= size; i += 4) _mm_storeu_ps(out + i, _mm256_cvtpd_ps(_mm256_loadu_pd(in + i)));
+            for(; i < size; ++i) out[i] = float(in[i]);
+        }
+
+        inline void convert(Int24 const* in, double* out, size_t size)
+        {
+            size_t i = 0;
+            for(; i + 4 <= size; i += 4) _mm256_storeu_pd(out + i, load(in + i));
+            for(; i < size; ++i) out[i] = in[i];
+        }
+
+        inline void convert(double const* in, Int24* out, size_t size)
+        {
+            const __m256d minimum = _mm256_set1_pd(-Int24::Scale);
+            const __m256d maximum = _mm256_set1_pd(Int24::Scale - 1.);
+            const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            size_t i = 0;
+
+            for(; i + 4 <= size; i += 4)
+            {
+                const __m256d scaled = _mm256_mul_pd(_mm256_loadu_pd(in + i), _mm256_set1_pd(Int24::Scale));
+                const __m128i integers = _mm256_cvtpd_epi32(_mm256_min_pd(_mm256_max_pd(scaled, minimum), maximum));
+
+                // the low 3 bytes of each int32, packed in 12 bytes
+                const __m128i bytes = _mm_shuffle_epi8(integers, shuffle);
+                const int32_t last = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+                _mm_storel_epi64((__m128i*)(out + i), bytes);
+                std::memcpy((uint8_t*)(out + i) + 8, &last, 4);
+            }
+
+            for(; i < size; ++i) out[i] = in[i];
+        }
+
+        #elif defined(__SSE2__) || defined(_M_X64)
+
+        //! @brief Returns 2 contiguous samples.
+        inline __m128d load(double const* in) { return _mm_loadu_pd(in); }
+        inline __m128d load(float const* in) { return _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((double const*)in))); }
+        inline __m128d load(Int24 const* in) { return _mm_set_pd(in[1], in[0]); }
+
+        //! @brief Returns 2 samples.
+        inline __m128d load(double const* in_0, double const* in_1) { return _mm_loadh_pd(_mm_load_sd(in_0), in_1); }
+        inline __m128d load(float const* in_0, float const* in_1) { return _mm_set_pd(*in_1, *in_0); }
+        inline __m128d load(Int24 const* in_0, Int24 const* in_1) { return _mm_set_pd(*in_1, *in_0); }
+
+        inline void convert(float const* in, double* out, size_t size)
+        {
+            size_t i = 0;
+            for(; i + 2 <= size; i += 2) _mm_storeu_pd(out + i, load(in + i));
+            for(; i < size; ++i) out[i] = in[i];
+        }
+
+        inline void convert(double const* in, float* out, size_t size)
+        {
+            size_t i = 0;
+            for(; i + 2 <= size; i += 2) _mm_storel_pi((__m64*)(out + i), _mm_cvtpd_ps(_mm_loadu_pd(in + i)));
+            for(; i < size; ++i) out[i] = float(in[i]);
+        }
+
+        //! @details The samples are scaled, clipped and rounded 2 at a time, their bytes are stored one by one.
+        inline void convert(double const* in, Int24* out, size_t size)
+        {
+            const __m128d minimum = _mm_set1_pd(-Int24::Scale);
+            const __m128d maximum = _mm_set1_pd(Int24::Scale - 1.);
+            size_t i = 0;
+
+            for(; i + 2 <= size; i += 2)
+            {
+                const __m128d scaled = _mm_mul_pd(_mm_loadu_pd(in + i), _mm_set1_pd(Int24::Scale));
+                const __m128i integers = _mm_cvtpd_epi32(_mm_min_pd(_mm_max_pd(scaled, minimum), maximum));
+                const int32_t integer_0 = _mm_cvtsi128_si32(integers);
+                const int32_t integer_1 = _mm_cvtsi128_si32(_mm_shuffle_epi32(integers, 1));
+
+                std::memcpy(out[i].m_bytes, &integer_0, 3);
+                std::memcpy(out[i + 1].m_bytes, &integer_1, 3);
+            }
+
+            for(; i < size; ++i) out[i] = in[i];
+        }
+
+        #endif
+    }
+}
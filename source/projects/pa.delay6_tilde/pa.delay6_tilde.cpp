@@ -0,0 +1,170 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief A single writer / multiple readers delay line stored on disk, for delays of minutes or hours.
+
+#include "c74_msp.h"
+using namespace c74::max;
+
+#include <stdlib.h> // malloc, calloc, free...
+
+#include "DiskDelayLine.hpp"
+using paccpp::DiskDelayLine;
+
+static t_class* this_class = nullptr;
+
+struct t_pa_delay6_tilde
+{
+    t_pxobject          m_obj;
+    
+    DiskDelayLine*      m_line;
+    
+    t_atom_long         m_number_of_readers;
+    size_t*             m_delay_sizes;
+};
+
+void pa_delay6_tilde_status(t_pa_delay6_tilde* x)
+{
+    object_post((t_object*)x, "delays from %ld to %ld samples, %ld misses, %ld overruns",
+                (long)x->m_line->minDelay(), (long)x->m_line->maxDelay(),
+                (long)x->m_line->misses(), (long)x->m_line->overruns());
+}
+
+void pa_delay6_tilde_perform64(t_pa_delay6_tilde* x, t_object* dsp64,
+                               double** ins, long numins, double** outs, long numouts,
+                               long vecsize, long flags, void* userparam)
+{
+    DiskDelayLine& line = *x->m_line;
+    const t_atom_long readers = x->m_number_of_readers;
+    size_t* delay_sizes = x->m_delay_sizes;
+    
+    // the delay sizes are read once per vector (rounded to a sample), before the outputs that may share their memory
+    for(int j = 0; j < readers; ++j)
+    {
+        const double delay = ins[j+1][0];
+        delay_sizes[j] = (delay > 0.) ? (size_t)(delay + 0.5) : 0;
+    }
+    
+    line.write(ins[0], vecsize);
+    
+    // each reader copies the blocks of its window
+    for(int j = 0; j < readers; ++j)
+    {
+        line.read(j, delay_sizes[j], outs[j], vecsize);
+    }
+}
+
+void pa_delay6_tilde_dsp64(t_pa_delay6_tilde* x, t_object* dsp64, short* count,
+                            double samplerate, long maxvectorsize, long flags)
+{
+    // without its file, the line outputs zeros
+    object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
+                         dsp64, gensym("dsp_add64"), (t_object*)x,
+                         (t_perfroutine64)pa_delay6_tilde_perform64, 0, NULL);
+}
+
+void pa_delay6_tilde_assist(t_pa_delay6_tilde* x, void* unused,
+                             t_assist_function io, long index, char* string_dest)
+{
+    if(io == ASSIST_INLET)
+    {
+        if(index == 0)
+        {
+            strncpy(string_dest, "(signal) input to be delayed, (status) post the misses and overruns", ASSIST_STRING_MAXSIZE);
+        }
+        else
+        {
+            strncpy(string_dest, "(signal) delay size in samps (read once per vector)", ASSIST_STRING_MAXSIZE);
+        }
+    }
+    else if(io == ASSIST_OUTLET)
+    {
+        strncpy(string_dest, "(signal) Output", ASSIST_STRING_MAXSIZE);
+    }
+}
+
+void* pa_delay6_tilde_new(t_symbol *name, long argc, t_atom *argv)
+{
+    t_pa_delay6_tilde* x = (t_pa_delay6_tilde*)object_alloc(this_class);
+    
+    if(x)
+    {
+        t_atom_long ndelay = 1;
+        t_atom_long buffersize = (t_atom_long)(sys_getsr() * 60.); // default to 1 minute
+        const char* path = "";
+        
+        if(argc >= 1 && (atom_gettype(argv) == A_FLOAT || atom_gettype(argv) == A_LONG))
+        {
+            if(atom_getlong(argv) > 0)
+            {
+                buffersize = atom_getlong(argv);
+            }
+            else
+            {
+                object_error((t_object*)x, "buffer size must be > 0");
+            }
+        }
+        
+        // init number of delays
+        if(argc >= 2 && atom_gettype(argv+1) == A_LONG)
+        {
+            ndelay = atom_getlong(argv+1);
+            if(ndelay < 1)
+            {
+                ndelay = 1;
+            }
+        }
+        
+        // the file of the line (a temporary file by default)
+        if(argc >= 3 && atom_gettype(argv+2) == A_SYM)
+        {
+            path = atom_getsym(argv+2)->s_name;
+        }
+        
+        x->m_number_of_readers = ndelay;
+        x->m_delay_sizes = (size_t*)calloc(x->m_number_of_readers, sizeof(size_t));
+        
+        // instantiate a new DiskDelayLine object (it opens the file and starts its I/O thread)
+        // Note: dont forget to delete it in the free method !
+        x->m_line = new DiskDelayLine((size_t)buffersize, (size_t)ndelay, path);
+        
+        if(!x->m_line->isOpen())
+        {
+            object_error((t_object*)x, "can't open the file of the delay line");
+        }
+        
+        dsp_setup((t_pxobject*)x, (long)(x->m_number_of_readers + 1));
+        for(int i = 0; i < x->m_number_of_readers; ++i)
+        {
+            outlet_new(x, "signal");
+        }
+    }
+    
+    return x;
+}
+
+void pa_delay6_tilde_free(t_pa_delay6_tilde* x)
+{
+    dsp_free((t_pxobject*)x);
+    
+    free(x->m_delay_sizes);
+    
+    // free the memory for the DiskDelayLine object (it stops its I/O thread and closes the file)
+    delete x->m_line;
+}
+
+void ext_main(void* r)
+{
+    this_class = class_new("pa.delay6~", (method)pa_delay6_tilde_new, (method)pa_delay6_tilde_free,
+                           sizeof(t_pa_delay6_tilde), 0, A_GIMME, 0);
+    
+    class_addmethod(this_class, (method)pa_delay6_tilde_assist,     "assist",   A_CANT,     0);
+    class_addmethod(this_class, (method)pa_delay6_tilde_dsp64,      "dsp64",    A_CANT,     0);
+    class_addmethod(this_class, (method)pa_delay6_tilde_status,     "status",               0);
+    
+    class_dspinit(this_class);
+    class_register(CLASS_BOX, this_class);
+}
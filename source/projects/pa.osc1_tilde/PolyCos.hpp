@@ -0,0 +1,192 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                 POLYNOMIAL COSINE                                //
+    // ================================================================================ //
+
+    //! @brief cos(2pi.phase) with minimax polynomials, at several accuracy tiers.
+    //! @details The phase (in periods) is reduced to x in [-0.5, 0.5] by subtracting the nearest integer,
+    //! then cos(2pi.x) = sin(2pi.t) with t = 0.25 - |x| in [-0.25, 0.25],
+    //! and sin(2pi.t) = t.P(t^2) where P minimizes the absolute error (Remez exchange).
+    //! There are no tables, no branches and no divisions, so the block versions vectorize.
+    namespace polycos
+    {
+        //! @brief Degree 5, max error 6.8e-5.
+        struct Low
+        {
+            static const size_t Order = 3;
+            static double coefficient(size_t k)
+            {
+                static constexpr double coefficients[Order] =
+                {
+                    6.281280076622390488514e+00,
+                    -4.109524268714373399988e+01,
+                    7.358551473502464592563e+01
+                };
+
+                return coefficients[k];
+            }
+        };
+
+        //! @brief Degree 9, max error 3.3e-9.
+        struct Medium
+        {
+            static const size_t Order = 5;
+            static double coefficient(size_t k)
+            {
+                static constexpr double coefficients[Order] =
+                {
+                    6.283185160089477547772e+00,
+                    -4.134165503141630455819e+01,
+                    8.160100407326348066761e+01,
+                    -7.654978229363476743830e+01,
+                    3.953670606601820263631e+01
+                };
+
+                return coefficients[k];
+            }
+        };
+
+        //! @brief Degree 15, max error 9e-17 (below the rounding errors of the evaluation in double).
+        struct High
+        {
+            static const size_t Order = 8;
+            static double coefficient(size_t k)
+            {
+                static constexpr double coefficients[Order] =
+                {
+                    6.283185307179580391535e+00,
+                    -4.134170224039508262692e+01,
+                    8.160524927502629002690e+01,
+                    -7.670585964746952988309e+01,
+                    4.205868830538995007913e+01,
+                    -1.509447161663201886456e+01,
+                    3.816997428325530272546e+00,
+                    -6.909358823981081849017e-01
+                };
+
+                return coefficients[k];
+            }
+        };
+
+        //! @brief Returns cos(2pi.phase).
+        template<class Tier, class T>
+        inline T cosine(Tier, T phase)
+        {
+            const T x = phase - std::floor(phase + T(0.5));
+            const T t = T(0.25) - std::abs(x);
+            const T u = t * t;
+
+            T sum = T(Tier::coefficient(Tier::Order - 1));
+            for(size_t k = Tier::Order - 1; k > 0; --k)
+            {
+                sum = sum * u + T(Tier::coefficient(k - 1));
+            }
+
+            return t * sum;
+        }
+
+        //! @brief outs[i] = cos(2pi.phases[i]), phases and outs can be the same array.
+        template<class Tier, class T>
+        inline void cosine(Tier, T const* phases, T* outs, long vecsize)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                outs[i] = cosine(Tier(), phases[i]);
+            }
+        }
+
+        #if defined(__AVX2__)
+
+        template<class Tier>
+        inline __m256d cosine(Tier, __m256d phase)
+        {
+            const __m256d x = _mm256_sub_pd(phase, _mm256_round_pd(phase, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+            const __m256d t = _mm256_sub_pd(_mm256_set1_pd(0.25), _mm256_andnot_pd(_mm256_set1_pd(-0.), x));
+            const __m256d u = _mm256_mul_pd(t, t);
+
+            __m256d sum = _mm256_set1_pd(Tier::coefficient(Tier::Order - 1));
+            for(size_t k = Tier::Order - 1; k > 0; --k)
+            {
+                sum = _mm256_add_pd(_mm256_mul_pd(sum, u), _mm256_set1_pd(Tier::coefficient(k - 1)));
+            }
+
+            return _mm256_mul_pd(t, sum);
+        }
+
+        template<class Tier>
+        inline void cosine(Tier, double const* phases, double* outs, long vecsize)
+        {
+            long i = 0;
+
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                _mm256_storeu_pd(outs + i, cosine(Tier(), _mm256_loadu_pd(phases + i)));
+            }
+
+            for(; i < vecsize; ++i)
+            {
+                outs[i] = cosine(Tier(), phases[i]);
+            }
+        }
+
+        #elif defined(__SSE2__) || defined(_M_X64)
+
+        //! @details SSE2 has no rounding instruction: adding and subtracting 1.5 * 2^52 rounds to the nearest
+        //! integer (for |phase| < 2^51), ties may go either way which is fine since cos(pi) = cos(-pi).
+        template<class Tier>
+        inline __m128d cosine(Tier, __m128d phase)
+        {
+            const __m128d magic = _mm_set1_pd(6755399441055744.);
+            const __m128d x = _mm_sub_pd(phase, _mm_sub_pd(_mm_add_pd(phase, magic), magic));
+            const __m128d t = _mm_sub_pd(_mm_set1_pd(0.25), _mm_andnot_pd(_mm_set1_pd(-0.), x));
+            const __m128d u = _mm_mul_pd(t, t);
+
+            __m128d sum = _mm_set1_pd(Tier::coefficient(Tier::Order - 1));
+            for(size_t k = Tier::Order - 1; k > 0; --k)
+            {
+                sum = _mm_add_pd(_mm_mul_pd(sum, u), _mm_set1_pd(Tier::coefficient(k - 1)));
+            }
+
+            return _mm_mul_pd(t, sum);
+        }
+
+        template<class Tier>
+        inline void cosine(Tier, double const* phases, double* outs, long vecsize)
+        {
+            long i = 0;
+
+            // two vectors per iteration to hide the latency of the polynomial
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                const __m128d out_0 = cosine(Tier(), _mm_loadu_pd(phases + i));
+                const __m128d out_1 = cosine(Tier(), _mm_loadu_pd(phases + i + 2));
+
+                _mm_storeu_pd(outs + i, out_0);
+                _mm_storeu_pd(outs + i + 2, out_1);
+            }
+
+            for(; i < vecsize; ++i)
+            {
+                outs[i] = cosine(Tier(), phases[i]);
+            }
+        }
+
+        #endif
+    }
+}
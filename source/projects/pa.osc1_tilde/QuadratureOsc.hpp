@@ -0,0 +1,255 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                  ROTATION KERNELS                                //
+    // ================================================================================ //
+    
+    namespace simd
+    {
+        //! @brief Rotate Lanes complex numbers groups times, the real parts of each group are written to outs.
+        template<class T, size_t Lanes>
+        inline void rotateLanes(T (&lanes_re)[Lanes], T (&lanes_im)[Lanes], T rotation_re, T rotation_im,
+                                T* outs, long groups)
+        {
+            for(long g = 0; g < groups; ++g, outs += Lanes)
+            {
+                for(size_t k = 0; k < Lanes; ++k)
+                {
+                    const T re = lanes_re[k];
+                    const T im = lanes_im[k];
+                    
+                    lanes_re[k] = re * rotation_re - im * rotation_im;
+                    lanes_im[k] = re * rotation_im + im * rotation_re;
+                    outs[k] = lanes_re[k];
+                }
+            }
+        }
+        
+        #if defined(__AVX2__)
+        
+        //! @brief 8 lanes in 2 + 2 registers.
+        inline void rotateLanes(double (&lanes_re)[8], double (&lanes_im)[8], double rotation_re, double rotation_im,
+                                double* outs, long groups)
+        {
+            const __m256d rot_re = _mm256_set1_pd(rotation_re);
+            const __m256d rot_im = _mm256_set1_pd(rotation_im);
+            __m256d re_0 = _mm256_loadu_pd(lanes_re), re_1 = _mm256_loadu_pd(lanes_re + 4);
+            __m256d im_0 = _mm256_loadu_pd(lanes_im), im_1 = _mm256_loadu_pd(lanes_im + 4);
+            
+            for(long g = 0; g < groups; ++g, outs += 8)
+            {
+                const __m256d next_0 = _mm256_sub_pd(_mm256_mul_pd(re_0, rot_re), _mm256_mul_pd(im_0, rot_im));
+                const __m256d next_1 = _mm256_sub_pd(_mm256_mul_pd(re_1, rot_re), _mm256_mul_pd(im_1, rot_im));
+                im_0 = _mm256_add_pd(_mm256_mul_pd(re_0, rot_im), _mm256_mul_pd(im_0, rot_re));
+                im_1 = _mm256_add_pd(_mm256_mul_pd(re_1, rot_im), _mm256_mul_pd(im_1, rot_re));
+                re_0 = next_0;
+                re_1 = next_1;
+                
+                _mm256_storeu_pd(outs, re_0);
+                _mm256_storeu_pd(outs + 4, re_1);
+            }
+            
+            _mm256_storeu_pd(lanes_re, re_0); _mm256_storeu_pd(lanes_re + 4, re_1);
+            _mm256_storeu_pd(lanes_im, im_0); _mm256_storeu_pd(lanes_im + 4, im_1);
+        }
+        
+        #elif defined(__SSE2__) || defined(_M_X64)
+        
+        //! @brief 8 lanes in 4 + 4 registers.
+        inline void rotateLanes(double (&lanes_re)[8], double (&lanes_im)[8], double rotation_re, double rotation_im,
+                                double* outs, long groups)
+        {
+            const __m128d rot_re = _mm_set1_pd(rotation_re);
+            const __m128d rot_im = _mm_set1_pd(rotation_im);
+            __m128d re[4], im[4];
+            
+            for(int v = 0; v < 4; ++v)
+            {
+                re[v] = _mm_loadu_pd(lanes_re + 2 * v);
+                im[v] = _mm_loadu_pd(lanes_im + 2 * v);
+            }
+            
+            for(long g = 0; g < groups; ++g, outs += 8)
+            {
+                for(int v = 0; v < 4; ++v)
+                {
+                    const __m128d next = _mm_sub_pd(_mm_mul_pd(re[v], rot_re), _mm_mul_pd(im[v], rot_im));
+                    im[v] = _mm_add_pd(_mm_mul_pd(re[v], rot_im), _mm_mul_pd(im[v], rot_re));
+                    re[v] = next;
+                    
+                    _mm_storeu_pd(outs + 2 * v, re[v]);
+                }
+            }
+            
+            for(int v = 0; v < 4; ++v)
+            {
+                _mm_storeu_pd(lanes_re + 2 * v, re[v]);
+                _mm_storeu_pd(lanes_im + 2 * v, im[v]);
+            }
+        }
+        
+        #endif
+    }
+    
+    // ================================================================================ //
+    //                                  QUADRATURE OSC                                  //
+    // ================================================================================ //
+
+    //! @brief A constant-frequency cosine oscillator without table nor cos() per sample.
+    //! @details Lanes consecutive samples are the real parts of Lanes complex numbers
+    //! z[k] = exp(2i.pi.(phase + k.inc)), multiplied all together by the rotation exp(2i.pi.Lanes.inc)
+    //! to get the next Lanes samples (4 multiplications and 2 additions per sample, the lanes are independent
+    //! so the loop vectorizes).
+    //! The rounding errors of the recursion make the magnitude and the phase of z drift:
+    //! - the magnitude is renormalized at the end of every block (a Newton step of 1/sqrt(|z|^2)).
+    //! - the phase is accumulated in double like the other oscillators, z is computed again
+    //! from it with cos() and sin() every ResyncPeriod samples, when the increment changes
+    //! or when the phase is set.
+    //! Between two resyncs the error is below ResyncPeriod / Lanes * 4 epsilon (about 1e-11 with doubles).
+    template<class SampleType, size_t Lanes = 8>
+    class QuadratureOsc
+    {
+    public: // methods
+
+        using sample_t = SampleType;
+
+        //! @brief The maximum number of samples between two resyncs.
+        static const long ResyncPeriod = 65536;
+
+        //! Default constructor
+        QuadratureOsc() = default;
+
+        //! Destructor
+        ~QuadratureOsc() = default;
+
+        //! @brief Process a block of samples.
+        //! @param phase The phase of the first sample (in [0, 1[).
+        //! @param inc The phase increment per sample (frequency / samplerate).
+        //! @return The phase after the block, to pass to the next call.
+        sample_t process(sample_t phase, sample_t inc, sample_t* outs, long vecsize)
+        {
+            if(phase != m_phase || inc != m_inc || m_countdown <= 0)
+            {
+                resync(phase, inc);
+            }
+
+            long i = 0;
+
+            // the end of the current group
+            while(i < vecsize && m_position < Lanes)
+            {
+                outs[i++] = m_re[m_position++];
+            }
+
+            // whole groups
+            const long groups = (vecsize - i) / long(Lanes);
+            
+            if(groups > 0)
+            {
+                simd::rotateLanes(m_re, m_im, m_rotation_re, m_rotation_im, outs + i, groups);
+                i += groups * Lanes;
+            }
+            
+            // the beginning of the next group
+            if(i < vecsize)
+            {
+                rotate(m_re, m_im);
+                m_position = 0;
+
+                while(i < vecsize)
+                {
+                    outs[i++] = m_re[m_position++];
+                }
+            }
+
+            renormalize();
+
+            m_countdown -= vecsize;
+            m_phase += inc * vecsize;
+            m_phase -= std::floor(m_phase);
+
+            return m_phase;
+        }
+
+    private: // methods
+
+        //! @brief Compute the lanes and the rotation from the phase.
+        void resync(sample_t phase, sample_t inc)
+        {
+            const double two_pi = 2. * M_PI;
+
+            for(size_t k = 0; k < Lanes; ++k)
+            {
+                const double angle = two_pi * (phase + k * inc);
+                m_re[k] = std::cos(angle);
+                m_im[k] = std::sin(angle);
+            }
+
+            m_rotation_re = std::cos(two_pi * Lanes * inc);
+            m_rotation_im = std::sin(two_pi * Lanes * inc);
+
+            m_phase = phase;
+            m_inc = inc;
+            m_position = 0;
+            m_countdown = ResyncPeriod;
+        }
+
+        //! @brief Advance all the lanes by Lanes samples.
+        void rotate(sample_t* lanes_re, sample_t* lanes_im) const
+        {
+            const sample_t rotation_re = m_rotation_re;
+            const sample_t rotation_im = m_rotation_im;
+
+            for(size_t k = 0; k < Lanes; ++k)
+            {
+                const sample_t re = lanes_re[k];
+                const sample_t im = lanes_im[k];
+
+                lanes_re[k] = re * rotation_re - im * rotation_im;
+                lanes_im[k] = re * rotation_im + im * rotation_re;
+            }
+        }
+
+        //! @brief Bring the magnitude of the lanes back to 1.
+        //! @details 1/sqrt(x) ~= (3 - x) / 2 near x = 1, the error is squared.
+        void renormalize()
+        {
+            for(size_t k = 0; k < Lanes; ++k)
+            {
+                const sample_t gain = sample_t(1.5) - sample_t(0.5) * (m_re[k] * m_re[k] + m_im[k] * m_im[k]);
+
+                m_re[k] *= gain;
+                m_im[k] *= gain;
+            }
+        }
+
+    private: // variables
+
+        sample_t    m_re[Lanes] = {};
+        sample_t    m_im[Lanes] = {};
+        sample_t    m_rotation_re = 1.;
+        sample_t    m_rotation_im = 0.;
+        sample_t    m_phase = -1.;
+        sample_t    m_inc = 0.;
+        size_t      m_position = 0;
+        long        m_countdown = 0;
+    };
+}
@@ -10,6 +10,12 @@
 #include "c74_msp.h"
 using namespace c74::max;
 
+#include "QuadratureOsc.hpp"
+using paccpp::QuadratureOsc;
+
+#include "PolyCos.hpp"
+namespace polycos = paccpp::polycos;
+
 static t_class* this_class = nullptr;
 
 struct t_pa_osc1_tilde
@@ -22,6 +28,13 @@ struct t_pa_osc1_tilde
     // to perform with float freq
     double      m_freq;
     double      m_phase_inc;
+    
+    // recursive mode (float freq only)
+    long                    m_recursive;
+    QuadratureOsc<double>*  m_quadrature;
+    
+    // 0 : cos(), 1 to 3 : polynomial approximations (low, medium, high)
+    long                    m_accuracy;
 };
 
 void pa_osc1_tilde_float(t_pa_osc1_tilde* x, double d)
@@ -35,6 +48,17 @@ void pa_osc1_tilde_int(t_pa_osc1_tilde* x, long l)
     pa_osc1_tilde_float(x, (double)l);
 }
 
+//! @brief Replace a block of phases by their cosine with the polynomial of the current accuracy.
+void pa_osc1_tilde_polycos(long accuracy, double* phases, long vecsize)
+{
+    switch(accuracy)
+    {
+        case 1: polycos::cosine(polycos::Low(), phases, phases, vecsize); break;
+        case 2: polycos::cosine(polycos::Medium(), phases, phases, vecsize); break;
+        default: polycos::cosine(polycos::High(), phases, phases, vecsize); break;
+    }
+}
+
 void pa_osc1_tilde_perform64_vec(t_pa_osc1_tilde* x, t_object* dsp64,
                                  double** ins, long numins, double** outs, long numouts,
                                  long vecsize, long flags, void* userparam)
@@ -47,6 +71,25 @@ void pa_osc1_tilde_perform64_vec(t_pa_osc1_tilde* x, t_object* dsp64,
     double phase_inc = 0.f;
     double phase = x->m_phase;
     
+    if(x->m_accuracy)
+    {
+        // phases first, then all the cosines at once,
+        // the polynomial reduces the phase itself so it is only wrapped once per vector
+        const double sr_inv = 1. / sr;
+        
+        for(long i = 0; i < vecsize; ++i)
+        {
+            // in and out can be the same array
+            freq = in[i];
+            out[i] = phase;
+            phase += freq * sr_inv;
+        }
+        
+        pa_osc1_tilde_polycos(x->m_accuracy, out, vecsize);
+        x->m_phase = phase - floor(phase);
+        return;
+    }
+    
     while(vecsize--)
     {
         freq = *in++;
@@ -73,6 +116,20 @@ void pa_osc1_tilde_perform64_float(t_pa_osc1_tilde* x, t_object* dsp64,
     const double phase_inc = x->m_phase_inc;
     double phase = x->m_phase;
     
+    if(x->m_accuracy)
+    {
+        for(long i = 0; i < vecsize; ++i)
+        {
+            out[i] = phase + i * phase_inc;
+        }
+        
+        pa_osc1_tilde_polycos(x->m_accuracy, out, vecsize);
+        
+        phase += vecsize * phase_inc;
+        x->m_phase = phase - floor(phase);
+        return;
+    }
+    
     while(vecsize--)
     {
         *out++ = cos(phase * 2. * M_PI);
@@ -87,6 +144,31 @@ void pa_osc1_tilde_perform64_float(t_pa_osc1_tilde* x, t_object* dsp64,
 }
 
 
+void pa_osc1_tilde_perform64_recursive(t_pa_osc1_tilde* x, t_object* dsp64,
+                                       double** ins, long numins, double** outs, long numouts,
+                                       long vecsize, long flags, void* userparam)
+{
+    // the frequency is constant: complex rotation instead of cos()
+    x->m_phase = x->m_quadrature->process(x->m_phase, x->m_phase_inc, outs[0], vecsize);
+}
+
+void pa_osc1_tilde_set_recursive(t_pa_osc1_tilde* x, long recursive)
+{
+    // taken into account when the dsp chain is compiled
+    x->m_recursive = (recursive != 0);
+}
+
+void pa_osc1_tilde_set_accuracy(t_pa_osc1_tilde* x, long accuracy)
+{
+    if(accuracy < 0 || accuracy > 3)
+    {
+        object_error((t_object*)x, "accuracy must be 0 (cos), 1 (low), 2 (medium) or 3 (high)");
+        return;
+    }
+    
+    x->m_accuracy = accuracy;
+}
+
 void pa_osc1_tilde_dsp64(t_pa_osc1_tilde* x, t_object* dsp64, short* count,
                          double samplerate, long maxvectorsize, long flags)
 {
@@ -104,7 +186,8 @@ void pa_osc1_tilde_dsp64(t_pa_osc1_tilde* x, t_object* dsp64, short* count,
         
         object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
                              dsp64, gensym("dsp_add64"), (t_object*)x,
-                             (t_perfroutine64)pa_osc1_tilde_perform64_float, 0, NULL);
+                             (t_perfroutine64)(x->m_recursive ? pa_osc1_tilde_perform64_recursive
+                                                              : pa_osc1_tilde_perform64_float), 0, NULL);
     }
 }
 
@@ -113,7 +196,7 @@ void pa_osc1_tilde_assist(t_pa_osc1_tilde* x, void* unused,
 {
     if(io == ASSIST_INLET)
     {
-        strncpy(string_dest, "(signal) Frequency", ASSIST_STRING_MAXSIZE);
+        strncpy(string_dest, "(signal) Frequency, (recursive) 1 to compute a float frequency without cos(), (accuracy) 0 to 3", ASSIST_STRING_MAXSIZE);
     }
     else if(io == ASSIST_OUTLET)
     {
@@ -130,6 +213,12 @@ void* pa_osc1_tilde_new(t_symbol *name, long argc, t_atom *argv)
         x->m_phase = 0.;
         x->m_freq = 0.;
         x->m_phase_inc = 0.;
+        x->m_recursive = 0;
+        x->m_accuracy = 0;
+        
+        // instantiate a new QuadratureOsc object
+        // Note: dont forget to delete it in the free method !
+        x->m_quadrature = new QuadratureOsc<double>();
         
         if(argc >= 1 && (atom_gettype(argv) == A_FLOAT || atom_gettype(argv) == A_LONG))
         {
@@ -137,6 +226,11 @@ void* pa_osc1_tilde_new(t_symbol *name, long argc, t_atom *argv)
             pa_osc1_tilde_float(x, atom_getfloat(argv));
         }
         
+        if(argc >= 2 && atom_gettype(argv + 1) == A_LONG)
+        {
+            pa_osc1_tilde_set_accuracy(x, atom_getlong(argv + 1));
+        }
+        
         dsp_setup((t_pxobject*)x, 1);
         outlet_new(x, "signal");
     }
@@ -147,6 +241,9 @@ void* pa_osc1_tilde_new(t_symbol *name, long argc, t_atom *argv)
 void pa_osc1_tilde_free(t_pa_osc1_tilde* x)
 {
     dsp_free((t_pxobject*)x);
+    
+    // free the memory for the QuadratureOsc object
+    delete x->m_quadrature;
 }
 
 void ext_main(void* r)
@@ -158,6 +255,8 @@ void ext_main(void* r)
     class_addmethod(this_class, (method)pa_osc1_tilde_dsp64,      "dsp64",    A_CANT,       0);
     class_addmethod(this_class, (method)pa_osc1_tilde_float,      "float",    A_FLOAT,      0);
     class_addmethod(this_class, (method)pa_osc1_tilde_int,        "int",      A_LONG,       0);
+    class_addmethod(this_class, (method)pa_osc1_tilde_set_recursive, "recursive", A_LONG,    0);
+    class_addmethod(this_class, (method)pa_osc1_tilde_set_accuracy, "accuracy", A_LONG,     0);
     
     class_dspinit(this_class);
     class_register(CLASS_BOX, this_class);
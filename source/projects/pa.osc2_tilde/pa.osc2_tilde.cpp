@@ -12,10 +12,28 @@ using namespace c74::max;
 
 #include <cmath> // cos...
 
+#include "Wavetable.hpp"
+using paccpp::wavetable::cosine;
+
 static t_class* this_class = nullptr;
 
 #define OSC2_COSTABLE_SIZE 512
-static double osc2_cos_table[OSC2_COSTABLE_SIZE];
+
+// the table is computed by the compiler (no startup cost)
+struct t_osc2_cos_table
+{
+    double values[OSC2_COSTABLE_SIZE];
+    
+    constexpr t_osc2_cos_table() : values{}
+    {
+        for(long i = 0; i < OSC2_COSTABLE_SIZE; i++)
+        {
+            values[i] = cosine(i, OSC2_COSTABLE_SIZE);
+        }
+    }
+};
+
+static constexpr t_osc2_cos_table osc2_cos_table {};
 
 struct t_pa_osc2_tilde
 {
@@ -29,16 +47,6 @@ struct t_pa_osc2_tilde
     double      m_phase_inc;
 };
 
-void pa_osc2_tilde_fill_cos_table()
-{
-    int i;
-    for(i=0; i < OSC2_COSTABLE_SIZE; i++)
-    {
-        osc2_cos_table[i] = cos(2.f * M_PI * i / OSC2_COSTABLE_SIZE);
-        //post("%f, ", osc2_cos_table[i]);
-    }
-}
-
 void pa_osc2_tilde_float(t_pa_osc2_tilde* x, double d)
 {
     x->m_freq = d;
@@ -63,7 +71,7 @@ void pa_osc2_tilde_perform64_vec(t_pa_osc2_tilde* x, t_object* dsp64,
     // interpolation values
     double y1, y2, frac;
     
-    double *cos_table = osc2_cos_table;
+    const double *cos_table = osc2_cos_table.values;
     
     const double sr = x->m_sr;
     double freq;
@@ -114,7 +122,7 @@ void pa_osc2_tilde_perform64_float(t_pa_osc2_tilde* x, t_object* dsp64,
     // interpolation values
     double y1, y2, frac;
     
-    double *cos_table = osc2_cos_table;
+    const double *cos_table = osc2_cos_table.values;
     
     const double phase_inc = x->m_phase_inc;
     double phase = x->m_phase;
@@ -225,8 +233,6 @@ void ext_main(void* r)
     class_addmethod(this_class, (method)pa_osc2_tilde_float,      "float",    A_FLOAT,      0);
     class_addmethod(this_class, (method)pa_osc2_tilde_int,        "int",      A_LONG,       0);
     
-    pa_osc2_tilde_fill_cos_table();
-    
     class_dspinit(this_class);
     class_register(CLASS_BOX, this_class);
 }
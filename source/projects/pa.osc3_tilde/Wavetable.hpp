@@ -0,0 +1,87 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                 TABLE GENERATION                                 //
+    // ================================================================================ //
+    
+    namespace wavetable
+    {
+        //! @brief Taylor series of cos(x), accurate to the last bit for x in [0, pi/4].
+        constexpr double cosTaylor(double x)
+        {
+            const double x2 = x * x;
+            double term = 1.;
+            double sum = 1.;
+            
+            for(int k = 1; k <= 10; ++k)
+            {
+                term *= -x2 / ((2 * k - 1) * (2 * k));
+                sum += term;
+            }
+            
+            return sum;
+        }
+        
+        //! @brief Taylor series of sin(x), accurate to the last bit for x in [0, pi/4].
+        constexpr double sinTaylor(double x)
+        {
+            const double x2 = x * x;
+            double term = x;
+            double sum = x;
+            
+            for(int k = 1; k <= 10; ++k)
+            {
+                term *= -x2 / ((2 * k) * (2 * k + 1));
+                sum += term;
+            }
+            
+            return sum;
+        }
+        
+        //! @brief Returns cos(2 * pi * i / size), can be evaluated at compile time.
+        //! @details The index is reduced to the first octant with integer arithmetic
+        //! so that every value is as accurate as the Taylor series (size must be a multiple of 8).
+        constexpr double cosine(size_t i, size_t size)
+        {
+            i %= size;
+            
+            // cos(x) = cos(2pi - x)
+            size_t j = (i <= size / 2) ? i : (size - i);
+            double sign = 1.;
+            
+            // cos(x) = -cos(pi - x)
+            if(j * 4 > size)
+            {
+                j = size / 2 - j;
+                sign = -1.;
+            }
+            
+            // cos(x) = sin(pi/2 - x)
+            if(j * 8 > size)
+            {
+                return sign * sinTaylor(2. * M_PI * (size / 4 - j) / size);
+            }
+            
+            return sign * cosTaylor(2. * M_PI * j / size);
+        }
+        
+        //! @brief Returns the base 2 logarithm of a power of two.
+        constexpr size_t log2(size_t size)
+        {
+            return (size <= 1) ? 0 : (1 + log2(size / 2));
+        }
+    }
+}
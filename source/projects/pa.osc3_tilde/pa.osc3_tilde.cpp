@@ -11,11 +11,39 @@
 using namespace c74::max;
 
 #include <cmath> // cos...
+#include <cstdint>
+
+#include "QuadratureOsc.hpp"
+#include "Wavetable.hpp"
+using paccpp::QuadratureOsc;
+using paccpp::wavetable::cosine;
 
 static t_class* this_class = nullptr;
 
 #define OSC3_COSTABLE_SIZE 512
-static double osc3_cos_table[OSC3_COSTABLE_SIZE+1]; // size + 1 additional sample to facilitate linear interpolation
+
+// fixed-point mode: one period is 2^32, the top 9 bits index the 512 points table
+// and the 23 low bits are the interpolation delta.
+#define OSC3_FIXED_PERIOD 4294967296.
+#define OSC3_FIXED_FRACTION_BITS 23
+#define OSC3_FIXED_FRACTION_MASK ((1u << OSC3_FIXED_FRACTION_BITS) - 1)
+
+// the table is computed by the compiler (no startup cost)
+struct t_osc3_cos_table
+{
+    double values[OSC3_COSTABLE_SIZE+1]; // size + 1 additional sample to facilitate linear interpolation
+    
+    constexpr t_osc3_cos_table() : values{}
+    {
+        // the last sample (OSC3_COSTABLE_SIZE) = first sample
+        for(long i = 0; i <= OSC3_COSTABLE_SIZE; i++)
+        {
+            values[i] = cosine(i, OSC3_COSTABLE_SIZE);
+        }
+    }
+};
+
+static constexpr t_osc3_cos_table osc3_cos_table {};
 
 struct t_pa_osc3_tilde
 {
@@ -27,23 +55,26 @@ struct t_pa_osc3_tilde
     // to perform with float freq
     double      m_freq;
     double      m_phase_inc;
+    
+    // fixed-point mode
+    long        m_fixed;
+    uint32_t    m_fixed_phase;
+    uint32_t    m_fixed_phase_inc;
+    
+    // recursive mode (float freq only)
+    long                    m_recursive;
+    QuadratureOsc<double>*  m_quadrature;
 };
 
-void pa_osc3_tilde_fill_cos_table()
+// converts periods (|periods| < 2^31) to 2^-32 period units, negative values wrap around.
+static inline uint32_t pa_osc3_tilde_to_fixed(double periods)
 {
-    int i;
-    for(i=0; i < OSC3_COSTABLE_SIZE; i++)
-    {
-        osc3_cos_table[i] = cos(2.f * M_PI * i / OSC3_COSTABLE_SIZE);
-        //post("%f, ", osc3_cos_table[i]);
-    }
-    
-    osc3_cos_table[OSC3_COSTABLE_SIZE] = osc3_cos_table[0]; // last sample = first sample
+    return (uint32_t)(int64_t)(periods * OSC3_FIXED_PERIOD);
 }
 
 void pa_osc3_tilde_reset_phase(t_pa_osc3_tilde *x, double d)
 {
-    const int tsize = (OSC3_COSTABLE_SIZE-1);
+    const int tsize = OSC3_COSTABLE_SIZE;
     double phase = d * tsize;
     
     // wrap between table boundaries
@@ -51,12 +82,14 @@ void pa_osc3_tilde_reset_phase(t_pa_osc3_tilde *x, double d)
     while(phase < 0) { phase += tsize; }
     
     x->m_phase = phase;
+    x->m_fixed_phase = pa_osc3_tilde_to_fixed(phase / tsize);
 }
 
 void pa_osc3_tilde_float(t_pa_osc3_tilde* x, double d)
 {
     x->m_freq = d;
-    x->m_phase_inc = (x->m_freq / x->m_sr) * (OSC3_COSTABLE_SIZE-1);
+    x->m_phase_inc = (x->m_freq / x->m_sr) * OSC3_COSTABLE_SIZE;
+    x->m_fixed_phase_inc = (uint32_t)llround(fmod(x->m_freq / x->m_sr, 1.) * OSC3_FIXED_PERIOD);
 }
 
 void pa_osc3_tilde_int(t_pa_osc3_tilde* x, long l)
@@ -64,6 +97,70 @@ void pa_osc3_tilde_int(t_pa_osc3_tilde* x, long l)
     pa_osc3_tilde_float(x, (double)l);
 }
 
+void pa_osc3_tilde_set_fixed(t_pa_osc3_tilde* x, long fixed)
+{
+    fixed = (fixed != 0);
+    
+    if(fixed == x->m_fixed) return;
+    
+    // carry the phase over to the other accumulator
+    if(fixed)
+    {
+        x->m_fixed_phase = pa_osc3_tilde_to_fixed(x->m_phase / OSC3_COSTABLE_SIZE);
+    }
+    else
+    {
+        x->m_phase = x->m_fixed_phase * (OSC3_COSTABLE_SIZE / OSC3_FIXED_PERIOD);
+    }
+    
+    x->m_fixed = fixed;
+}
+
+// 32-bit fixed-point phase: the index is in the top bits and the delta in the low bits.
+static inline double pa_osc3_tilde_read_fixed(uint32_t phase)
+{
+    const double *cos_table = osc3_cos_table.values;
+    const uint32_t idx_1 = phase >> OSC3_FIXED_FRACTION_BITS;
+    const double delta = (phase & OSC3_FIXED_FRACTION_MASK) * (1. / (OSC3_FIXED_FRACTION_MASK + 1.));
+    const double y1 = cos_table[idx_1];
+    
+    return y1 + delta * (cos_table[idx_1+1] - y1);
+}
+
+// the phase wraps by overflow and never drifts, in is NULL for the float frequency.
+static inline void pa_osc3_tilde_perform_fixed(t_pa_osc3_tilde* x, double const* in, double* out, long vecsize)
+{
+    uint32_t phase = x->m_fixed_phase;
+    
+    if(in)
+    {
+        const double scale = OSC3_FIXED_PERIOD / x->m_sr;
+        
+        for(long i = 0; i < vecsize; ++i)
+        {
+            // the input is read before the output is written (in and out can be the same vector)
+            const double freq = in[i];
+            
+            out[i] = pa_osc3_tilde_read_fixed(phase);
+            
+            // increment phase (truncated to 2^-32 period)
+            phase += (uint32_t)(int64_t)(freq * scale);
+        }
+    }
+    else
+    {
+        const uint32_t phase_inc = x->m_fixed_phase_inc;
+        
+        for(long i = 0; i < vecsize; ++i)
+        {
+            out[i] = pa_osc3_tilde_read_fixed(phase);
+            phase += phase_inc;
+        }
+    }
+    
+    x->m_fixed_phase = phase;
+}
+
 void pa_osc3_tilde_perform64_vec(t_pa_osc3_tilde* x, t_object* dsp64,
                                  double** ins, long numins, double** outs, long numouts,
                                  long vecsize, long flags, void* userparam)
@@ -71,16 +168,22 @@ void pa_osc3_tilde_perform64_vec(t_pa_osc3_tilde* x, t_object* dsp64,
     double* in = ins[0];
     double* out = outs[0];
     
+    if(x->m_fixed)
+    {
+        pa_osc3_tilde_perform_fixed(x, in, out, vecsize);
+        return;
+    }
+    
     // interpolation index
     int idx_1;
     
-    const int tsize = (OSC3_COSTABLE_SIZE-1);
+    const int tsize = OSC3_COSTABLE_SIZE;
     
     const double sr = x->m_sr;
     
     // interpolation values
     double y1, delta;
-    double *cos_table = osc3_cos_table;
+    const double *cos_table = osc3_cos_table.values;
     double freq;
     double tphase = x->m_phase; // phase in 0. to OSC3_COSTABLE_SIZE. range
     
@@ -117,14 +220,20 @@ void pa_osc3_tilde_perform64_float(t_pa_osc3_tilde* x, t_object* dsp64,
 {
     double* out = outs[0];
     
+    if(x->m_fixed)
+    {
+        pa_osc3_tilde_perform_fixed(x, NULL, out, vecsize);
+        return;
+    }
+    
     /// interpolation index
     int idx_1;
     
-    const int tsize = (OSC3_COSTABLE_SIZE-1);
+    const int tsize = OSC3_COSTABLE_SIZE;
     
     // interpolation values
     double y1, delta;
-    double *cos_table = osc3_cos_table;
+    const double *cos_table = osc3_cos_table.values;
     double tphase = x->m_phase; // phase in 0. to OSC3_COSTABLE_SIZE. range
     const double phase_inc = x->m_phase_inc;
     
@@ -154,6 +263,23 @@ void pa_osc3_tilde_perform64_float(t_pa_osc3_tilde* x, t_object* dsp64,
 }
 
 
+void pa_osc3_tilde_perform64_recursive(t_pa_osc3_tilde* x, t_object* dsp64,
+                                       double** ins, long numins, double** outs, long numouts,
+                                       long vecsize, long flags, void* userparam)
+{
+    // the frequency is constant: complex rotation instead of the table (phases in periods)
+    const double tsize = OSC3_COSTABLE_SIZE;
+    const double phase = x->m_quadrature->process(x->m_phase / tsize, x->m_phase_inc / tsize, outs[0], vecsize);
+    
+    x->m_phase = phase * tsize;
+}
+
+void pa_osc3_tilde_set_recursive(t_pa_osc3_tilde* x, long recursive)
+{
+    // taken into account when the dsp chain is compiled
+    x->m_recursive = (recursive != 0);
+}
+
 void pa_osc3_tilde_dsp64(t_pa_osc3_tilde* x, t_object* dsp64, short* count,
                          double samplerate, long maxvectorsize, long flags)
 {
@@ -174,7 +300,8 @@ void pa_osc3_tilde_dsp64(t_pa_osc3_tilde* x, t_object* dsp64, short* count,
         
         object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
                              dsp64, gensym("dsp_add64"), (t_object*)x,
-                             (t_perfroutine64)pa_osc3_tilde_perform64_float, 0, NULL);
+                             (t_perfroutine64)(x->m_recursive ? pa_osc3_tilde_perform64_recursive
+                                                              : pa_osc3_tilde_perform64_float), 0, NULL);
     }
 }
 
@@ -183,7 +310,7 @@ void pa_osc3_tilde_assist(t_pa_osc3_tilde* x, void* unused,
 {
     if(io == ASSIST_INLET)
     {
-        strncpy(string_dest, "(signal) Frequency", ASSIST_STRING_MAXSIZE);
+        strncpy(string_dest, "(signal) Frequency, (fixed) 1 for a 32-bit fixed-point phase, (recursive) 1 to compute a float frequency without table", ASSIST_STRING_MAXSIZE);
     }
     else if(io == ASSIST_OUTLET)
     {
@@ -200,6 +327,14 @@ void* pa_osc3_tilde_new(t_symbol *name, long argc, t_atom *argv)
         x->m_phase = 0.;
         x->m_freq = 0.;
         x->m_phase_inc = 0.;
+        x->m_fixed = 0;
+        x->m_fixed_phase = 0;
+        x->m_fixed_phase_inc = 0;
+        x->m_recursive = 0;
+        
+        // instantiate a new QuadratureOsc object
+        // Note: dont forget to delete it in the free method !
+        x->m_quadrature = new QuadratureOsc<double>();
         
         if(argc >= 1 && (atom_gettype(argv) == A_FLOAT || atom_gettype(argv) == A_LONG))
         {
@@ -217,6 +352,9 @@ void* pa_osc3_tilde_new(t_symbol *name, long argc, t_atom *argv)
 void pa_osc3_tilde_free(t_pa_osc3_tilde* x)
 {
     dsp_free((t_pxobject*)x);
+    
+    // free the memory for the QuadratureOsc object
+    delete x->m_quadrature;
 }
 
 void ext_main(void* r)
@@ -228,8 +366,8 @@ void ext_main(void* r)
     class_addmethod(this_class, (method)pa_osc3_tilde_dsp64,      "dsp64",    A_CANT,       0);
     class_addmethod(this_class, (method)pa_osc3_tilde_float,      "float",    A_FLOAT,      0);
     class_addmethod(this_class, (method)pa_osc3_tilde_int,        "int",      A_LONG,       0);
-    
-    pa_osc3_tilde_fill_cos_table();
+    class_addmethod(this_class, (method)pa_osc3_tilde_set_fixed,  "fixed",    A_LONG,       0);
+    class_addmethod(this_class, (method)pa_osc3_tilde_set_recursive, "recursive", A_LONG,    0);
     
     class_dspinit(this_class);
     class_register(CLASS_BOX, this_class);
@@ -0,0 +1,273 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include "Fft.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                   ADDITIVE FFT                                   //
+    // ================================================================================ //
+
+    //! @brief Additive synthesis by inverse FFT (FFT-1, Rodet & Depalle).
+    //! @details Every Hop samples, each partial adds the main lobe of a Blackman-Harris window
+    //! centered on its frequency to a spectrum (LobeBins bins, scaled by its amplitude and phase).
+    //! The inverse FFT of this spectrum is the windowed sum of the partials: it is divided by the
+    //! window and multiplied by a triangle of 2 * Hop samples, then overlap-added to the output.
+    //! The cost per partial is LobeBins complex additions per hop instead of one cosine per sample,
+    //! plus one FFT per hop, so it is faster than direct summation for large banks.
+    //! There is no latency, but parameter changes are only taken into account every Hop samples.
+    template<class SampleType>
+    class AdditiveFft
+    {
+    public: // methods
+
+        using sample_t = SampleType;
+
+        //! @brief The size of the FFT.
+        static const size_t FrameSize = 512;
+
+        //! @brief The number of samples between two frames.
+        static const size_t Hop = FrameSize / 4;
+
+        //! @brief Constructor
+        //! @details Computes the spectral lobe and the synthesis window.
+        AdditiveFft()
+        : m_fft(FrameSize)
+        , m_re(FrameSize, 0.)
+        , m_im(FrameSize, 0.)
+        , m_output(2 * Hop, 0.)
+        , m_synthesis(2 * Hop, 0.)
+        , m_lobe(LobeBins * LobeOversampling + 2, 0.)
+        {
+            // the transform of the (zero-phase) window, sampled every 1/LobeOversampling bin.
+            for(size_t i = 0; i < m_lobe.size(); ++i)
+            {
+                const double x = double(i) / LobeOversampling - LobeBins / 2;
+                double value = 0.;
+
+                for(size_t m = 0; m < 4; ++m)
+                {
+                    value += 0.5 * BlackmanHarris[m] * (dirichlet(x - m) + dirichlet(x + m));
+                }
+
+                m_lobe[i] = value;
+            }
+
+            // keep the center of the frame where the window is large,
+            // 1/FrameSize is the normalization of the inverse FFT.
+            for(size_t j = 0; j < 2 * Hop; ++j)
+            {
+                const double n = double(j) - double(Hop);
+                const double triangle = 1. - std::abs(n) / Hop;
+
+                m_synthesis[j] = triangle / (window(n) * FrameSize);
+            }
+
+            reset();
+        }
+
+        //! @brief Destructor
+        ~AdditiveFft() = default;
+
+        //! @brief Discard the frames being overlap-added.
+        void reset()
+        {
+            for(auto& sample : m_output)
+            {
+                sample = 0.;
+            }
+
+            m_position = Hop;
+        }
+
+        //! @brief Add the output of the partials to outs.
+        //! @param phases The phases of the partials (in [0, 1[) at the center of the next frame.
+        //! @param increments The frequency of the partials divided by the samplerate.
+        //! @param amplitudes The amplitudes of the partials.
+        void process(sample_t* phases, sample_t const* increments, sample_t const* amplitudes,
+                     size_t count, sample_t* outs, long vecsize)
+        {
+            process(outs, vecsize, [this, phases, increments, amplitudes, count](sample_t* re, sample_t* im) {
+                addLobes(phases, increments, amplitudes, 0, count, re, im);
+            });
+        }
+
+        //! @brief Add the output of the partials to outs, their lobes are added by a function.
+        //! @param lobes Called with the (zeroed) spectrum of each frame, lobes(re, im) adds the lobes of all the partials
+        //! (eg. split between several threads, see addLobes()).
+        template<class Lobes>
+        void process(sample_t* outs, long vecsize, Lobes&& lobes)
+        {
+            long i = 0;
+
+            while(i < vecsize)
+            {
+                if(m_position == Hop)
+                {
+                    synthesize(lobes);
+                }
+
+                const long available = long(Hop - m_position);
+                const long n = (vecsize - i < available) ? (vecsize - i) : available;
+                sample_t const* output = m_output.data() + m_position;
+
+                for(long j = 0; j < n; ++j)
+                {
+                    outs[i+j] += output[j];
+                }
+
+                i += n;
+                m_position += n;
+            }
+        }
+
+        //! @brief Add the lobes of the partials [begin, end) to a spectrum of FrameSize bins, and move their phases to the next frame.
+        //! @details Only reads the tables of the object: several threads can add different partials to their own spectrum.
+        void addLobes(sample_t* phases, sample_t const* increments, sample_t const* amplitudes,
+                      size_t begin, size_t end, sample_t* re, sample_t* im) const
+        {
+            const size_t mask = FrameSize - 1;
+            sample_t const* const lobe = m_lobe.data();
+
+            for(size_t p = begin; p < end; ++p)
+            {
+                const sample_t amplitude = amplitudes[p];
+                const sample_t increment = increments[p];
+                sample_t phase = phases[p];
+
+                if(amplitude != 0.)
+                {
+                    const sample_t bin = increment * FrameSize;
+                    const sample_t angle = sample_t(2. * M_PI) * phase;
+                    const sample_t value_re = sample_t(0.5) * amplitude * cos(angle);
+                    const sample_t value_im = sample_t(0.5) * amplitude * sin(angle);
+
+                    const long first = long(floor(bin)) - long(LobeBins / 2) + 1;
+
+                    for(size_t j = 0; j < LobeBins; ++j)
+                    {
+                        const long k = first + long(j);
+
+                        // linear interpolation of the lobe at k - bin (in ]-LobeBins/2, LobeBins/2]).
+                        const sample_t position = (sample_t(k) - bin + sample_t(LobeBins / 2)) * LobeOversampling;
+                        const size_t index = size_t(position);
+                        const sample_t delta = position - index;
+                        const sample_t gain = lobe[index] + delta * (lobe[index+1] - lobe[index]);
+
+                        // the positive frequency and its conjugate at the negative frequency,
+                        // bins out of [0, FrameSize[ fold back like the partial would alias.
+                        const size_t positive = size_t(k) & mask;
+                        const size_t negative = (FrameSize - positive) & mask;
+
+                        re[positive] += gain * value_re;
+                        im[positive] += gain * value_im;
+                        re[negative] += gain * value_re;
+                        im[negative] -= gain * value_im;
+                    }
+                }
+
+                // phase at the center of the next frame.
+                phase += increment * sample_t(Hop);
+                phases[p] = phase - floor(phase);
+            }
+        }
+
+    private: // methods
+
+        //! @brief The Blackman-Harris window centered on 0, for n in [-FrameSize/2, FrameSize/2[.
+        static double window(double n)
+        {
+            double value = 0.;
+
+            for(size_t m = 0; m < 4; ++m)
+            {
+                value += BlackmanHarris[m] * cos(2. * M_PI * m * n / FrameSize);
+            }
+
+            return value;
+        }
+
+        //! @brief The transform of a rectangular window of FrameSize samples centered on 0.
+        static double dirichlet(double x)
+        {
+            const double denominator = sin(M_PI * x / FrameSize);
+
+            if(std::abs(denominator) < 1e-12)
+            {
+                return FrameSize;
+            }
+
+            return cos(M_PI * x / FrameSize) * sin(M_PI * x) / denominator;
+        }
+
+        //! @brief Compute the next frame and overlap-add it.
+        template<class Lobes>
+        void synthesize(Lobes& lobes)
+        {
+            const size_t mask = FrameSize - 1;
+            sample_t* const re = m_re.data();
+            sample_t* const im = m_im.data();
+
+            for(size_t k = 0; k < FrameSize; ++k)
+            {
+                re[k] = im[k] = 0.;
+            }
+
+            lobes(re, im);
+
+            m_fft.inverse(re, im);
+
+            // the second half of the previous frame is complete once the first half of this one is added.
+            sample_t* const output = m_output.data();
+            sample_t const* const synthesis = m_synthesis.data();
+
+            for(size_t j = 0; j < Hop; ++j)
+            {
+                output[j] = output[j + Hop];
+                output[j + Hop] = 0.;
+            }
+
+            for(size_t j = 0; j < 2 * Hop; ++j)
+            {
+                output[j] += re[(j - Hop) & mask] * synthesis[j];
+            }
+
+            m_position = 0;
+        }
+
+    private: // variables
+
+        //! @brief The number of bins of the main lobe of the window.
+        static const size_t LobeBins = 8;
+
+        //! @brief The number of points of the lobe table per bin.
+        static const size_t LobeOversampling = 256;
+
+        //! @brief The coefficients of the 4-term Blackman-Harris window (-92dB side lobes).
+        static constexpr double BlackmanHarris[4] = {0.35875, 0.48829, 0.14128, 0.01168};
+
+        Fft<sample_t>           m_fft;
+        std::vector<sample_t>   m_re;
+        std::vector<sample_t>   m_im;
+        std::vector<sample_t>   m_output;
+        std::vector<sample_t>   m_synthesis;
+        std::vector<sample_t>   m_lobe;
+        size_t                  m_position = Hop;
+    };
+
+    template<class SampleType>
+    constexpr double AdditiveFft<SampleType>::BlackmanHarris[4];
+}
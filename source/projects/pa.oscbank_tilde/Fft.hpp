@@ -0,0 +1,129 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                        FFT                                       //
+    // ================================================================================ //
+
+    //! @brief An in-place radix-2 complex FFT of a fixed power-of-two size.
+    //! @details Twiddle factors and the bit-reversal permutation are computed by the constructor
+    //! so the transforms don't allocate. Real and imaginary parts are stored in separate arrays.
+    template<class SampleType>
+    class Fft
+    {
+    public: // methods
+
+        using sample_t = SampleType;
+
+        //! @brief Constructor
+        //! @param size The size of the transform, must be a power of two.
+        explicit Fft(size_t size)
+        : m_size(size)
+        , m_cos(size / 2)
+        , m_sin(size / 2)
+        , m_reverse(size)
+        {
+            for(size_t i = 0; i < size / 2; ++i)
+            {
+                const double angle = 2. * M_PI * i / size;
+                m_cos[i] = cos(angle);
+                m_sin[i] = sin(angle);
+            }
+
+            size_t bits = 0;
+            while((size_t(1) << bits) < size) ++bits;
+
+            for(size_t i = 0; i < size; ++i)
+            {
+                size_t reversed = 0;
+                for(size_t b = 0; b < bits; ++b)
+                {
+                    reversed |= ((i >> b) & 1) << (bits - 1 - b);
+                }
+
+                m_reverse[i] = reversed;
+            }
+        }
+
+        //! @brief Returns the size of the transform.
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        //! @brief Inverse transform, without the 1/size normalization.
+        //! @details x[n] = sum(X[k] * exp(2i.pi.k.n / size))
+        void inverse(sample_t* re, sample_t* im) const
+        {
+            transform(re, im, sample_t(1.));
+        }
+
+        //! @brief Forward transform.
+        //! @details X[k] = sum(x[n] * exp(-2i.pi.k.n / size))
+        void forward(sample_t* re, sample_t* im) const
+        {
+            transform(re, im, sample_t(-1.));
+        }
+
+    private: // methods
+
+        void transform(sample_t* re, sample_t* im, sample_t sign) const
+        {
+            for(size_t i = 0; i < m_size; ++i)
+            {
+                const size_t j = m_reverse[i];
+                if(i < j)
+                {
+                    std::swap(re[i], re[j]);
+                    std::swap(im[i], im[j]);
+                }
+            }
+
+            for(size_t half = 1; half < m_size; half *= 2)
+            {
+                const size_t step = m_size / (2 * half);
+
+                for(size_t start = 0; start < m_size; start += 2 * half)
+                {
+                    for(size_t k = 0; k < half; ++k)
+                    {
+                        const sample_t wr = m_cos[k * step];
+                        const sample_t wi = sign * m_sin[k * step];
+
+                        const size_t a = start + k;
+                        const size_t b = a + half;
+
+                        const sample_t tr = re[b] * wr - im[b] * wi;
+                        const sample_t ti = re[b] * wi + im[b] * wr;
+
+                        re[b] = re[a] - tr;
+                        im[b] = im[a] - ti;
+                        re[a] += tr;
+                        im[a] += ti;
+                    }
+                }
+            }
+        }
+
+    private: // variables
+
+        size_t                  m_size;
+        std::vector<sample_t>   m_cos;
+        std::vector<sample_t>   m_sin;
+        std::vector<size_t>     m_reverse;
+    };
+}
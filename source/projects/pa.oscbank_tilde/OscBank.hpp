@@ -0,0 +1,850 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include "AdditiveFft.hpp"
+#include "Handoff.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                     OSC BANK                                     //
+    // ================================================================================ //
+
+    //! @brief A bank of cosine oscillators stored as a structure of arrays.
+    //! @details Phases, increments and amplitudes of all oscillators are stored in contiguous arrays
+    //! so that the same operation can be applied to several oscillators at once (SIMD).
+    //! Oscillators are processed by tiles that stay in the L1 cache for the whole vector,
+    //! and the cosine is computed with a branchless polynomial instead of a table lookup.
+    //! Banks of at least getCrossover() oscillators are synthesized by inverse FFT instead (see AdditiveFft).
+    //!
+    //! The oscillator arrays (State) and the optional worker threads (Workers) are built by
+    //! the message thread and handed to the audio thread with a Handoff,
+    //! so process() never locks, allocates nor frees:
+    //! - setFrequencies(), setAmplitudes(), setSampleRate(), setCrossover() and setThreads()
+    //!   publish new objects (message thread).
+    //! - update() adopts them and retires the previous ones (audio thread).
+    //! - reclaim() deletes the retired objects (message thread, eg. from a clock).
+    //! @tparam Lanes The number of oscillators processed together (the bank is padded to a multiple of it).
+    template<class SampleType, size_t Lanes = 8>
+    class OscBank
+    {
+    public: // methods
+
+        using sample_t = SampleType;
+
+        //! @brief Default constructor
+        OscBank() = default;
+
+        //! @brief Destructor
+        //! @details The audio thread must not use the bank anymore.
+        ~OscBank() = default;
+
+        //! @brief Set the current sampling rate (message thread)
+        //! @details You need to set a valid samplerate before calling any process method
+        void setSampleRate(sample_t samplerate)
+        {
+            m_sr = samplerate;
+            publishState();
+        }
+
+        //! @brief Set the frequency of each oscillator (message thread)
+        //! @details The number of frequencies sets the number of oscillators,
+        //! existing oscillators keep their phase, new ones start at 0.
+        void setFrequencies(sample_t const* freqs, size_t count)
+        {
+            m_frequencies.assign(freqs, freqs + count);
+            publishState();
+        }
+
+        //! @brief Set the amplitude of each oscillator (message thread)
+        //! @details Oscillators without an amplitude have an amplitude of 1.
+        void setAmplitudes(sample_t const* amplitudes, size_t count)
+        {
+            m_amplitudes.assign(amplitudes, amplitudes + count);
+            publishState();
+        }
+
+        //! @brief Set the number of oscillators from which the inverse FFT is used (message thread)
+        //! @details Defaults to DefaultCrossover, 0 never uses the inverse FFT (exact but slower for large banks).
+        void setCrossover(size_t count)
+        {
+            m_crossover = count;
+            publishState();
+        }
+
+        //! @brief Returns the number of oscillators from which the inverse FFT is used (message thread)
+        size_t getCrossover() const
+        {
+            return m_crossover;
+        }
+
+        //! @brief Set the number of worker threads (message thread)
+        //! @details With 0 (the default) the whole bank is processed by the audio thread,
+        //! otherwise the oscillators of a bank of at least 1024 oscillators (summed directly or by inverse FFT)
+        //! are split in chunks shared by the audio thread and the workers.
+        void setThreads(size_t count)
+        {
+            m_threads = (count < MaxThreads) ? count : MaxThreads;
+            m_workers.publish(new Workers(m_threads));
+        }
+
+        //! @brief Returns the number of worker threads (message thread)
+        size_t getThreads() const
+        {
+            return m_threads;
+        }
+
+        //! @brief Delete the objects retired by the audio thread, if any (message thread)
+        void reclaim()
+        {
+            m_states.reclaim();
+            m_workers.reclaim();
+        }
+
+        //! @brief Adopt the last published objects (audio thread)
+        //! @details The phases of the current State are copied to the new one.
+        //! Nothing is adopted while a worker that the audio thread didn't wait for is still rendering.
+        //! @return true if objects have been retired and need to be reclaimed.
+        bool update()
+        {
+            // a late worker may still read the current State (see Workers)
+            Workers const* const workers = m_workers.get();
+
+            if(workers != nullptr && workers->late())
+            {
+                return false;
+            }
+
+            const bool state_retired = m_states.update([](State& state, State const* previous) {
+                if(previous != nullptr)
+                {
+                    state.copyPhases(*previous);
+                }
+            });
+
+            const bool workers_retired = m_workers.update();
+
+            return state_retired || workers_retired;
+        }
+
+        //! @brief Returns the number of oscillators being processed (audio thread)
+        size_t size() const
+        {
+            State const* state = m_states.get();
+            return (state != nullptr) ? state->m_size : 0;
+        }
+
+        //! @brief Process a block of samples (audio thread)
+        //! @details Output the sum of all oscillators divided by the number of oscillators.
+        void process(sample_t* outs, long vecsize)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                outs[i] = 0.;
+            }
+
+            State* const state = m_states.get();
+
+            if(state == nullptr)
+            {
+                return;
+            }
+
+            if(state->m_inverse_fft)
+            {
+                // the frames of a previous inverse FFT period are not related to this one.
+                if(!m_inverse_fft_running)
+                {
+                    m_inverse_fft.reset();
+                }
+
+                Workers* const workers = m_workers.get();
+
+                if(parallel(workers, *state))
+                {
+                    m_inverse_fft.process(outs, vecsize, [this, workers, state](sample_t* re, sample_t* im) {
+                        workers->addLobes(m_inverse_fft, *state, re, im, m_values);
+                    });
+                }
+                else
+                {
+                    m_inverse_fft.process(state->m_phases.data(), state->m_increments.data(),
+                                          state->m_amplitudes.data(), state->m_size, outs, vecsize);
+                }
+            }
+            else
+            {
+                processDirect(*state, outs, vecsize);
+            }
+
+            m_inverse_fft_running = state->m_inverse_fft;
+
+            // the reciprocal of the oscillator count is computed once when the State is built.
+            const sample_t gain = state->m_gain;
+
+            for(long i = 0; i < vecsize; ++i)
+            {
+                outs[i] *= gain;
+            }
+        }
+
+        //! @brief Returns cos(2 * pi * phase) for a phase between 0. and 1.
+        //! @details Uses cos(2pi.p) = sin(2pi.t) with t = |p - 0.5| - 0.25 in [-0.25, 0.25]
+        //! and a minimax polynomial of sin on this range (max error 3.4e-9).
+        static inline sample_t cosine(sample_t phase)
+        {
+            const sample_t t = std::abs(phase - sample_t(0.5)) - sample_t(0.25);
+            const sample_t t2 = t * t;
+
+            return t * (sample_t(6.28318516008910202351)
+                        + t2 * (sample_t(-41.3416550313194068565)
+                                + t2 * (sample_t(81.6010040667254648028)
+                                        + t2 * (sample_t(-76.5497821338334169736)
+                                                + t2 * sample_t(39.5367047854199946330)))));
+        }
+
+    private: // constants
+
+        //! @brief The number of oscillators of a tile (their state fits in the L1 cache).
+        static const size_t TileSize = 256;
+
+        //! @brief Banks smaller than this are always processed by the audio thread only.
+        //! @details Summed directly, they cost about as much per block as their inverse FFT costs per frame.
+        static const size_t MinParallelSize = 4 * TileSize;
+
+        //! @brief The maximum number of worker threads.
+        static const size_t MaxThreads = 64;
+
+        //! @brief The default crossover, measured with pa.bench (see the readme).
+        //! @details From 128 oscillators on, the inverse FFT costs half as much as summing them directly
+        //! and its bursty frames no longer make the slowest vectors (p99) slower.
+        static const size_t DefaultCrossover = 128;
+
+        static_assert(TileSize % Lanes == 0, "TileSize must be a multiple of Lanes");
+
+    private: // classes
+
+        //! @brief The arrays of all the oscillators, only modified by the thread that owns it.
+        class State
+        {
+        public: // methods
+
+            //! @brief Build the oscillators, padded to a multiple of Lanes with silent ones.
+            //! @details Oscillators without an amplitude have an amplitude of 1.
+            State(sample_t const* freqs, size_t count,
+                  sample_t const* amplitudes, size_t amplitudes_count,
+                  sample_t samplerate, bool inverse_fft)
+            : m_size(count)
+            , m_gain(sample_t(1.) / ((count > 0) ? count : 1))
+            , m_inverse_fft(inverse_fft)
+            {
+                const size_t padded_size = ((count + Lanes - 1) / Lanes) * Lanes;
+
+                m_phases.resize(padded_size, 0.);
+                m_next.resize(padded_size, 0.);
+                m_increments.resize(padded_size, 0.);
+                m_amplitudes.resize(padded_size, 0.);
+
+                for(size_t i = 0; i < count; ++i)
+                {
+                    m_increments[i] = (samplerate > 0.) ? (freqs[i] / samplerate) : 0.;
+                    m_amplitudes[i] = (i < amplitudes_count) ? amplitudes[i] : 1.;
+                }
+            }
+
+            //! @brief Continue the phases of the oscillators of another State.
+            void copyPhases(State const& other)
+            {
+                const size_t count = (m_size < other.m_size) ? m_size : other.m_size;
+
+                for(size_t i = 0; i < count; ++i)
+                {
+                    m_phases[i] = other.m_phases[i];
+                }
+            }
+
+            //! @brief Move the phases a number of samples forward (audio thread).
+            //! @details The workers render from the phases without moving them (see Workers): once all the chunks are done,
+            //! the moved phases are written in the other buffer and the buffers are swapped,
+            //! so a late worker can still read the ones it started from.
+            void advance(sample_t samples)
+            {
+                const size_t padded_size = m_phases.size();
+
+                for(size_t j = 0; j < padded_size; ++j)
+                {
+                    sample_t phase = m_phases[j] + m_increments[j] * samples;
+                    phase -= static_cast<sample_t>(static_cast<int>(phase));
+                    phase += (phase < sample_t(0.)) ? sample_t(1.) : sample_t(0.);
+
+                    m_next[j] = phase;
+                }
+
+                m_phases.swap(m_next);
+            }
+
+            std::vector<sample_t>   m_phases;
+            std::vector<sample_t>   m_next;
+            std::vector<sample_t>   m_increments;
+            std::vector<sample_t>   m_amplitudes;
+
+            size_t                  m_size = 0;
+            sample_t                m_gain = 1.;
+
+            //! @brief Synthesize the oscillators by inverse FFT instead of summing them.
+            bool                    m_inverse_fft = false;
+        };
+
+        //! @brief A pool of worker threads that render chunks of oscillators.
+        //! @details For each block (or each frame of the inverse FFT), the audio thread describes the chunks then opens a new generation.
+        //! The audio thread and the workers claim chunks with a compare-and-swap on a single word
+        //! (generation | chunk count | next chunk) and render them into per-chunk buffers
+        //! (samples, or the lobes of a spectrum for the inverse FFT). The phases are only read, each chunk moves a copy of them.
+        //! The audio thread renders the chunks nobody else claimed, then waits for the workers at most twice the time
+        //! it took to render a chunk: it renders the chunks still not done (eg. a worker has been preempted) in its own buffers,
+        //! the first of the two renders to be done is kept. Once all of them are done, it sums the buffers in chunk order
+        //! and moves the phases of the State (see State::advance()).
+        //! A late worker still reads the job it started: until it's done, the audio thread renders the blocks alone (see late()).
+        //! The workers spin for a while after their last chunk, then park on a condition variable until the next generation.
+        class Workers
+        {
+        public: // methods
+
+            //! @brief Start count worker threads (each one pinned to a different core on linux).
+            explicit Workers(size_t count)
+            {
+                if(count == 0)
+                {
+                    return;
+                }
+
+                m_chunks = std::vector<Chunk>((count + 1) * ChunksPerThread);
+
+                const unsigned cores = std::thread::hardware_concurrency();
+
+                for(size_t i = 0; i < count; ++i)
+                {
+                    m_threads.emplace_back(&Workers::run, this);
+
+                    #if defined(__linux__)
+                    if(cores > 1)
+                    {
+                        // the audio thread is left alone on the first core.
+                        cpu_set_t cpuset;
+                        CPU_ZERO(&cpuset);
+                        CPU_SET((i + 1) % cores, &cpuset);
+                        pthread_setaffinity_np(m_threads.back().native_handle(), sizeof(cpu_set_t), &cpuset);
+                    }
+                    #else
+                    (void)cores;
+                    #endif
+                }
+            }
+
+            //! @brief Stop and join the worker threads (a late one finishes its chunk first).
+            ~Workers()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_quit.store(true, std::memory_order_relaxed);
+                }
+
+                m_wakeup.notify_all();
+
+                for(auto& thread : m_threads)
+                {
+                    thread.join();
+                }
+            }
+
+            Workers(Workers const&) = delete;
+            Workers& operator=(Workers const&) = delete;
+
+            //! @brief Returns the number of worker threads.
+            size_t size() const
+            {
+                return m_threads.size();
+            }
+
+            //! @brief Returns true while a worker renders a chunk that the audio thread didn't wait for (audio thread).
+            //! @details Its job, its State and the phases it reads must stay untouched until it's done.
+            bool late() const
+            {
+                return m_busy.load(std::memory_order_seq_cst) != 0;
+            }
+
+            //! @brief Add the output of all the oscillators of state to outs (audio thread).
+            void process(State& state, sample_t* outs, long vecsize, sample_t* values)
+            {
+                for(long offset = 0; offset < vecsize; offset += MaxBlockSize)
+                {
+                    const long blocksize = (vecsize - offset < MaxBlockSize) ? (vecsize - offset) : MaxBlockSize;
+                    sample_t* const block = outs + offset;
+
+                    if(late())
+                    {
+                        processTiles(state, block, blocksize, values);
+                        continue;
+                    }
+
+                    m_blocksize = blocksize;
+
+                    const size_t chunk_count = dispatch(&Workers::renderTiles, state, values);
+
+                    for(size_t k = 0; k < chunk_count; ++k)
+                    {
+                        sample_t const* chunk_outs = m_chunks[k].result();
+
+                        for(long i = 0; i < blocksize; ++i)
+                        {
+                            block[i] += chunk_outs[i];
+                        }
+                    }
+
+                    state.advance(sample_t(blocksize));
+                }
+            }
+
+            //! @brief Add the lobes of all the oscillators of state to the spectrum of a frame of an inverse FFT (audio thread).
+            void addLobes(AdditiveFft<sample_t> const& inverse_fft, State& state, sample_t* re, sample_t* im, sample_t* values)
+            {
+                const size_t bins = AdditiveFft<sample_t>::FrameSize;
+
+                if(late())
+                {
+                    inverse_fft.addLobes(state.m_phases.data(), state.m_increments.data(), state.m_amplitudes.data(),
+                                         0, state.m_phases.size(), re, im);
+                    return;
+                }
+
+                m_inverse_fft = &inverse_fft;
+
+                const size_t chunk_count = dispatch(&Workers::renderLobes, state, values);
+
+                for(size_t k = 0; k < chunk_count; ++k)
+                {
+                    sample_t const* chunk_re = m_chunks[k].result();
+                    sample_t const* chunk_im = chunk_re + bins;
+
+                    for(size_t i = 0; i < bins; ++i)
+                    {
+                        re[i] += chunk_re[i];
+                        im[i] += chunk_im[i];
+                    }
+                }
+
+                state.advance(sample_t(AdditiveFft<sample_t>::Hop));
+            }
+
+        private: // methods
+
+            //! @brief Split the oscillators of state in chunks of whole lanes.
+            //! @return The number of chunks.
+            size_t split(State& state)
+            {
+                const size_t lanes_count = state.m_phases.size() / Lanes;
+                const size_t chunk_count = (m_chunks.size() < lanes_count) ? m_chunks.size() : lanes_count;
+
+                for(size_t k = 0; k < chunk_count; ++k)
+                {
+                    m_chunks[k].m_begin = (lanes_count * k / chunk_count) * Lanes;
+                    m_chunks[k].m_end = (lanes_count * (k + 1) / chunk_count) * Lanes;
+                }
+
+                m_state = &state;
+                m_phases = state.m_phases.data();
+                return chunk_count;
+            }
+
+            //! @brief A task that renders a chunk into a buffer.
+            using Task = void (Workers::*)(size_t index, sample_t* outs, sample_t* values);
+
+            //! @brief Open a new generation of a task, render chunks until they are all claimed,
+            //! then wait for the workers to finish theirs and render the ones they are late for (audio thread).
+            //! @return The number of chunks.
+            size_t dispatch(Task task, State& state, sample_t* values)
+            {
+                const size_t chunk_count = split(state);
+
+                m_task = task;
+                m_generation = (m_generation + 1) & GenerationMask;
+
+                const uint64_t open = (m_generation << 2) | Chunk::Open;
+
+                for(size_t k = 0; k < chunk_count; ++k)
+                {
+                    m_chunks[k].m_status.store(open, std::memory_order_relaxed);
+                }
+
+                m_claim.store((m_generation << 32) | (uint64_t(chunk_count) << 16), std::memory_order_seq_cst);
+
+                // a worker that parks at the same time misses this generation, not the next one
+                if(m_sleepers.load(std::memory_order_seq_cst) > 0)
+                {
+                    m_wakeup.notify_all();
+                }
+
+                clock::time_point start = clock::now();
+
+                while(work(values))
+                {
+                    const clock::time_point end = clock::now();
+                    m_chunk_time = end - start;
+                    start = end;
+                }
+
+                const clock::time_point deadline = clock::now() + 2 * m_chunk_time;
+
+                for(size_t k = 0; k < chunk_count; ++k)
+                {
+                    Chunk& chunk = m_chunks[k];
+
+                    while(chunk.m_status.load(std::memory_order_acquire) == open)
+                    {
+                        if(clock::now() < deadline)
+                        {
+                            relax();
+                            continue;
+                        }
+
+                        // the worker is late: the audio thread renders the chunk too, in its own buffer
+                        (this->*task)(k, chunk.m_outs[1], values);
+
+                        uint64_t expected = open;
+                        chunk.m_status.compare_exchange_strong(expected, open | Chunk::Taken, std::memory_order_acq_rel);
+                    }
+                }
+
+                return chunk_count;
+            }
+
+            //! @brief Render the samples of the oscillators of a chunk, their phases are moved in a copy.
+            void renderTiles(size_t index, sample_t* outs, sample_t* values)
+            {
+                Chunk const& chunk = m_chunks[index];
+                State const& state = *m_state;
+                sample_t phases[TileSize];
+
+                for(long i = 0; i < m_blocksize; ++i)
+                {
+                    outs[i] = 0.;
+                }
+
+                for(size_t tile = chunk.m_begin; tile < chunk.m_end; tile += TileSize)
+                {
+                    const size_t count = (tile + TileSize < chunk.m_end) ? TileSize : (chunk.m_end - tile);
+
+                    std::copy(m_phases + tile, m_phases + tile + count, phases);
+                    processTile(phases, state.m_increments.data() + tile, state.m_amplitudes.data() + tile,
+                                count, outs, m_blocksize, values);
+                }
+            }
+
+            //! @brief Render the lobes of the oscillators of a chunk: the real parts then the imaginary parts of a spectrum.
+            void renderLobes(size_t index, sample_t* outs, sample_t*)
+            {
+                Chunk const& chunk = m_chunks[index];
+                State const& state = *m_state;
+                const size_t bins = AdditiveFft<sample_t>::FrameSize;
+                sample_t phases[TileSize];
+
+                for(size_t i = 0; i < 2 * bins; ++i)
+                {
+                    outs[i] = 0.;
+                }
+
+                for(size_t tile = chunk.m_begin; tile < chunk.m_end; tile += TileSize)
+                {
+                    const size_t count = (tile + TileSize < chunk.m_end) ? TileSize : (chunk.m_end - tile);
+
+                    std::copy(m_phases + tile, m_phases + tile + count, phases);
+                    m_inverse_fft->addLobes(phases, state.m_increments.data() + tile, state.m_amplitudes.data() + tile,
+                                            0, count, outs, outs + bins);
+                }
+            }
+
+            //! @brief Claim and render one chunk of the current generation.
+            //! @return false if there is no chunk left.
+            bool work(sample_t* values)
+            {
+                uint64_t claim = m_claim.load(std::memory_order_acquire);
+
+                for(;;)
+                {
+                    const uint64_t chunk_count = (claim >> 16) & 0xffff;
+                    const uint64_t index = claim & 0xffff;
+
+                    if(index >= chunk_count)
+                    {
+                        return false;
+                    }
+
+                    if(m_claim.compare_exchange_weak(claim, claim + 1,
+                                                     std::memory_order_acq_rel, std::memory_order_acquire))
+                    {
+                        Chunk& chunk = m_chunks[index];
+                        const uint64_t open = ((claim >> 32) << 2) | Chunk::Open;
+
+                        // counted before the status is checked: once the audio thread sees no busy thread,
+                        // a thread that starts late sees that its chunk has been taken over and leaves the job untouched.
+                        m_busy.fetch_add(1, std::memory_order_seq_cst);
+
+                        if(chunk.m_status.load(std::memory_order_seq_cst) == open)
+                        {
+                            (this->*m_task)(size_t(index), chunk.m_outs[0], values);
+
+                            uint64_t expected = open;
+                            chunk.m_status.compare_exchange_strong(expected, open | Chunk::Claimed, std::memory_order_acq_rel);
+                        }
+
+                        m_busy.fetch_sub(1, std::memory_order_release);
+                        return true;
+                    }
+                }
+            }
+
+            //! @brief Returns true if a generation has chunks left to claim or the threads are stopped.
+            bool pending() const
+            {
+                const uint64_t claim = m_claim.load(std::memory_order_seq_cst);
+                return (claim & 0xffff) < ((claim >> 16) & 0xffff) || m_quit.load(std::memory_order_relaxed);
+            }
+
+            //! @brief The worker thread loop: spin for a while when there is nothing to do, then park until the next generation.
+            void run()
+            {
+                sample_t values[TileSize];
+                size_t idle = 0;
+
+                while(!m_quit.load(std::memory_order_relaxed))
+                {
+                    if(work(values))
+                    {
+                        idle = 0;
+                    }
+                    else if(++idle < SpinCount)
+                    {
+                        relax();
+                    }
+                    else
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+
+                        m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+                        m_wakeup.wait(lock, [this] { return pending(); });
+                        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+                        idle = 0;
+                    }
+                }
+            }
+
+            static inline void relax()
+            {
+                #if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+                _mm_pause();
+                #elif defined(__aarch64__)
+                __asm__ __volatile__("yield");
+                #endif
+            }
+
+        private: // variables
+
+            //! @brief The number of chunks per thread (small chunks balance the load between threads).
+            static const size_t ChunksPerThread = 4;
+
+            //! @brief The number of samples rendered per generation.
+            static const long MaxBlockSize = 512;
+
+            //! @brief The size of the buffer of a chunk: a block of samples or a spectrum of the inverse FFT.
+            static const size_t BufferSize = 2 * AdditiveFft<sample_t>::FrameSize;
+
+            static_assert(BufferSize >= size_t(MaxBlockSize), "a chunk must hold a block of samples");
+
+            //! @brief The number of times an idle worker polls for a chunk before it parks.
+            static const size_t SpinCount = 4096;
+
+            static const uint64_t GenerationMask = 0xffffffff;
+
+            //! @brief The renders of a chunk: the one of the thread that claimed it and the one of the audio thread if it was late.
+            //! @details The status is the generation and the render that is done first (Open until then).
+            struct Chunk
+            {
+                enum Render : uint64_t { Open = 0, Claimed = 1, Taken = 2 };
+
+                //! @brief Returns the buffer of the render that is done (audio thread).
+                sample_t const* result() const
+                {
+                    return m_outs[(m_status.load(std::memory_order_acquire) & 3) == Taken];
+                }
+
+                size_t                  m_begin = 0;
+                size_t                  m_end = 0;
+                std::atomic<uint64_t>   m_status {0};
+                sample_t                m_outs[2][BufferSize];
+            };
+
+            std::vector<Chunk>          m_chunks;
+            std::vector<std::thread>    m_threads;
+
+            // the job, written by the audio thread before a new generation is opened
+            Task                        m_task = nullptr;
+            State const*                m_state = nullptr;
+            sample_t const*             m_phases = nullptr;
+            AdditiveFft<sample_t> const* m_inverse_fft = nullptr;
+            long                        m_blocksize = 0;
+            uint64_t                    m_generation = 0;
+
+            using clock = std::chrono::steady_clock;
+
+            // audio thread: the time it took to render its last chunk
+            clock::duration             m_chunk_time = std::chrono::milliseconds(1);
+
+            std::atomic<uint64_t>       m_claim {0};
+            std::atomic<size_t>         m_busy {0};
+            std::atomic<bool>           m_quit {false};
+
+            // the parked workers
+            std::mutex                  m_mutex;
+            std::condition_variable     m_wakeup;
+            std::atomic<size_t>         m_sleepers {0};
+        };
+
+    private: // methods
+
+        //! @brief Build a new State from the parameters of the message thread and publish it.
+        void publishState()
+        {
+            const size_t count = m_frequencies.size();
+
+            m_states.publish(new State(m_frequencies.data(), count,
+                                       m_amplitudes.data(), m_amplitudes.size(),
+                                       m_sr, m_crossover > 0 && count >= m_crossover));
+        }
+
+        //! @brief Returns true if the oscillators of state are split between the audio thread and the workers.
+        static bool parallel(Workers const* workers, State const& state)
+        {
+            return workers != nullptr && workers->size() > 0 && state.m_phases.size() >= MinParallelSize;
+        }
+
+        //! @brief Add the output of all the oscillators to outs, with the worker threads if any.
+        void processDirect(State& state, sample_t* outs, long vecsize)
+        {
+            Workers* const workers = m_workers.get();
+
+            if(parallel(workers, state))
+            {
+                workers->process(state, outs, vecsize, m_values);
+            }
+            else
+            {
+                processTiles(state, outs, vecsize, m_values);
+            }
+        }
+
+        //! @brief Add the output of all the oscillators to outs, tile by tile (one thread).
+        static void processTiles(State& state, sample_t* outs, long vecsize, sample_t* values)
+        {
+            const size_t padded_size = state.m_phases.size();
+
+            for(size_t tile = 0; tile < padded_size; tile += TileSize)
+            {
+                const size_t count = (tile + TileSize < padded_size) ? TileSize : (padded_size - tile);
+
+                processTile(state.m_phases.data() + tile, state.m_increments.data() + tile, state.m_amplitudes.data() + tile,
+                            count, outs, vecsize, values);
+            }
+        }
+
+        //! @brief Add the output of count oscillators (a multiple of Lanes, at most TileSize) to outs, and move their phases.
+        //! @details For each sample, all the oscillators of the tile are first computed into values
+        //! (one independent operation per oscillator, vectorized by the compiler)
+        //! then summed with Lanes partial sums (floating-point sums can't be reordered by the compiler).
+        static void processTile(sample_t* phases, sample_t const* increments, sample_t const* amplitudes, size_t count,
+                                sample_t* outs, long vecsize, sample_t* values)
+        {
+
+            for(long i = 0; i < vecsize; ++i)
+            {
+                for(size_t j = 0; j < count; ++j)
+                {
+                    sample_t phase = phases[j];
+
+                    values[j] = amplitudes[j] * cosine(phase);
+
+                    // increment then wrap phase between 0. and 1. without branches
+                    // (the increment is in ]-1, 1[ so the integral part is 0 or 1).
+                    phase += increments[j];
+                    phase -= static_cast<sample_t>(static_cast<int>(phase));
+                    phase += (phase < sample_t(0.)) ? sample_t(1.) : sample_t(0.);
+
+                    phases[j] = phase;
+                }
+
+                sample_t acc[Lanes] = {};
+
+                for(size_t j = 0; j < count; j += Lanes)
+                {
+                    for(size_t k = 0; k < Lanes; ++k)
+                    {
+                        acc[k] += values[j+k];
+                    }
+                }
+
+                sample_t sum = 0.;
+                for(size_t k = 0; k < Lanes; ++k)
+                {
+                    sum += acc[k];
+                }
+
+                outs[i] += sum;
+            }
+        }
+
+    private: // variables
+
+        // message thread
+        std::vector<sample_t>   m_frequencies;
+        std::vector<sample_t>   m_amplitudes;
+        sample_t                m_sr = 0.;
+        size_t                  m_crossover = DefaultCrossover;
+        size_t                  m_threads = 0;
+
+        // handoff between the message thread and the audio thread
+        Handoff<State>          m_states;
+
+        // audio thread
+        sample_t                m_values[TileSize];
+        AdditiveFft<sample_t>   m_inverse_fft;
+        bool                    m_inverse_fft_running = false;
+
+        // destroyed first: the workers are joined while the States and the inverse FFT they read still exist
+        Handoff<Workers>        m_workers;
+    };
+}
@@ -11,8 +11,8 @@
 #include "c74_msp.h"
 using namespace c74::max;
 
-#include "Osc.hpp"
-using paccpp::Osc;
+#include "OscBank.hpp"
+using paccpp::OscBank;
 
 #include <vector>
 
@@ -22,67 +22,81 @@ struct t_pa_oscbank_tilde
 {
     t_pxobject  m_obj;
     
-    // store a vector of Osc pointers
-    std::vector<Osc<double>*> m_oscbank;
+    // store an OscBank pointer
+    OscBank<double>* m_oscbank;
+    
+    // deletes the oscillators replaced by the audio thread
+    t_clock*    m_clock;
 };
 
+void pa_oscbank_tilde_reclaim(t_pa_oscbank_tilde* x)
+{
+    x->m_oscbank->reclaim();
+}
+
 void pa_oscbank_tilde_list(t_pa_oscbank_tilde* x, t_symbol* s, int argc, t_atom* argv)
 {
-    float sr = sys_getsr();
-    
-    // reserve space for new oscillators in the vector
-    x->m_oscbank.reserve(argc);
+    std::vector<double> freqs(argc, 0.);
     
     for(int i = 0; i < argc; ++i)
     {
-        // allocate a new Osc object if needed
-        if(x->m_oscbank.size() <= i)
-        {
-            x->m_oscbank.push_back(new Osc<double>());
-            x->m_oscbank[i]->setSampleRate(sr);
-        }
-        
         if(atom_gettype(argv+i) == A_FLOAT || atom_gettype(argv+i) == A_LONG)
         {
-            x->m_oscbank[i]->setFrequency(atom_getfloat(argv+i));
+            freqs[i] = atom_getfloat(argv+i);
         }
         else
         {
-            x->m_oscbank[i]->setFrequency(0.);
             object_error((t_object*)x, "bad frequency for osc %i, reset to 0Hz", i);
         }
     }
     
-    // delete all useless pointers and remove them from the vector
-    if(x->m_oscbank.size() > argc)
+    // the new oscillators are built here and handed to the audio thread without locking.
+    x->m_oscbank->setFrequencies(freqs.data(), freqs.size());
+}
+
+void pa_oscbank_tilde_set_amplitudes(t_pa_oscbank_tilde* x, t_symbol* s, int argc, t_atom* argv)
+{
+    std::vector<double> amplitudes(argc, 1.);
+    
+    for(int i = 0; i < argc; ++i)
     {
-        for(int i = argc; i < x->m_oscbank.size(); ++i)
+        if(atom_gettype(argv+i) == A_FLOAT || atom_gettype(argv+i) == A_LONG)
         {
-            delete x->m_oscbank[i];
+            amplitudes[i] = atom_getfloat(argv+i);
+        }
+        else
+        {
+            object_error((t_object*)x, "bad amplitude for osc %i, reset to 1", i);
         }
-        
-        x->m_oscbank.erase(x->m_oscbank.begin()+argc, x->m_oscbank.end());
     }
+    
+    x->m_oscbank->setAmplitudes(amplitudes.data(), amplitudes.size());
+}
+
+void pa_oscbank_tilde_set_crossover(t_pa_oscbank_tilde* x, long count)
+{
+    // banks of at least count oscillators are synthesized by inverse FFT, 0 means never
+    x->m_oscbank->setCrossover(count > 0 ? count : 0);
+}
+
+void pa_oscbank_tilde_set_threads(t_pa_oscbank_tilde* x, long count)
+{
+    // 0 means that the audio thread processes all the oscillators
+    x->m_oscbank->setThreads(count > 0 ? count : 0);
 }
 
 void pa_oscbank_tilde_perform64(t_pa_oscbank_tilde* x, t_object* dsp64,
                                        double** ins, long numins, double** outs, long numouts,
                                        long vecsize, long flags, void* userparam)
 {
-    double* outputs = outs[0];
-    const size_t osc_count = (!x->m_oscbank.empty()) ? x->m_oscbank.size() : 1ul;
-    
-    while(vecsize--)
+    // adopt the last oscillators sent by the list method,
+    // the previous ones can't be deleted in the audio thread so we defer it to the clock.
+    if(x->m_oscbank->update())
     {
-        double out = 0.f;
-        
-        for(Osc<double>* osc : x->m_oscbank)
-        {
-            out += osc->process();
-        }
-        
-        *outputs++ = out / osc_count;
+        clock_delay(x->m_clock, 0);
     }
+    
+    x->m_oscbank->process(outs[0], vecsize);
 }
 
 
@@ -90,12 +104,7 @@ void pa_oscbank_tilde_dsp64(t_pa_oscbank_tilde* x, t_object* dsp64, short* count
                              double samplerate, long maxvectorsize, long flags)
 {
     // set samplerate of all oscillators
-    const float sr = sys_getsr();
-    
-    for(Osc<double>* osc : x->m_oscbank)
-    {
-        osc->setSampleRate(sr);
-    }
+    x->m_oscbank->setSampleRate(sys_getsr());
     
     object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
                          dsp64, gensym("dsp_add64"), (t_object*)x,
@@ -107,7 +116,7 @@ void pa_oscbank_tilde_assist(t_pa_oscbank_tilde* x, void* unused,
 {
     if(io == ASSIST_INLET)
     {
-        strncpy(string_dest, "(list) list of floats sets osc frequencies", ASSIST_STRING_MAXSIZE);
+        strncpy(string_dest, "(list) osc frequencies, (amplitudes) osc amplitudes, (crossover) number of osc from which inverse FFT is used (default 128, 0: off), (threads) number of worker threads", ASSIST_STRING_MAXSIZE);
     }
     else if(io == ASSIST_OUTLET)
     {
@@ -121,6 +130,19 @@ void* pa_oscbank_tilde_new(t_symbol *name, long argc, t_atom *argv)
     
     if(x)
     {
+        // instantiate a new OscBank object
+        // Note: dont forget to delete it in the free method !
+        x->m_oscbank = new OscBank<double>();
+        x->m_oscbank->setSampleRate(sys_getsr());
+        
+        x->m_clock = clock_new(x, (method)pa_oscbank_tilde_reclaim);
+        
+        // first argument sets the number of worker threads (0 by default)
+        if(argc >= 1 && (atom_gettype(argv) == A_FLOAT || atom_gettype(argv) == A_LONG))
+        {
+            pa_oscbank_tilde_set_threads(x, atom_getlong(argv));
+        }
+        
         outlet_new(x, "signal");
     }
     
@@ -131,14 +153,11 @@ void pa_oscbank_tilde_free(t_pa_oscbank_tilde* x)
 {
     dsp_free((t_pxobject*)x);
     
-    // free the memory allocated for each Osc objects of the vector
-    for(Osc<double>* osc : x->m_oscbank)
-    {
-        delete osc;
-    }
+    // get rid of the clock
+    freeobject(x->m_clock);
     
-    // then clear the vector
-    x->m_oscbank.clear();
+    // free the memory for the OscBank object
+    delete x->m_oscbank;
 }
 
 void ext_main(void* r)
@@ -149,6 +168,9 @@ void ext_main(void* r)
     class_addmethod(this_class, (method)pa_oscbank_tilde_assist,     "assist",   A_CANT,		0);
     class_addmethod(this_class, (method)pa_oscbank_tilde_dsp64,      "dsp64",    A_CANT,		0);
     class_addmethod(this_class, (method)pa_oscbank_tilde_list,       "list",     A_GIMME,       0);
+    class_addmethod(this_class, (method)pa_oscbank_tilde_set_amplitudes, "amplitudes", A_GIMME,   0);
+    class_addmethod(this_class, (method)pa_oscbank_tilde_set_crossover,  "crossover",  A_LONG,    0);
+    class_addmethod(this_class, (method)pa_oscbank_tilde_set_threads,    "threads",    A_LONG,    0);
     
     class_dspinit(this_class);
     class_register(CLASS_BOX, this_class);
@@ -5,6 +5,7 @@
  */
 
 #include "Phasor.hpp"
+#include "Wavetable.hpp"
 
 #include <array>
 
@@ -13,76 +14,411 @@
 
 namespace paccpp
 {
+    // ================================================================================ //
+    //                                   INTERPOLATION                                  //
+    // ================================================================================ //
+    
+    //! @brief Reads the nearest point of a table.
+    struct InterpolationNone
+    {
+        template<class T>
+        static inline T read(T const* table, size_t idx, T delta)
+        {
+            return (delta < T(0.5)) ? table[idx] : table[idx+1];
+        }
+    };
+    
+    //! @brief Linear interpolation between two points of a table.
+    struct InterpolationLinear
+    {
+        template<class T>
+        static inline T read(T const* table, size_t idx, T delta)
+        {
+            const T y1 = table[idx];
+            return y1 + delta * (table[idx+1] - y1);
+        }
+    };
+    
+    //! @brief Cubic (4-point Hermite) interpolation between two points of a table.
+    struct InterpolationCubic
+    {
+        template<class T>
+        static inline T read(T const* table, size_t idx, T delta)
+        {
+            const T y0 = table[idx-1];
+            const T y1 = table[idx];
+            const T y2 = table[idx+1];
+            const T y3 = table[idx+2];
+            
+            const T c1 = T(0.5) * (y2 - y0);
+            const T c2 = y0 - T(2.5) * y1 + T(2.) * y2 - T(0.5) * y3;
+            const T c3 = T(0.5) * (y3 - y0) + T(1.5) * (y1 - y2);
+            
+            return ((c3 * delta + c2) * delta + c1) * delta + y1;
+        }
+    };
+    
+    // ================================================================================ //
+    //                                   TABLE KERNELS                                  //
+    // ================================================================================ //
+    
+    namespace simd
+    {
+        //! @brief outs[i] = the table read at phases[i] (in [0, 1[) with an Interpolation.
+        //! @details table points to the first point of the period, size is the number of points of the period.
+        template<class Interpolation, class T>
+        inline void readTable(Interpolation, T const* table, size_t size, T const* phases, T* outs, long vecsize)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const T phase = phases[i] * size;
+                const size_t idx = static_cast<size_t>(phase);
+                outs[i] = Interpolation::read(table, idx, phase - idx);
+            }
+        }
+        
+        //! @brief outs[i] = the table read at a phase incremented by freqs[i] * scale, returns the next phase.
+        template<class Interpolation, class T>
+        inline T oscillate(Interpolation, T const* table, size_t size, T phase,
+                           T const* freqs, T scale, T* outs, long vecsize)
+        {
+            phase = accumulatePhase(phase, freqs, scale, outs, vecsize);
+            readTable(Interpolation(), table, size, outs, outs, vecsize);
+            return phase;
+        }
+        
+        //! @brief outs[i] = the table read at phase + i * inc, returns the next phase.
+        template<class Interpolation, class T>
+        inline T oscillate(Interpolation, T const* table, size_t size, T phase, T inc, T* outs, long vecsize)
+        {
+            phase = rampPhase(phase, inc, outs, vecsize);
+            readTable(Interpolation(), table, size, outs, outs, vecsize);
+            return phase;
+        }
+        
+        #if defined(__AVX2__)
+        
+        //! @brief Linear interpolation of 4 points at once with gathers.
+        inline void readTable(InterpolationLinear, double const* table, size_t size,
+                              double const* phases, double* outs, long vecsize)
+        {
+            const __m256d vsize = _mm256_set1_pd(double(size));
+            long i = 0;
+            
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                const __m256d phase = _mm256_mul_pd(_mm256_loadu_pd(phases + i), vsize);
+                const __m128i idx = _mm256_cvttpd_epi32(phase);
+                const __m256d delta = _mm256_sub_pd(phase, _mm256_cvtepi32_pd(idx));
+                
+                const __m256d y1 = _mm256_i32gather_pd(table, idx, 8);
+                const __m256d y2 = _mm256_i32gather_pd(table + 1, idx, 8);
+                
+                _mm256_storeu_pd(outs + i, _mm256_add_pd(y1, _mm256_mul_pd(delta, _mm256_sub_pd(y2, y1))));
+            }
+            
+            readTable<InterpolationLinear, double>(InterpolationLinear(), table, size, phases + i, outs + i, vecsize - i);
+        }
+        
+        //! @brief Linear interpolation of 4 positions (in points, not wrapped).
+        //! @details Adding 1.5 * 2^52 to position - 0.5 leaves floor(position) in the low bits of the mantissa
+        //! (two's complement), so masking them wraps the index for free (size is a power of two).
+        //! On ties the index is one point lower with delta = 1, which reads the same value.
+        inline __m256d readPositions(double const* table, __m256i mask, __m256d position)
+        {
+            const __m256d magic = _mm256_set1_pd(6755399441055744.);
+            const __m256d rounded = _mm256_add_pd(_mm256_sub_pd(position, _mm256_set1_pd(0.5)), magic);
+            const __m256d delta = _mm256_sub_pd(position, _mm256_sub_pd(rounded, magic));
+            const __m256i idx = _mm256_and_si256(_mm256_castpd_si256(rounded), mask);
+            
+            const __m256d y1 = _mm256_i64gather_pd(table, idx, 8);
+            const __m256d y2 = _mm256_i64gather_pd(table + 1, idx, 8);
+            
+            return _mm256_add_pd(y1, _mm256_mul_pd(delta, _mm256_sub_pd(y2, y1)));
+        }
+        
+        //! @brief Phase accumulation and table reading in one pass.
+        //! @details The phase is accumulated in points and is never wrapped per sample,
+        //! readPositions() wraps the indices.
+        inline double oscillate(InterpolationLinear, double const* table, size_t size, double phase,
+                                double const* freqs, double scale, double* outs, long vecsize)
+        {
+            const __m256d vscale = _mm256_set1_pd(scale * size);
+            const __m256d vsize = _mm256_set1_pd(double(size));
+            const __m256d vsize_inv = _mm256_set1_pd(1. / size);
+            const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(size - 1));
+            const __m256d zero = _mm256_setzero_pd();
+            __m256d carry = _mm256_set1_pd(phase * size);
+            long i = 0;
+            
+            for(; i + 8 <= vecsize; i += 8)
+            {
+                __m256d sum_0 = _mm256_mul_pd(_mm256_loadu_pd(freqs + i), vscale);
+                __m256d sum_1 = _mm256_mul_pd(_mm256_loadu_pd(freqs + i + 4), vscale);
+                
+                // exclusive prefix sums [0, a, a+b, a+b+c] and the totals
+                sum_0 = _mm256_add_pd(sum_0, _mm256_blend_pd(_mm256_permute4x64_pd(sum_0, 0x90), zero, 0x1));
+                sum_1 = _mm256_add_pd(sum_1, _mm256_blend_pd(_mm256_permute4x64_pd(sum_1, 0x90), zero, 0x1));
+                sum_0 = _mm256_add_pd(sum_0, _mm256_permute2f128_pd(sum_0, sum_0, 0x08));
+                sum_1 = _mm256_add_pd(sum_1, _mm256_permute2f128_pd(sum_1, sum_1, 0x08));
+                
+                const __m256d total_0 = _mm256_permute4x64_pd(sum_0, 0xff);
+                const __m256d total_1 = _mm256_permute4x64_pd(sum_1, 0xff);
+                const __m256d before_0 = _mm256_blend_pd(_mm256_permute4x64_pd(sum_0, 0x90), zero, 0x1);
+                const __m256d before_1 = _mm256_blend_pd(_mm256_permute4x64_pd(sum_1, 0x90), zero, 0x1);
+                
+                _mm256_storeu_pd(outs + i, readPositions(table, mask, _mm256_add_pd(carry, before_0)));
+                _mm256_storeu_pd(outs + i + 4, readPositions(table, mask, _mm256_add_pd(carry, _mm256_add_pd(total_0, before_1))));
+                
+                carry = _mm256_add_pd(carry, _mm256_add_pd(total_0, total_1));
+                if((i & 31) == 24) carry = _mm256_mul_pd(wrapPhase(_mm256_mul_pd(carry, vsize_inv)), vsize);
+            }
+            
+            phase = wrapPhase(_mm256_cvtsd_f64(carry) / size);
+            return oscillate<InterpolationLinear, double>(InterpolationLinear(), table, size, phase,
+                                                          freqs + i, scale, outs + i, vecsize - i);
+        }
+        
+        inline double oscillate(InterpolationLinear, double const* table, size_t size, double phase,
+                                double inc, double* outs, long vecsize)
+        {
+            const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(size - 1));
+            const __m256d vphase = _mm256_set1_pd(phase * size);
+            const __m256d vinc = _mm256_set1_pd(inc * size);
+            const __m256d step = _mm256_set1_pd(4.);
+            __m256d index = _mm256_set_pd(3., 2., 1., 0.);
+            long i = 0;
+            
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                _mm256_storeu_pd(outs + i, readPositions(table, mask, _mm256_add_pd(vphase, _mm256_mul_pd(index, vinc))));
+                index = _mm256_add_pd(index, step);
+            }
+            
+            phase = wrapPhase(phase + double(i) * inc);
+            return oscillate<InterpolationLinear, double>(InterpolationLinear(), table, size, phase,
+                                                          inc, outs + i, vecsize - i);
+        }
+        
+        #elif defined(__SSE2__) || defined(_M_X64)
+        
+        //! @brief Linear interpolation of 2 points at once (each lane loads its 2 adjacent points).
+        inline void readTable(InterpolationLinear, double const* table, size_t size,
+                              double const* phases, double* outs, long vecsize)
+        {
+            const __m128d vsize = _mm_set1_pd(double(size));
+            long i = 0;
+            
+            for(; i + 2 <= vecsize; i += 2)
+            {
+                const __m128d phase = _mm_mul_pd(_mm_loadu_pd(phases + i), vsize);
+                const __m128i idx = _mm_cvttpd_epi32(phase);
+                const __m128d delta = _mm_sub_pd(phase, _mm_cvtepi32_pd(idx));
+                
+                const __m128d points_0 = _mm_loadu_pd(table + _mm_cvtsi128_si32(idx));
+                const __m128d points_1 = _mm_loadu_pd(table + _mm_cvtsi128_si32(_mm_shuffle_epi32(idx, 0x55)));
+                
+                const __m128d y1 = _mm_unpacklo_pd(points_0, points_1);
+                const __m128d y2 = _mm_unpackhi_pd(points_0, points_1);
+                
+                _mm_storeu_pd(outs + i, _mm_add_pd(y1, _mm_mul_pd(delta, _mm_sub_pd(y2, y1))));
+            }
+            
+            readTable<InterpolationLinear, double>(InterpolationLinear(), table, size, phases + i, outs + i, vecsize - i);
+        }
+        
+        //! @brief Linear interpolation of 2 positions (in points, not wrapped).
+        //! @details Adding 1.5 * 2^52 to position - 0.5 leaves floor(position) in the low bits of the mantissa
+        //! (two's complement), so masking them wraps the index for free (size is a power of two).
+        //! On ties the index is one point lower with delta = 1, which reads the same value.
+        inline __m128d readPositions(double const* table, __m128i mask, __m128d position)
+        {
+            const __m128d magic = _mm_set1_pd(6755399441055744.);
+            const __m128d rounded = _mm_add_pd(_mm_sub_pd(position, _mm_set1_pd(0.5)), magic);
+            const __m128d delta = _mm_sub_pd(position, _mm_sub_pd(rounded, magic));
+            const __m128i idx = _mm_and_si128(_mm_castpd_si128(rounded), mask);
+            
+            const __m128d points_0 = _mm_loadu_pd(table + _mm_cvtsi128_si32(idx));
+            const __m128d points_1 = _mm_loadu_pd(table + _mm_cvtsi128_si32(_mm_unpackhi_epi64(idx, idx)));
+            
+            const __m128d y1 = _mm_unpacklo_pd(points_0, points_1);
+            const __m128d y2 = _mm_unpackhi_pd(points_0, points_1);
+            
+            return _mm_add_pd(y1, _mm_mul_pd(delta, _mm_sub_pd(y2, y1)));
+        }
+        
+        //! @brief Phase accumulation and table reading in one pass.
+        //! @details The phase is accumulated in points and is never wrapped per sample,
+        //! readPositions() wraps the indices.
+        inline double oscillate(InterpolationLinear, double const* table, size_t size, double phase,
+                                double const* freqs, double scale, double* outs, long vecsize)
+        {
+            const __m128d vscale = _mm_set1_pd(scale * size);
+            const __m128d vsize = _mm_set1_pd(double(size));
+            const __m128d vsize_inv = _mm_set1_pd(1. / size);
+            const __m128i mask = _mm_set1_epi32(static_cast<int>(size - 1));
+            __m128d carry = _mm_set1_pd(phase * size);
+            long i = 0;
+            
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                const __m128d inc_0 = _mm_mul_pd(_mm_loadu_pd(freqs + i), vscale);
+                const __m128d inc_1 = _mm_mul_pd(_mm_loadu_pd(freqs + i + 2), vscale);
+                
+                const __m128d before_0 = _mm_unpacklo_pd(_mm_setzero_pd(), inc_0);
+                const __m128d before_1 = _mm_unpacklo_pd(_mm_setzero_pd(), inc_1);
+                const __m128d total_0 = _mm_add_pd(inc_0, _mm_shuffle_pd(inc_0, inc_0, 0x1));
+                const __m128d total_1 = _mm_add_pd(inc_1, _mm_shuffle_pd(inc_1, inc_1, 0x1));
+                
+                _mm_storeu_pd(outs + i, readPositions(table, mask, _mm_add_pd(carry, before_0)));
+                _mm_storeu_pd(outs + i + 2, readPositions(table, mask, _mm_add_pd(carry, _mm_add_pd(total_0, before_1))));
+                
+                carry = _mm_add_pd(carry, _mm_add_pd(total_0, total_1));
+                if((i & 31) == 28) carry = _mm_mul_pd(wrapPhase(_mm_mul_pd(carry, vsize_inv)), vsize);
+            }
+            
+            phase = wrapPhase(_mm_cvtsd_f64(carry) / size);
+            return oscillate<InterpolationLinear, double>(InterpolationLinear(), table, size, phase,
+                                                          freqs + i, scale, outs + i, vecsize - i);
+        }
+        
+        inline double oscillate(InterpolationLinear, double const* table, size_t size, double phase,
+                                double inc, double* outs, long vecsize)
+        {
+            const __m128i mask = _mm_set1_epi32(static_cast<int>(size - 1));
+            const __m128d vphase = _mm_set1_pd(phase * size);
+            const __m128d vinc = _mm_set1_pd(inc * size);
+            const __m128d step = _mm_set1_pd(2.);
+            __m128d index = _mm_set_pd(1., 0.);
+            long i = 0;
+            
+            for(; i + 2 <= vecsize; i += 2)
+            {
+                _mm_storeu_pd(outs + i, readPositions(table, mask, _mm_add_pd(vphase, _mm_mul_pd(index, vinc))));
+                index = _mm_add_pd(index, step);
+            }
+            
+            phase = wrapPhase(phase + double(i) * inc);
+            return oscillate<InterpolationLinear, double>(InterpolationLinear(), table, size, phase,
+                                                          inc, outs + i, vecsize - i);
+        }
+        
+        #endif
+    }
+    
     // ================================================================================ //
     //                                    COS TABLE                                     //
     // ================================================================================ //
     
     //! @brief A cosine wave table that can be read with a phase between 0. and 1.
-    template<class SampleType, size_t TableSize = 512>
+    //! @details The table is computed at compile time, so it costs nothing at startup
+    //! and lives in read-only memory (TableSize * sizeof(SampleType) bytes, to weigh against the cache size).
+    //! One guard point before and two after the period let every Interpolation read without wrapping.
+    //! @tparam TableSize The number of points of one period (a power of two from 512 to 65536).
+    //! @tparam Interpolation InterpolationNone, InterpolationLinear or InterpolationCubic.
+    template<class SampleType, size_t TableSize = 512, class Interpolation = InterpolationLinear>
     class CosTable
     {
     public: // methods
         
         using sample_t = SampleType;
         
+        static_assert(TableSize >= 512 && TableSize <= 65536 && (TableSize & (TableSize - 1)) == 0,
+                      "TableSize must be a power of two between 512 and 65536");
+        
         //! @brief Constructor.
-        //! @details Initialize the cosinus table.
-        CosTable()
+        //! @details Initialize the cosinus table (at compile time for a constexpr table).
+        constexpr CosTable() : m_table{}
         {
-            const size_t tsize = size();
-            
-            for(size_t i = 0; i < tsize; ++i)
+            // m_table[j] = cos(2pi * (j - 1) / TableSize)
+            for(size_t j = 0; j < TableSize + GuardPoints; ++j)
             {
-                m_table[i] = cos(2.f * M_PI * i / tsize);
+                m_table[j] = static_cast<sample_t>(wavetable::cosine(j + TableSize - 1, TableSize));
             }
-            
-            m_table[m_table.size()] = m_table[0];
         }
         
-        //! @brief Destructor
-        ~CosTable() = default;
-        
         //! @brief Returns the size of the array
-        size_t size() const
+        static constexpr size_t size()
+        {
+            return TableSize;
+        }
+        
+        //! @brief Returns the value of the point at index idx (0 <= idx <= size())
+        constexpr sample_t operator[](size_t idx) const
         {
-            return m_table.size() - 1;
+            return m_table[idx + 1];
         }
         
-        //! @brief Returns a linear interpolated value given a phase value between 0. and 1.
+        //! @brief Returns an interpolated value given a phase value between 0. and 1. (excluded).
         sample_t getInterp(sample_t phase) const
         {
-            // we cast to int to keep only the integer part of the floating-point number (eg. 3.99 => 3)
-            phase *= (size() - 1);
+            phase *= TableSize;
             
             // we cast to int to keep only the integer part of the floating-point number (eg. 3.99 => 3)
-            const size_t idx_1 = static_cast<size_t>(phase);
+            const size_t idx = static_cast<size_t>(phase);
             
             // delta = tphase - integral part of the the floating-point number
-            sample_t delta = phase - idx_1;
+            const sample_t delta = phase - idx;
             
-            const sample_t y1 = m_table[idx_1];
+            // the guard points allow to read idx-1 to idx+2 without wrapping
+            return Interpolation::read(m_table + 1, idx, delta);
+        }
+        
+        //! @brief Returns an interpolated value given a 32-bit fixed-point phase (2^32 is one period).
+        //! @details The index is in the top bits and the delta in the low bits, so there is nothing to wrap.
+        //! @see FixedPhasor
+        sample_t getInterp(uint32_t phase) const
+        {
+            const size_t idx = phase >> FractionBits;
+            const sample_t delta = (phase & FractionMask) * sample_t(1. / (FractionMask + 1.));
             
-            // linear interpolation
-            // (idx2 can always be idx_1+1 thanks to the additional sample in the table)
-            return y1 + delta * (m_table[idx_1+1] - y1);
+            return Interpolation::read(m_table + 1, idx, delta);
+        }
+        
+        //! @brief Interpolated values of a block of phases between 0. and 1. (excluded).
+        //! @details phases and outs can be the same array.
+        void getInterp(sample_t const* phases, sample_t* outs, long vecsize) const
+        {
+            simd::readTable(Interpolation(), m_table + 1, TableSize, phases, outs, vecsize);
+        }
+        
+        //! @brief Values of a block read from phase, incremented by freqs[i] * scale.
+        //! @return The phase after the block.
+        sample_t oscillate(sample_t phase, sample_t const* freqs, sample_t scale, sample_t* outs, long vecsize) const
+        {
+            return simd::oscillate(Interpolation(), m_table + 1, TableSize, phase, freqs, scale, outs, vecsize);
+        }
+        
+        //! @brief Values of a block read from phase, incremented by inc.
+        //! @return The phase after the block.
+        sample_t oscillate(sample_t phase, sample_t inc, sample_t* outs, long vecsize) const
+        {
+            return simd::oscillate(Interpolation(), m_table + 1, TableSize, phase, inc, outs, vecsize);
         }
         
     private: // variables
         
-        std::array<sample_t, TableSize+1> m_table;
+        static const size_t GuardPoints = 3;
+        static const size_t FractionBits = 32 - wavetable::log2(TableSize);
+        static const uint32_t FractionMask = (uint32_t(1) << FractionBits) - 1;
+        
+        sample_t m_table[TableSize + GuardPoints];
     };
     
     // ================================================================================ //
     //                                       OSC                                        //
     // ================================================================================ //
     
-    template<class SampleType>
+    //! @brief A cosine oscillator reading a CosTable.
+    //! @tparam TableSize The number of points of the table.
+    //! @tparam Interpolation The interpolation used to read the table.
+    template<class SampleType, size_t TableSize = 512, class Interpolation = InterpolationLinear>
     class Osc
     {
     public: // methods
         
         using sample_t = SampleType;
-        using costable_t = CosTable<sample_t, 512>;
+        using costable_t = CosTable<sample_t, TableSize, Interpolation>;
         
         //! Default constructor
         Osc() = default;
@@ -109,6 +445,24 @@ namespace paccpp
             return m_phasor.getFrequency();
         }
         
+        //! @brief Set the phase
+        void setPhase(double phase)
+        {
+            m_phasor.setPhase(phase);
+        }
+        
+        //! @brief Get the current phase
+        double getPhase() const
+        {
+            return m_phasor.getPhase();
+        }
+        
+        //! @brief Get the phase increment per sample (frequency / samplerate)
+        sample_t getIncrement() const
+        {
+            return m_phasor.getIncrement();
+        }
+        
         //! @brief Increment the oscillator and return current phase value
         //! @details The Oscillator is running at the current frequency.
         //! @return The current phase.
@@ -124,22 +478,29 @@ namespace paccpp
         //! then increment the oscillator phase and return current value
         void process(sample_t const* freqs, sample_t* outs, long vecsize)
         {
-            while(vecsize--)
-            {
-                m_phasor.setFrequency(*freqs++);
-                *outs++ = process();
-            }
+            const sample_t sr = m_phasor.getSampleRate();
+            const sample_t scale = (sr > 0.) ? (1. / sr) : 0.;
+            
+            // the phases are accumulated and read in the same pass.
+            m_phasor.setPhase(m_costable.oscillate(m_phasor.getPhase(), freqs, scale, outs, vecsize));
+        }
+        
+        //! @brief Process a block of samples at the current frequency
+        //! @see setFrequency
+        void process(sample_t* outs, long vecsize)
+        {
+            m_phasor.setPhase(m_costable.oscillate(m_phasor.getPhase(), m_phasor.getIncrement(), outs, vecsize));
         }
         
     private: // variables
         
-        static const costable_t m_costable;
+        static constexpr costable_t m_costable {};
         
         Phasor<sample_t> m_phasor = {};
     };
     
-    // Les variables statiques doivent être initialisées à l'extérieur de la classe:
-    template<class SampleType>
-    typename Osc<SampleType>::costable_t const Osc<SampleType>::m_costable = {};
+    // Les variables statiques doivent être définies à l'extérieur de la classe:
+    template<class SampleType, size_t TableSize, class Interpolation>
+    constexpr typename Osc<SampleType, TableSize, Interpolation>::costable_t Osc<SampleType, TableSize, Interpolation>::m_costable;
     
 }
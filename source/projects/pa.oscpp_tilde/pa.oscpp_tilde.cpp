@@ -14,6 +14,9 @@ using namespace c74::max;
 #include "Osc.hpp"
 using paccpp::Osc;
 
+#include "QuadratureOsc.hpp"
+using paccpp::QuadratureOsc;
+
 static t_class* this_class = nullptr;
 
 struct t_pa_oscpp_tilde
@@ -22,6 +25,10 @@ struct t_pa_oscpp_tilde
     
     // store a Phasor pointer
     Osc<double>* m_osc;
+    
+    // recursive mode (float freq only)
+    long m_recursive;
+    QuadratureOsc<double>* m_quadrature;
 };
 
 void pa_oscpp_tilde_float(t_pa_oscpp_tilde* x, double d)
@@ -50,12 +57,23 @@ void pa_oscpp_tilde_perform64_float(t_pa_oscpp_tilde* x, t_object* dsp64,
 {
     double* out = outs[0];
     
-    while(vecsize--)
-    {
-        *out++ = x->m_osc->process();
-    }
+    x->m_osc->process(out, vecsize);
 }
 
+void pa_oscpp_tilde_perform64_recursive(t_pa_oscpp_tilde* x, t_object* dsp64,
+                                        double** ins, long numins, double** outs, long numouts,
+                                        long vecsize, long flags, void* userparam)
+{
+    // the frequency is constant: complex rotation instead of the table
+    Osc<double>* osc = x->m_osc;
+    osc->setPhase(x->m_quadrature->process(osc->getPhase(), osc->getIncrement(), outs[0], vecsize));
+}
+
+void pa_oscpp_tilde_set_recursive(t_pa_oscpp_tilde* x, long recursive)
+{
+    // taken into account when the dsp chain is compiled
+    x->m_recursive = (recursive != 0);
+}
 
 void pa_oscpp_tilde_dsp64(t_pa_oscpp_tilde* x, t_object* dsp64, short* count,
                              double samplerate, long maxvectorsize, long flags)
@@ -72,7 +90,8 @@ void pa_oscpp_tilde_dsp64(t_pa_oscpp_tilde* x, t_object* dsp64, short* count,
     {
         object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
                              dsp64, gensym("dsp_add64"), (t_object*)x,
-                             (t_perfroutine64)pa_oscpp_tilde_perform64_float, 0, NULL);
+                             (t_perfroutine64)(x->m_recursive ? pa_oscpp_tilde_perform64_recursive
+                                                              : pa_oscpp_tilde_perform64_float), 0, NULL);
     }
 }
 
@@ -81,7 +100,7 @@ void pa_oscpp_tilde_assist(t_pa_oscpp_tilde* x, void* unused,
 {
     if(io == ASSIST_INLET)
     {
-        strncpy(string_dest, "(signal) Frequency", ASSIST_STRING_MAXSIZE);
+        strncpy(string_dest, "(signal) Frequency, (recursive) 1 to compute a float frequency without table", ASSIST_STRING_MAXSIZE);
     }
     else if(io == ASSIST_OUTLET)
     {
@@ -98,6 +117,8 @@ void* pa_oscpp_tilde_new(t_symbol *name, long argc, t_atom *argv)
         // instantiate a new Osc object
         // Note: dont forget to delete it in the free method !
         x->m_osc = new Osc<double>();
+        x->m_quadrature = new QuadratureOsc<double>();
+        x->m_recursive = 0;
         
         if(argc >= 1 && (atom_gettype(argv) == A_FLOAT || atom_gettype(argv) == A_LONG))
         {
@@ -116,8 +137,9 @@ void pa_oscpp_tilde_free(t_pa_oscpp_tilde* x)
 {
     dsp_free((t_pxobject*)x);
     
-    // free the memory for the Osc object
+    // free the memory for the Osc objects
     delete x->m_osc;
+    delete x->m_quadrature;
 }
 
 void ext_main(void* r)
@@ -129,6 +151,7 @@ void ext_main(void* r)
     class_addmethod(this_class, (method)pa_oscpp_tilde_dsp64,      "dsp64",    A_CANT,		0);
     class_addmethod(this_class, (method)pa_oscpp_tilde_float,      "float",    A_FLOAT,    0);
     class_addmethod(this_class, (method)pa_oscpp_tilde_int,        "int",      A_LONG,     0);
+    class_addmethod(this_class, (method)pa_oscpp_tilde_set_recursive, "recursive", A_LONG, 0);
     
     class_dspinit(this_class);
     class_register(CLASS_BOX, this_class);
@@ -5,9 +5,193 @@
  */
 
 #include <cmath>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 namespace paccpp
 {
+    // ================================================================================ //
+    //                                   PHASE KERNELS                                  //
+    // ================================================================================ //
+    
+    //! @brief Block kernels shared by Phasor and Osc.
+    //! @details The generic versions are scalar, the double versions use AVX2 or SSE2 when
+    //! the compiler targets them (eg. -mavx2) and fall back to the scalar version for the last samples.
+    namespace simd
+    {
+        //! @brief Wrap a phase between 0. and 1. (excluded) without branches.
+        template<class T>
+        inline T wrapPhase(T phase)
+        {
+            phase -= std::floor(phase);
+            return (phase < T(1.)) ? phase : T(0.);
+        }
+        
+        //! @brief outs[i] = phase then phase += freqs[i] * scale, returns the last phase.
+        //! @details freqs and outs can be the same array: each frequency is read before its output is written.
+        template<class T>
+        inline T accumulatePhase(T phase, T const* freqs, T scale, T* outs, long vecsize)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const T freq = freqs[i];
+                
+                outs[i] = phase;
+                phase = wrapPhase(phase + freq * scale);
+            }
+            
+            return phase;
+        }
+        
+        //! @brief outs[i] = phase + i * inc (wrapped), returns the next phase.
+        template<class T>
+        inline T rampPhase(T phase, T inc, T* outs, long vecsize)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                outs[i] = wrapPhase(phase + T(i) * inc);
+            }
+            
+            return wrapPhase(phase + T(vecsize) * inc);
+        }
+        
+        #if defined(__AVX2__)
+        
+        //! @brief Wrap 4 phases between 0. and 1. (excluded).
+        inline __m256d wrapPhase(__m256d phase)
+        {
+            phase = _mm256_sub_pd(phase, _mm256_floor_pd(phase));
+            return _mm256_and_pd(phase, _mm256_cmp_pd(phase, _mm256_set1_pd(1.), _CMP_LT_OQ));
+        }
+        
+        inline double accumulatePhase(double phase, double const* freqs, double scale, double* outs, long vecsize)
+        {
+            const __m256d vscale = _mm256_set1_pd(scale);
+            const __m256d zero = _mm256_setzero_pd();
+            __m256d carry = _mm256_set1_pd(phase);
+            long i = 0;
+            
+            // inclusive prefix sum [a, a+b, a+b+c, a+b+c+d]
+            auto prefix = [zero](__m256d inc)
+            {
+                const __m256d sum = _mm256_add_pd(inc, _mm256_blend_pd(_mm256_permute4x64_pd(inc, 0x90), zero, 0x1));
+                return _mm256_add_pd(sum, _mm256_permute2f128_pd(sum, sum, 0x08));
+            };
+            
+            // exclusive prefix sum [0, a, a+b, a+b+c]
+            auto shift = [zero](__m256d sum)
+            {
+                return _mm256_blend_pd(_mm256_permute4x64_pd(sum, 0x90), zero, 0x1);
+            };
+            
+            // two vectors per iteration so that the carry is only added once every 8 samples.
+            for(; i + 8 <= vecsize; i += 8)
+            {
+                const __m256d sum_0 = prefix(_mm256_mul_pd(_mm256_loadu_pd(freqs + i), vscale));
+                const __m256d sum_1 = prefix(_mm256_mul_pd(_mm256_loadu_pd(freqs + i + 4), vscale));
+                const __m256d total_0 = _mm256_permute4x64_pd(sum_0, 0xff);
+                const __m256d total_1 = _mm256_permute4x64_pd(sum_1, 0xff);
+                
+                _mm256_storeu_pd(outs + i, wrapPhase(_mm256_add_pd(carry, shift(sum_0))));
+                _mm256_storeu_pd(outs + i + 4, wrapPhase(_mm256_add_pd(carry, _mm256_add_pd(total_0, shift(sum_1)))));
+                
+                // the carry is only wrapped every 32 samples to keep it off the critical path.
+                carry = _mm256_add_pd(carry, _mm256_add_pd(total_0, total_1));
+                if((i & 31) == 24) carry = wrapPhase(carry);
+            }
+            
+            return accumulatePhase<double>(wrapPhase(_mm256_cvtsd_f64(carry)), freqs + i, scale, outs + i, vecsize - i);
+        }
+        
+        inline double rampPhase(double phase, double inc, double* outs, long vecsize)
+        {
+            const __m256d vphase = _mm256_set1_pd(phase);
+            const __m256d vinc = _mm256_set1_pd(inc);
+            const __m256d step = _mm256_set1_pd(4.);
+            __m256d index = _mm256_set_pd(3., 2., 1., 0.);
+            long i = 0;
+            
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                _mm256_storeu_pd(outs + i, wrapPhase(_mm256_add_pd(vphase, _mm256_mul_pd(index, vinc))));
+                index = _mm256_add_pd(index, step);
+            }
+            
+            return rampPhase<double>(wrapPhase(phase + double(i) * inc), inc, outs + i, vecsize - i);
+        }
+        
+        #elif defined(__SSE2__) || defined(_M_X64)
+        
+        //! @brief Wrap 2 phases between 0. and 1. (excluded).
+        //! @details SSE2 has no floor(): adding and subtracting 1.5 * 2^52 rounds to the nearest integer
+        //! (for |phase| < 2^51), so phase - 0.5 is rounded to get floor(phase) (or floor(phase) - 1 on ties).
+        inline __m128d wrapPhase(__m128d phase)
+        {
+            const __m128d magic = _mm_set1_pd(6755399441055744.);
+            const __m128d one = _mm_set1_pd(1.);
+            
+            const __m128d floor = _mm_sub_pd(_mm_add_pd(_mm_sub_pd(phase, _mm_set1_pd(0.5)), magic), magic);
+            
+            phase = _mm_sub_pd(phase, floor);
+            return _mm_and_pd(phase, _mm_cmplt_pd(phase, one));
+        }
+        
+        inline double accumulatePhase(double phase, double const* freqs, double scale, double* outs, long vecsize)
+        {
+            const __m128d vscale = _mm_set1_pd(scale);
+            __m128d carry = _mm_set1_pd(phase);
+            long i = 0;
+            
+            // two vectors per iteration so that the carry is only added once every 4 samples.
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                const __m128d inc_0 = _mm_mul_pd(_mm_loadu_pd(freqs + i), vscale);
+                const __m128d inc_1 = _mm_mul_pd(_mm_loadu_pd(freqs + i + 2), vscale);
+                
+                // exclusive prefix sums [0, a] and [0, c], totals [a+b, a+b] and [c+d, c+d]
+                const __m128d before_0 = _mm_unpacklo_pd(_mm_setzero_pd(), inc_0);
+                const __m128d before_1 = _mm_unpacklo_pd(_mm_setzero_pd(), inc_1);
+                const __m128d total_0 = _mm_add_pd(inc_0, _mm_shuffle_pd(inc_0, inc_0, 0x1));
+                const __m128d total_1 = _mm_add_pd(inc_1, _mm_shuffle_pd(inc_1, inc_1, 0x1));
+                
+                _mm_storeu_pd(outs + i, wrapPhase(_mm_add_pd(carry, before_0)));
+                _mm_storeu_pd(outs + i + 2, wrapPhase(_mm_add_pd(carry, _mm_add_pd(total_0, before_1))));
+                
+                // the carry is only wrapped every 32 samples to keep it off the critical path.
+                carry = _mm_add_pd(carry, _mm_add_pd(total_0, total_1));
+                if((i & 31) == 28) carry = wrapPhase(carry);
+            }
+            
+            return accumulatePhase<double>(wrapPhase(_mm_cvtsd_f64(carry)), freqs + i, scale, outs + i, vecsize - i);
+        }
+        
+        inline double rampPhase(double phase, double inc, double* outs, long vecsize)
+        {
+            const __m128d vphase = _mm_set1_pd(phase);
+            const __m128d vinc = _mm_set1_pd(inc);
+            const __m128d step = _mm_set1_pd(2.);
+            __m128d index = _mm_set_pd(1., 0.);
+            long i = 0;
+            
+            for(; i + 2 <= vecsize; i += 2)
+            {
+                _mm_storeu_pd(outs + i, wrapPhase(_mm_add_pd(vphase, _mm_mul_pd(index, vinc))));
+                index = _mm_add_pd(index, step);
+            }
+            
+            return rampPhase<double>(wrapPhase(phase + double(i) * inc), inc, outs + i, vecsize - i);
+        }
+        
+        #endif
+    }
+    
+    // ================================================================================ //
+    //                                      PHASOR                                      //
+    // ================================================================================ //
+    
     template<class SampleType>
     class Phasor
     {
@@ -31,6 +215,7 @@ namespace paccpp
         void setSampleRate(sample_t samplerate)
         {
             m_sr = samplerate;
+            m_sr_inv = (m_sr > 0.) ? (1. / m_sr) : 0.;
             computeIncrement();
         }
         
@@ -67,6 +252,12 @@ namespace paccpp
             return m_freq;
         }
         
+        //! @brief Get the phase increment per sample (frequency / samplerate)
+        sample_t getIncrement() const
+        {
+            return m_phase_inc;
+        }
+        
         //! @brief Increment the phasor and return current phase value
         //! @details Phasor is running at the current frequency.
         //! @return The current phase.
@@ -88,36 +279,184 @@ namespace paccpp
         
         //! @brief Process a block of samples
         //! @details Update phasor frequency with the inputs
-        //! then increment the phasor and return current phase value
+        //! then increment the phasor and return current phase value.
+        //! Increments are computed with 1/sr, accumulated with a prefix sum and wrapped without branches.
         void process(sample_t const* freqs, sample_t* outs, long vecsize)
         {
-            sample_t freq = 0.f;
+            m_phase = simd::accumulatePhase(m_phase, freqs, m_sr_inv, outs, vecsize);
+        }
+        
+        //! @brief Process a block of samples at the current frequency
+        //! @see setFrequency
+        void process(sample_t* outs, long vecsize)
+        {
+            m_phase = simd::rampPhase(m_phase, m_phase_inc, outs, vecsize);
+        }
+        
+    private: // methods
+        
+        void computeIncrement()
+        {
+            m_phase_inc = (m_sr > 0.) ? (m_freq / m_sr) : 0.;
+        }
+        
+    private: // variables
+        
+        sample_t    m_sr = 0.;
+        sample_t    m_sr_inv = 0.;
+        sample_t    m_phase = 0.;
+        sample_t    m_freq = 0.;
+        sample_t    m_phase_inc = 0.;
+    };
+    
+    // ================================================================================ //
+    //                                   FIXED PHASOR                                   //
+    // ================================================================================ //
+    
+    //! @brief A Phasor with a 32-bit fixed-point phase accumulator.
+    //! @details One period is 2^32, so the phase wraps for free when the unsigned addition overflows,
+    //! and is always exact: after n samples it is the sum of the n increments modulo 2^32,
+    //! whatever the duration. The cost is the resolution of the increment: 2^-32 period per sample,
+    //! ie. a frequency error up to samplerate / 2^33 (5 microHz at 44.1kHz).
+    template<class SampleType>
+    class FixedPhasor
+    {
+    public: // methods
+        
+        using sample_t = SampleType;
+        
+        //! @brief The value of one period.
+        static constexpr double Period = 4294967296.;
+        
+        //! Default constructor
+        FixedPhasor(sample_t freq = 0.) :
+        m_freq(freq)
+        {
+            ;
+        }
+        
+        //! @brief Destructor
+        ~FixedPhasor() = default;
+        
+        //! @brief Set the current sampling rate
+        //! @details You need to set a valid samplerate before calling any process method
+        void setSampleRate(sample_t samplerate)
+        {
+            m_sr = samplerate;
+            m_fixed_scale = (m_sr > 0.) ? (Period / m_sr) : 0.;
+            computeIncrement();
+        }
+        
+        //! @brief Get the current sampling rate
+        sample_t getSampleRate() const
+        {
+            return m_sr;
+        }
+        
+        //! @brief Set the phase
+        void setPhase(double phase)
+        {
+            m_phase = toFixed(phase - std::floor(phase));
+        }
+        
+        //! @brief Get the current phase
+        double getPhase() const
+        {
+            return m_phase * (1. / Period);
+        }
+        
+        //! @brief Get the current phase in 2^-32 period units
+        uint32_t getFixedPhase() const
+        {
+            return m_phase;
+        }
+        
+        //! @brief Set the frequency
+        void setFrequency(double freq)
+        {
+            m_freq = freq;
+            computeIncrement();
+        }
+        
+        //! @brief Get the frequency
+        double getFrequency() const
+        {
+            return m_freq;
+        }
+        
+        //! @brief Get the phase increment per sample in 2^-32 period units
+        uint32_t getFixedIncrement() const
+        {
+            return m_phase_inc;
+        }
+        
+        //! @brief Increment the phasor and return current phase value
+        //! @see setFrequency
+        sample_t process()
+        {
+            const sample_t out = m_phase * sample_t(1. / Period);
+            m_phase += m_phase_inc;
+            return out;
+        }
+        
+        //! @brief Process a block of samples
+        //! @details Update phasor frequency with the inputs
+        //! then increment the phasor and return current phase value.
+        void process(sample_t const* freqs, sample_t* outs, long vecsize)
+        {
+            const sample_t scale = m_fixed_scale;
+            uint32_t phase = m_phase;
             
-            while(vecsize--)
+            for(long i = 0; i < vecsize; ++i)
             {
-                freq = *freqs++;
+                // the frequency is read before the output is written (freqs and outs can be the same array)
+                const sample_t freq = freqs[i];
                 
-                *outs++ = m_phase;
-                
-                m_phase += (freq / m_sr);
-                
-                if(m_phase >= 1.f) m_phase -= 1.f;
-                if(m_phase < 0.f) m_phase += 1.f;
+                outs[i] = phase * sample_t(1. / Period);
+                phase += static_cast<uint32_t>(static_cast<int64_t>(freq * scale));
+            }
+            
+            m_phase = phase;
+        }
+        
+        //! @brief Process a block of samples at the current frequency
+        //! @see setFrequency
+        void process(sample_t* outs, long vecsize)
+        {
+            const uint32_t phase = m_phase;
+            const uint32_t inc = m_phase_inc;
+            
+            for(long i = 0; i < vecsize; ++i)
+            {
+                outs[i] = uint32_t(phase + uint32_t(i) * inc) * sample_t(1. / Period);
             }
+            
+            m_phase = phase + uint32_t(vecsize) * inc;
+        }
+        
+        //! @brief Converts periods (|value| < 2^31) to 2^-32 period units, negative values wrap around.
+        static uint32_t toFixed(double periods)
+        {
+            return static_cast<uint32_t>(static_cast<int64_t>(periods * Period));
         }
         
     private: // methods
         
         void computeIncrement()
         {
-            m_phase_inc = (m_sr > 0.) ? (m_freq / m_sr) : 0.;
+            // rounded to the nearest unit (the increments of a signal frequency are truncated)
+            m_phase_inc = (m_sr > 0.) ? static_cast<uint32_t>(std::llround(std::fmod(m_freq / m_sr, 1.) * Period)) : 0;
         }
         
     private: // variables
         
-        sample_t    m_sr;
-        sample_t    m_phase = 0.;
+        sample_t    m_sr = 0.;
+        sample_t    m_fixed_scale = 0.;
         sample_t    m_freq = 0.;
-        sample_t    m_phase_inc = 0.;
+        uint32_t    m_phase = 0;
+        uint32_t    m_phase_inc = 0;
     };
+    
+    template<class SampleType>
+    constexpr double FixedPhasor<SampleType>::Period;
 }
@@ -12,6 +12,7 @@ using namespace c74::max;
 
 #include "Phasor.hpp"
 using paccpp::Phasor;
+using paccpp::FixedPhasor;
 
 static t_class* this_class = nullptr;
 
@@ -21,11 +22,16 @@ struct t_pa_phasorpp_tilde
     
     // store a Phasor pointer
     Phasor<double>* m_phasor;
+    
+    // and its fixed-point version
+    FixedPhasor<double>* m_fixed_phasor;
+    long m_fixed;
 };
 
 void pa_phasorpp_tilde_float(t_pa_phasorpp_tilde* x, double d)
 {
     x->m_phasor->setFrequency(d);
+    x->m_fixed_phasor->setFrequency(d);
 }
 
 void pa_phasorpp_tilde_int(t_pa_phasorpp_tilde* x, long l)
@@ -33,6 +39,25 @@ void pa_phasorpp_tilde_int(t_pa_phasorpp_tilde* x, long l)
     pa_phasorpp_tilde_float(x, (double)l);
 }
 
+void pa_phasorpp_tilde_set_fixed(t_pa_phasorpp_tilde* x, long fixed)
+{
+    fixed = (fixed != 0);
+    
+    if(fixed == x->m_fixed) return;
+    
+    // carry the phase over to the other phasor
+    if(fixed)
+    {
+        x->m_fixed_phasor->setPhase(x->m_phasor->getPhase());
+    }
+    else
+    {
+        x->m_phasor->setPhase(x->m_fixed_phasor->getPhase());
+    }
+    
+    x->m_fixed = fixed;
+}
+
 void pa_phasorpp_tilde_perform64_vec(t_pa_phasorpp_tilde* x, t_object* dsp64,
                                    double** ins, long numins, double** outs, long numouts,
                                    long vecsize, long flags, void* userparam)
@@ -40,7 +65,14 @@ void pa_phasorpp_tilde_perform64_vec(t_pa_phasorpp_tilde* x, t_object* dsp64,
     double const* in = ins[0];
     double* out = outs[0];
     
-    x->m_phasor->process(in, out, vecsize);
+    if(x->m_fixed)
+    {
+        x->m_fixed_phasor->process(in, out, vecsize);
+    }
+    else
+    {
+        x->m_phasor->process(in, out, vecsize);
+    }
 }
 
 void pa_phasorpp_tilde_perform64_float(t_pa_phasorpp_tilde* x, t_object* dsp64,
@@ -49,9 +81,13 @@ void pa_phasorpp_tilde_perform64_float(t_pa_phasorpp_tilde* x, t_object* dsp64,
 {
     double* out = outs[0];
     
-    while(vecsize--)
+    if(x->m_fixed)
+    {
+        x->m_fixed_phasor->process(out, vecsize);
+    }
+    else
     {
-        *out++ = x->m_phasor->process();
+        x->m_phasor->process(out, vecsize);
     }
 }
 
@@ -60,6 +96,7 @@ void pa_phasorpp_tilde_dsp64(t_pa_phasorpp_tilde* x, t_object* dsp64, short* cou
                            double samplerate, long maxvectorsize, long flags)
 {
     x->m_phasor->setSampleRate(sys_getsr());
+    x->m_fixed_phasor->setSampleRate(sys_getsr());
     
     if(count[0])
     {
@@ -80,7 +117,7 @@ void pa_phasorpp_tilde_assist(t_pa_phasorpp_tilde* x, void* unused,
 {
     if(io == ASSIST_INLET)
     {
-        strncpy(string_dest, "(signal) Frequency", ASSIST_STRING_MAXSIZE);
+        strncpy(string_dest, "(signal) Frequency, (fixed) 1 for a 32-bit fixed-point phase", ASSIST_STRING_MAXSIZE);
     }
     else if(io == ASSIST_OUTLET)
     {
@@ -97,6 +134,8 @@ void* pa_phasorpp_tilde_new(t_symbol *name, long argc, t_atom *argv)
         // instantiate a new Phasor object
         // Note: dont forget to delete it in the free method !
         x->m_phasor = new Phasor<double>();
+        x->m_fixed_phasor = new FixedPhasor<double>();
+        x->m_fixed = 0;
         
         if(argc >= 1 && (atom_gettype(argv) == A_FLOAT || atom_gettype(argv) == A_LONG))
         {
@@ -115,8 +154,9 @@ void pa_phasorpp_tilde_free(t_pa_phasorpp_tilde* x)
 {
     dsp_free((t_pxobject*)x);
     
-    // free the memory for the Phasor object
+    // free the memory for the Phasor objects
     delete x->m_phasor;
+    delete x->m_fixed_phasor;
 }
 
 void ext_main(void* r)
@@ -128,6 +168,7 @@ void ext_main(void* r)
     class_addmethod(this_class, (method)pa_phasorpp_tilde_dsp64,      "dsp64",    A_CANT,		0);
     class_addmethod(this_class, (method)pa_phasorpp_tilde_float,      "float",    A_FLOAT,    0);
     class_addmethod(this_class, (method)pa_phasorpp_tilde_int,        "int",      A_LONG,     0);
+    class_addmethod(this_class, (method)pa_phasorpp_tilde_set_fixed,  "fixed",    A_LONG,     0);
     
     class_dspinit(this_class);
     class_register(CLASS_BOX, this_class);
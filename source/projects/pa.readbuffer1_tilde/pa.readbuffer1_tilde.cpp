@@ -10,69 +10,331 @@
 #include "c74_msp.h"
 using namespace c74::max;
 
+#include <algorithm> // std::fill, std::min, std::max
+#include <stdlib.h> // malloc, calloc, free...
+
+#include "ChannelCache.hpp"
+using paccpp::ChannelCache;
+
+#include "Handoff.hpp"
+using paccpp::Handoff;
+
+#include "MappedFile.hpp"
+using paccpp::MappedFile;
+
 static t_class* this_class = nullptr;
 
 struct t_pa_readbuffer1_tilde
 {
     t_pxobject      m_obj;
     t_buffer_ref*   m_buffer_reference;
+    std::atomic<ChannelCache*>  m_cache;
+    t_clock*        m_clock;
+    bool            m_refresh_scheduled;
+    
+    // the channel of the buffer read by each outlet (from 0)
+    long            m_number_of_outlets;
+    long*           m_channels;
+    
+    // the file read in place instead of the buffer~ (an empty one reads the buffer~) and the last one mapped
+    Handoff<MappedFile>*    m_files;
+    MappedFile*     m_latest;
+    
+    // the time ahead of the play head whose pages are loaded in advance (0 if none) and its clock
+    double          m_prefetch;
+    t_clock*        m_prefetch_clock;
 };
 
-void pa_readbuffer1_dsp_perform(t_pa_readbuffer1_tilde *x, t_object *dsp64,
-                                double **ins, long numins, double **outs, long numouts,
-                                long sampleframes, long flags, void *userparam)
+//! @brief The number of samples whose indices are computed at once.
+static const long index_block_size = 64;
+
+//! @brief The time between two rebuilds of the planar copy while the buffer~ is modified (ms).
+static const double refresh_interval = 20.;
+
+//! @brief Returns the planar copies of the buffer~, shared with pa.readbuffer2~ (the registry is bound to a symbol).
+ChannelCache::Registry& pa_readbuffer1_caches()
 {
-    double *in = ins[0];
-    double *out = outs[0];
-    int n = sampleframes;
-    float *tab;
-    t_atom_long index, size, nc;
+    t_symbol* name = gensym("__paccpp.channelcache");
+    
+    if(!name->s_thing)
+    {
+        name->s_thing = (t_object*)new ChannelCache::Registry();
+    }
+    
+    return *(ChannelCache::Registry*)name->s_thing;
+}
+
+//! @brief Returns the mappings of the files, shared with pa.readbuffer2~ (the registry is bound to a symbol).
+MappedFile::Registry& pa_readbuffer1_mappings()
+{
+    t_symbol* name = gensym("__paccpp.mappedfile");
     
-    t_buffer_obj* buffer = buffer_ref_getobject(x->m_buffer_reference);
-    if(buffer)
+    if(!name->s_thing)
     {
-        tab = buffer_locksamples(buffer);
+        name->s_thing = (t_object*)new MappedFile::Registry();
+    }
+    
+    return *(MappedFile::Registry*)name->s_thing;
+}
+
+//! @brief Refresh on the next tick of the clock, the modifications of the buffer~ until then are coalesced.
+void pa_readbuffer1_schedule_refresh(t_pa_readbuffer1_tilde *x)
+{
+    if(!x->m_refresh_scheduled)
+    {
+        x->m_refresh_scheduled = true;
+        clock_fdelay(x->m_clock, refresh_interval);
+    }
+}
+
+//! @brief Rebuild the planar copy of the buffer~ if it has been modified, delete the copies and the file replaced by the audio thread (message thread).
+void pa_readbuffer1_refresh(t_pa_readbuffer1_tilde *x)
+{
+    x->m_refresh_scheduled = false;
+    x->m_files->reclaim();
+    
+    ChannelCache* cache = x->m_cache.load();
+    
+    if(cache->stale())
+    {
+        t_buffer_obj* buffer = buffer_ref_getobject(x->m_buffer_reference);
+        float* tab = buffer ? buffer_locksamples(buffer) : nullptr;
+        
         if(tab)
         {
-            size = buffer_getframecount(buffer);
-            nc = buffer_getchannelcount(buffer);
+            cache->build(tab, (long)buffer_getframecount(buffer), (long)buffer_getchannelcount(buffer));
+            buffer_unlocksamples(buffer);
+        }
+        else
+        {
+            cache->build(nullptr, 0, 0);
+        }
+    }
+    
+    // a copy still read by a perform routine is deleted by a next tick
+    if(ChannelCache::reclaim(pa_readbuffer1_caches()))
+    {
+        pa_readbuffer1_schedule_refresh(x);
+    }
+}
+
+//! @brief Read a file in place (see MappedFile), the frames of a channel are interleaved with the other channels.
+void pa_readbuffer1_perform_mapped(t_pa_readbuffer1_tilde *x, MappedFile& file, double *in, double **outs, long numouts, long sampleframes)
+{
+    const long size = file.frames();
+    const long stride = file.channels();
+    long indices[index_block_size];
+    long first = 0, last = 0;
+    
+    for(long i = 0; i < sampleframes; i += index_block_size)
+    {
+        const long count = std::min(index_block_size, sampleframes - i);
+        
+        for(long j = 0; j < count; ++j)
+        {
+            long index = (long)(in[i + j] * size);
             
-            while (n--)
+            while(index < 0) { index += size; }
+            while(index >= size) { index -= size; }
+            
+            indices[j] = index * stride;
+        }
+        
+        if(i == 0) first = indices[0];
+        last = indices[count - 1];
+        
+        // a channel above the number of channels of the file reads the last one
+        for(long c = 0; c < numouts; ++c)
+        {
+            float const* tab = file.channel(std::min(x->m_channels[c], stride - 1));
+            double *out = outs[c] + i;
+            
+            for(long j = 0; j < count; ++j)
             {
-                index = (long)(*in++ * size);
-                
-                while(index < 0) { index += size; }
-                while(index >= size) { index -= size; }
-                
-                index *= nc;
-                
-                *out++ = tab[index];
+                out[j] = tab[indices[j]];
             }
-            
-            buffer_unlocksamples(buffer);
         }
-        else
+    }
+    
+    file.play(double(last / stride), last >= first);
+}
+
+//! @brief The indices of a block are computed first, then each outlet reads its channel in the planar copy of the buffer~.
+void pa_readbuffer1_dsp_perform(t_pa_readbuffer1_tilde *x, t_object *dsp64,
+                                double **ins, long numins, double **outs, long numouts,
+                                long sampleframes, long flags, void *userparam)
+{
+    double *in = ins[0];
+    long indices[index_block_size];
+    
+    // the previous file is deleted by the clock
+    if(x->m_files->update())
+    {
+        clock_delay(x->m_clock, 0);
+    }
+    
+    MappedFile* file = x->m_files->get();
+    
+    if(file && file->isOpen())
+    {
+        pa_readbuffer1_perform_mapped(x, *file, in, outs, numouts, sampleframes);
+        return;
+    }
+    
+    ChannelCache::Pin pin(*x->m_cache.load(std::memory_order_acquire));
+    ChannelCache::Planar const* planar = pin.get();
+    
+    if(!planar)
+    {
+        for(long c = 0; c < numouts; ++c)
         {
-            while(n--) { *out++ = 0.; }
+            std::fill(outs[c], outs[c] + sampleframes, 0.);
         }
+        
+        return;
     }
-    else
+    
+    const long size = planar->m_frames;
+    
+    // the inputs of a block are read before its outputs, that may share their memory, are written
+    for(long i = 0; i < sampleframes; i += index_block_size)
     {
-        while(n--) { *out++ = 0.; }
+        const long count = std::min(index_block_size, sampleframes - i);
+        
+        for(long j = 0; j < count; ++j)
+        {
+            long index = (long)(in[i + j] * size);
+            
+            while(index < 0) { index += size; }
+            while(index >= size) { index -= size; }
+            
+            indices[j] = index;
+        }
+        
+        // a channel above the number of channels of the buffer~ reads the last one
+        for(long c = 0; c < numouts; ++c)
+        {
+            float const* tab = planar->channel(std::min(x->m_channels[c], planar->m_channels - 1));
+            double *out = outs[c] + i;
+            
+            for(long j = 0; j < count; ++j)
+            {
+                out[j] = tab[indices[j]];
+            }
+        }
     }
 }
 
 void pa_readbuffer1_set(t_pa_readbuffer1_tilde *x, t_symbol *s)
 {
+    // an empty file: the buffer~ is read again
+    if(x->m_latest)
+    {
+        x->m_latest = nullptr;
+        x->m_files->publish(new MappedFile());
+    }
+    
     if (!x->m_buffer_reference)
         x->m_buffer_reference = buffer_ref_new((t_object *)x, s);
     else
         buffer_ref_set(x->m_buffer_reference, s);
+    
+    // the previous cache stays valid for the audio thread, only its copy is deleted with its last reader
+    ChannelCache* previous = x->m_cache.exchange(ChannelCache::acquire(pa_readbuffer1_caches(), s));
+    
+    if(previous)
+    {
+        previous->release();
+    }
+    
+    pa_readbuffer1_refresh(x);
+}
+
+//! @brief Read a file in place instead of the buffer~: a 32 bits float WAV file or a raw file of interleaved floats.
+//! @details map <file> [channels of a raw file]
+void pa_readbuffer1_map(t_pa_readbuffer1_tilde *x, t_symbol *s, long argc, t_atom *argv)
+{
+    char filename[MAX_PATH_CHARS];
+    char path[MAX_PATH_CHARS];
+    short volume;
+    t_fourcc type;
+    
+    if(argc < 1 || atom_gettype(argv) != A_SYM)
+    {
+        object_error((t_object*)x, "map needs a file");
+        return;
+    }
+    
+    snprintf(filename, MAX_PATH_CHARS, "%s", atom_getsym(argv)->s_name);
+    
+    if(locatefile_extended(filename, &volume, &type, NULL, 0) || path_toabsolutesystempath(volume, filename, path) != MAX_ERR_NONE)
+    {
+        object_error((t_object*)x, "can't find %s", atom_getsym(argv)->s_name);
+        return;
+    }
+    
+    MappedFile* file = new MappedFile();
+    
+    if(!file->open(pa_readbuffer1_mappings(), path, (argc >= 2) ? (long)atom_getlong(argv + 1) : 1))
+    {
+        object_error((t_object*)x, "can't map %s: %s", atom_getsym(argv)->s_name, file->error().c_str());
+        delete file;
+        return;
+    }
+    
+    x->m_latest = file;
+    x->m_files->publish(file);
+}
+
+//! @brief Load the pages of the file ahead of the play head in advance, every half of the time ahead (message thread).
+void pa_readbuffer1_advise(t_pa_readbuffer1_tilde *x)
+{
+    if(x->m_prefetch <= 0.) return;
+    
+    if(x->m_latest)
+    {
+        x->m_latest->advise((long)(x->m_prefetch * 0.001 * sys_getsr()));
+    }
+    
+    clock_fdelay(x->m_prefetch_clock, std::max(x->m_prefetch * 0.5, 10.));
+}
+
+//! @brief Set the time ahead of the play head (in ms at 1x) whose pages are loaded in advance, 0 to let the reads load them.
+void pa_readbuffer1_prefetch(t_pa_readbuffer1_tilde *x, double ms)
+{
+    x->m_prefetch = std::max(ms, 0.);
+    
+    if(x->m_prefetch > 0.)
+    {
+        clock_delay(x->m_prefetch_clock, 0);
+    }
+    else
+    {
+        clock_unset(x->m_prefetch_clock);
+    }
+}
+
+//! @brief Select the channels read by the outlets (from 1), in order.
+void pa_readbuffer1_channels(t_pa_readbuffer1_tilde *x, t_symbol *s, long argc, t_atom *argv)
+{
+    for(long c = 0; c < argc && c < x->m_number_of_outlets; ++c)
+    {
+        const t_atom_long channel = atom_getlong(argv + c);
+        
+        if(channel < 1)
+        {
+            object_error((t_object*)x, "channel must be >= 1");
+        }
+        
+        x->m_channels[c] = (long)std::max(channel, (t_atom_long)1) - 1;
+    }
 }
 
 void pa_readbuffer1_dsp_prepare(t_pa_readbuffer1_tilde *x, t_object *dsp64,
                                 short *count, double samplerate, long maxvectorsize, long flags)
 {
+    pa_readbuffer1_refresh(x);
+    
     dsp_add64(dsp64, (t_object *)x, (t_perfroutine64)pa_readbuffer1_dsp_perform, 0, NULL);
 }
 
@@ -81,27 +343,68 @@ void pa_readbuffer1_assist(t_pa_readbuffer1_tilde* x, void* unused,
 {
     if(io == ASSIST_OUTLET)
     {
-        strncpy(string_dest, "(signal) Output", ASSIST_STRING_MAXSIZE);
+        snprintf(string_dest, ASSIST_STRING_MAXSIZE, "(signal) Output of channel %ld", x->m_channels[index] + 1);
     }
     else
     {
-        strncpy(string_dest,"(signal) Sample", ASSIST_STRING_MAXSIZE);
+        strncpy(string_dest,"(signal) Sample, (channels) select the channels, (map) read a file in place, (prefetch) ms", ASSIST_STRING_MAXSIZE);
     }
 }
 
+//! @brief The planar copy is rebuilt by the clock, once for all the readers of the buffer~ and at most once per refresh_interval.
 t_max_err pa_readbuffer1_notify(t_pa_readbuffer1_tilde *x, t_symbol *s, t_symbol *msg, void *sender, void *data)
 {
+    if(msg == gensym("buffer_modified"))
+    {
+        x->m_cache.load()->invalidate();
+        pa_readbuffer1_schedule_refresh(x);
+    }
+    
     return buffer_ref_notify(x->m_buffer_reference, s, msg, sender, data);
 }
 
-void *pa_readbuffer1_new(t_symbol *s)
+void *pa_readbuffer1_new(t_symbol *name, long argc, t_atom *argv)
 {
     t_pa_readbuffer1_tilde* x = (t_pa_readbuffer1_tilde*)object_alloc(this_class);
     
     if(x)
     {
+        t_symbol* s = (argc >= 1 && atom_gettype(argv) == A_SYM) ? atom_getsym(argv) : gensym("");
+        long noutlets = 1;
+        
+        // init number of outlets
+        if(argc >= 2 && atom_gettype(argv+1) == A_LONG)
+        {
+            noutlets = (long)atom_getlong(argv+1);
+            if(noutlets < 1)
+            {
+                noutlets = 1;
+            }
+        }
+        
+        // outlet i reads channel i by default
+        x->m_number_of_outlets = noutlets;
+        x->m_channels = (long*)calloc(noutlets, sizeof(long));
+        for(long c = 0; c < noutlets; ++c)
+        {
+            x->m_channels[c] = c;
+        }
+        
+        // instantiate a new Handoff object (the files are unmapped with it)
+        // Note: dont forget to delete it in the free method !
+        x->m_files = new Handoff<MappedFile>();
+        x->m_latest = nullptr;
+        x->m_prefetch = 0.;
+        
+        x->m_clock = clock_new(x, (method)pa_readbuffer1_refresh);
+        x->m_refresh_scheduled = false;
+        x->m_prefetch_clock = clock_new(x, (method)pa_readbuffer1_advise);
+        
         dsp_setup((t_pxobject *)x, 1);
-        outlet_new((t_object *)x, "signal");
+        for(long c = 0; c < noutlets; ++c)
+        {
+            outlet_new((t_object *)x, "signal");
+        }
         
         pa_readbuffer1_set(x, s);
     }
@@ -113,16 +416,24 @@ void *pa_readbuffer1_new(t_symbol *s)
 void pa_readbuffer1_free(t_pa_readbuffer1_tilde *x)
 {
     dsp_free((t_pxobject *)x);
+    freeobject(x->m_clock);
+    freeobject(x->m_prefetch_clock);
+    x->m_cache.load()->release();
     object_free(x->m_buffer_reference);
+    free(x->m_channels);
+    delete x->m_files;
 }
 
 void ext_main(void *r)
 {
     t_class *c = class_new("pa.readbuffer1~", (method)pa_readbuffer1_new, (method)pa_readbuffer1_free,
-                           sizeof(t_pa_readbuffer1_tilde), 0L, A_SYM, 0);
+                           sizeof(t_pa_readbuffer1_tilde), 0L, A_GIMME, 0);
     
     class_addmethod(c, (method)pa_readbuffer1_dsp_prepare,   "dsp64",    A_CANT,     0);
     class_addmethod(c, (method)pa_readbuffer1_set,           "set",      A_SYM,      0);
+    class_addmethod(c, (method)pa_readbuffer1_channels,      "channels", A_GIMME,    0);
+    class_addmethod(c, (method)pa_readbuffer1_map,           "map",      A_GIMME,    0);
+    class_addmethod(c, (method)pa_readbuffer1_prefetch,      "prefetch", A_FLOAT,    0);
     class_addmethod(c, (method)pa_readbuffer1_assist,        "assist",   A_CANT,     0);
     class_addmethod(c, (method)pa_readbuffer1_notify,        "notify",   A_CANT,     0);
     
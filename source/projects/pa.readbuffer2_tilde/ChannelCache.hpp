@@ -0,0 +1,438 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                   CHANNEL CACHE                                  //
+    // ================================================================================ //
+
+    //! @brief A planar copy of the interleaved samples of a buffer~, shared by all its readers.
+    //! @details Each channel is stored contiguously (a read uses every byte of a cache line, whatever the number of channels),
+    //! surrounded by Guard frames copied from its other end so that an interpolation never wraps.
+    //! The copy is rebuilt by the message thread (build()) and swapped in atomically: the audio thread pins the current copy
+    //! for the duration of a perform routine (see Pin), a replaced copy is retired and only deleted by a later reclaim()
+    //! once no perform routine pins it, the message thread never waits for the audio thread.
+    //! The caches are registered by the name of their buffer~ in a Registry shared by all the externals that read them,
+    //! they are never deleted (a reader may switch to another buffer while the audio thread uses the previous cache),
+    //! only their copies are, when their last reader releases them.
+    //!
+    //! If a reader asks for levels, the copy is followed by a mip-map: level l is the buffer~ low-passed and decimated by 2^l,
+    //! a reader that transposes up reads a level where it doesn't skip samples (no aliasing).
+    //! The levels are built by a background thread after the copy, then swapped in with it.
+    class ChannelCache
+    {
+    public: // methods
+
+        //! @brief The number of frames copied before and after each channel.
+        static const long Guard = 16;
+
+        //! @brief The largest number of levels (up to 128x).
+        static const long MaxLevels = 8;
+
+        //! @brief The planar samples of a level, frames + 2 * Guard samples per channel.
+        struct Level
+        {
+            long                m_frames;
+            std::vector<float>  m_samples;
+
+            //! @brief Returns the first sample of a channel (the Guard samples before it can be read).
+            float const* channel(long index) const
+            {
+                return m_samples.data() + index * (m_frames + 2 * Guard) + Guard;
+            }
+        };
+
+        //! @brief The levels of a copy, level 0 holds the samples of the buffer~.
+        struct Planar
+        {
+            long                                    m_frames;
+            long                                    m_channels;
+            std::vector<std::shared_ptr<Level>>     m_levels;
+
+            //! @brief Returns the first sample of a channel (level 0).
+            float const* channel(long index) const
+            {
+                return m_levels[0]->channel(index);
+            }
+
+            //! @brief Returns the number of levels built.
+            long levels() const
+            {
+                return (long)m_levels.size();
+            }
+
+            //! @brief Returns a level (the last one built if it doesn't exist yet).
+            Level const& level(long index) const
+            {
+                return *m_levels[std::min(index, levels() - 1)];
+            }
+        };
+
+        //! @brief Pins the current copy while a perform routine reads it (audio thread).
+        class Pin
+        {
+        public: // methods
+
+            Pin(ChannelCache& cache) : m_cache(cache)
+            {
+                m_cache.m_pins.fetch_add(1, std::memory_order_seq_cst);
+                m_planar = m_cache.m_current.load(std::memory_order_seq_cst);
+            }
+
+            ~Pin()
+            {
+                m_cache.m_pins.fetch_sub(1, std::memory_order_release);
+            }
+
+            Pin(Pin const&) = delete;
+            Pin& operator=(Pin const&) = delete;
+
+            //! @brief Returns the current copy, nullptr if the buffer~ doesn't exist or is empty.
+            Planar const* get() const { return m_planar; }
+
+        private: // variables
+
+            ChannelCache&   m_cache;
+            Planar const*   m_planar;
+        };
+
+        //! @brief The caches by the name of their buffer~.
+        //! @details A single registry is shared by all the externals (bound to a symbol), so a buffer~ read
+        //! by pa.readbuffer1~ and pa.readbuffer2~ has one copy: they must be built with the same ChannelCache.
+        using Registry = std::map<void const*, std::unique_ptr<ChannelCache>>;
+
+        //! @brief Returns the cache of a buffer~ and counts a reader (message thread).
+        //! @param caches The registry of the caches.
+        //! @param key The name of the buffer~ (a t_symbol* is unique).
+        //! @param levels The number of levels needed by the reader, the cache builds the most asked.
+        static ChannelCache* acquire(Registry& caches, void const* key, long levels = 1)
+        {
+            std::unique_ptr<ChannelCache>& cache = caches[key];
+            if(!cache) cache.reset(new ChannelCache());
+
+            cache->m_readers++;
+            cache->request(levels);
+
+            return cache.get();
+        }
+
+        //! @brief Delete the copies retired by all the caches that no perform routine pins anymore (message thread).
+        //! @return true if some copies are still pinned, the caller tries again later (eg. on its next clock tick).
+        static bool reclaim(Registry& caches)
+        {
+            bool pinned = false;
+
+            for(auto& cache : caches)
+            {
+                pinned |= !cache.second->reclaim();
+            }
+
+            return pinned;
+        }
+
+        //! @brief Uncount a reader, the copy is retired with the last one (message thread).
+        void release()
+        {
+            if(--m_readers == 0)
+            {
+                stop();
+                publish(nullptr);
+                m_stale = true;
+                m_levels = 1;
+            }
+        }
+
+        //! @brief Destructor
+        ~ChannelCache()
+        {
+            stop();
+            delete m_current.load();
+
+            for(Planar* planar : m_retired)
+            {
+                delete planar;
+            }
+        }
+
+        ChannelCache(ChannelCache const&) = delete;
+        ChannelCache& operator=(ChannelCache const&) = delete;
+
+        //! @brief Ask for more levels than the readers did so far (message thread).
+        //! @details The levels are built with the next copy: the copy is then stale (see stale()).
+        void request(long levels)
+        {
+            if(levels > m_levels)
+            {
+                m_levels = std::min(levels, MaxLevels);
+                m_stale = true;
+            }
+        }
+
+        //! @brief The buffer~ has been modified, the copy must be rebuilt (message thread).
+        //! @details The readers coalesce the modifications: they rebuild the copy on a clock, once for all of them (see stale()).
+        void invalidate() { m_stale = true; }
+
+        //! @brief Returns true if the copy must be rebuilt (message thread).
+        bool stale() const { return m_stale; }
+
+        //! @brief Rebuild the copy from the interleaved samples of the buffer~ (message thread).
+        //! @details The levels are built in the background, a build of the previous samples is abandoned.
+        //! @param samples The samples or nullptr if the buffer~ doesn't exist.
+        void build(float const* samples, long frames, long channels)
+        {
+            stop();
+
+            Planar* planar = nullptr;
+
+            if(samples && frames > 0 && channels > 0)
+            {
+                std::shared_ptr<Level> level(new Level {frames, std::vector<float>(channels * (frames + 2 * Guard))});
+
+                for(long c = 0; c < channels; ++c)
+                {
+                    float* out = level->m_samples.data() + c * (frames + 2 * Guard) + Guard;
+
+                    for(long i = 0; i < frames; ++i)
+                    {
+                        out[i] = samples[i * channels + c];
+                    }
+
+                    wrap(out, frames);
+                }
+
+                planar = new Planar {frames, channels, {level}};
+            }
+
+            publish(planar);
+            m_stale = false;
+
+            if(planar && m_levels > 1)
+            {
+                m_cancel.store(false, std::memory_order_relaxed);
+                m_builder = std::thread(&ChannelCache::buildLevels, this, *planar, m_levels);
+            }
+        }
+
+    private: // methods
+
+        ChannelCache() = default;
+
+        //! @brief Copy the ends of a channel in its guards.
+        static void wrap(float* samples, long frames)
+        {
+            for(long i = 1; i <= Guard; ++i)
+            {
+                samples[-i] = samples[frames - 1 - (i - 1) % frames];
+                samples[frames - 1 + i] = samples[(i - 1) % frames];
+            }
+        }
+
+        //! @brief Returns the coefficients of the low-pass filter of the levels.
+        //! @details A Kaiser windowed sinc (127 taps, beta 9, about -90 dB) cutting at 0.23 of the sampling rate of a level,
+        //! below the Nyquist frequency of the next one.
+        static std::vector<float> const& lowpass()
+        {
+            static const std::vector<float> coefficients = []
+            {
+                const long taps = 127;
+                const double cutoff = 0.23, beta = 9.;
+                std::vector<float> h(taps);
+                double sum = 0.;
+
+                for(long k = 0; k < taps; ++k)
+                {
+                    const double t = double(k - taps / 2);
+                    const double r = t / double(taps / 2);
+                    const double x = 2. * M_PI * cutoff * t;
+                    const double sinc = (t == 0.) ? 1. : std::sin(x) / x;
+                    const double value = 2. * cutoff * sinc * bessel(beta * std::sqrt(1. - r * r)) / bessel(beta);
+
+                    h[k] = float(value);
+                    sum += value;
+                }
+
+                for(float& value : h) value = float(value / sum);
+                return h;
+            }();
+
+            return coefficients;
+        }
+
+        //! @brief The modified Bessel function of the first kind I0 (for the Kaiser window).
+        static double bessel(double x)
+        {
+            double sum = 1., term = 1.;
+
+            for(int k = 1; k < 32; ++k)
+            {
+                term *= (x / (2. * k)) * (x / (2. * k));
+                sum += term;
+            }
+
+            return sum;
+        }
+
+        //! @brief Low-pass and decimate a level by 2 (background thread).
+        //! @details The filter is split in its even and odd taps, applied to the even and odd samples of the channel:
+        //! each tap is added to a block of outputs at once (a loop that the compiler vectorizes).
+        //! @return nullptr if the build has been abandoned.
+        std::shared_ptr<Level> decimate(Level const& in, long channels)
+        {
+            static const long Block = 256;
+
+            std::vector<float> const& h = lowpass();
+            const long taps = (long)h.size();
+            const long half = taps / 2;
+            const long frames = (in.m_frames + 1) / 2;
+            std::shared_ptr<Level> out(new Level {frames, std::vector<float>(channels * (frames + 2 * Guard))});
+
+            // the even and odd samples of the channel, from half samples before it, extended as a loop
+            const long size = frames + taps / 2 + 1;
+            std::vector<float> even(size), odd(size);
+
+            for(long c = 0; c < channels; ++c)
+            {
+                if(m_cancel.load(std::memory_order_relaxed)) return nullptr;
+
+                float const* samples = in.channel(c);
+
+                for(long i = 0; i < size; ++i)
+                {
+                    even[i] = samples[((2 * i - half) % in.m_frames + in.m_frames) % in.m_frames];
+                    odd[i] = samples[((2 * i + 1 - half) % in.m_frames + in.m_frames) % in.m_frames];
+                }
+
+                float* outs = out->m_samples.data() + c * (frames + 2 * Guard) + Guard;
+
+                for(long start = 0; start < frames; start += Block)
+                {
+                    // the message thread waits for the abandoned builds (see stop())
+                    if(m_cancel.load(std::memory_order_relaxed)) return nullptr;
+
+                    float* block = outs + start;
+                    const long count = std::min(Block, frames - start);
+
+                    std::fill(block, block + count, 0.f);
+
+                    for(long k = 0; k < taps; ++k)
+                    {
+                        const float coefficient = h[k];
+                        float const* x = ((k & 1) ? odd.data() : even.data()) + start + k / 2;
+
+                        for(long j = 0; j < count; ++j)
+                        {
+                            block[j] += coefficient * x[j];
+                        }
+                    }
+                }
+
+                wrap(outs, frames);
+            }
+
+            return out;
+        }
+
+        //! @brief Build the levels after the first one, then swap them in (background thread).
+        void buildLevels(Planar planar, long levels)
+        {
+            while(planar.levels() < levels && planar.m_levels.back()->m_frames > 1)
+            {
+                std::shared_ptr<Level> level = decimate(*planar.m_levels.back(), planar.m_channels);
+                if(!level) return;
+
+                planar.m_levels.push_back(level);
+            }
+
+            // the copy being read shares the first levels
+            swap(new Planar(planar));
+        }
+
+        //! @brief Abandon the build of the levels and wait for the background thread (message thread).
+        void stop()
+        {
+            if(m_builder.joinable())
+            {
+                m_cancel.store(true, std::memory_order_relaxed);
+                m_builder.join();
+            }
+        }
+
+        //! @brief Swap the copy in and retire the previous one, deleted by reclaim() once it isn't pinned anymore (message thread).
+        //! @details The message thread only publishes once the background thread is stopped.
+        void publish(Planar* planar)
+        {
+            Planar* const previous = m_current.exchange(planar, std::memory_order_seq_cst);
+
+            if(previous)
+            {
+                m_retired.push_back(previous);
+            }
+
+            reclaim();
+        }
+
+        //! @brief Delete the retired copies if no perform routine pins the cache (message thread).
+        //! @details A perform routine counts its pin before it loads the current copy: once the count is seen at zero
+        //! after a copy has been swapped out, no perform routine can read it anymore.
+        //! @return false if some retired copies are still pinned.
+        bool reclaim()
+        {
+            if(m_retired.empty()) return true;
+            if(m_pins.load(std::memory_order_seq_cst) != 0) return false;
+
+            for(Planar* planar : m_retired)
+            {
+                delete planar;
+            }
+
+            m_retired.clear();
+            return true;
+        }
+
+        //! @brief Swap the copy with its levels in, then delete the previous one once it isn't pinned anymore (background thread).
+        //! @details The perform routines pin the cache for a vector at most, the background thread can wait for them.
+        void swap(Planar* planar)
+        {
+            Planar* const previous = m_current.exchange(planar, std::memory_order_seq_cst);
+
+            while(m_pins.load(std::memory_order_seq_cst) != 0)
+            {
+                std::this_thread::yield();
+            }
+
+            delete previous;
+        }
+
+    private: // variables
+
+        std::atomic<Planar*>    m_current {nullptr};
+        std::atomic<long>       m_pins {0};
+
+        // the copies swapped out by the message thread, not deleted yet
+        std::vector<Planar*>    m_retired;
+
+        // the background thread that builds the levels
+        std::thread             m_builder;
+        std::atomic<bool>       m_cancel {false};
+
+        // message thread
+        long                    m_readers = 0;
+        long                    m_levels = 1;
+        bool                    m_stale = true;
+    };
+}
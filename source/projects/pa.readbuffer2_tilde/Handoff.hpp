@@ -0,0 +1,128 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <atomic>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                      HANDOFF                                     //
+    // ================================================================================ //
+
+    //! @brief Hands objects built by the message thread over to the audio thread.
+    //! @details The audio thread never allocates nor frees, objects go through two atomic slots:
+    //! - publish() stores a new object in the pending slot (message thread).
+    //! - update() makes the pending object current and retires the previous one (audio thread).
+    //! - reclaim() deletes the retired object (message thread, eg. from a clock).
+    //! A pending object is only adopted once the previous retired one has been reclaimed,
+    //! and once it is ready when the audio thread prepares it over several vectors (eg. copies a history in chunks).
+    template<class T>
+    class Handoff
+    {
+    public: // methods
+
+        //! @brief Default constructor
+        Handoff() = default;
+
+        //! @brief Destructor
+        //! @details The audio thread must not use the current object anymore.
+        ~Handoff()
+        {
+            delete m_pending.exchange(nullptr);
+            delete m_retired.exchange(nullptr);
+            delete m_incoming;
+            delete m_current;
+        }
+
+        Handoff(Handoff const&) = delete;
+        Handoff& operator=(Handoff const&) = delete;
+
+        //! @brief Publish a new object (message thread)
+        //! @details An object published earlier and not yet adopted is deleted.
+        void publish(T* object)
+        {
+            reclaim();
+            delete m_pending.exchange(object, std::memory_order_acq_rel);
+        }
+
+        //! @brief Delete the object retired by the audio thread, if any (message thread)
+        void reclaim()
+        {
+            delete m_retired.exchange(nullptr, std::memory_order_acquire);
+        }
+
+        //! @brief Prepare then adopt the last published object (audio thread)
+        //! @details The object is taken from the pending slot once the retired one has been reclaimed,
+        //! then prepare is called at each vector until it returns true: an object published meanwhile waits for the next update.
+        //! @param prepare Called with the new object and the current one (if any), returns true once the new one is ready.
+        //! @param adopt Called with the new and the previous object (if any) before the swap.
+        //! @return true if the previous object has been retired and needs to be reclaimed.
+        template<class Prepare, class Adopt>
+        bool update(Prepare&& prepare, Adopt&& adopt)
+        {
+            if(m_incoming == nullptr)
+            {
+                if(m_retired.load(std::memory_order_acquire) != nullptr)
+                {
+                    return false;
+                }
+
+                m_incoming = m_pending.exchange(nullptr, std::memory_order_acq_rel);
+            }
+
+            if(m_incoming == nullptr || (m_current != nullptr && !prepare(*m_incoming, *m_current)))
+            {
+                return false;
+            }
+
+            T* const object = m_incoming;
+            m_incoming = nullptr;
+
+            adopt(*object, m_current);
+
+            T* const old = m_current;
+            m_current = object;
+
+            if(old != nullptr)
+            {
+                m_retired.store(old, std::memory_order_release);
+                return true;
+            }
+
+            return false;
+        }
+
+        //! @brief Adopt the last published object (audio thread)
+        //! @param adopt Called with the new and the previous object (if any) before the swap.
+        //! @return true if the previous object has been retired and needs to be reclaimed.
+        template<class Function>
+        bool update(Function&& adopt)
+        {
+            return update([](T&, T const&) { return true; }, adopt);
+        }
+
+        //! @brief Adopt the last published object (audio thread)
+        bool update()
+        {
+            return update([](T&, T const*) {});
+        }
+
+        //! @brief Returns the current object (audio thread)
+        T* get() const
+        {
+            return m_current;
+        }
+
+    private: // variables
+
+        std::atomic<T*>     m_pending {nullptr};
+        std::atomic<T*>     m_retired {nullptr};
+        T*                  m_incoming = nullptr;
+        T*                  m_current = nullptr;
+    };
+}
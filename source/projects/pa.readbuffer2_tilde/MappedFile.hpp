@@ -0,0 +1,370 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                    MAPPED FILE                                   //
+    // ================================================================================ //
+
+    //! @brief The samples of a 32 bits float WAV file (or a raw file of interleaved floats) read in place in a memory mapping.
+    //! @details The file is mapped read-only and shared: all the readers of a file (the same device and inode) use the same mapping,
+    //! whose pages are the ones of the page cache of the system. Nothing is copied but the frames around the ends of the file:
+    //! a read that needs the frames after the last one (or before the first one) reads the edges, a planar copy of
+    //! the 2 * Guard last frames followed by the 2 * Guard first ones (see edge()).
+    //! The pages are loaded by the first read of each one, advise() asks the system to load the ones around the play head in advance.
+    //! The samples are read as floats of the byte order of the host (little endian).
+    class MappedFile
+    {
+    private: // classes
+
+        struct Mapping;
+
+    public: // classes
+
+        //! @brief The mappings by the device and the inode of their file.
+        //! @details A single registry is shared by all the externals (bound to a symbol), so the readers of a file
+        //! share its mapping whatever their external. The entries of the unmapped files are erased by the next lookup.
+        using Registry = std::map<std::pair<uint64_t, uint64_t>, std::weak_ptr<Mapping>>;
+
+    public: // methods
+
+        //! @brief The largest number of frames read before and after a position.
+        static const long Guard = 16;
+
+        //! @brief The number of frames of each channel of the edges.
+        static const long EdgeFrames = 4 * Guard;
+
+        //! @brief Default constructor, an empty file (see open()).
+        MappedFile() = default;
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
+
+        //! @brief Map a file, or share the mapping of another reader of the file (message thread).
+        //! @param mappings The registry of the mappings.
+        //! @param path The file: a WAV file of 32 bits floats, any other file is read as raw interleaved floats.
+        //! @param channels The number of channels of a raw file.
+        //! @return false if the file can't be mapped (see error()).
+        bool open(Registry& mappings, std::string const& path, long channels = 1)
+        {
+            m_mapping = share(mappings, path, m_error);
+
+            if(!m_mapping)
+            {
+                return false;
+            }
+
+            uint8_t const* bytes = (uint8_t const*)m_mapping->m_base;
+            const size_t length = m_mapping->m_length;
+            size_t offset = 0, size = length;
+
+            m_channels = std::max(channels, 1L);
+            m_samplerate = 0.;
+
+            if(length >= 12 && (match(bytes, "RIFF") || match(bytes, "RF64")) && match(bytes + 8, "WAVE"))
+            {
+                if(!parseWave(bytes, length, offset, size)) return fail();
+            }
+
+            // the samples are read as floats in place
+            if(offset % sizeof(float) != 0)
+            {
+                m_error = "the samples are not aligned on 4 bytes";
+                return fail();
+            }
+
+            m_frames = long(size / (sizeof(float) * size_t(m_channels)));
+
+            if(m_frames < 1)
+            {
+                m_error = "the file has no samples";
+                return fail();
+            }
+
+            // the indices of the SIMD kernels are 32 bits integers
+            if(int64_t(m_frames) * m_channels + Guard >= (int64_t(1) << 31))
+            {
+                m_error = "the file is too large to be read in place (2^31 samples at most)";
+                return fail();
+            }
+
+            m_samples = (float const*)(bytes + offset);
+            m_edges.resize(size_t(EdgeFrames * m_channels));
+
+            for(long c = 0; c < m_channels; ++c)
+            {
+                for(long k = 0; k < EdgeFrames; ++k)
+                {
+                    const long frame = ((k - 2 * Guard) % m_frames + m_frames) % m_frames;
+                    m_edges[c * EdgeFrames + k] = m_samples[frame * m_channels + c];
+                }
+            }
+
+            return true;
+        }
+
+        //! @brief Returns true if a file is mapped.
+        bool isOpen() const { return m_samples != nullptr; }
+
+        //! @brief Returns the reason why the file couldn't be mapped.
+        std::string const& error() const { return m_error; }
+
+        //! @brief Returns the number of channels.
+        long channels() const { return m_channels; }
+
+        //! @brief Returns the number of frames.
+        long frames() const { return m_frames; }
+
+        //! @brief Returns the sampling rate of a WAV file, 0 for a raw file.
+        double samplerate() const { return m_samplerate; }
+
+        //! @brief Returns the first sample of a channel in the mapping, the samples of a channel are channels() floats apart.
+        float const* channel(long index) const { return m_samples + index; }
+
+        //! @brief Returns true if the frames around a position (Guard frames on both sides) are in the mapping.
+        bool inside(double position) const
+        {
+            return position >= double(Guard) && position < double(m_frames - Guard);
+        }
+
+        //! @brief Returns the position in the edges of a position near an end of the file (see inside()).
+        double edge(double position) const
+        {
+            return (position < double(Guard)) ? position + double(2 * Guard) : position - double(m_frames) + double(2 * Guard);
+        }
+
+        //! @brief Returns the first frame of a channel of the edges (planar, EdgeFrames frames).
+        float const* edges(long index) const { return m_edges.data() + index * EdgeFrames; }
+
+        //! @brief Set the play head (audio thread).
+        //! @param position The position of the play head in frames.
+        //! @param forward The direction of the play.
+        void play(double position, bool forward)
+        {
+            m_position.store(position, std::memory_order_relaxed);
+            m_forward.store(forward, std::memory_order_relaxed);
+        }
+
+        //! @brief Ask the system to load the pages of the frames ahead of the play head (message thread).
+        //! @details A hint (madvise MADV_WILLNEED): the pages are read in the background and the call doesn't wait for them.
+        //! @param ahead The number of frames ahead of the play head, in the direction of the play (wrapped around the file).
+        void advise(long ahead) const
+        {
+            const long first = std::min(std::max(long(m_position.load(std::memory_order_relaxed)), 0L), m_frames - 1);
+            ahead = std::min(std::max(ahead, 1L), m_frames);
+
+            if(m_forward.load(std::memory_order_relaxed))
+            {
+                adviseFrames(first, std::min(ahead, m_frames - first));
+                adviseFrames(0, ahead - std::min(ahead, m_frames - first));
+            }
+            else
+            {
+                adviseFrames(std::max(first + 1 - ahead, 0L), std::min(ahead, first + 1));
+                adviseFrames(m_frames - (ahead - std::min(ahead, first + 1)), ahead - std::min(ahead, first + 1));
+            }
+        }
+
+    private: // methods
+
+        //! @brief A read-only mapping of a whole file, unmapped with its last reader.
+        struct Mapping
+        {
+            void*   m_base = nullptr;
+            size_t  m_length = 0;
+
+            ~Mapping()
+            {
+                #if defined(__unix__) || defined(__APPLE__)
+                if(m_base) munmap(m_base, m_length);
+                #endif
+            }
+        };
+
+        static bool match(uint8_t const* bytes, const char* tag)
+        {
+            return std::memcmp(bytes, tag, 4) == 0;
+        }
+
+        static uint32_t little32(uint8_t const* b) { return uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 | uint32_t(b[3]) << 24; }
+        static uint16_t little16(uint8_t const* b) { return uint16_t(b[0] | b[1] << 8); }
+        static uint64_t little64(uint8_t const* b) { return uint64_t(little32(b)) | uint64_t(little32(b + 4)) << 32; }
+
+        //! @brief Returns the mapping of a file, mapped by the first of its readers.
+        static std::shared_ptr<Mapping> share(Registry& mappings, std::string const& path, std::string& error)
+        {
+            #if defined(__unix__) || defined(__APPLE__)
+
+            // the files unmapped since the last lookup
+            for(auto it = mappings.begin(); it != mappings.end();)
+            {
+                it = it->second.expired() ? mappings.erase(it) : std::next(it);
+            }
+
+            const int file = ::open(path.c_str(), O_RDONLY);
+            struct stat status;
+
+            if(file < 0 || fstat(file, &status) != 0 || status.st_size <= 0)
+            {
+                error = (file < 0) ? "can't open the file" : "the file is empty";
+                if(file >= 0) ::close(file);
+                return nullptr;
+            }
+
+            std::weak_ptr<Mapping>& shared = mappings[{uint64_t(status.st_dev), uint64_t(status.st_ino)}];
+            std::shared_ptr<Mapping> mapping = shared.lock();
+
+            if(!mapping)
+            {
+                void* base = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+
+                if(base != MAP_FAILED)
+                {
+                    mapping = std::make_shared<Mapping>();
+                    mapping->m_base = base;
+                    mapping->m_length = size_t(status.st_size);
+                    shared = mapping;
+                }
+                else
+                {
+                    error = "can't map the file";
+                }
+            }
+
+            // the mapping stays valid once the file is closed
+            ::close(file);
+            return mapping;
+
+            #else
+
+            error = "memory mapped files are not supported on this system";
+            return nullptr;
+
+            #endif
+        }
+
+        //! @brief Find the samples of a WAV file.
+        bool parseWave(uint8_t const* bytes, size_t length, size_t& offset, size_t& size)
+        {
+            size_t position = 12;
+            uint64_t data_size = 0;
+            bool format = false;
+
+            while(position + 8 <= length)
+            {
+                uint8_t const* chunk = bytes + position;
+                uint64_t chunk_size = little32(chunk + 4);
+                const size_t body = position + 8;
+
+                if(match(chunk, "ds64") && body + 16 <= length)
+                {
+                    data_size = little64(bytes + body + 8);
+                }
+                else if(match(chunk, "fmt ") && chunk_size >= 16 && body + 16 <= length)
+                {
+                    uint16_t tag = little16(bytes + body);
+
+                    // WAVE_FORMAT_EXTENSIBLE: the format is the beginning of the sub format
+                    if(tag == 0xFFFE && chunk_size >= 26 && body + 26 <= length) tag = little16(bytes + body + 24);
+
+                    if(tag != 3 || little16(bytes + body + 14) != 32)
+                    {
+                        m_error = "only the WAV files of 32 bits floats can be read in place";
+                        return false;
+                    }
+
+                    m_channels = little16(bytes + body + 2);
+                    m_samplerate = little32(bytes + body + 4);
+                    format = true;
+                }
+                else if(match(chunk, "data"))
+                {
+                    if(!format || m_channels < 1)
+                    {
+                        m_error = "no format before the samples";
+                        return false;
+                    }
+
+                    if(chunk_size == 0xFFFFFFFF) chunk_size = data_size;
+
+                    // a truncated file is read up to its end
+                    offset = body;
+                    size = size_t(std::min<uint64_t>(chunk_size, length - body));
+                    return true;
+                }
+
+                // the chunks are padded to an even size
+                position = body + size_t(chunk_size + (chunk_size & 1));
+            }
+
+            m_error = "no samples in the WAV file";
+            return false;
+        }
+
+        bool fail()
+        {
+            m_mapping.reset();
+            m_samples = nullptr;
+            m_frames = 0;
+            return false;
+        }
+
+        //! @brief Advise the pages of count frames from a frame.
+        void adviseFrames(long first, long count) const
+        {
+            #if defined(__unix__) || defined(__APPLE__)
+
+            if(count <= 0) return;
+
+            const size_t page = size_t(sysconf(_SC_PAGESIZE));
+            const uintptr_t begin = uintptr_t(m_samples + first * m_channels) / page * page;
+            const uintptr_t end = uintptr_t(m_samples + (first + count) * m_channels);
+
+            madvise((void*)begin, size_t(end - begin), MADV_WILLNEED);
+
+            #endif
+        }
+
+    private: // variables
+
+        std::shared_ptr<Mapping>    m_mapping;
+        std::string                 m_error;
+
+        float const*                m_samples = nullptr;
+        long                        m_channels = 0;
+        long                        m_frames = 0;
+        double                      m_samplerate = 0.;
+
+        // the frames around the ends of the file
+        std::vector<float>          m_edges;
+
+        // the play head
+        std::atomic<double>         m_position {0.};
+        std::atomic<bool>           m_forward {true};
+    };
+}
@@ -0,0 +1,390 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include "Phasor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                 PLAYBACK KERNELS                                 //
+    // ================================================================================ //
+    
+    //! @brief The coefficients of the windowed sinc interpolation, for Phases fractions of a sample (and 1.).
+    //! @details A Kaiser windowed sinc (beta 8) of Taps taps, cutting at 0.45 of the sampling rate,
+    //! each phase is normalized to a unit gain. A tap k is applied to the sample index - (Taps / 2 - 1) + k.
+    struct SincTable
+    {
+        static const long Taps = 32;
+        static const long Phases = 512;
+        
+        SincTable() : m_coefficients((Phases + 1) * Taps)
+        {
+            const double cutoff = 0.45, beta = 8.;
+            
+            for(long phase = 0; phase <= Phases; ++phase)
+            {
+                const double frac = double(phase) / double(Phases);
+                float* row = m_coefficients.data() + phase * Taps;
+                double sum = 0.;
+                
+                for(long k = 0; k < Taps; ++k)
+                {
+                    const double t = double(k - (Taps / 2 - 1)) - frac;
+                    const double r = std::min(std::abs(t) / double(Taps / 2), 1.);
+                    const double x = 2. * M_PI * cutoff * t;
+                    const double sinc = (x == 0.) ? 1. : std::sin(x) / x;
+                    const double value = sinc * bessel(beta * std::sqrt(1. - r * r)) / bessel(beta);
+                    
+                    row[k] = float(value);
+                    sum += value;
+                }
+                
+                for(long k = 0; k < Taps; ++k)
+                {
+                    row[k] = float(row[k] / sum);
+                }
+            }
+        }
+        
+        //! @brief Returns the taps of a phase in [0, Phases].
+        float const* row(long phase) const
+        {
+            return m_coefficients.data() + phase * Taps;
+        }
+        
+        //! @brief The modified Bessel function of the first kind I0 (for the Kaiser window).
+        static double bessel(double x)
+        {
+            double sum = 1., term = 1.;
+            
+            for(int k = 1; k < 32; ++k)
+            {
+                term *= (x / (2. * k)) * (x / (2. * k));
+                sum += term;
+            }
+            
+            return sum;
+        }
+        
+        std::vector<float> m_coefficients;
+    };
+    
+    //! @brief Returns the sinc table, built by the first call (call it from the message thread first).
+    inline SincTable const& sincTable()
+    {
+        static const SincTable table;
+        return table;
+    }
+    
+    //! @brief Block kernels that read a channel of a buffer at a phase in [0, 1).
+    //! @details The phases are computed first for a block (see accumulatePhase and rampPhase),
+    //! then each phase is scaled to a position in frames and the frames around it are interpolated:
+    //! 2 frames for readLinear, 4 for readHermite, SincTable::Taps for readSinc.
+    //! The samples of a channel are surrounded by guard frames (see ChannelCache), the kernels never wrap.
+    //! The frames of a channel are contiguous or stride samples apart (a channel of interleaved frames, see MappedFile).
+    //! The generic versions are scalar, the double versions use AVX2 or SSE2 when the compiler targets them:
+    //! the frames of 4 phases are gathered (or 2 phases loaded one by one) for the linear and Hermite interpolations,
+    //! the taps of a phase are applied 8 (or 4) at a time for the sinc interpolation.
+    namespace simd
+    {
+        //! @brief outs[i] = the linear interpolation of a channel at phases[i].
+        //! @param samples The frames of the channel.
+        //! @param frames The number of frames (> 0).
+        //! @param scale The number of frames of a phase of 1., at most frames (see ChannelCache::Level).
+        //! @param stride The number of samples from a frame to the next one.
+        template<class T>
+        inline void readLinear(float const* samples, long frames, T scale, T const* phases, T* outs, long vecsize, long stride = 1)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const T position = phases[i] * scale;
+                
+                // a phase just below 1. may be rounded to the number of frames
+                const long index = std::min((long)position, frames - 1);
+                const T frac = position - T(index);
+                
+                const T y1 = samples[index * stride];
+                const T y2 = samples[(index + 1) * stride];
+                
+                outs[i] = y1 + frac * (y2 - y1);
+            }
+        }
+        
+        //! @brief outs[i] = the 4 points Hermite interpolation (Catmull-Rom) of a channel at phases[i].
+        template<class T>
+        inline void readHermite(float const* samples, long frames, T scale, T const* phases, T* outs, long vecsize, long stride = 1)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const T position = phases[i] * scale;
+                const long index = std::min((long)position, frames - 1);
+                const T frac = position - T(index);
+                
+                const T y0 = samples[(index - 1) * stride];
+                const T y1 = samples[index * stride];
+                const T y2 = samples[(index + 1) * stride];
+                const T y3 = samples[(index + 2) * stride];
+                
+                const T c1 = T(0.5) * (y2 - y0);
+                const T c2 = y0 - T(2.5) * y1 + T(2.) * y2 - T(0.5) * y3;
+                const T c3 = T(0.5) * (y3 - y0) + T(1.5) * (y1 - y2);
+                
+                outs[i] = ((c3 * frac + c2) * frac + c1) * frac + y1;
+            }
+        }
+        
+        //! @brief outs[i] = the windowed sinc interpolation of a channel at phases[i].
+        //! @details The taps of the two phases around the fraction are interpolated.
+        template<class T>
+        inline void readSinc(float const* samples, long frames, T scale, T const* phases, T* outs, long vecsize, long stride = 1)
+        {
+            SincTable const& table = sincTable();
+            
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const T position = phases[i] * scale;
+                const long index = std::min((long)position, frames - 1);
+                const T phase = (position - T(index)) * T(SincTable::Phases);
+                const long row = std::min((long)phase, SincTable::Phases - 1);
+                const float weight = float(phase - T(row));
+                
+                float const* h1 = table.row(row);
+                float const* h2 = table.row(row + 1);
+                float const* x = samples + (index - (SincTable::Taps / 2 - 1)) * stride;
+                float sum = 0.f;
+                
+                for(long k = 0; k < SincTable::Taps; ++k)
+                {
+                    sum += x[k * stride] * (h1[k] + weight * (h2[k] - h1[k]));
+                }
+                
+                outs[i] = sum;
+            }
+        }
+        
+        #if defined(__AVX2__)
+        
+        inline void readLinear(float const* samples, long frames, double scale, double const* phases, double* outs, long vecsize, long stride = 1)
+        {
+            const __m256d vscale = _mm256_set1_pd(scale);
+            const __m128i last = _mm_set1_epi32(int(frames - 1));
+            const __m128i vstride = _mm_set1_epi32(int(stride));
+            long i = 0;
+            
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                const __m256d position = _mm256_mul_pd(_mm256_loadu_pd(phases + i), vscale);
+                const __m128i index = _mm_min_epi32(_mm256_cvttpd_epi32(position), last);
+                const __m128i offset = _mm_mullo_epi32(index, vstride);
+                const __m256d frac = _mm256_sub_pd(position, _mm256_cvtepi32_pd(index));
+                
+                const __m256d y1 = _mm256_cvtps_pd(_mm_i32gather_ps(samples, offset, 4));
+                const __m256d y2 = _mm256_cvtps_pd(_mm_i32gather_ps(samples + stride, offset, 4));
+                
+                _mm256_storeu_pd(outs + i, _mm256_add_pd(y1, _mm256_mul_pd(frac, _mm256_sub_pd(y2, y1))));
+            }
+            
+            readLinear<double>(samples, frames, scale, phases + i, outs + i, vecsize - i, stride);
+        }
+        
+        inline void readHermite(float const* samples, long frames, double scale, double const* phases, double* outs, long vecsize, long stride = 1)
+        {
+            const __m256d vscale = _mm256_set1_pd(scale);
+            const __m128i last = _mm_set1_epi32(int(frames - 1));
+            const __m128i vstride = _mm_set1_epi32(int(stride));
+            const __m256d half = _mm256_set1_pd(0.5);
+            long i = 0;
+            
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                const __m256d position = _mm256_mul_pd(_mm256_loadu_pd(phases + i), vscale);
+                const __m128i index = _mm_min_epi32(_mm256_cvttpd_epi32(position), last);
+                const __m128i offset = _mm_mullo_epi32(index, vstride);
+                const __m256d frac = _mm256_sub_pd(position, _mm256_cvtepi32_pd(index));
+                
+                const __m256d y0 = _mm256_cvtps_pd(_mm_i32gather_ps(samples - stride, offset, 4));
+                const __m256d y1 = _mm256_cvtps_pd(_mm_i32gather_ps(samples, offset, 4));
+                const __m256d y2 = _mm256_cvtps_pd(_mm_i32gather_ps(samples + stride, offset, 4));
+                const __m256d y3 = _mm256_cvtps_pd(_mm_i32gather_ps(samples + 2 * stride, offset, 4));
+                
+                const __m256d c1 = _mm256_mul_pd(half, _mm256_sub_pd(y2, y0));
+                const __m256d c2 = _mm256_sub_pd(_mm256_add_pd(y0, _mm256_add_pd(y2, y2)),
+                                                 _mm256_mul_pd(half, _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(5.), y1), y3)));
+                const __m256d c3 = _mm256_add_pd(_mm256_mul_pd(half, _mm256_sub_pd(y3, y0)),
+                                                 _mm256_mul_pd(_mm256_set1_pd(1.5), _mm256_sub_pd(y1, y2)));
+                
+                __m256d out = _mm256_add_pd(_mm256_mul_pd(c3, frac), c2);
+                out = _mm256_add_pd(_mm256_mul_pd(out, frac), c1);
+                _mm256_storeu_pd(outs + i, _mm256_add_pd(_mm256_mul_pd(out, frac), y1));
+            }
+            
+            readHermite<double>(samples, frames, scale, phases + i, outs + i, vecsize - i, stride);
+        }
+        
+        inline void readSinc(float const* samples, long frames, double scale, double const* phases, double* outs, long vecsize, long stride = 1)
+        {
+            SincTable const& table = sincTable();
+            
+            // the taps of interleaved frames are gathered
+            const __m256i taps = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int(stride)));
+            
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const double position = phases[i] * scale;
+                const long index = std::min((long)position, frames - 1);
+                const double phase = (position - double(index)) * double(SincTable::Phases);
+                const long row = std::min((long)phase, SincTable::Phases - 1);
+                const __m256 weight = _mm256_set1_ps(float(phase - double(row)));
+                
+                float const* h1 = table.row(row);
+                float const* h2 = table.row(row + 1);
+                float const* x = samples + (index - (SincTable::Taps / 2 - 1)) * stride;
+                __m256 sum_0 = _mm256_setzero_ps();
+                __m256 sum_1 = _mm256_setzero_ps();
+                
+                auto load = [x, stride, taps](long k)
+                {
+                    return (stride == 1) ? _mm256_loadu_ps(x + k) : _mm256_i32gather_ps(x + k * stride, taps, 4);
+                };
+                
+                for(long k = 0; k < SincTable::Taps; k += 16)
+                {
+                    const __m256 h1_0 = _mm256_loadu_ps(h1 + k), h1_1 = _mm256_loadu_ps(h1 + k + 8);
+                    const __m256 h_0 = _mm256_add_ps(h1_0, _mm256_mul_ps(weight, _mm256_sub_ps(_mm256_loadu_ps(h2 + k), h1_0)));
+                    const __m256 h_1 = _mm256_add_ps(h1_1, _mm256_mul_ps(weight, _mm256_sub_ps(_mm256_loadu_ps(h2 + k + 8), h1_1)));
+                    
+                    sum_0 = _mm256_add_ps(sum_0, _mm256_mul_ps(load(k), h_0));
+                    sum_1 = _mm256_add_ps(sum_1, _mm256_mul_ps(load(k + 8), h_1));
+                }
+                
+                // horizontal sum of the 8 lanes
+                const __m256 sum = _mm256_add_ps(sum_0, sum_1);
+                __m128 lanes = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+                lanes = _mm_add_ps(lanes, _mm_movehl_ps(lanes, lanes));
+                lanes = _mm_add_ss(lanes, _mm_shuffle_ps(lanes, lanes, 1));
+                
+                outs[i] = _mm_cvtss_f32(lanes);
+            }
+        }
+        
+        #elif defined(__SSE2__) || defined(_M_X64)
+        
+        //! @details SSE2 has no gather: the indices are computed 2 at a time and the frames loaded one by one.
+        inline void readLinear(float const* samples, long frames, double scale, double const* phases, double* outs, long vecsize, long stride = 1)
+        {
+            const __m128d vscale = _mm_set1_pd(scale);
+            long i = 0;
+            
+            for(; i + 2 <= vecsize; i += 2)
+            {
+                const __m128d position = _mm_mul_pd(_mm_loadu_pd(phases + i), vscale);
+                const __m128i truncated = _mm_cvttpd_epi32(position);
+                
+                const long index_0 = std::min((long)_mm_cvtsi128_si32(truncated), frames - 1);
+                const long index_1 = std::min((long)_mm_cvtsi128_si32(_mm_shuffle_epi32(truncated, 1)), frames - 1);
+                
+                const __m128d frac = _mm_sub_pd(position, _mm_set_pd(double(index_1), double(index_0)));
+                const __m128d y1 = _mm_set_pd(samples[index_1 * stride], samples[index_0 * stride]);
+                const __m128d y2 = _mm_set_pd(samples[(index_1 + 1) * stride], samples[(index_0 + 1) * stride]);
+                
+                _mm_storeu_pd(outs + i, _mm_add_pd(y1, _mm_mul_pd(frac, _mm_sub_pd(y2, y1))));
+            }
+            
+            readLinear<double>(samples, frames, scale, phases + i, outs + i, vecsize - i, stride);
+        }
+        
+        inline void readHermite(float const* samples, long frames, double scale, double const* phases, double* outs, long vecsize, long stride = 1)
+        {
+            const __m128d vscale = _mm_set1_pd(scale);
+            const __m128d half = _mm_set1_pd(0.5);
+            long i = 0;
+            
+            for(; i + 2 <= vecsize; i += 2)
+            {
+                const __m128d position = _mm_mul_pd(_mm_loadu_pd(phases + i), vscale);
+                const __m128i truncated = _mm_cvttpd_epi32(position);
+                
+                const long index_0 = std::min((long)_mm_cvtsi128_si32(truncated), frames - 1);
+                const long index_1 = std::min((long)_mm_cvtsi128_si32(_mm_shuffle_epi32(truncated, 1)), frames - 1);
+                
+                const __m128d frac = _mm_sub_pd(position, _mm_set_pd(double(index_1), double(index_0)));
+                const __m128d y0 = _mm_set_pd(samples[(index_1 - 1) * stride], samples[(index_0 - 1) * stride]);
+                const __m128d y1 = _mm_set_pd(samples[index_1 * stride], samples[index_0 * stride]);
+                const __m128d y2 = _mm_set_pd(samples[(index_1 + 1) * stride], samples[(index_0 + 1) * stride]);
+                const __m128d y3 = _mm_set_pd(samples[(index_1 + 2) * stride], samples[(index_0 + 2) * stride]);
+                
+                const __m128d c1 = _mm_mul_pd(half, _mm_sub_pd(y2, y0));
+                const __m128d c2 = _mm_sub_pd(_mm_add_pd(y0, _mm_add_pd(y2, y2)),
+                                              _mm_mul_pd(half, _mm_add_pd(_mm_mul_pd(_mm_set1_pd(5.), y1), y3)));
+                const __m128d c3 = _mm_add_pd(_mm_mul_pd(half, _mm_sub_pd(y3, y0)),
+                                              _mm_mul_pd(_mm_set1_pd(1.5), _mm_sub_pd(y1, y2)));
+                
+                __m128d out = _mm_add_pd(_mm_mul_pd(c3, frac), c2);
+                out = _mm_add_pd(_mm_mul_pd(out, frac), c1);
+                _mm_storeu_pd(outs + i, _mm_add_pd(_mm_mul_pd(out, frac), y1));
+            }
+            
+            readHermite<double>(samples, frames, scale, phases + i, outs + i, vecsize - i, stride);
+        }
+        
+        inline void readSinc(float const* samples, long frames, double scale, double const* phases, double* outs, long vecsize, long stride = 1)
+        {
+            // the taps of interleaved frames are loaded one by one
+            if(stride != 1)
+            {
+                readSinc<double>(samples, frames, scale, phases, outs, vecsize, stride);
+                return;
+            }
+            
+            SincTable const& table = sincTable();
+            
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const double position = phases[i] * scale;
+                const long index = std::min((long)position, frames - 1);
+                const double phase = (position - double(index)) * double(SincTable::Phases);
+                const long row = std::min((long)phase, SincTable::Phases - 1);
+                const __m128 weight = _mm_set1_ps(float(phase - double(row)));
+                
+                float const* h1 = table.row(row);
+                float const* h2 = table.row(row + 1);
+                float const* x = samples + index - (SincTable::Taps / 2 - 1);
+                __m128 sum_0 = _mm_setzero_ps();
+                __m128 sum_1 = _mm_setzero_ps();
+                
+                for(long k = 0; k < SincTable::Taps; k += 8)
+                {
+                    const __m128 h1_0 = _mm_loadu_ps(h1 + k), h1_1 = _mm_loadu_ps(h1 + k + 4);
+                    const __m128 h_0 = _mm_add_ps(h1_0, _mm_mul_ps(weight, _mm_sub_ps(_mm_loadu_ps(h2 + k), h1_0)));
+                    const __m128 h_1 = _mm_add_ps(h1_1, _mm_mul_ps(weight, _mm_sub_ps(_mm_loadu_ps(h2 + k + 4), h1_1)));
+                    
+                    sum_0 = _mm_add_ps(sum_0, _mm_mul_ps(_mm_loadu_ps(x + k), h_0));
+                    sum_1 = _mm_add_ps(sum_1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), h_1));
+                }
+                
+                // horizontal sum of the 4 lanes
+                __m128 lanes = _mm_add_ps(sum_0, sum_1);
+                lanes = _mm_add_ps(lanes, _mm_movehl_ps(lanes, lanes));
+                lanes = _mm_add_ss(lanes, _mm_shuffle_ps(lanes, lanes, 1));
+                
+                outs[i] = _mm_cvtss_f32(lanes);
+            }
+        }
+        
+        #endif
+    }
+}
@@ -10,8 +10,51 @@
 #include "c74_msp.h"
 using namespace c74::max;
 
+#include <algorithm> // std::all_of, std::fill, std::min, std::max
+#include <cmath> // std::abs, std::ldexp
+#include <stdlib.h> // malloc, calloc, free...
+
+#include "ChannelCache.hpp"
+using paccpp::ChannelCache;
+
+#include "Handoff.hpp"
+using paccpp::Handoff;
+
+#include "MappedFile.hpp"
+using paccpp::MappedFile;
+
+#include "Playback.hpp"
+
 static t_class* this_class = nullptr;
 
+//! @brief The names of the interpolations, in the order of m_interpolation.
+static const char* const interpolation_names[] = {"linear", "hermite", "sinc"};
+
+//! @brief The interpolations, the perform method of the selected one is picked by the dsp64 method.
+struct t_linear
+{
+    static void read(float const* samples, long frames, double scale, double const* phases, double* outs, long size, long stride = 1)
+    {
+        paccpp::simd::readLinear(samples, frames, scale, phases, outs, size, stride);
+    }
+};
+
+struct t_hermite
+{
+    static void read(float const* samples, long frames, double scale, double const* phases, double* outs, long size, long stride = 1)
+    {
+        paccpp::simd::readHermite(samples, frames, scale, phases, outs, size, stride);
+    }
+};
+
+struct t_sinc
+{
+    static void read(float const* samples, long frames, double scale, double const* phases, double* outs, long size, long stride = 1)
+    {
+        paccpp::simd::readSinc(samples, frames, scale, phases, outs, size, stride);
+    }
+};
+
 struct t_pa_readbuffer2_tilde
 {
     t_pxobject      m_obj;
@@ -21,81 +64,274 @@ struct t_pa_readbuffer2_tilde
 
     // buffer
     t_buffer_ref*   m_buffer_reference;
+    std::atomic<ChannelCache*>  m_cache;
+    t_clock*        m_clock;
+    bool            m_refresh_scheduled;
+
+    // the channel of the buffer read by each outlet (from 0)
+    long            m_number_of_outlets;
+    long*           m_channels;
+
+    // the interpolation, the mip-map switch and the level read by the last block
+    long            m_interpolation;
+    long            m_mipmap;
+    long            m_level;
+
+    // the file read in place instead of the buffer~ (an empty one reads the buffer~) and the last one mapped
+    Handoff<MappedFile>*    m_files;
+    MappedFile*     m_latest;
+
+    // the time ahead of the play head whose pages are loaded in advance (0 if none) and its clock
+    double          m_prefetch;
+    t_clock*        m_prefetch_clock;
 };
 
-void pa_readbuffer2_dsp_perform(t_pa_readbuffer2_tilde *x, t_object *dsp64,
-                                double **ins, long numins, double **outs, long numouts,
-                                long sampleframes, long flags, void *userparam)
+//! @brief The number of samples whose phases are computed at once.
+static const long phase_block_size = 64;
+
+//! @brief The time between two rebuilds of the planar copy while the buffer~ is modified (ms).
+static const double refresh_interval = 20.;
+
+//! @brief Returns the planar copies of the buffer~, shared with pa.readbuffer1~ (the registry is bound to a symbol).
+ChannelCache::Registry& pa_readbuffer2_caches()
 {
-    double *in = ins[0];
-    double *out = outs[0];
-    int n = sampleframes;
-    double sr = sys_getsr();
+    t_symbol* name = gensym("__paccpp.channelcache");
 
-    double speed = 0.f;
-    double freq = 0.f;
-    double phase = x->m_phase;
-    double tphase = 0.f; // phase in 0. to buffersize. range
+    if(!name->s_thing)
+    {
+        name->s_thing = (t_object*)new ChannelCache::Registry();
+    }
 
-    // interpolation indexes
-    long idx_1, idx_2;
+    return *(ChannelCache::Registry*)name->s_thing;
+}
 
-    // interpolation values
-    double y1, y2, frac;
+//! @brief Returns the mappings of the files, shared with pa.readbuffer1~ (the registry is bound to a symbol).
+MappedFile::Registry& pa_readbuffer2_mappings()
+{
+    t_symbol* name = gensym("__paccpp.mappedfile");
 
-    // buffer
-    float *tab;
-    t_atom_long buffersize, nc;
+    if(!name->s_thing)
+    {
+        name->s_thing = (t_object*)new MappedFile::Registry();
+    }
+
+    return *(MappedFile::Registry*)name->s_thing;
+}
+
+//! @brief Refresh on the next tick of the clock, the modifications of the buffer~ until then are coalesced.
+void pa_readbuffer2_schedule_refresh(t_pa_readbuffer2_tilde *x)
+{
+    if(!x->m_refresh_scheduled)
+    {
+        x->m_refresh_scheduled = true;
+        clock_fdelay(x->m_clock, refresh_interval);
+    }
+}
+
+//! @brief Rebuild the planar copy of the buffer~ if it has been modified, delete the copies and the file replaced by the audio thread (message thread).
+void pa_readbuffer2_refresh(t_pa_readbuffer2_tilde *x)
+{
+    x->m_refresh_scheduled = false;
+    x->m_files->reclaim();
 
-    t_buffer_obj* buffer = buffer_ref_getobject(x->m_buffer_reference);
-    if(buffer)
+    ChannelCache* cache = x->m_cache.load();
+
+    if(cache->stale())
     {
-        tab = buffer_locksamples(buffer);
+        t_buffer_obj* buffer = buffer_ref_getobject(x->m_buffer_reference);
+        float* tab = buffer ? buffer_locksamples(buffer) : nullptr;
+
         if(tab)
         {
-            buffersize = buffer_getframecount(buffer);
-            nc = buffer_getchannelcount(buffer);
+            cache->build(tab, (long)buffer_getframecount(buffer), (long)buffer_getchannelcount(buffer));
+            buffer_unlocksamples(buffer);
+        }
+        else
+        {
+            cache->build(nullptr, 0, 0);
+        }
+    }
 
-            while(n--)
-            {
-                speed = *in++;
+    // a copy still read by a perform routine is deleted by a next tick
+    if(ChannelCache::reclaim(pa_readbuffer2_caches()))
+    {
+        pa_readbuffer2_schedule_refresh(x);
+    }
+}
 
-                freq = sr / buffersize * speed;
+//! @brief Returns the first level where a speed doesn't skip samples (ceil(log2(speed))), among the levels built.
+long pa_readbuffer2_level(double speed, long levels)
+{
+    long level = 0;
 
-                // wrap phase between 0. and 1.
-                if(phase >= 1.f) { phase -= 1.f; }
-                else if(phase < 0.f) { phase += 1.f; }
+    while(level < levels - 1 && speed > double(1L << level))
+    {
+        level++;
+    }
 
-                tphase = phase * buffersize;
+    return level;
+}
 
-                // we cast in int to keep only the integer part of the floating-point number (eg. 3.99 => 3)
-                idx_1 = (int)tphase;
+//! @brief Read a file in place (see MappedFile), with the phases of the buffer~ scaled to its frames.
+//! @details The positions of a block are split in runs inside the file, read in the mapping (the frames of a channel are interleaved),
+//! and runs near its ends, read in the planar copy of its edges. There is no mip-map.
+template<class Interpolation>
+void pa_readbuffer2_perform_mapped(t_pa_readbuffer2_tilde *x, MappedFile& file, double *in, double **outs, long numouts, long sampleframes)
+{
+    const double frames = double(file.frames());
+    const double size_inv = 1. / frames;
+    const bool forward = (in[0] >= 0.);
+    double phase = x->m_phase;
+    double positions[phase_block_size];
+    double offsets[phase_block_size];
 
-                // wrap idx_2
-                idx_2 = (idx_1 < (buffersize-1)) ? (idx_1+1) : 0;
+    // the speeds of a block are read before its outputs, that may share their memory, are written
+    for(long i = 0; i < sampleframes; i += phase_block_size)
+    {
+        const long size = std::min(phase_block_size, sampleframes - i);
+        const double speed = in[i];
 
-                frac = tphase - idx_1;
+        if(std::all_of(in + i + 1, in + i + size, [speed](double value) { return value == speed; }))
+        {
+            phase = paccpp::simd::rampPhase(phase, speed * size_inv, positions, size);
+        }
+        else
+        {
+            phase = paccpp::simd::accumulatePhase(phase, in + i, size_inv, positions, size);
+        }
 
-                y1 = tab[idx_1 * nc];
-                y2 = tab[idx_2 * nc];
+        for(long j = 0; j < size; ++j)
+        {
+            positions[j] *= frames;
+        }
 
-                // linear interpolation
-                *out++ = y1 + frac * (y2 - y1);
+        for(long start = 0, end = 0; start < size; start = end)
+        {
+            const bool inside = file.inside(positions[start]);
 
-                // increment phase
-                phase += (freq / sr);
+            while(end < size && file.inside(positions[end]) == inside)
+            {
+                if(!inside) offsets[end] = file.edge(positions[end]);
+                ++end;
             }
 
-            buffer_unlocksamples(buffer);
+            // a channel above the number of channels of the file reads the last one
+            for(long c = 0; c < numouts; ++c)
+            {
+                const long channel = std::min(x->m_channels[c], file.channels() - 1);
+                double *out = outs[c] + i;
+
+                if(inside)
+                {
+                    Interpolation::read(file.channel(channel), file.frames(), 1., positions + start, out + start, end - start, file.channels());
+                }
+                else
+                {
+                    Interpolation::read(file.edges(channel), MappedFile::EdgeFrames, 1., offsets + start, out + start, end - start);
+                }
+            }
         }
-        else
+    }
+
+    x->m_phase = phase;
+    file.play(phase * frames, forward);
+}
+
+//! @brief Read the buffer~ by blocks: the phases of a block are accumulated first, then each outlet interpolates its channel.
+//! @details The phase increment is speed / buffersize (the sampling rate cancels out), computed with 1 / buffersize.
+//! When the speed is constant during a block, its phases are a ramp: they don't depend on each other.
+//! The channels are read in the planar copy of the buffer~ (see ChannelCache), the buffer~ itself is never locked here.
+//! A block played faster than 1x reads the level of the mip-map given by its fastest speed,
+//! the first block that reads another level crossfades from the previous one.
+template<class Interpolation>
+void pa_readbuffer2_dsp_perform(t_pa_readbuffer2_tilde *x, t_object *dsp64,
+                                double **ins, long numins, double **outs, long numouts,
+                                long sampleframes, long flags, void *userparam)
+{
+    double *in = ins[0];
+
+    // the previous file is deleted by the clock
+    if(x->m_files->update())
+    {
+        clock_delay(x->m_clock, 0);
+    }
+
+    MappedFile* file = x->m_files->get();
+
+    if(file && file->isOpen())
+    {
+        pa_readbuffer2_perform_mapped<Interpolation>(x, *file, in, outs, numouts, sampleframes);
+        return;
+    }
+
+    double phase = x->m_phase;
+
+    ChannelCache::Pin pin(*x->m_cache.load(std::memory_order_acquire));
+    ChannelCache::Planar const* planar = pin.get();
+
+    if(!planar)
+    {
+        for(long c = 0; c < numouts; ++c)
         {
-            while(n--) { *out++ = 0.; }
+            std::fill(outs[c], outs[c] + sampleframes, 0.);
         }
+
+        return;
     }
-    else
+
+    const long buffersize = planar->m_frames;
+    const double size_inv = 1. / buffersize;
+    double phases[phase_block_size];
+    double faded[phase_block_size];
+
+    // the speeds of a block are read before its outputs, that may share their memory, are written
+    for(long i = 0; i < sampleframes; i += phase_block_size)
     {
-        while(n--) { *out++ = 0.; }
+        const long size = std::min(phase_block_size, sampleframes - i);
+        const double speed = in[i];
+        double fastest = std::abs(speed);
+
+        if(std::all_of(in + i + 1, in + i + size, [speed](double value) { return value == speed; }))
+        {
+            phase = paccpp::simd::rampPhase(phase, speed * size_inv, phases, size);
+        }
+        else
+        {
+            for(long j = 1; j < size; ++j)
+            {
+                fastest = std::max(fastest, std::abs(in[i + j]));
+            }
+
+            phase = paccpp::simd::accumulatePhase(phase, in + i, size_inv, phases, size);
+        }
+
+        const long level = x->m_mipmap ? pa_readbuffer2_level(fastest, planar->levels()) : 0;
+        const long previous = std::min(x->m_level, planar->levels() - 1);
+        ChannelCache::Level const& current = planar->level(level);
+        ChannelCache::Level const& last = planar->level(previous);
+
+        // a channel above the number of channels of the buffer~ reads the last one
+        for(long c = 0; c < numouts; ++c)
+        {
+            const long channel = std::min(x->m_channels[c], planar->m_channels - 1);
+            double *out = outs[c] + i;
+
+            Interpolation::read(current.channel(channel), current.m_frames, std::ldexp(double(buffersize), -(int)level),
+                                phases, out, size);
+
+            if(previous != level)
+            {
+                Interpolation::read(last.channel(channel), last.m_frames, std::ldexp(double(buffersize), -(int)previous),
+                                    phases, faded, size);
+
+                for(long j = 0; j < size; ++j)
+                {
+                    out[j] = faded[j] + (out[j] - faded[j]) * double(j + 1) / double(size);
+                }
+            }
+        }
+
+        x->m_level = level;
     }
 
     x->m_phase = phase;
@@ -106,16 +342,157 @@ void pa_readbuffer2_set(t_pa_readbuffer2_tilde *x, t_symbol *s)
     // reset phase
     x->m_phase = 0.;
 
+    // an empty file: the buffer~ is read again
+    if(x->m_latest)
+    {
+        x->m_latest = nullptr;
+        x->m_files->publish(new MappedFile());
+    }
+
     if (!x->m_buffer_reference)
         x->m_buffer_reference = buffer_ref_new((t_object *)x, s);
     else
         buffer_ref_set(x->m_buffer_reference, s);
+
+    // the previous cache stays valid for the audio thread, only its copy is deleted with its last reader
+    ChannelCache* previous = x->m_cache.exchange(ChannelCache::acquire(pa_readbuffer2_caches(), s, x->m_mipmap ? ChannelCache::MaxLevels : 1));
+
+    if(previous)
+    {
+        previous->release();
+    }
+
+    pa_readbuffer2_refresh(x);
+}
+
+//! @brief Read a file in place instead of the buffer~: a 32 bits float WAV file or a raw file of interleaved floats.
+//! @details map <file> [channels of a raw file]
+void pa_readbuffer2_map(t_pa_readbuffer2_tilde *x, t_symbol *s, long argc, t_atom *argv)
+{
+    char filename[MAX_PATH_CHARS];
+    char path[MAX_PATH_CHARS];
+    short volume;
+    t_fourcc type;
+
+    if(argc < 1 || atom_gettype(argv) != A_SYM)
+    {
+        object_error((t_object*)x, "map needs a file");
+        return;
+    }
+
+    snprintf(filename, MAX_PATH_CHARS, "%s", atom_getsym(argv)->s_name);
+
+    if(locatefile_extended(filename, &volume, &type, NULL, 0) || path_toabsolutesystempath(volume, filename, path) != MAX_ERR_NONE)
+    {
+        object_error((t_object*)x, "can't find %s", atom_getsym(argv)->s_name);
+        return;
+    }
+
+    MappedFile* file = new MappedFile();
+
+    if(!file->open(pa_readbuffer2_mappings(), path, (argc >= 2) ? (long)atom_getlong(argv + 1) : 1))
+    {
+        object_error((t_object*)x, "can't map %s: %s", atom_getsym(argv)->s_name, file->error().c_str());
+        delete file;
+        return;
+    }
+
+    x->m_latest = file;
+    x->m_files->publish(file);
+}
+
+//! @brief Load the pages of the file ahead of the play head in advance, every half of the time ahead (message thread).
+void pa_readbuffer2_advise(t_pa_readbuffer2_tilde *x)
+{
+    if(x->m_prefetch <= 0.) return;
+
+    if(x->m_latest)
+    {
+        x->m_latest->advise((long)(x->m_prefetch * 0.001 * sys_getsr()));
+    }
+
+    clock_fdelay(x->m_prefetch_clock, std::max(x->m_prefetch * 0.5, 10.));
+}
+
+//! @brief Set the time ahead of the play head (in ms at 1x) whose pages are loaded in advance, 0 to let the reads load them.
+void pa_readbuffer2_prefetch(t_pa_readbuffer2_tilde *x, double ms)
+{
+    x->m_prefetch = std::max(ms, 0.);
+
+    if(x->m_prefetch > 0.)
+    {
+        clock_delay(x->m_prefetch_clock, 0);
+    }
+    else
+    {
+        clock_unset(x->m_prefetch_clock);
+    }
+}
+
+//! @brief Select the channels read by the outlets (from 1), in order.
+void pa_readbuffer2_channels(t_pa_readbuffer2_tilde *x, t_symbol *s, long argc, t_atom *argv)
+{
+    for(long c = 0; c < argc && c < x->m_number_of_outlets; ++c)
+    {
+        const t_atom_long channel = atom_getlong(argv + c);
+
+        if(channel < 1)
+        {
+            object_error((t_object*)x, "channel must be >= 1");
+        }
+
+        x->m_channels[c] = (long)std::max(channel, (t_atom_long)1) - 1;
+    }
+}
+
+void pa_readbuffer2_set_interp(t_pa_readbuffer2_tilde *x, t_symbol *name)
+{
+    for(long i = 0; i < 3; ++i)
+    {
+        if(strcmp(name->s_name, interpolation_names[i]) == 0)
+        {
+            // taken into account when the dsp chain is compiled
+            x->m_interpolation = i;
+            return;
+        }
+    }
+
+    object_error((t_object*)x, "unknown interpolation %s (linear, hermite or sinc)", name->s_name);
+}
+
+//! @brief The levels are only built for the readers that use them, they are built with the next copy when the mip-map is turned on.
+void pa_readbuffer2_set_mipmap(t_pa_readbuffer2_tilde *x, long state)
+{
+    ChannelCache* cache = x->m_cache.load();
+
+    x->m_mipmap = (state != 0);
+
+    if(x->m_mipmap)
+    {
+        cache->request(ChannelCache::MaxLevels);
+    }
+
+    if(cache->stale())
+    {
+        pa_readbuffer2_schedule_refresh(x);
+    }
 }
 
 void pa_readbuffer2_dsp_prepare(t_pa_readbuffer2_tilde *x, t_object *dsp64,
                                 short *count, double samplerate, long maxvectorsize, long flags)
 {
-    dsp_add64(dsp64, (t_object *)x, (t_perfroutine64)pa_readbuffer2_dsp_perform, 0, NULL);
+    pa_readbuffer2_refresh(x);
+
+    t_perfroutine64 perform;
+
+    switch(x->m_interpolation)
+    {
+        case 1: perform = (t_perfroutine64)pa_readbuffer2_dsp_perform<t_hermite>; break;
+        case 2: perform = (t_perfroutine64)pa_readbuffer2_dsp_perform<t_sinc>; break;
+        default: perform = (t_perfroutine64)pa_readbuffer2_dsp_perform<t_linear>; break;
+    }
+
+    dsp_add64(dsp64, (t_object *)x, perform, 0, NULL);
 }
 
 void pa_readbuffer2_assist(t_pa_readbuffer2_tilde* x, void* unused,
@@ -123,27 +500,75 @@ void pa_readbuffer2_assist(t_pa_readbuffer2_tilde* x, void* unused,
 {
     if(io == ASSIST_OUTLET)
     {
-        strncpy(string_dest, "(signal) Output", ASSIST_STRING_MAXSIZE);
+        snprintf(string_dest, ASSIST_STRING_MAXSIZE, "(signal) Output of channel %ld", x->m_channels[index] + 1);
     }
     else
     {
-        strncpy(string_dest,"(signal) Read speed", ASSIST_STRING_MAXSIZE);
+        strncpy(string_dest,"(signal) Read speed, (channels) select the channels, (interp) linear, hermite or sinc, (mipmap) anti-aliasing on/off, (map) read a file in place, (prefetch) ms", ASSIST_STRING_MAXSIZE);
     }
 }
 
+//! @brief The planar copy is rebuilt by the clock, once for all the readers of the buffer~ and at most once per refresh_interval.
 t_max_err pa_readbuffer2_notify(t_pa_readbuffer2_tilde *x, t_symbol *s, t_symbol *msg, void *sender, void *data)
 {
+    if(msg == gensym("buffer_modified"))
+    {
+        x->m_cache.load()->invalidate();
+        pa_readbuffer2_schedule_refresh(x);
+    }
+
     return buffer_ref_notify(x->m_buffer_reference, s, msg, sender, data);
 }
 
-void *pa_readbuffer2_new(t_symbol *s)
+void *pa_readbuffer2_new(t_symbol *name, long argc, t_atom *argv)
 {
     t_pa_readbuffer2_tilde* x = (t_pa_readbuffer2_tilde*)object_alloc(this_class);
 
     if(x)
     {
+        t_symbol* s = (argc >= 1 && atom_gettype(argv) == A_SYM) ? atom_getsym(argv) : gensym("");
+        long noutlets = 1;
+
+        // init number of outlets
+        if(argc >= 2 && atom_gettype(argv+1) == A_LONG)
+        {
+            noutlets = (long)atom_getlong(argv+1);
+            if(noutlets < 1)
+            {
+                noutlets = 1;
+            }
+        }
+
+        // outlet i reads channel i by default
+        x->m_number_of_outlets = noutlets;
+        x->m_channels = (long*)calloc(noutlets, sizeof(long));
+        for(long c = 0; c < noutlets; ++c)
+        {
+            x->m_channels[c] = c;
+        }
+
+        x->m_interpolation = 0;
+        x->m_mipmap = 1;
+        x->m_level = 0;
+
+        // the sinc table is built once, on the message thread
+        paccpp::sincTable();
+
+        // instantiate a new Handoff object (the files are unmapped with it)
+        // Note: dont forget to delete it in the free method !
+        x->m_files = new Handoff<MappedFile>();
+        x->m_latest = nullptr;
+        x->m_prefetch = 0.;
+
+        x->m_clock = clock_new(x, (method)pa_readbuffer2_refresh);
+        x->m_refresh_scheduled = false;
+        x->m_prefetch_clock = clock_new(x, (method)pa_readbuffer2_advise);
+
         dsp_setup((t_pxobject *)x, 1);
-        outlet_new((t_object *)x, "signal");
+        for(long c = 0; c < noutlets; ++c)
+        {
+            outlet_new((t_object *)x, "signal");
+        }
 
         pa_readbuffer2_set(x, s);
     }
@@ -155,16 +580,26 @@ void *pa_readbuffer2_new(t_symbol *s)
 void pa_readbuffer2_free(t_pa_readbuffer2_tilde *x)
 {
     dsp_free((t_pxobject *)x);
+    freeobject(x->m_clock);
+    freeobject(x->m_prefetch_clock);
+    x->m_cache.load()->release();
     object_free(x->m_buffer_reference);
+    free(x->m_channels);
+    delete x->m_files;
 }
 
 void ext_main(void *r)
 {
     t_class *c = class_new("pa.readbuffer2~", (method)pa_readbuffer2_new, (method)pa_readbuffer2_free,
-                           sizeof(t_pa_readbuffer2_tilde), 0L, A_SYM, 0);
+                           sizeof(t_pa_readbuffer2_tilde), 0L, A_GIMME, 0);
 
     class_addmethod(c, (method)pa_readbuffer2_dsp_prepare,   "dsp64",    A_CANT,     0);
     class_addmethod(c, (method)pa_readbuffer2_set,           "set",      A_DEFSYM,   0);
+    class_addmethod(c, (method)pa_readbuffer2_channels,      "channels", A_GIMME,    0);
+    class_addmethod(c, (method)pa_readbuffer2_set_interp,    "interp",   A_SYM,      0);
+    class_addmethod(c, (method)pa_readbuffer2_set_mipmap,    "mipmap",   A_LONG,     0);
+    class_addmethod(c, (method)pa_readbuffer2_map,           "map",      A_GIMME,    0);
+    class_addmethod(c, (method)pa_readbuffer2_prefetch,      "prefetch", A_FLOAT,    0);
     class_addmethod(c, (method)pa_readbuffer2_assist,        "assist",   A_CANT,     0);
     class_addmethod(c, (method)pa_readbuffer2_notify,        "notify",   A_CANT,     0);
 
@@ -0,0 +1,272 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include "LockFreeQueue.hpp"
+#include "SoundFile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                    DISK STREAM                                   //
+    // ================================================================================ //
+
+    //! @brief Streams a sound file from disk for a reader that plays it at any speed, in both directions.
+    //! @details Only a ring of slots is kept in memory, each holds a block of BlockSize frames of every channel (planar),
+    //! surrounded by Guard frames of the blocks around it so that an interpolation never leaves its block.
+    //! The audio thread asks for the blocks of a window that starts at the play head and goes ahead of it,
+    //! in the direction of the play, an I/O thread reads them in the slots that the window doesn't use anymore:
+    //! - the requests go through a LockFreeQueue, the slot of a request is chosen by the audio thread.
+    //! - a slot is used only once the I/O thread has tagged it with the number of its block.
+    //!
+    //! A slot is only replaced when the audio thread asks for it, after its reads: a tagged slot can be read without checking it again.
+    //! The file is read as a loop. A play head that reaches a block that is not in memory yet (after a seek,
+    //! or if the disk is too slow) outputs zeros and counts a miss.
+    class DiskStream
+    {
+    public: // methods
+
+        //! @brief The number of frames of a block (a read of the file).
+        static const long BlockSize = 8192;
+
+        //! @brief The number of frames of the blocks around it copied before and after a block.
+        static const long Guard = 16;
+
+        //! @brief The largest number of blocks in memory.
+        static const long MaxWindow = 256;
+
+        //! @brief The number of frames between two channels of a block.
+        static const long Stride = BlockSize + 2 * Guard;
+
+        //! @brief Constructor, opens the file and starts the I/O thread (message thread).
+        //! @details The blocks ahead of the start frame are read first.
+        //! @param path The sound file (see SoundFile).
+        //! @param ahead The number of blocks read ahead of the play head (from 1 to MaxWindow - 2).
+        //! @param start The position of the play head in frames.
+        DiskStream(std::string const& path, long ahead, double start = 0.)
+        : m_ahead(std::min(std::max(ahead, 1L), MaxWindow - 2))
+        , m_slots(m_ahead + 2)
+        {
+            if(!m_file.open(path))
+            {
+                return;
+            }
+
+            m_blocks = (m_file.frames() + BlockSize - 1) / BlockSize;
+            m_samples.assign(size_t(m_slots * m_file.channels() * Stride), 0.f);
+            m_tags.reset(new std::atomic<int64_t>[m_slots]);
+            m_requested.assign(size_t(m_slots), -1);
+
+            for(long slot = 0; slot < m_slots; ++slot)
+            {
+                m_tags[slot].store(-1, std::memory_order_relaxed);
+            }
+
+            m_position.store(start, std::memory_order_relaxed);
+
+            // the first requests are pushed before the I/O thread starts (the queue has a single producer)
+            prefetch((int64_t)start, true);
+
+            m_thread = std::thread(&DiskStream::run, this);
+        }
+
+        //! @brief Destructor, stops the I/O thread and closes the file (message thread).
+        //! @details The audio thread must not use the stream anymore.
+        ~DiskStream()
+        {
+            m_quit.store(true, std::memory_order_relaxed);
+
+            if(m_thread.joinable())
+            {
+                m_thread.join();
+            }
+        }
+
+        DiskStream(DiskStream const&) = delete;
+        DiskStream& operator=(DiskStream const&) = delete;
+
+        //! @brief Returns false if the file couldn't be opened or read (see error()).
+        bool isOpen() const { return m_blocks > 0; }
+
+        //! @brief Returns the reason why the file couldn't be opened.
+        std::string const& error() const { return m_file.error(); }
+
+        //! @brief Returns the number of channels of the file.
+        long channels() const { return m_file.channels(); }
+
+        //! @brief Returns the number of frames of the file.
+        int64_t frames() const { return m_file.frames(); }
+
+        //! @brief Returns the sampling rate of the file.
+        double samplerate() const { return m_file.samplerate(); }
+
+        //! @brief Returns the number of blocks read ahead of the play head.
+        long ahead() const { return m_ahead; }
+
+        //! @brief Returns the number of blocks (or parts of blocks) that were not in memory when the play head needed them.
+        size_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+
+        //! @brief Returns the position of the play head in frames, at the end of the last vector (any thread).
+        double position() const { return m_position.load(std::memory_order_relaxed); }
+
+        //! @brief Set the position of the play head in frames (audio thread).
+        void play(double position) { m_position.store(position, std::memory_order_relaxed); }
+
+        //! @brief Move the play head to a frame, at the beginning of the next vector (message thread).
+        void seek(int64_t frame)
+        {
+            m_seek.store(std::min(std::max(frame, int64_t(0)), frames() - 1), std::memory_order_relaxed);
+        }
+
+        //! @brief Returns the frame asked by the last seek() or -1 if there was none since the last call (audio thread).
+        int64_t takeSeek()
+        {
+            return m_seek.exchange(-1, std::memory_order_relaxed);
+        }
+
+        //! @brief Returns the block of a frame in [0, frames()].
+        int64_t block(int64_t frame) const
+        {
+            return std::min(frame / BlockSize, m_blocks - 1);
+        }
+
+        //! @brief Returns the first frame of the first channel of a block, nullptr if the block is not in memory (audio thread).
+        //! @details The channels follow each other, Stride frames apart. The Guard frames before and after a channel can be read.
+        //! A miss is counted.
+        float const* find(int64_t block)
+        {
+            for(long slot = 0; slot < m_slots; ++slot)
+            {
+                if(m_requested[slot] == block)
+                {
+                    if(m_tags[slot].load(std::memory_order_acquire) != block) break;
+
+                    return m_samples.data() + slot * channels() * Stride + Guard;
+                }
+            }
+
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        //! @brief Ask for the blocks of the window of the play head (audio thread).
+        //! @details The window is the block of the play head, the ahead blocks that follow it in the direction of the play
+        //! and the one before it. The nearest blocks are asked first, a block of a slot outside the window is replaced.
+        //! @param frame The frame of the play head.
+        //! @param forward The direction of the play.
+        void prefetch(int64_t frame, bool forward)
+        {
+            const int64_t first = block(std::min(std::max(frame, int64_t(0)), frames() - 1));
+            const int64_t step = forward ? 1 : -1;
+            int64_t window[MaxWindow];
+            long size = 0;
+
+            // the window wraps around the file, a file of fewer blocks is entirely in it
+            for(long i = -1; i <= m_ahead && size < m_blocks; ++i)
+            {
+                window[size++] = ((first + i * step) % m_blocks + m_blocks) % m_blocks;
+            }
+
+            auto inWindow = [&window, size](int64_t block)
+            {
+                return std::find(window, window + size, block) != window + size;
+            };
+
+            // the block of the play head and the ones ahead first
+            std::rotate(window, window + 1, window + size);
+
+            long victim = 0;
+
+            for(long i = 0; i < size; ++i)
+            {
+                const int64_t block = window[i];
+
+                if(std::find(m_requested.begin(), m_requested.end(), block) != m_requested.end()) continue;
+
+                while(victim < m_slots && m_requested[victim] >= 0 && inWindow(m_requested[victim]))
+                {
+                    victim++;
+                }
+
+                // asked again at the next vector if the queue is full
+                if(victim == m_slots || !m_requests.push({block, victim})) return;
+
+                m_requested[victim++] = block;
+            }
+        }
+
+    private: // methods
+
+        //! @brief A block to read in a slot.
+        struct Request
+        {
+            int64_t m_block;
+            long    m_slot;
+        };
+
+        //! @brief The I/O thread: handles the requests in order, sleeps 1 ms when there is none.
+        void run()
+        {
+            Request request;
+
+            while(!m_quit.load(std::memory_order_relaxed))
+            {
+                if(!m_requests.pop(request))
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+
+                float* samples = m_samples.data() + request.m_slot * channels() * Stride;
+
+                // untagged while it is replaced
+                m_tags[request.m_slot].store(-1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+
+                // the frames after the end of the file are the ones of its beginning (and the ones before it its end)
+                m_file.read(request.m_block * BlockSize - Guard, Stride, samples, Stride);
+
+                m_tags[request.m_slot].store(request.m_block, std::memory_order_release);
+            }
+        }
+
+    private: // variables
+
+        SoundFile                   m_file;
+
+        const long                  m_ahead;
+        const long                  m_slots;
+        int64_t                     m_blocks = 0;
+
+        // the slots: the frames of every channel of a block, one after the other
+        std::vector<float>          m_samples;
+
+        // the block in each slot (-1 while it is replaced)
+        std::unique_ptr<std::atomic<int64_t>[]> m_tags;
+
+        // the block last asked for each slot (audio thread)
+        std::vector<int64_t>        m_requested;
+
+        LockFreeQueue<Request, 256> m_requests;
+        std::atomic<size_t>         m_misses {0};
+        std::atomic<double>         m_position {0.};
+        std::atomic<int64_t>        m_seek {-1};
+
+        std::thread                 m_thread;
+        std::atomic<bool>           m_quit {false};
+    };
+}
@@ -0,0 +1,81 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                  LOCK FREE QUEUE                                 //
+    // ================================================================================ //
+
+    //! @brief A bounded queue between one producer thread and one consumer thread.
+    //! @details The elements are stored in a ring of Capacity slots (a power of two),
+    //! push() and pop() never wait nor allocate: they can be called from the audio thread.
+    template<class Type, size_t Capacity>
+    class LockFreeQueue
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0, "the capacity must be a power of two");
+
+    public: // methods
+
+        LockFreeQueue() = default;
+        ~LockFreeQueue() = default;
+
+        LockFreeQueue(LockFreeQueue const&) = delete;
+        LockFreeQueue& operator=(LockFreeQueue const&) = delete;
+
+        //! @brief Add an element (producer thread).
+        //! @return false if the queue is full, the element is then dropped.
+        bool push(Type const& value)
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+            if(tail - m_head.load(std::memory_order_acquire) == Capacity)
+            {
+                return false;
+            }
+
+            m_slots[tail & (Capacity - 1)] = value;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        //! @brief Remove the oldest element (consumer thread).
+        //! @return false if the queue is empty.
+        bool pop(Type& value)
+        {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+
+            if(head == m_tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            value = m_slots[head & (Capacity - 1)];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+    private: // variables
+
+        // the size of a cache line
+        static const size_t CacheLine = 64;
+
+        Type                m_slots[Capacity];
+
+        // on their own cache lines, each one is written by a single thread: they are padded rather than aligned,
+        // the queue is a member of objects allocated with new (no over-aligned new before C++17)
+        char                m_head_padding[CacheLine];
+        std::atomic<size_t> m_head {0};
+        char                m_tail_padding[CacheLine - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> m_tail {0};
+        char                m_end_padding[CacheLine - sizeof(std::atomic<size_t>)];
+    };
+}
@@ -0,0 +1,390 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                    SOUND FILE                                    //
+    // ================================================================================ //
+
+    //! @brief Reads the frames of an uncompressed WAV (RF64 for the files over 4 GB) or AIFF / AIFC file.
+    //! @details The samples can be 8, 16, 24 or 32 bits integers or 32 or 64 bits floats, in either byte order.
+    //! The header is parsed by open(), read() then decodes any range of frames into planar floats.
+    class SoundFile
+    {
+    public: // methods
+
+        //! @brief Default constructor
+        SoundFile() = default;
+
+        //! @brief Destructor, closes the file.
+        ~SoundFile()
+        {
+            close();
+        }
+
+        SoundFile(SoundFile const&) = delete;
+        SoundFile& operator=(SoundFile const&) = delete;
+
+        //! @brief Open a file and parse its header.
+        //! @return false if the file can't be opened or its format is not supported (see error()).
+        bool open(std::string const& path)
+        {
+            close();
+
+            m_file = std::fopen(path.c_str(), "rb");
+
+            if(!m_file)
+            {
+                return fail("can't open the file");
+            }
+
+            uint8_t header[12];
+
+            if(std::fread(header, 1, 12, m_file) != 12)
+            {
+                return fail("the file is too short");
+            }
+
+            const bool parsed = ((match(header, "RIFF") || match(header, "RF64")) && match(header + 8, "WAVE")) ? parseWave(match(header, "RF64"))
+                              : (match(header, "FORM") && (match(header + 8, "AIFF") || match(header + 8, "AIFC"))) ? parseAiff(match(header + 8, "AIFC"))
+                              : fail("not a WAV or AIFF file");
+
+            if(!parsed) return false;
+
+            if(m_channels < 1 || m_frames < 1 || m_bytes < 1)
+            {
+                return fail("the file has no samples");
+            }
+
+            return true;
+        }
+
+        //! @brief Close the file.
+        void close()
+        {
+            if(m_file)
+            {
+                std::fclose(m_file);
+                m_file = nullptr;
+            }
+
+            m_channels = 0;
+            m_frames = 0;
+        }
+
+        //! @brief Returns true if a file is open and its header has been parsed.
+        bool isOpen() const { return m_file != nullptr && m_frames > 0; }
+
+        //! @brief Returns the reason of the last failure of open().
+        std::string const& error() const { return m_error; }
+
+        //! @brief Returns the number of channels.
+        long channels() const { return m_channels; }
+
+        //! @brief Returns the number of frames.
+        int64_t frames() const { return m_frames; }
+
+        //! @brief Returns the sampling rate of the file.
+        double samplerate() const { return m_samplerate; }
+
+        //! @brief Read frames into planar floats, the file is read as a loop (the frames before 0 and after the end wrap).
+        //! @param start The first frame.
+        //! @param count The number of frames.
+        //! @param outs The first sample of the first channel, channel c is written from outs + c * stride.
+        //! @return false if the file couldn't be read (the frames are then zeros).
+        bool read(int64_t start, long count, float* outs, long stride)
+        {
+            bool done = true;
+            long i = 0;
+
+            while(i < count)
+            {
+                const int64_t frame = ((start + i) % m_frames + m_frames) % m_frames;
+                const long size = (long)std::min<int64_t>(count - i, m_frames - frame);
+
+                done &= readRange(frame, size, outs + i, stride);
+                i += size;
+            }
+
+            return done;
+        }
+
+    private: // methods
+
+        enum class Encoding
+        {
+            Integer,
+            Float
+        };
+
+        static bool match(uint8_t const* bytes, const char* tag)
+        {
+            return std::memcmp(bytes, tag, 4) == 0;
+        }
+
+        static uint32_t little32(uint8_t const* b) { return uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 | uint32_t(b[3]) << 24; }
+        static uint16_t little16(uint8_t const* b) { return uint16_t(b[0] | b[1] << 8); }
+        static uint64_t little64(uint8_t const* b) { return uint64_t(little32(b)) | uint64_t(little32(b + 4)) << 32; }
+        static uint32_t big32(uint8_t const* b) { return uint32_t(b[3]) | uint32_t(b[2]) << 8 | uint32_t(b[1]) << 16 | uint32_t(b[0]) << 24; }
+        static uint16_t big16(uint8_t const* b) { return uint16_t(b[1] | b[0] << 8); }
+
+        //! @brief An 80 bits IEEE extended float (the sampling rate of an AIFF file).
+        static double extended(uint8_t const* b)
+        {
+            const int exponent = ((b[0] & 0x7F) << 8) | b[1];
+            const uint64_t mantissa = uint64_t(big32(b + 2)) << 32 | uint64_t(big32(b + 6));
+            const double value = std::ldexp(double(mantissa), exponent - 16383 - 63);
+            return (b[0] & 0x80) ? -value : value;
+        }
+
+        bool fail(const char* reason)
+        {
+            m_error = reason;
+            close();
+            return false;
+        }
+
+        void seek(int64_t offset)
+        {
+            #if defined(_WIN32)
+            _fseeki64(m_file, offset, SEEK_SET);
+            #else
+            fseeko(m_file, off_t(offset), SEEK_SET);
+            #endif
+        }
+
+        //! @brief Parse the chunks of a WAV file.
+        bool parseWave(bool rf64)
+        {
+            uint8_t chunk[8];
+            int64_t position = 12;
+            uint64_t data_size = 0;
+            bool format = false;
+
+            while(std::fread(chunk, 1, 8, m_file) == 8)
+            {
+                uint64_t size = little32(chunk + 4);
+                const int64_t body = position + 8;
+
+                if(match(chunk, "ds64") && size >= 16)
+                {
+                    uint8_t ds64[16];
+                    if(std::fread(ds64, 1, 16, m_file) != 16) break;
+                    data_size = little64(ds64 + 8);
+                }
+                else if(match(chunk, "fmt ") && size >= 16)
+                {
+                    uint8_t fmt[40] = {0};
+                    if(std::fread(fmt, 1, std::min<size_t>(size, 40), m_file) != std::min<size_t>(size, 40)) break;
+
+                    uint16_t tag = little16(fmt);
+
+                    // WAVE_FORMAT_EXTENSIBLE: the format is the beginning of the sub format
+                    if(tag == 0xFFFE && size >= 26) tag = little16(fmt + 24);
+
+                    const long bits = little16(fmt + 14);
+
+                    m_channels = little16(fmt + 2);
+                    m_samplerate = little32(fmt + 4);
+                    m_bytes = bits / 8;
+                    m_big_endian = false;
+
+                    // the size of a frame divides the size of the samples
+                    if(m_channels < 1) return fail("the WAV file has no channels");
+                    if(bits < 8 || bits % 8 != 0) return fail("unsupported WAV sample size");
+
+                    if(tag == 1 && m_bytes >= 1 && m_bytes <= 4) m_encoding = Encoding::Integer;
+                    else if(tag == 3 && (m_bytes == 4 || m_bytes == 8)) m_encoding = Encoding::Float;
+                    else return fail("unsupported WAV encoding (PCM or float only)");
+
+                    // 8 bits samples are unsigned
+                    m_unsigned = (m_bytes == 1);
+                    format = true;
+                }
+                else if(match(chunk, "data"))
+                {
+                    if(!format) return fail("no format before the samples");
+
+                    if(rf64 && size == 0xFFFFFFFF) size = data_size;
+
+                    m_offset = body;
+                    m_frames = int64_t(size / uint64_t(m_channels * m_bytes));
+                    return true;
+                }
+
+                // the chunks are padded to an even size
+                position = body + int64_t(size + (size & 1));
+                seek(position);
+            }
+
+            return fail("no samples in the WAV file");
+        }
+
+        //! @brief Parse the chunks of an AIFF or AIFC file.
+        bool parseAiff(bool aifc)
+        {
+            uint8_t chunk[8];
+            int64_t position = 12;
+            bool format = false;
+            int64_t frames = 0;
+
+            while(std::fread(chunk, 1, 8, m_file) == 8)
+            {
+                const uint64_t size = big32(chunk + 4);
+                const int64_t body = position + 8;
+
+                if(match(chunk, "COMM") && size >= 18)
+                {
+                    uint8_t comm[22] = {0};
+                    if(std::fread(comm, 1, std::min<size_t>(size, 22), m_file) != std::min<size_t>(size, 22)) break;
+
+                    m_channels = big16(comm);
+                    frames = big32(comm + 2);
+                    m_bytes = (big16(comm + 6) + 7) / 8;
+                    m_samplerate = extended(comm + 8);
+                    m_encoding = Encoding::Integer;
+                    m_big_endian = true;
+                    m_unsigned = false;
+
+                    if(aifc && size >= 22)
+                    {
+                        if(match(comm + 18, "sowt")) m_big_endian = false;
+                        else if(match(comm + 18, "fl32") || match(comm + 18, "FL32")) { m_encoding = Encoding::Float; m_bytes = 4; }
+                        else if(match(comm + 18, "fl64") || match(comm + 18, "FL64")) { m_encoding = Encoding::Float; m_bytes = 8; }
+                        else if(!match(comm + 18, "NONE")) return fail("unsupported AIFC compression");
+                    }
+
+                    // the size of a frame divides the size of the samples
+                    if(m_channels < 1)
+                    {
+                        return fail("the AIFF file has no channels");
+                    }
+
+                    if(m_encoding == Encoding::Integer && (m_bytes < 1 || m_bytes > 4))
+                    {
+                        return fail("unsupported AIFF sample size");
+                    }
+
+                    format = true;
+                }
+                else if(match(chunk, "SSND"))
+                {
+                    if(!format) return fail("no format before the samples");
+
+                    uint8_t ssnd[8];
+                    if(std::fread(ssnd, 1, 8, m_file) != 8) break;
+
+                    if(size < 8 + uint64_t(big32(ssnd))) return fail("the AIFF samples are truncated");
+
+                    m_offset = body + 8 + big32(ssnd);
+                    m_frames = std::min(frames, int64_t((size - 8 - big32(ssnd)) / uint64_t(m_channels * m_bytes)));
+                    return true;
+                }
+
+                position = body + int64_t(size + (size & 1));
+                seek(position);
+            }
+
+            return fail("no samples in the AIFF file");
+        }
+
+        //! @brief Read contiguous frames (in the file) and decode them.
+        bool readRange(int64_t frame, long count, float* outs, long stride)
+        {
+            const size_t frame_bytes = size_t(m_channels * m_bytes);
+            m_raw.resize(size_t(count) * frame_bytes);
+
+            seek(m_offset + frame * int64_t(frame_bytes));
+            const size_t read = std::fread(m_raw.data(), frame_bytes, size_t(count), m_file);
+
+            // a truncated file reads as zeros
+            std::fill(m_raw.begin() + read * frame_bytes, m_raw.end(), uint8_t(m_unsigned ? 0x80 : 0));
+
+            for(long c = 0; c < m_channels; ++c)
+            {
+                decode(m_raw.data() + c * m_bytes, frame_bytes, outs + c * stride, count);
+            }
+
+            return read == size_t(count);
+        }
+
+        //! @brief Decode the samples of a channel.
+        void decode(uint8_t const* in, size_t step, float* out, long count) const
+        {
+            uint8_t bytes[8];
+
+            for(long i = 0; i < count; ++i, in += step)
+            {
+                // in little endian order
+                for(long b = 0; b < m_bytes; ++b)
+                {
+                    bytes[b] = m_big_endian ? in[m_bytes - 1 - b] : in[b];
+                }
+
+                if(m_encoding == Encoding::Float)
+                {
+                    if(m_bytes == 4)
+                    {
+                        const uint32_t word = little32(bytes);
+                        float value;
+                        std::memcpy(&value, &word, 4);
+                        out[i] = value;
+                    }
+                    else
+                    {
+                        const uint64_t word = little64(bytes);
+                        double value;
+                        std::memcpy(&value, &word, 8);
+                        out[i] = float(value);
+                    }
+                }
+                else
+                {
+                    // the bytes in the high part of an int32, shifted back with the sign
+                    uint32_t word = 0;
+                    for(long b = 0; b < m_bytes; ++b)
+                    {
+                        word |= uint32_t(bytes[b]) << (8 * (4 - m_bytes + b));
+                    }
+
+                    if(m_unsigned) word ^= 0x80000000u;
+
+                    out[i] = float(double(int32_t(word)) * (1. / 2147483648.));
+                }
+            }
+        }
+
+    private: // variables
+
+        std::FILE*              m_file = nullptr;
+        std::string             m_error;
+
+        long                    m_channels = 0;
+        int64_t                 m_frames = 0;
+        double                  m_samplerate = 0.;
+
+        // the samples: their offset in the file, size, encoding and byte order
+        int64_t                 m_offset = 0;
+        long                    m_bytes = 0;
+        Encoding                m_encoding = Encoding::Integer;
+        bool                    m_big_endian = false;
+        bool                    m_unsigned = false;
+
+        std::vector<uint8_t>    m_raw;
+    };
+}
@@ -0,0 +1,417 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief Read a sound file streamed from disk at a given speed.
+
+// header for msp objects
+#include "c74_msp.h"
+using namespace c74::max;
+
+#include <algorithm> // std::all_of, std::fill, std::min, std::max
+#include <cmath> // std::ceil
+#include <stdlib.h> // malloc, calloc, free...
+
+#include "DiskStream.hpp"
+using paccpp::DiskStream;
+
+#include "Handoff.hpp"
+using paccpp::Handoff;
+
+#include "Playback.hpp"
+
+static t_class* this_class = nullptr;
+
+//! @brief The names of the interpolations, in the order of m_interpolation.
+static const char* const interpolation_names[] = {"linear", "hermite", "sinc"};
+
+//! @brief The interpolations, the perform method of the selected one is picked by the dsp64 method.
+struct t_linear
+{
+    static void read(float const* samples, long frames, double scale, double const* phases, double* outs, long size)
+    {
+        paccpp::simd::readLinear(samples, frames, scale, phases, outs, size);
+    }
+};
+
+struct t_hermite
+{
+    static void read(float const* samples, long frames, double scale, double const* phases, double* outs, long size)
+    {
+        paccpp::simd::readHermite(samples, frames, scale, phases, outs, size);
+    }
+};
+
+struct t_sinc
+{
+    static void read(float const* samples, long frames, double scale, double const* phases, double* outs, long size)
+    {
+        paccpp::simd::readSinc(samples, frames, scale, phases, outs, size);
+    }
+};
+
+struct t_pa_readbuffer3_tilde
+{
+    t_pxobject              m_obj;
+
+    // phasor
+    double                  m_phase;
+
+    // the stream read by the audio thread, the last one opened (for the seek messages) and its file
+    Handoff<DiskStream>*    m_streams;
+    DiskStream*             m_latest;
+    t_symbol*               m_path;
+    t_clock*                m_clock;
+
+    // the read-ahead in ms (at 1x)
+    double                  m_readahead;
+
+    // the channel of the file read by each outlet (from 0)
+    long                    m_number_of_outlets;
+    long*                   m_channels;
+
+    // the interpolation
+    long                    m_interpolation;
+};
+
+//! @brief The number of samples whose phases are computed at once.
+static const long phase_block_size = 64;
+
+//! @brief Delete the stream replaced by the audio thread (message thread).
+void pa_readbuffer3_reclaim(t_pa_readbuffer3_tilde *x)
+{
+    x->m_streams->reclaim();
+}
+
+//! @brief Open the file in a new stream that starts at a position in frames, the audio thread adopts it at its next vector (message thread).
+void pa_readbuffer3_stream(t_pa_readbuffer3_tilde *x, t_symbol *s, double start)
+{
+    char filename[MAX_PATH_CHARS];
+    char path[MAX_PATH_CHARS];
+    short volume;
+    t_fourcc type;
+
+    snprintf(filename, MAX_PATH_CHARS, "%s", s->s_name);
+
+    if(locatefile_extended(filename, &volume, &type, NULL, 0) || path_toabsolutesystempath(volume, filename, path) != MAX_ERR_NONE)
+    {
+        object_error((t_object*)x, "can't find %s", s->s_name);
+        return;
+    }
+
+    const long ahead = (long)std::ceil(x->m_readahead * 0.001 * sys_getsr() / DiskStream::BlockSize);
+    DiskStream* stream = new DiskStream(path, ahead, start);
+
+    if(!stream->isOpen())
+    {
+        object_error((t_object*)x, "can't read %s: %s", s->s_name, stream->error().c_str());
+        delete stream;
+        return;
+    }
+
+    x->m_path = s;
+    x->m_latest = stream;
+    x->m_streams->publish(stream);
+}
+
+//! @brief Read the file by blocks: the phases of a block are accumulated first, then each outlet interpolates its channel.
+//! @details The phases are the ones of pa.readbuffer2~ (see Phasor.hpp), scaled to frames of the file.
+//! The positions of a block are split in runs of the same block of the stream (see DiskStream),
+//! a run is interpolated in the block, whose guard frames hold the frames around it. A block that is not in memory reads zeros.
+//! The stream is asked for the blocks ahead of the play head before the reads: it never waits for the disk.
+template<class Interpolation>
+void pa_readbuffer3_dsp_perform(t_pa_readbuffer3_tilde *x, t_object *dsp64,
+                                double **ins, long numins, double **outs, long numouts,
+                                long sampleframes, long flags, void *userparam)
+{
+    // a new stream starts where it has been opened, the previous one is deleted by the clock
+    auto adopt = [x](DiskStream& stream, DiskStream const* previous)
+    {
+        x->m_phase = double(stream.position()) / double(stream.frames());
+    };
+
+    if(x->m_streams->update(adopt))
+    {
+        clock_delay(x->m_clock, 0);
+    }
+
+    DiskStream* stream = x->m_streams->get();
+
+    if(!stream)
+    {
+        for(long c = 0; c < numouts; ++c)
+        {
+            std::fill(outs[c], outs[c] + sampleframes, 0.);
+        }
+
+        return;
+    }
+
+    double *in = ins[0];
+    const double frames = double(stream->frames());
+    const double size_inv = 1. / frames;
+    double phase = x->m_phase;
+
+    const int64_t seek = stream->takeSeek();
+
+    if(seek >= 0)
+    {
+        phase = double(seek) * size_inv;
+    }
+
+    stream->prefetch((int64_t)(phase * frames), in[0] >= 0.);
+
+    double positions[phase_block_size];
+    double offsets[phase_block_size];
+
+    // the speeds of a block are read before its outputs, that may share their memory, are written
+    for(long i = 0; i < sampleframes; i += phase_block_size)
+    {
+        const long size = std::min(phase_block_size, sampleframes - i);
+        const double speed = in[i];
+
+        if(std::all_of(in + i + 1, in + i + size, [speed](double value) { return value == speed; }))
+        {
+            phase = paccpp::simd::rampPhase(phase, speed * size_inv, positions, size);
+        }
+        else
+        {
+            phase = paccpp::simd::accumulatePhase(phase, in + i, size_inv, positions, size);
+        }
+
+        for(long j = 0; j < size; ++j)
+        {
+            positions[j] *= frames;
+        }
+
+        for(long start = 0, end = 0; start < size; start = end)
+        {
+            const int64_t block = stream->block((int64_t)positions[start]);
+            const double first = double(block * DiskStream::BlockSize);
+
+            // the positions in the block, from its first frame
+            for(; end < size && stream->block((int64_t)positions[end]) == block; ++end)
+            {
+                offsets[end] = positions[end] - first;
+            }
+
+            float const* samples = stream->find(block);
+
+            // a channel above the number of channels of the file reads the last one
+            for(long c = 0; c < numouts; ++c)
+            {
+                double *out = outs[c] + i;
+
+                if(samples)
+                {
+                    const long channel = std::min(x->m_channels[c], stream->channels() - 1);
+
+                    Interpolation::read(samples + channel * DiskStream::Stride, DiskStream::BlockSize, 1.,
+                                        offsets + start, out + start, end - start);
+                }
+                else
+                {
+                    std::fill(out + start, out + end, 0.);
+                }
+            }
+        }
+    }
+
+    x->m_phase = phase;
+    stream->play(phase * frames);
+}
+
+void pa_readbuffer3_open(t_pa_readbuffer3_tilde *x, t_symbol *s)
+{
+    pa_readbuffer3_stream(x, s, 0.);
+}
+
+//! @brief Move the play head to a time of the file in ms, at the beginning of the next vector.
+void pa_readbuffer3_seek(t_pa_readbuffer3_tilde *x, double ms)
+{
+    if(!x->m_latest)
+    {
+        object_error((t_object*)x, "no file to seek in");
+        return;
+    }
+
+    x->m_latest->seek((int64_t)(ms * 0.001 * x->m_latest->samplerate()));
+}
+
+//! @brief Set the read-ahead in ms (at 1x), the file is opened again at the play head.
+void pa_readbuffer3_set_readahead(t_pa_readbuffer3_tilde *x, double ms)
+{
+    if(ms <= 0.)
+    {
+        object_error((t_object*)x, "read-ahead must be > 0");
+        return;
+    }
+
+    x->m_readahead = ms;
+
+    if(x->m_latest)
+    {
+        pa_readbuffer3_stream(x, x->m_path, x->m_latest->position());
+    }
+}
+
+//! @brief Select the channels read by the outlets (from 1), in order.
+void pa_readbuffer3_channels(t_pa_readbuffer3_tilde *x, t_symbol *s, long argc, t_atom *argv)
+{
+    for(long c = 0; c < argc && c < x->m_number_of_outlets; ++c)
+    {
+        const t_atom_long channel = atom_getlong(argv + c);
+
+        if(channel < 1)
+        {
+            object_error((t_object*)x, "channel must be >= 1");
+        }
+
+        x->m_channels[c] = (long)std::max(channel, (t_atom_long)1) - 1;
+    }
+}
+
+void pa_readbuffer3_set_interp(t_pa_readbuffer3_tilde *x, t_symbol *name)
+{
+    for(long i = 0; i < 3; ++i)
+    {
+        if(strcmp(name->s_name, interpolation_names[i]) == 0)
+        {
+            // taken into account when the dsp chain is compiled
+            x->m_interpolation = i;
+            return;
+        }
+    }
+
+    object_error((t_object*)x, "unknown interpolation %s (linear, hermite or sinc)", name->s_name);
+}
+
+void pa_readbuffer3_status(t_pa_readbuffer3_tilde *x)
+{
+    DiskStream const* stream = x->m_latest;
+
+    if(!stream)
+    {
+        object_post((t_object*)x, "no file");
+        return;
+    }
+
+    object_post((t_object*)x, "%s: %ld channels, %lld frames at %.0f Hz, %ld blocks of %ld frames read ahead, %ld misses",
+                x->m_path->s_name, stream->channels(), (long long)stream->frames(), stream->samplerate(),
+                stream->ahead(), DiskStream::BlockSize, (long)stream->misses());
+}
+
+void pa_readbuffer3_dsp_prepare(t_pa_readbuffer3_tilde *x, t_object *dsp64,
+                                short *count, double samplerate, long maxvectorsize, long flags)
+{
+    t_perfroutine64 perform;
+
+    switch(x->m_interpolation)
+    {
+        case 1: perform = (t_perfroutine64)pa_readbuffer3_dsp_perform<t_hermite>; break;
+        case 2: perform = (t_perfroutine64)pa_readbuffer3_dsp_perform<t_sinc>; break;
+        default: perform = (t_perfroutine64)pa_readbuffer3_dsp_perform<t_linear>; break;
+    }
+
+    dsp_add64(dsp64, (t_object *)x, perform, 0, NULL);
+}
+
+void pa_readbuffer3_assist(t_pa_readbuffer3_tilde* x, void* unused,
+                           t_assist_function io, long index, char* string_dest)
+{
+    if(io == ASSIST_OUTLET)
+    {
+        snprintf(string_dest, ASSIST_STRING_MAXSIZE, "(signal) Output of channel %ld", x->m_channels[index] + 1);
+    }
+    else
+    {
+        strncpy(string_dest,"(signal) Read speed, (open) a sound file, (seek) ms, (readahead) ms, (channels) select the channels, (interp) linear, hermite or sinc, (status) post the misses", ASSIST_STRING_MAXSIZE);
+    }
+}
+
+void *pa_readbuffer3_new(t_symbol *name, long argc, t_atom *argv)
+{
+    t_pa_readbuffer3_tilde* x = (t_pa_readbuffer3_tilde*)object_alloc(this_class);
+
+    if(x)
+    {
+        long noutlets = 1;
+
+        // init number of outlets
+        if(argc >= 2 && atom_gettype(argv+1) == A_LONG)
+        {
+            noutlets = (long)atom_getlong(argv+1);
+            if(noutlets < 1)
+            {
+                noutlets = 1;
+            }
+        }
+
+        // outlet i reads channel i by default
+        x->m_number_of_outlets = noutlets;
+        x->m_channels = (long*)calloc(noutlets, sizeof(long));
+        for(long c = 0; c < noutlets; ++c)
+        {
+            x->m_channels[c] = c;
+        }
+
+        x->m_phase = 0.;
+        x->m_readahead = 1000.;
+        x->m_interpolation = 0;
+
+        // the sinc table is built once, on the message thread
+        paccpp::sincTable();
+
+        // instantiate a new Handoff object (the streams are deleted with it)
+        // Note: dont forget to delete it in the free method !
+        x->m_streams = new Handoff<DiskStream>();
+        x->m_latest = nullptr;
+        x->m_path = nullptr;
+        x->m_clock = clock_new(x, (method)pa_readbuffer3_reclaim);
+
+        dsp_setup((t_pxobject *)x, 1);
+        for(long c = 0; c < noutlets; ++c)
+        {
+            outlet_new((t_object *)x, "signal");
+        }
+
+        if(argc >= 1 && atom_gettype(argv) == A_SYM)
+        {
+            pa_readbuffer3_open(x, atom_getsym(argv));
+        }
+    }
+
+    return (x);
+}
+
+void pa_readbuffer3_free(t_pa_readbuffer3_tilde *x)
+{
+    dsp_free((t_pxobject *)x);
+    freeobject(x->m_clock);
+
+    // free the memory for the Handoff object (it stops the I/O threads of the streams and closes their files)
+    delete x->m_streams;
+    free(x->m_channels);
+}
+
+void ext_main(void *r)
+{
+    t_class *c = class_new("pa.readbuffer3~", (method)pa_readbuffer3_new, (method)pa_readbuffer3_free,
+                           sizeof(t_pa_readbuffer3_tilde), 0L, A_GIMME, 0);
+
+    class_addmethod(c, (method)pa_readbuffer3_dsp_prepare,   "dsp64",     A_CANT,     0);
+    class_addmethod(c, (method)pa_readbuffer3_open,          "open",      A_SYM,      0);
+    class_addmethod(c, (method)pa_readbuffer3_seek,          "seek",      A_FLOAT,    0);
+    class_addmethod(c, (method)pa_readbuffer3_set_readahead, "readahead", A_FLOAT,    0);
+    class_addmethod(c, (method)pa_readbuffer3_channels,      "channels",  A_GIMME,    0);
+    class_addmethod(c, (method)pa_readbuffer3_set_interp,    "interp",    A_SYM,      0);
+    class_addmethod(c, (method)pa_readbuffer3_status,        "status",                0);
+    class_addmethod(c, (method)pa_readbuffer3_assist,        "assist",    A_CANT,     0);
+
+    class_dspinit(c);
+    class_register(CLASS_BOX, c);
+
+    this_class = c;
+}
@@ -0,0 +1,284 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include "PageAllocator.hpp"
+#include "Sample.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                    RING BUFFER                                   //
+    // ================================================================================ //
+
+    //! @brief The memory of a delay line.
+    //! @details The capacity is rounded up to a power of two so the positions wrap with a mask,
+    //! and the first guard() samples are mirrored after the end of the buffer:
+    //! the guard() samples that follow a tap are contiguous in memory,
+    //! an interpolated read never has to wrap its indices.
+    //! The samples can be stored as double, float or Int24, the blocks are converted when they are written.
+    //! The pages of the buffer are mapped when it is resized (see PageAllocator), they can be locked with lock().
+    template<class SampleType>
+    class RingBuffer
+    {
+    public: // methods
+
+        using sample_t = SampleType;
+
+        //! @brief The number of mirrored samples by default (enough for a 4 points interpolation).
+        static const size_t DefaultGuard = 4;
+
+        //! @brief Default constructor, an empty buffer: nothing is allocated until resize().
+        RingBuffer() = default;
+
+        //! @brief Constructor
+        //! @param size The number of past samples that can be read.
+        //! @param guard The number of samples that can be read after a tap.
+        //! @param pages The flags of the PageAllocator.
+        explicit RingBuffer(size_t size, size_t guard = DefaultGuard, unsigned pages = 0)
+        {
+            resize(size, guard, pages);
+        }
+
+        //! Destructor
+        ~RingBuffer() = default;
+
+        //! @brief Change the size of the buffer, its content is cleared.
+        //! @param pages The flags of the PageAllocator.
+        void resize(size_t size, size_t guard = DefaultGuard, unsigned pages = 0)
+        {
+            size_t capacity = 1;
+            while(capacity < size || capacity < guard) capacity <<= 1;
+
+            m_size = size;
+            m_capacity = capacity;
+            m_mask = capacity - 1;
+            m_guard = guard;
+            m_writer = 0;
+
+            m_data = PageVector<sample_t>(capacity + guard, sample_t(0.), PageAllocator<sample_t>(pages));
+        }
+
+        //! @brief Returns the size asked by resize().
+        size_t size() const { return m_size; }
+
+        //! @brief Returns the power of two size of the buffer.
+        size_t capacity() const { return m_capacity; }
+
+        //! @brief Returns the number of samples mirrored after the end of the buffer.
+        size_t guard() const { return m_guard; }
+
+        //! @brief Lock the pages of the buffer in memory, returns false if the system refused.
+        bool lock() const
+        {
+            return lockPages(m_data.data(), m_data.size() * sizeof(sample_t));
+        }
+
+        //! @brief Set all the samples to zero.
+        void clear()
+        {
+            std::fill(m_data.begin(), m_data.end(), sample_t(0.));
+        }
+
+        //! @brief Set size samples to zero from offset samples after the write head (offset + size <= capacity()).
+        void clear(size_t offset, size_t size)
+        {
+            const size_t start = (m_writer + offset) & m_mask;
+            const size_t first = std::min(size, m_capacity - start);
+
+            std::fill(m_data.begin() + start, m_data.begin() + (start + first), sample_t(0.));
+            std::fill(m_data.begin(), m_data.begin() + (size - first), sample_t(0.));
+
+            // mirror the head if it was cleared
+            if(start < m_guard || first < size)
+            {
+                std::copy(m_data.begin(), m_data.begin() + m_guard, m_data.begin() + m_capacity);
+            }
+        }
+
+        //! @brief Write the next sample.
+        void write(sample_t value)
+        {
+            m_data[m_writer] = value;
+
+            if(m_writer < m_guard)
+            {
+                m_data[m_writer + m_capacity] = value;
+            }
+
+            m_writer = (m_writer + 1) & m_mask;
+        }
+
+        //! @brief Write a block of samples (size <= capacity()), converted to the storage type.
+        template<class ValueType>
+        void write(ValueType const* values, size_t size)
+        {
+            const size_t first = std::min(size, m_capacity - m_writer);
+
+            simd::convert(values, m_data.data() + m_writer, first);
+            simd::convert(values + first, m_data.data(), size - first);
+
+            // mirror the head if it was written
+            if(m_writer < m_guard || first < size)
+            {
+                std::copy(m_data.begin(), m_data.begin() + m_guard, m_data.begin() + m_capacity);
+            }
+
+            m_writer = (m_writer + size) & m_mask;
+        }
+
+        //! @brief Write size samples of another buffer from the one written delay samples ago, in the order they were written.
+        //! @details size <= delay <= other.capacity() and size <= capacity() (see DeferredHistory).
+        void write(RingBuffer const& other, size_t delay, size_t size)
+        {
+            const size_t start = (other.m_writer - delay) & other.m_mask;
+            const size_t first = std::min(size, other.m_capacity - start);
+
+            write(other.m_data.data() + start, first);
+            write(other.m_data.data(), size - first);
+        }
+
+        //! @brief Returns the sample written delay samples ago (1 is the last one).
+        sample_t read(size_t delay) const
+        {
+            return m_data[(m_writer - delay) & m_mask];
+        }
+
+        //! @brief Returns a pointer to the sample written delay samples ago.
+        //! @details tap(delay)[k] is the sample written (delay - k) samples ago, for k in [0, guard()].
+        sample_t const* tap(size_t delay) const
+        {
+            return m_data.data() + ((m_writer - delay) & m_mask);
+        }
+
+        //! @brief Returns the samples, followed by the guard.
+        sample_t const* data() const { return m_data.data(); }
+
+        //! @brief Returns the position of the next sample to write.
+        size_t position() const { return m_writer; }
+
+        //! @brief Returns capacity() - 1, to wrap a position.
+        size_t mask() const { return m_mask; }
+
+    private: // variables
+
+        PageVector<sample_t>    m_data;
+        size_t                  m_size = 0;
+        size_t                  m_capacity = 0;
+        size_t                  m_mask = 0;
+        size_t                  m_guard = 0;
+        size_t                  m_writer = 0;
+    };
+
+    // ================================================================================ //
+    //                                    TAP READERS                                   //
+    // ================================================================================ //
+
+    namespace simd
+    {
+        //! @brief Linear interpolating reads of a ring buffer, for a block of delay sizes.
+        //! @details The block of input samples must have been written first (from position):
+        //! the sample i of the block is delayed relatively to position + i, so the capacity of the ring buffer
+        //! must exceed the largest delay by the size of the block.
+        //! @param data The samples of the ring buffer (followed by its guard).
+        //! @param mask The capacity of the ring buffer - 1.
+        //! @param position The position of the first sample of the block in the ring buffer.
+        //! @param delays The delay sizes in samples, clipped to [1, max_delay].
+        //! The samples can have another type than the delays: they are converted when they are read.
+        template<class S, class T>
+        inline void readLinear(S const* data, size_t mask, size_t position,
+                               T const* delays, T max_delay, T* outs, long vecsize)
+        {
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const T delay = std::max(std::min(delays[i], max_delay), T(1.));
+                const size_t integer = size_t(delay);
+                const T delta = delay - T(integer);
+
+                // the sample delayed by the integer part is followed by the one before it
+                S const* reader = data + ((position + i - integer - 1) & mask);
+                const T y1 = T(reader[1]);
+                outs[i] = y1 + delta * (T(reader[0]) - y1);
+            }
+        }
+
+        #if defined(__AVX2__)
+
+        //! @brief 4 samples at a time with gathers (the capacity must fit in 31 bits).
+        template<class S>
+        inline void readLinear(S const* data, size_t mask, size_t position,
+                               double const* delays, double max_delay, double* outs, long vecsize)
+        {
+            const __m256d one = _mm256_set1_pd(1.);
+            const __m256d maximum = _mm256_set1_pd(max_delay);
+            const __m128i mask_4 = _mm_set1_epi32(int32_t(mask));
+            const __m128i step = _mm_set1_epi32(4);
+            __m128i positions = _mm_add_epi32(_mm_set1_epi32(int32_t(position - 1)), _mm_setr_epi32(0, 1, 2, 3));
+            long i = 0;
+
+            for(; i + 4 <= vecsize; i += 4)
+            {
+                const __m256d delay = _mm256_max_pd(_mm256_min_pd(_mm256_loadu_pd(delays + i), maximum), one);
+                const __m128i integer = _mm256_cvttpd_epi32(delay);
+                const __m256d delta = _mm256_sub_pd(delay, _mm256_cvtepi32_pd(integer));
+                const __m128i index = _mm_and_si128(_mm_sub_epi32(positions, integer), mask_4);
+
+                const __m256d y2 = gather(data, index);
+                const __m256d y1 = gather(data + 1, index);
+
+                _mm256_storeu_pd(outs + i, _mm256_add_pd(y1, _mm256_mul_pd(delta, _mm256_sub_pd(y2, y1))));
+                positions = _mm_add_epi32(positions, step);
+            }
+
+            readLinear<S, double>(data, mask, position + i, delays + i, max_delay, outs + i, vecsize - i);
+        }
+
+        #elif defined(__SSE2__) || defined(_M_X64)
+
+        //! @brief 2 samples at a time, the indices are computed with SIMD and the samples loaded one by one.
+        template<class S>
+        inline void readLinear(S const* data, size_t mask, size_t position,
+                               double const* delays, double max_delay, double* outs, long vecsize)
+        {
+            const __m128d one = _mm_set1_pd(1.);
+            const __m128d maximum = _mm_set1_pd(max_delay);
+            const __m128i mask_2 = _mm_set1_epi32(int32_t(mask));
+            const __m128i step = _mm_set1_epi32(2);
+            __m128i positions = _mm_add_epi32(_mm_set1_epi32(int32_t(position - 1)), _mm_setr_epi32(0, 1, 0, 0));
+            long i = 0;
+
+            for(; i + 2 <= vecsize; i += 2)
+            {
+                const __m128d delay = _mm_max_pd(_mm_min_pd(_mm_loadu_pd(delays + i), maximum), one);
+                const __m128i integer = _mm_cvttpd_epi32(delay);
+                const __m128d delta = _mm_sub_pd(delay, _mm_cvtepi32_pd(integer));
+                const __m128i index = _mm_and_si128(_mm_sub_epi32(positions, integer), mask_2);
+
+                S const* reader_0 = data + _mm_cvtsi128_si32(index);
+                S const* reader_1 = data + _mm_cvtsi128_si32(_mm_shuffle_epi32(index, 1));
+
+                const __m128d y2 = load(reader_0, reader_1);
+                const __m128d y1 = load(reader_0 + 1, reader_1 + 1);
+
+                _mm_storeu_pd(outs + i, _mm_add_pd(y1, _mm_mul_pd(delta, _mm_sub_pd(y2, y1))));
+                positions = _mm_add_epi32(positions, step);
+            }
+
+            readLinear<S, double>(data, mask, position + i, delays + i, max_delay, outs + i, vecsize - i);
+        }
+
+        #endif
+    }
+}
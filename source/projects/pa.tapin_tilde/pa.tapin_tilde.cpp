@@ -0,0 +1,155 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief The writer of a named delay line, read by pa.tapout~ objects.
+
+#include "c74_msp.h"
+using namespace c74::max;
+
+#include <string>
+
+#include "SharedDelayLine.hpp"
+using paccpp::SharedDelayLine;
+
+static t_class* this_class = nullptr;
+
+struct t_pa_tapin_tilde
+{
+    t_pxobject                  m_obj;
+    
+    t_symbol*                   m_name;
+    SharedDelayLine<double>*    m_line;
+};
+
+//! @brief Returns the symbol that points to the line of a given name (see pa.tapout~).
+//! @details The name is prefixed so that it doesn't collide with send / receive names.
+t_symbol* pa_tapin_tilde_registry_symbol(t_symbol* name)
+{
+    return gensym(("pa.tapin~ " + std::string(name->s_name)).c_str());
+}
+
+//! @brief Ask the perform method to clear the line (see DeferredClear), the readers are muted until it is done.
+void pa_tapin_tilde_clear(t_pa_tapin_tilde* x)
+{
+    x->m_line->clear();
+}
+
+void pa_tapin_tilde_perform64(t_pa_tapin_tilde* x, t_object* dsp64,
+                              double** ins, long numins, double** outs, long numouts,
+                              long vecsize, long flags, void* userparam)
+{
+    x->m_line->write(ins[0], vecsize);
+}
+
+void pa_tapin_tilde_dsp64(t_pa_tapin_tilde* x, t_object* dsp64, short* count,
+                          double samplerate, long maxvectorsize, long flags)
+{
+    // the readers count the vectors from here
+    x->m_line->prepare(maxvectorsize);
+    
+    object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
+                         dsp64, gensym("dsp_add64"), (t_object*)x,
+                         (t_perfroutine64)pa_tapin_tilde_perform64, 0, NULL);
+}
+
+void pa_tapin_tilde_assist(t_pa_tapin_tilde* x, void* unused,
+                           t_assist_function io, long index, char* string_dest)
+{
+    if(io == ASSIST_INLET)
+    {
+        strncpy(string_dest, "(signal) input to be delayed, (clear) clear the delay line", ASSIST_STRING_MAXSIZE);
+    }
+}
+
+void* pa_tapin_tilde_new(t_symbol *name, long argc, t_atom *argv)
+{
+    t_pa_tapin_tilde* x = (t_pa_tapin_tilde*)object_alloc(this_class);
+    
+    if(x)
+    {
+        x->m_name = nullptr;
+        
+        t_atom_long buffersize = (t_atom_long)(sys_getsr() * 0.1); // default to 100ms
+        
+        if(argc >= 1 && atom_gettype(argv) == A_SYM)
+        {
+            x->m_name = atom_getsym(argv);
+        }
+        else
+        {
+            object_error((t_object*)x, "missing delay line name");
+        }
+        
+        if(argc >= 2 && (atom_gettype(argv+1) == A_FLOAT || atom_gettype(argv+1) == A_LONG))
+        {
+            if(atom_getlong(argv+1) > 1)
+            {
+                buffersize = atom_getlong(argv+1);
+            }
+            else
+            {
+                object_error((t_object*)x, "buffer size must be > 1");
+            }
+        }
+        
+        // instantiate a new SharedDelayLine object
+        // Note: dont forget to release it in the free method !
+        x->m_line = new SharedDelayLine<double>(buffersize);
+        
+        // register it for the readers
+        if(x->m_name)
+        {
+            t_symbol* registry = pa_tapin_tilde_registry_symbol(x->m_name);
+            
+            if(registry->s_thing == nullptr)
+            {
+                registry->s_thing = (t_object*)x->m_line;
+            }
+            else
+            {
+                object_error((t_object*)x, "a pa.tapin~ named %s already exists", x->m_name->s_name);
+            }
+        }
+        
+        dsp_setup((t_pxobject*)x, 1);
+    }
+    
+    return x;
+}
+
+void pa_tapin_tilde_free(t_pa_tapin_tilde* x)
+{
+    dsp_free((t_pxobject*)x);
+    
+    // unregister the line, the readers that still use it keep a reference
+    if(x->m_name)
+    {
+        t_symbol* registry = pa_tapin_tilde_registry_symbol(x->m_name);
+        
+        if(registry->s_thing == (t_object*)x->m_line)
+        {
+            registry->s_thing = nullptr;
+        }
+    }
+    
+    if(x->m_line->release())
+    {
+        delete x->m_line;
+    }
+}
+
+void ext_main(void* r)
+{
+    this_class = class_new("pa.tapin~", (method)pa_tapin_tilde_new, (method)pa_tapin_tilde_free,
+                           sizeof(t_pa_tapin_tilde), 0, A_GIMME, 0);
+    
+    class_addmethod(this_class, (method)pa_tapin_tilde_assist,  "assist",   A_CANT,     0);
+    class_addmethod(this_class, (method)pa_tapin_tilde_dsp64,   "dsp64",    A_CANT,     0);
+    class_addmethod(this_class, (method)pa_tapin_tilde_clear,   "clear",                0);
+    
+    class_dspinit(this_class);
+    class_register(CLASS_BOX, this_class);
+}
@@ -0,0 +1,194 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                  PAGE ALLOCATOR                                  //
+    // ================================================================================ //
+
+    //! @brief Lock pages in memory so they are never paged out (mlock).
+    //! @return false if the system refused (eg. above the RLIMIT_MEMLOCK limit, see ulimit -l) or can't lock.
+    inline bool lockPages(void const* data, size_t size)
+    {
+        #if defined(__unix__) || defined(__APPLE__)
+        return size == 0 || mlock(data, size) == 0;
+        #else
+        return false;
+        #endif
+    }
+
+    //! @brief An allocator for the memory of a delay line, its pages are mapped when it is allocated.
+    //! @details A fresh block of memory is only mapped page by page, by the first write to each page (a minor fault).
+    //! The blocks of this allocator are mapped anonymously and every page is written before they are returned,
+    //! so the first pass of a write head on the audio thread doesn't fault.
+    //! With the HugePages flag, the block uses 2 MB pages (far fewer TLB misses when a read head moves in a large line):
+    //! explicit huge pages if the system has a pool (MAP_HUGETLB, see /proc/sys/vm/nr_hugepages),
+    //! transparent huge pages otherwise (MADV_HUGEPAGE, if they are enabled).
+    //! The pages are unlocked and unmapped with the block, see lockPages().
+    template<class T>
+    class PageAllocator
+    {
+    public: // methods
+
+        static_assert(std::is_trivially_copyable<T>::value, "the samples are stored in raw pages");
+
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        enum Flags
+        {
+            HugePages = 1
+        };
+
+        //! @brief The size of the small pages (the size of the system page if it is larger).
+        static const size_t PageSize = 4096;
+
+        //! @brief The size of the huge pages.
+        static const size_t HugePageSize = 2 * 1024 * 1024;
+
+        //! @brief Constructor
+        //! @param flags A combination of Flags.
+        PageAllocator(unsigned flags = 0) noexcept : m_flags(flags) {}
+
+        template<class U>
+        PageAllocator(PageAllocator<U> const& other) noexcept : m_flags(other.flags()) {}
+
+        //! @brief Returns the flags of the allocator.
+        unsigned flags() const noexcept { return m_flags; }
+
+        //! @brief Allocate a block of size elements, its pages are mapped.
+        T* allocate(size_t size)
+        {
+            const size_t bytes = Header + size * sizeof(T);
+            uint8_t* data = nullptr;
+
+            #if defined(__unix__) || defined(__APPLE__)
+
+            const size_t page = std::max(PageSize, size_t(sysconf(_SC_PAGESIZE)));
+            size_t length = roundUp(bytes, page);
+            void* base = MAP_FAILED;
+
+            if(m_flags & HugePages)
+            {
+                #if defined(MAP_HUGETLB)
+                // explicit huge pages are reserved by the system, they are mapped with the block
+                length = roundUp(bytes, HugePageSize);
+                base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+                #endif
+
+                if(base == MAP_FAILED)
+                {
+                    // transparent huge pages need a block aligned on a huge page
+                    length = roundUp(bytes, HugePageSize) + HugePageSize;
+                    base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+                    if(base != MAP_FAILED)
+                    {
+                        data = (uint8_t*)roundUp(size_t(base), HugePageSize);
+
+                        #if defined(MADV_HUGEPAGE)
+                        madvise(data, length - size_t(data - (uint8_t*)base), MADV_HUGEPAGE);
+                        #endif
+                    }
+                }
+            }
+            else
+            {
+                #if defined(MAP_POPULATE)
+                base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+                #else
+                base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                #endif
+            }
+
+            if(base == MAP_FAILED) throw std::bad_alloc();
+
+            if(data == nullptr) data = (uint8_t*)base;
+
+            #else
+
+            const size_t page = PageSize;
+            const size_t length = bytes;
+            void* base = ::operator new(length);
+            data = (uint8_t*)base;
+
+            #endif
+
+            // write each page (MAP_POPULATE may not have mapped them all)
+            volatile uint8_t* const pages = data;
+            for(size_t offset = 0; offset < bytes; offset += page)
+            {
+                pages[offset] = 0;
+            }
+
+            Block* const block = (Block*)data;
+            block->m_base = base;
+            block->m_length = length;
+
+            return (T*)(data + Header);
+        }
+
+        //! @brief Free a block.
+        void deallocate(T* pointer, size_t) noexcept
+        {
+            Block const* const block = (Block const*)((uint8_t*)pointer - Header);
+
+            #if defined(__unix__) || defined(__APPLE__)
+            munmap(block->m_base, block->m_length);
+            #else
+            ::operator delete(block->m_base);
+            #endif
+        }
+
+        template<class U>
+        bool operator==(PageAllocator<U> const& other) const noexcept { return m_flags == other.flags(); }
+
+        template<class U>
+        bool operator!=(PageAllocator<U> const& other) const noexcept { return m_flags != other.flags(); }
+
+    private: // methods
+
+        static size_t roundUp(size_t size, size_t alignment)
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+    private: // variables
+
+        //! @brief The mapping of a block, stored before its elements.
+        struct Block
+        {
+            void*   m_base;
+            size_t  m_length;
+        };
+
+        //! @brief The room for the Block, the elements are aligned on a cache line.
+        static const size_t Header = 64;
+
+        unsigned m_flags;
+    };
+
+    //! @brief A vector whose pages are mapped when it is allocated.
+    template<class T>
+    using PageVector = std::vector<T, PageAllocator<T>>;
+}
@@ -0,0 +1,174 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include "DeferredClear.hpp"
+#include "RingBuffer.hpp"
+
+#include <atomic>
+#include <cstddef>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                 SHARED DELAY LINE                                //
+    // ================================================================================ //
+
+    //! @brief A delay line written by one object and read by any number of others.
+    //! @details The line is reference counted: the writer and every reader hold a reference,
+    //! the last one to release it deletes it.
+    //! The writer publishes its position and the number of vectors written after each vector,
+    //! the readers only load them: reading never waits for the writer.
+    //! The readers use the number of vectors written to know if the writer has already
+    //! processed the current vector (it comes before them in the dsp chain) or not.
+    //! A clear is done by the writer a chunk per vector (see DeferredClear), the readers are muted until then.
+    //! A reader hands its line over to the audio thread with a Reference (see Handoff).
+    template<class SampleType>
+    class SharedDelayLine
+    {
+    public: // classes
+
+        //! @brief A reference to a line (or to no line), retained on construction and released on destruction.
+        //! @details The line is deleted with its last reference: a Reference is only deleted by the message thread.
+        class Reference
+        {
+        public: // methods
+
+            //! @brief Constructor, retains the line if any.
+            explicit Reference(SharedDelayLine* line = nullptr)
+            : m_line(line)
+            {
+                if(m_line) m_line->retain();
+            }
+
+            //! @brief Destructor, releases the line and deletes it if it was the last reference.
+            ~Reference()
+            {
+                if(m_line && m_line->release())
+                {
+                    delete m_line;
+                }
+            }
+
+            Reference(Reference const&) = delete;
+            Reference& operator=(Reference const&) = delete;
+
+            //! @brief Returns the line, nullptr if none.
+            SharedDelayLine* get() const { return m_line; }
+
+        private: // variables
+
+            SharedDelayLine* const m_line;
+        };
+
+    public: // methods
+
+        using sample_t = SampleType;
+
+        //! @brief Constructor, with one reference.
+        //! @param size The largest delay in samples + 1.
+        explicit SharedDelayLine(size_t size)
+        : m_buffer(size)
+        , m_size(size)
+        {
+            ;
+        }
+
+        //! Destructor
+        ~SharedDelayLine() = default;
+
+        //! @brief Add a reference to the line.
+        void retain()
+        {
+            m_references.fetch_add(1);
+        }
+
+        //! @brief Remove a reference to the line.
+        //! @return true if it was the last one, the line must then be deleted.
+        bool release()
+        {
+            return (m_references.fetch_sub(1) == 1);
+        }
+
+        //! @brief Returns the size asked at construction.
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        //! @brief Called by the writer when the dsp chain is compiled.
+        //! @details The ring buffer is enlarged by a vector (and cleared) if needed,
+        //! so a sample written at the end of a vector can't overwrite one that the beginning reads.
+        void prepare(size_t maxvectorsize)
+        {
+            if(m_buffer.size() < m_size + maxvectorsize)
+            {
+                m_buffer.resize(m_size + maxvectorsize);
+                m_position.store(0);
+                m_clear.restart(m_buffer.capacity());
+            }
+
+            m_vectors.store(0);
+        }
+
+        //! @brief Write a vector then publish it.
+        //! @details A clear asked since the last vector starts here, a chunk ahead of the write head is zeroed first.
+        void write(sample_t const* values, long vecsize)
+        {
+            m_clear.start(m_buffer.capacity());
+            m_clear.step([this](size_t offset, size_t size) { m_buffer.clear(offset, size); });
+
+            m_buffer.write(values, vecsize);
+            m_clear.written((size_t)vecsize);
+
+            m_clearing.store(m_clear.active(), std::memory_order_release);
+            m_position.store(m_buffer.position(), std::memory_order_release);
+            m_vectors.fetch_add(1, std::memory_order_release);
+        }
+
+        //! @brief Ask the writer to set all the samples to zero (message thread).
+        //! @details The samples are zeroed by write(), at most DeferredClear::Chunk per vector.
+        void clear()
+        {
+            m_clear.request();
+        }
+
+        //! @brief Returns true while the line is being cleared, the readers are muted.
+        bool clearing() const
+        {
+            return m_clearing.load(std::memory_order_acquire);
+        }
+
+        //! @brief Returns the position in the ring buffer of the first sample of the current vector.
+        //! @param vectors_read The number of vectors the reader processed before this one (since the dsp was compiled).
+        //! @param written Set to true if the writer already wrote the current vector.
+        size_t vectorPosition(long vecsize, long vectors_read, bool& written) const
+        {
+            const long vectors = m_vectors.load(std::memory_order_acquire);
+            const size_t position = m_position.load(std::memory_order_acquire);
+
+            written = (vectors > vectors_read);
+            return written ? ((position - vecsize) & m_buffer.mask()) : position;
+        }
+
+        //! @brief Returns the samples of the ring buffer (followed by its guard).
+        sample_t const* data() const { return m_buffer.data(); }
+
+        //! @brief Returns the capacity of the ring buffer - 1.
+        size_t mask() const { return m_buffer.mask(); }
+
+    private: // variables
+
+        RingBuffer<sample_t>    m_buffer;
+        const size_t            m_size;
+        DeferredClear           m_clear;
+        std::atomic<bool>       m_clearing {false};
+        std::atomic<size_t>     m_position {0};
+        std::atomic<long>       m_vectors {0};
+        std::atomic<long>       m_references {1};
+    };
+}
@@ -0,0 +1,256 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief Multiple readers of a delay line written by a pa.tapin~ object.
+
+#include "c74_msp.h"
+using namespace c74::max;
+
+#include <stdlib.h> // malloc, calloc, free...
+#include <string.h> // memcpy
+
+#include <string>
+
+#include "SharedDelayLine.hpp"
+using paccpp::SharedDelayLine;
+
+#include "Handoff.hpp"
+using paccpp::Handoff;
+
+using t_line_reference = SharedDelayLine<double>::Reference;
+
+static t_class* this_class = nullptr;
+
+struct t_pa_tapout_tilde
+{
+    t_pxobject                  m_obj;
+    
+    t_symbol*                   m_name;
+    
+    // the line read by the audio thread, and the last one published (message thread)
+    Handoff<t_line_reference>*  m_lines;
+    SharedDelayLine<double>*    m_line;
+    
+    // releases the lines replaced by the audio thread
+    t_clock*                    m_clock;
+    
+    t_atom_long                 m_number_of_readers;
+    
+    double*                     m_delay_sizes;
+    long                        m_vectors_read;
+};
+
+//! @brief Returns the symbol that points to the line of a given name (see pa.tapin~).
+t_symbol* pa_tapout_tilde_registry_symbol(t_symbol* name)
+{
+    return gensym(("pa.tapin~ " + std::string(name->s_name)).c_str());
+}
+
+void pa_tapout_tilde_reclaim(t_pa_tapout_tilde* x)
+{
+    x->m_lines->reclaim();
+}
+
+//! @brief Look for the line of the current name and hand a reference to it over to the audio thread.
+//! @details The line previously read is released by the clock once the audio thread stopped reading it.
+void pa_tapout_tilde_attach(t_pa_tapout_tilde* x)
+{
+    SharedDelayLine<double>* line = nullptr;
+    
+    if(x->m_name)
+    {
+        line = (SharedDelayLine<double>*)pa_tapout_tilde_registry_symbol(x->m_name)->s_thing;
+    }
+    
+    if(line != x->m_line)
+    {
+        x->m_line = line;
+        x->m_lines->publish(new t_line_reference(line));
+    }
+    
+    if(x->m_name && !line)
+    {
+        object_error((t_object*)x, "no pa.tapin~ named %s", x->m_name->s_name);
+    }
+}
+
+void pa_tapout_tilde_set(t_pa_tapout_tilde* x, t_symbol* name)
+{
+    x->m_name = name;
+    pa_tapout_tilde_attach(x);
+}
+
+void pa_tapout_tilde_perform64(t_pa_tapout_tilde* x, t_object* dsp64,
+                               double** ins, long numins, double** outs, long numouts,
+                               long vecsize, long flags, void* userparam)
+{
+    // adopt the last line published by the message thread,
+    // the previous one can't be released in the audio thread so we defer it to the clock.
+    if(x->m_lines->update())
+    {
+        clock_delay(x->m_clock, 0);
+    }
+    
+    t_line_reference const* reference = x->m_lines->get();
+    SharedDelayLine<double>* line = reference ? reference->get() : nullptr;
+    const t_atom_long readers = x->m_number_of_readers;
+    double* delay_sizes = x->m_delay_sizes;
+    
+    if(!line)
+    {
+        for(int j = 0; j < readers; ++j)
+        {
+            memset(outs[j], 0, vecsize * sizeof(double));
+        }
+        
+        return;
+    }
+    
+    // we first need to store the delay sizes because they may be overriden by outputs
+    for(int j = 0; j < readers; ++j)
+    {
+        memcpy(delay_sizes + j * vecsize, ins[j], vecsize * sizeof(double));
+    }
+    
+    // the current vector is in the line if the pa.tapin~ comes before in the dsp chain,
+    // otherwise the delays can't be shorter than a vector.
+    bool written = false;
+    const size_t position = line->vectorPosition(vecsize, x->m_vectors_read++, written);
+    
+    // the pa.tapin~ is clearing the line (see DeferredClear)
+    if(line->clearing())
+    {
+        for(int j = 0; j < readers; ++j)
+        {
+            memset(outs[j], 0, vecsize * sizeof(double));
+        }
+        
+        return;
+    }
+    
+    if(!written)
+    {
+        for(long i = 0; i < readers * vecsize; ++i)
+        {
+            if(delay_sizes[i] < vecsize) delay_sizes[i] = (double)vecsize;
+        }
+    }
+    
+    for(int j = 0; j < readers; ++j)
+    {
+        paccpp::simd::readLinear(line->data(), line->mask(), position,
+                                 delay_sizes + j * vecsize, (double)(line->size() - 1), outs[j], vecsize);
+    }
+}
+
+void pa_tapout_tilde_dsp64(t_pa_tapout_tilde* x, t_object* dsp64, short* count,
+                           double samplerate, long maxvectorsize, long flags)
+{
+    // the pa.tapin~ may have been replaced, and counts its vectors from here
+    pa_tapout_tilde_attach(x);
+    x->m_vectors_read = 0;
+    
+    // a vector of delay sizes per reader
+    free(x->m_delay_sizes);
+    x->m_delay_sizes = (double*)malloc(sizeof(double) * x->m_number_of_readers * maxvectorsize);
+    
+    object_method_direct(void, (t_object*, t_object*, t_perfroutine64, long, void*),
+                         dsp64, gensym("dsp_add64"), (t_object*)x,
+                         (t_perfroutine64)pa_tapout_tilde_perform64, 0, NULL);
+}
+
+void pa_tapout_tilde_assist(t_pa_tapout_tilde* x, void* unused,
+                            t_assist_function io, long index, char* string_dest)
+{
+    if(io == ASSIST_INLET)
+    {
+        strncpy(string_dest, "(signal) delay size in samps, (set) name of the pa.tapin~", ASSIST_STRING_MAXSIZE);
+    }
+    else if(io == ASSIST_OUTLET)
+    {
+        strncpy(string_dest, "(signal) Output", ASSIST_STRING_MAXSIZE);
+    }
+}
+
+void* pa_tapout_tilde_new(t_symbol *name, long argc, t_atom *argv)
+{
+    t_pa_tapout_tilde* x = (t_pa_tapout_tilde*)object_alloc(this_class);
+    
+    if(x)
+    {
+        x->m_name = nullptr;
+        x->m_lines = new Handoff<t_line_reference>();
+        x->m_line = nullptr;
+        x->m_clock = clock_new(x, (method)pa_tapout_tilde_reclaim);
+        x->m_vectors_read = 0;
+        
+        t_atom_long ndelay = 1;
+        
+        if(argc >= 1 && atom_gettype(argv) == A_SYM)
+        {
+            x->m_name = atom_getsym(argv);
+        }
+        
+        // init number of delays
+        if(argc >= 2 && atom_gettype(argv+1) == A_LONG)
+        {
+            ndelay = atom_getlong(argv+1);
+            if(ndelay < 1)
+            {
+                ndelay = 1;
+            }
+        }
+        
+        x->m_number_of_readers = ndelay;
+        
+        // allocated for the vector size by the dsp64 method
+        x->m_delay_sizes = nullptr;
+        
+        dsp_setup((t_pxobject*)x, (long)x->m_number_of_readers);
+        for(int i = 0; i < x->m_number_of_readers; ++i)
+        {
+            outlet_new(x, "signal");
+        }
+        
+        // the pa.tapin~ may be created later, it is looked for again when the dsp is compiled
+        if(x->m_name)
+        {
+            SharedDelayLine<double>* line = (SharedDelayLine<double>*)pa_tapout_tilde_registry_symbol(x->m_name)->s_thing;
+            
+            if(line)
+            {
+                x->m_line = line;
+                x->m_lines->publish(new t_line_reference(line));
+            }
+        }
+    }
+    
+    return x;
+}
+
+void pa_tapout_tilde_free(t_pa_tapout_tilde* x)
+{
+    dsp_free((t_pxobject*)x);
+    
+    free(x->m_delay_sizes);
+    
+    // get rid of the clock, then release the lines
+    freeobject(x->m_clock);
+    delete x->m_lines;
+}
+
+void ext_main(void* r)
+{
+    this_class = class_new("pa.tapout~", (method)pa_tapout_tilde_new, (method)pa_tapout_tilde_free,
+                           sizeof(t_pa_tapout_tilde), 0, A_GIMME, 0);
+    
+    class_addmethod(this_class, (method)pa_tapout_tilde_assist,     "assist",   A_CANT,     0);
+    class_addmethod(this_class, (method)pa_tapout_tilde_dsp64,      "dsp64",    A_CANT,     0);
+    class_addmethod(this_class, (method)pa_tapout_tilde_set,        "set",      A_SYM,      0);
+    
+    class_dspinit(this_class);
+    class_register(CLASS_BOX, this_class);
+}